@@ -21,32 +21,29 @@
 
 using namespace std;
 
-string Attributes::atNames[NUM_ATR];
-int Attributes::numAttrs = 0;
-//Attributes::staticInit Attributes::staticInitializer;
-
 // Default constructor
 Attributes::Attributes(void) {
-   numAttrs++;
-   if (numAttrs == 1)
-      Setup();
    attributes = 0;
 } // constructor
 
 // Alternate constructor
 Attributes::Attributes(const uint64_t a) {
-   numAttrs++;
-   if (numAttrs == 1)
-      Setup();
    attributes = a;
 } // alternate constructor
 
-// Destructor.
-Attributes::~Attributes(void) {
-   numAttrs--;
-} // Attributes destructor
+// The names of the attribute bits. They're set up only once, on first use,
+// so that Attributes (and hence GPTPart) can be trivially copyable, and
+// never change afterwards. C++ guarantees that a function-local static is
+// initialized exactly once, even if several threads get here at once.
+const vector<string> & Attributes::Names(void) {
+   static const vector<string> names = NameAttributes();
+
+   return names;
+} // Attributes::Names()
 
-void Attributes::Setup(void) {
+// Give names to the attribute bits. Used by Names().
+vector<string> Attributes::NameAttributes(void) {
+   vector<string> atNames(NUM_ATR);
    ostringstream temp;
 
    // Most bits are undefined, so start by giving them an
@@ -54,7 +51,7 @@ void Attributes::Setup(void) {
    for (int i = 0; i < NUM_ATR; i++) {
       temp.str("");
       temp << "Undefined bit #" << i;
-      Attributes::atNames[i] = temp.str();
+      atNames[i] = temp.str();
    } // for
 
    // Now reset those names that are defined....
@@ -64,7 +61,8 @@ void Attributes::Setup(void) {
    atNames[60] = "read-only";
    atNames[62] = "hidden";
    atNames[63] = "do not automount";
-}  // Attributes::Setup()
+   return atNames;
+}  // Attributes::NameAttributes()
 
 // Display current attributes to user
 void Attributes::DisplayAttributes(void) {
@@ -120,10 +118,10 @@ void Attributes::ChangeAttributes(void) {
          bitValue = UINT64_C(1) << response; // Find the integer value of the bit
          if (bitValue & attributes) { // bit is set
             attributes &= ~bitValue; // so unset it
-	         cout << "Have disabled the '" << atNames[response] << "' attribute.\n";
+	         cout << "Have disabled the '" << GetAttributeName(response) << "' attribute.\n";
          } else { // bit is not set
             attributes |= bitValue; // so set it
-            cout << "Have enabled the '" << atNames[response] << "' attribute.\n";
+            cout << "Have enabled the '" << GetAttributeName(response) << "' attribute.\n";
          } // if/else
       } // if
    } while (response != 64);
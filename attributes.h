@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 #ifndef __GPT_ATTRIBUTES
 #define __GPT_ATTRIBUTES
@@ -14,15 +15,13 @@ using namespace std;
 
 class Attributes {
 protected:
-   static string atNames[NUM_ATR];
-   static int numAttrs;
-   void Setup(void);
+   static vector<string> NameAttributes(void);
+   static const vector<string> & Names(void);
    uint64_t attributes;
 
 public:
    Attributes(void);
    Attributes(const uint64_t a);
-   ~Attributes(void);
    void operator=(uint64_t a) {attributes = a;}
 
    uint64_t GetAttributes(void) const {return attributes;}
@@ -32,7 +31,7 @@ public:
    void ChangeAttributes(void);
    bool OperateOnAttributes(const uint32_t partNum, const string& attributeOperator, const string& attributeBits);
 
-   static const string& GetAttributeName(const uint32_t bitNum) {return atNames [bitNum];}
+   static const string& GetAttributeName(const uint32_t bitNum) {return Names()[bitNum];}
    static void ListAttributes(void);
 }; // class Attributes
 
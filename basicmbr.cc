@@ -20,7 +20,11 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <iostream>
+#include <iomanip>
+#include <new>
 #include <algorithm>
+#include "diag.h"
+#include "jsonout.h"
 #include "mbr.h"
 #include "support.h"
 
@@ -57,15 +61,16 @@ BasicMBRData::BasicMBRData(const BasicMBRData & orig) {
       diskSize = orig.diskSize;
       numHeads = orig.numHeads;
       numSecspTrack = orig.numSecspTrack;
-      canDeleteMyDisk = orig.canDeleteMyDisk;
       device = orig.device;
       state = orig.state;
 
       myDisk = new DiskIO;
       if (myDisk == NULL) {
-         cerr << "Unable to allocate memory in BasicMBRData copy constructor! Terminating!\n";
-         exit(1);
+         DIAG(diag_no_memory,
+              "Unable to allocate memory in BasicMBRData copy constructor! Terminating!\n");
+         throw bad_alloc();
       } // if
+      canDeleteMyDisk = 1;
       if (orig.myDisk != NULL)
          myDisk->OpenForRead(orig.myDisk->GetName());
 
@@ -75,6 +80,31 @@ BasicMBRData::BasicMBRData(const BasicMBRData & orig) {
    } // if
 } // BasicMBRData copy constructor
 
+// Move constructor. Rather than opening the device anew, as the copy
+// constructor does, this takes over orig's DiskIO object (and the duty to
+// delete it, if orig had that), leaving orig with none.
+BasicMBRData::BasicMBRData(BasicMBRData && orig) {
+   int i;
+
+   memcpy(code, orig.code, 440);
+   diskSignature = orig.diskSignature;
+   nulls = orig.nulls;
+   MBRSignature = orig.MBRSignature;
+   blockSize = orig.blockSize;
+   diskSize = orig.diskSize;
+   numHeads = orig.numHeads;
+   numSecspTrack = orig.numSecspTrack;
+   device = move(orig.device);
+   state = orig.state;
+   myDisk = orig.myDisk;
+   canDeleteMyDisk = orig.canDeleteMyDisk;
+   orig.myDisk = NULL;
+   orig.canDeleteMyDisk = 0;
+   for (i = 0; i < MAX_MBR_PARTS; i++) {
+      partitions[i] = orig.partitions[i];
+   } // for
+} // BasicMBRData move constructor
+
 BasicMBRData::BasicMBRData(string filename) {
    blockSize = SECTOR_SIZE;
    diskSize = 0;
@@ -114,15 +144,17 @@ BasicMBRData & BasicMBRData::operator=(const BasicMBRData & orig) {
       diskSize = orig.diskSize;
       numHeads = orig.numHeads;
       numSecspTrack = orig.numSecspTrack;
-      canDeleteMyDisk = orig.canDeleteMyDisk;
       device = orig.device;
       state = orig.state;
 
+      if (canDeleteMyDisk)
+         delete myDisk;
       myDisk = new DiskIO;
       if (myDisk == NULL) {
-         cerr << "Unable to allocate memory in BasicMBRData::operator=()! Terminating!\n";
-         exit(1);
+         DIAG(diag_no_memory, "Unable to allocate memory in BasicMBRData::operator=()! Terminating!\n");
+         throw bad_alloc();
       } // if
+      canDeleteMyDisk = 1;
       if (orig.myDisk != NULL)
          myDisk->OpenForRead(orig.myDisk->GetName());
 
@@ -133,6 +165,35 @@ BasicMBRData & BasicMBRData::operator=(const BasicMBRData & orig) {
    return *this;
 } // BasicMBRData::operator=()
 
+// Move assignment -- as the move constructor, takes over orig's DiskIO
+// object rather than opening the device anew.
+BasicMBRData & BasicMBRData::operator=(BasicMBRData && orig) {
+   int i;
+
+   if (&orig != this) {
+      memcpy(code, orig.code, 440);
+      diskSignature = orig.diskSignature;
+      nulls = orig.nulls;
+      MBRSignature = orig.MBRSignature;
+      blockSize = orig.blockSize;
+      diskSize = orig.diskSize;
+      numHeads = orig.numHeads;
+      numSecspTrack = orig.numSecspTrack;
+      device = move(orig.device);
+      state = orig.state;
+      if (canDeleteMyDisk)
+         delete myDisk;
+      myDisk = orig.myDisk;
+      canDeleteMyDisk = orig.canDeleteMyDisk;
+      orig.myDisk = NULL;
+      orig.canDeleteMyDisk = 0;
+      for (i = 0; i < MAX_MBR_PARTS; i++) {
+         partitions[i] = orig.partitions[i];
+      } // for
+   } // if
+   return *this;
+} // BasicMBRData::operator=(BasicMBRData &&)
+
 /**********************
  *                    *
  * Disk I/O functions *
@@ -147,8 +208,9 @@ int BasicMBRData::ReadMBRData(const string & deviceFilename) {
    if (myDisk == NULL) {
       myDisk = new DiskIO;
       if (myDisk == NULL) {
-         cerr << "Unable to allocate memory in BasicMBRData::ReadMBRData()! Terminating!\n";
-         exit(1);
+         DIAG(diag_no_memory,
+              "Unable to allocate memory in BasicMBRData::ReadMBRData()! Terminating!\n");
+         throw bad_alloc();
       } // if
       canDeleteMyDisk = 1;
    } // if
@@ -188,7 +250,7 @@ int BasicMBRData::ReadMBRData(DiskIO * theDisk, int checkBlockSize) {
      if (myDisk->Read(&tempMBR, 512))
         err = 0;
    if (err) {
-      cerr << "Problem reading disk in BasicMBRData::ReadMBRData()!\n";
+      DIAG(diag_read_error, "Problem reading disk in BasicMBRData::ReadMBRData()!\n");
    } else {
       for (i = 0; i < 440; i++)
          code[i] = tempMBR.code[i];
@@ -233,7 +295,7 @@ int BasicMBRData::ReadMBRData(DiskIO * theDisk, int checkBlockSize) {
                // Found it, so call a function to load everything from them....
                logicalNum = ReadLogicalParts(partitions[i].GetStartLBA(), abs(logicalNum) + 1);
                if (logicalNum < 0) {
-                  cerr << "Error reading logical partitions! List may be truncated!\n";
+                  DIAG(diag_bad_logicals, "Error reading logical partitions! List may be truncated!\n");
                } // if maxLogicals valid
                DeletePartition(i);
             } // if primary partition is extended
@@ -262,8 +324,9 @@ int BasicMBRData::ReadMBRData(DiskIO * theDisk, int checkBlockSize) {
                 (partitions[i].GetType() != UINT8_C(0x00)))
                state = hybrid;
             if (logicalNum != 3)
-               cerr << "Warning! MBR Logical partitions found on a hybrid MBR disk! This is an\n"
-                    << "EXTREMELY dangerous configuration!\n\a";
+               DIAG(diag_hybrid_logicals,
+                    "Warning! MBR Logical partitions found on a hybrid MBR disk! This is an\n"
+                    << "EXTREMELY dangerous configuration!\n\a");
          } // for
       } // if (hybrid detection code)
    } // no initial error
@@ -290,7 +353,7 @@ int BasicMBRData::ReadLogicalParts(uint64_t extendedStart, int partNum) {
    while (another && (partNum < MAX_MBR_PARTS) && (partNum >= 0) && (allOK > 0)) {
       for (i = 0; i < MAX_MBR_PARTS; i++) {
          if (EbrLocations[i] == offset) { // already read this one; infinite logical partition loop!
-            cerr << "Logical partition infinite loop detected! This is being corrected.\n";
+            DIAG(diag_ebr_loop, "Logical partition infinite loop detected! This is being corrected.\n");
             allOK = -1;
             if(partNum > 0) //don't go negative
                 partNum -= 1;
@@ -298,12 +361,12 @@ int BasicMBRData::ReadLogicalParts(uint64_t extendedStart, int partNum) {
       } // for
       EbrLocations[partNum] = offset;
       if (myDisk->Seek(offset) == 0) { // seek to EBR record
-         cerr << "Unable to seek to " << offset << "! Aborting!\n";
+         DIAG(diag_seek_error, "Unable to seek to " << offset << "! Aborting!\n");
          allOK = -1;
       }
       if (myDisk->Read(&ebr, 512) != 512) { // Load the data....
-         cerr << "Error seeking to or reading logical partition data from " << offset
-              << "!\nSome logical partitions may be missing!\n";
+         DIAG(diag_read_error, "Error seeking to or reading logical partition data from " << offset
+              << "!\nSome logical partitions may be missing!\n");
          allOK = -1;
       } else if (IsLittleEndian() != 1) { // Reverse byte ordering of some data....
          ReverseBytes(&ebr.MBRSignature, 2);
@@ -315,14 +378,9 @@ int BasicMBRData::ReadLogicalParts(uint64_t extendedStart, int partNum) {
 
       if (ebr.MBRSignature != MBR_SIGNATURE) {
          allOK = -1;
-         cerr << "EBR signature for logical partition invalid; read 0x";
-         cerr.fill('0');
-         cerr.width(4);
-         cerr.setf(ios::uppercase);
-         cerr << hex << ebr.MBRSignature << ", but should be 0x";
-         cerr.width(4);
-         cerr << MBR_SIGNATURE << dec << "\n";
-         cerr.fill(' ');
+         DIAG(diag_bad_ebr, "EBR signature for logical partition invalid; read 0x" << uppercase
+              << hex << setfill('0') << setw(4) << ebr.MBRSignature << ", but should be 0x"
+              << setw(4) << MBR_SIGNATURE << "\n");
       } // if
 
       if ((partNum >= 0) && (partNum < MAX_MBR_PARTS) && (allOK > 0)) {
@@ -331,7 +389,7 @@ int BasicMBRData::ReadLogicalParts(uint64_t extendedStart, int partNum) {
          // the logical partition when this is the case....
          ebrType = ebr.partitions[0].partitionType;
          if ((ebrType == 0x05) || (ebrType == 0x0f) || (ebrType == 0x85)) {
-            cout << "EBR points to an EBR!\n";
+            DIAG(diag_ebr_to_ebr, "EBR points to an EBR!\n");
             offset = extendedStart + ebr.partitions[0].firstLBA;
          } else {
             // Copy over the basic data....
@@ -362,7 +420,7 @@ int BasicMBRData::WriteMBRData(void) {
    if (myDisk != NULL) {
       if (myDisk->OpenForWrite() != 0) {
          allOK = WriteMBRData(myDisk);
-         cout << "Done writing data!\n";
+         DIAG(diag_write_done, "Done writing data!\n");
       } else {
          allOK = 0;
       } // if/else
@@ -465,11 +523,11 @@ int BasicMBRData::WriteMBRData(struct TempMBR & mbr, DiskIO *theDisk, uint64_t s
    if (allOK && theDisk->Seek(sector)) {
       if (theDisk->Write(&mbr, 512) != 512) {
          allOK = 0;
-         cerr << "Error " << errno << " when saving MBR!\n";
+         DIAG(diag_write_error, "Error " << errno << " when saving MBR!\n");
       } // if
    } else {
       allOK = 0;
-      cerr << "Error " << errno << " when seeking to MBR to write it!\n";
+      DIAG(diag_seek_error, "Error " << errno << " when seeking to MBR to write it!\n");
    } // if/else
    theDisk->Close();
 
@@ -491,12 +549,22 @@ int BasicMBRData::WriteMBRData(struct TempMBR & mbr, DiskIO *theDisk, uint64_t s
 void BasicMBRData::SetDisk(DiskIO *theDisk) {
    int err;
 
+   if (canDeleteMyDisk && (myDisk != theDisk))
+      delete myDisk;
    myDisk = theDisk;
    diskSize = theDisk->DiskSize(&err);
    canDeleteMyDisk = 0;
    ReadCHSGeom();
 } // BasicMBRData::SetDisk()
 
+// If the MBR uses oldDisk, switch it to newDisk, without re-reading the
+// disk's size or geometry. For use when the object that owns a DiskIO has
+// been moved, taking the open device to a new DiskIO object.
+void BasicMBRData::RelinkDisk(DiskIO *oldDisk, DiskIO *newDisk) {
+   if (myDisk == oldDisk)
+      myDisk = newDisk;
+} // BasicMBRData::RelinkDisk()
+
 /********************************************
  *                                          *
  * Functions that display data for the user *
@@ -534,6 +602,39 @@ void BasicMBRData::DisplayMBRData(void) {
    } // for
 } // BasicMBRData::DisplayMBRData()
 
+// Show what DisplayMBRData() does as a JSON object, with exact sizes
+// rather than rounded ones.
+void BasicMBRData::ShowJSON(ostream & os) {
+   static const char* stateNames[] = {"invalid", "protective", "hybrid", "mbr"};
+   static const char* inclusionNames[] = {"omitted", "primary", "logical"};
+   JSONWriter json;
+   uint64_t length;
+   int i;
+
+   json.BeginObject().Put("sectors", diskSize).Put("sector_size", blockSize);
+   json.PutHex("disk_signature", diskSignature, 8).Put("state", stateNames[state]);
+   json.Key("partitions").BeginArray();
+   for (i = 0; i < MAX_MBR_PARTS; i++) {
+      length = partitions[i].GetLengthLBA();
+      if (length != 0) {
+         json.BeginObject(1).Put("number", i + 1);
+         json.PutBool("bootable", partitions[i].GetStatus() & 0x80);
+         json.PutHex("status", partitions[i].GetStatus(), 2);
+         json.Put("first_lba", partitions[i].GetStartLBA());
+         json.Put("last_lba", partitions[i].GetLastLBA());
+         json.Put("sectors", length).Put("bytes", length * blockSize);
+         json.PutHex("type", partitions[i].GetType(), 2);
+         if (partitions[i].GetInclusion() <= LOGICAL)
+            json.Put("inclusion", inclusionNames[partitions[i].GetInclusion()]);
+         else
+            json.Put("inclusion", "error");
+         json.EndObject();
+      } // if
+   } // for
+   json.EndArray().EndObject();
+   json.Flush(os);
+} // BasicMBRData::ShowJSON()
+
 // Displays the state, as a word, on stdout. Used for debugging & to
 // tell the user about the MBR state when the program launches....
 void BasicMBRData::ShowState(void) {
@@ -649,15 +750,17 @@ int BasicMBRData::BlankGPTData(void) {
 
 // Read the CHS geometry using OS calls, or if that fails, set to
 // the most common value for big disks (255 heads, 63 sectors per
-// track, & however many cylinders that computes to).
+// track, & however many cylinders that computes to), and hand it on
+// to the partitions.
 void BasicMBRData::ReadCHSGeom(void) {
-   int err;
+   int err, i;
 
    numHeads = myDisk->GetNumHeads();
    numSecspTrack = myDisk->GetNumSecsPerTrack();
    diskSize = myDisk->DiskSize(&err);
    blockSize = myDisk->GetBlockSize();
-   partitions[0].SetGeometry(numHeads, numSecspTrack, diskSize, blockSize);
+   for (i = 0; i < MAX_MBR_PARTS; i++)
+      partitions[i].SetGeometry(numHeads, numSecspTrack, diskSize, blockSize);
 } // BasicMBRData::ReadCHSGeom()
 
 // Find the low and high used partition numbers (numbered from 0).
@@ -740,6 +843,17 @@ int BasicMBRData::LBAtoCHS(uint64_t lba, uint8_t * chs) {
 // conditions that the user should be told about.
 // Returns the number of problems found
 int BasicMBRData::FindOverlaps(void) {
+   VerifyReport report;
+   int numProbs;
+
+   numProbs = FindOverlaps(report);
+   DiagReport(report);
+   return numProbs;
+} // BasicMBRData::FindOverlaps()
+
+// As FindOverlaps(), but record what it finds in report rather than
+// displaying it.
+int BasicMBRData::FindOverlaps(VerifyReport & report) {
    int i, j, numProbs = 0, numEE = 0, ProtectiveOnOne = 0;
 
    for (i = 0; i < MAX_MBR_PARTS; i++) {
@@ -747,8 +861,7 @@ int BasicMBRData::FindOverlaps(void) {
          if ((partitions[i].GetInclusion() != NONE) && (partitions[j].GetInclusion() != NONE) &&
              (partitions[i].DoTheyOverlap(partitions[j]))) {
             numProbs++;
-            cout << "\nProblem: MBR partitions " << i + 1 << " and " << j + 1
-                 << " overlap!\n";
+            report.Add(verify_mbr_overlap, i, j);
          } // if
       } // for (j...)
       if (partitions[i].GetType() == 0xEE) {
@@ -759,14 +872,12 @@ int BasicMBRData::FindOverlaps(void) {
    } // for (i...)
 
    if (numEE > 1)
-      cout << "\nCaution: More than one 0xEE MBR partition found. This can cause problems\n"
-           << "in some OSes.\n";
+      report.Add(verify_mbr_multiple_ee);
    if (!ProtectiveOnOne && (numEE > 0))
-      cout << "\nWarning: 0xEE partition doesn't start on sector 1. This can cause "
-           << "problems\nin some OSes.\n";
+      report.Add(verify_mbr_ee_not_on_1);
 
    return numProbs;
-} // BasicMBRData::FindOverlaps()
+} // BasicMBRData::FindOverlaps(VerifyReport &)
 
 // Returns the number of primary partitions, including the extended partition
 // required to hold any logical partitions found.
@@ -1031,6 +1142,10 @@ void BasicMBRData::EmptyBootloader(void) {
 // since those toss the rulebook away anyhow....
 void BasicMBRData::AddPart(int num, const MBRPart& newPart) {
    partitions[num] = newPart;
+   // newPart's CHS values were computed for whatever geometry it was set
+   // up with; recompute them for this disk's....
+   partitions[num].SetGeometry(numHeads, numSecspTrack, diskSize, blockSize);
+   partitions[num].SetLocation(partitions[num].GetStartLBA(), partitions[num].GetLengthLBA());
 } // BasicMBRData::AddPart()
 
 // Create a partition of the specified number, starting LBA, and
@@ -1135,13 +1250,15 @@ int BasicMBRData::SetInclusionwChecks(int num, int inclStatus) {
          partitions[num].SetInclusion(inclStatus);
          if (!IsLegal()) {
             partitions[num].SetInclusion(origValue);
-            cerr << "Specified change is not legal! Aborting change!\n";
+            DIAG(diag_mbr_change_illegal, "Specified change is not legal! Aborting change!\n");
          } // if
       } else {
-         cerr << "Invalid partition inclusion code in BasicMBRData::SetInclusionwChecks()!\n";
+         DIAG(diag_internal,
+              "Invalid partition inclusion code in BasicMBRData::SetInclusionwChecks()!\n");
       } // if/else
    } else {
-      cerr << "Partition table is not currently in a valid state. Aborting change!\n";
+      DIAG(diag_mbr_change_illegal,
+           "Partition table is not currently in a valid state. Aborting change!\n");
       allOK = 0;
    } // if/else
    return allOK;
@@ -1175,8 +1292,9 @@ int BasicMBRData::DeleteOversizedParts() {
    for (i = 0; i < MAX_MBR_PARTS; i++) {
       if ((partitions[i].GetStartLBA() > diskSize) || (partitions[i].GetLastLBA() > diskSize) ||
           (partitions[i].GetStartLBA() > UINT32_MAX) || (partitions[i].GetLengthLBA() > UINT32_MAX)) {
-         cerr << "\aWarning: Deleting oversized partition #" << i + 1 << "! Start = "
-              << partitions[i].GetStartLBA() << ", length = " << partitions[i].GetLengthLBA() << "\n";
+         DIAG(diag_mbr_oversized_deleted, "\aWarning: Deleting oversized partition #" << i + 1
+              << "! Start = " << partitions[i].GetStartLBA() << ", length = "
+              << partitions[i].GetLengthLBA() << "\n");
          partitions[i].Empty();
          num++;
       } // if
@@ -1328,7 +1446,8 @@ int BasicMBRData::RemoveLogicalsFromFirstFour(void) {
             j++;
          } while ((j < MAX_MBR_PARTS) && !swapped);
          if (j >= MAX_MBR_PARTS)
-            cerr << "Warning! Too many partitions in BasicMBRData::RemoveLogicalsFromFirstFour()!\n";
+            DIAG(diag_internal,
+                 "Warning! Too many partitions in BasicMBRData::RemoveLogicalsFromFirstFour()!\n");
       } // if
    } // for i...
    return numMoved;
@@ -1377,6 +1496,7 @@ int BasicMBRData::CreateExtended(void) {
       if (NumLogicals() > 0) {
          SortMBR(4); // sort starting from 4 -- that is, logicals only
          temp.Empty();
+         temp.SetGeometry(numHeads, numSecspTrack, diskSize, blockSize);
          temp.SetStartLBA(FirstLogicalLBA() - 1);
          temp.SetLengthLBA(LastLogicalLBA() - FirstLogicalLBA() + 2);
          temp.SetType(0x0f, 1);
@@ -1389,7 +1509,7 @@ int BasicMBRData::CreateExtended(void) {
             i++;
          } while ((i < 4) && !swapped);
          if (!swapped) {
-            cerr << "Could not create extended partition; no room in primary table!\n";
+            DIAG(diag_no_extended, "Could not create extended partition; no room in primary table!\n");
             allOK = 0;
          } // if
       } // if (NumLogicals() > 0)
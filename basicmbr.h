@@ -7,6 +7,7 @@
 #include <sys/types.h>
 #include "diskio.h"
 #include "mbrpart.h"
+#include "verifyreport.h"
 
 #ifndef __BASICMBRSTRUCTS
 #define __BASICMBRSTRUCTS
@@ -65,8 +66,10 @@ public:
    BasicMBRData(void);
    BasicMBRData(string deviceFilename);
    BasicMBRData(const BasicMBRData &);
+   BasicMBRData(BasicMBRData && orig);
    ~BasicMBRData(void);
    BasicMBRData & operator=(const BasicMBRData & orig);
+   BasicMBRData & operator=(BasicMBRData && orig);
 
    // File I/O functions...
    int ReadMBRData(const string & deviceFilename);
@@ -78,9 +81,11 @@ public:
    int WriteMBRData(struct TempMBR & mbr, DiskIO *theDisk, uint64_t sector);
    void DiskSync(void) {myDisk->DiskSync();}
    void SetDisk(DiskIO *theDisk);
+   void RelinkDisk(DiskIO *oldDisk, DiskIO *newDisk);
 
    // Display data for user...
    void DisplayMBRData(void);
+   void ShowJSON(ostream & os);
    void ShowState(void);
 
    // GPT checks and fixes...
@@ -96,6 +101,7 @@ public:
    int GetPartRange(uint32_t* low, uint32_t* high);
    int LBAtoCHS(uint64_t lba, uint8_t * chs); // Convert LBA to CHS
    int FindOverlaps(void);
+   int FindOverlaps(VerifyReport & report);
    int NumPrimaries(void);
    int NumLogicals(void);
    int CountParts(void);
@@ -0,0 +1,251 @@
+// batch.cc
+// Class to run one sgdisk command line on many devices at once, each in
+// its own child process, and to report the results in order.
+
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "batch.h"
+
+using namespace std;
+
+DeviceBatch::DeviceBatch(void) {
+   maxJobs = BATCH_DEFAULT_JOBS;
+} // DeviceBatch constructor
+
+DeviceBatch::~DeviceBatch(void) {
+   for (BatchDevice & device : devices) {
+      if (device.output != NULL)
+         fclose(device.output);
+      if (device.errors != NULL)
+         fclose(device.errors);
+   } // for
+} // DeviceBatch destructor
+
+// Add one device to the end of the list.
+void DeviceBatch::AddDevice(const string & name) {
+   BatchDevice device;
+
+   device.name = name;
+   device.pid = 0;
+   device.done = 0;
+   device.retval = 0;
+   device.output = device.errors = NULL;
+   devices.push_back(device);
+} // DeviceBatch::AddDevice()
+
+// Add the devices matching patterns, a comma-separated list of glob
+// patterns (such as /dev/sd[a-z]), in sorted order for each pattern. A
+// pattern that matches nothing is added as it is, so that the user hears
+// about the missing device. Returns the number of devices added.
+int DeviceBatch::AddDevices(const string & patterns) {
+   istringstream inString(patterns);
+   string pattern;
+   glob_t matches;
+   size_t i;
+   int numAdded = 0;
+
+   while (getline(inString, pattern, ',')) {
+      if (pattern.empty())
+         continue;
+      if (glob(pattern.c_str(), GLOB_NOCHECK, NULL, &matches) == 0) {
+         for (i = 0; i < matches.gl_pathc; i++) {
+            AddDevice(matches.gl_pathv[i]);
+            numAdded++;
+         } // for
+         globfree(&matches);
+      } else {
+         AddDevice(pattern);
+         numAdded++;
+      } // if/else
+   } // while
+   return numAdded;
+} // DeviceBatch::AddDevices()
+
+// Add the devices named in a file (or standard input, if filename is "-"),
+// one per line. Blank lines and text from a '#' to the end of a line are
+// ignored. Returns 1 on success, 0 if the file couldn't be read.
+int DeviceBatch::AddDeviceList(const string & filename) {
+   ifstream inFile;
+   istream* in = &cin;
+   string line;
+   size_t pos;
+
+   if (filename != "-") {
+      inFile.open(filename.c_str());
+      if (!inFile.is_open()) {
+         cerr << "Unable to open device list " << filename << "!\n";
+         return 0;
+      } // if
+      in = &inFile;
+   } // if
+   while (getline(*in, line)) {
+      pos = line.find('#');
+      if (pos != string::npos)
+         line.erase(pos);
+      pos = line.find_first_not_of(" \t\r");
+      line.erase(0, (pos == string::npos) ? line.length() : pos);
+      pos = line.find_last_not_of(" \t\r");
+      line.erase((pos == string::npos) ? 0 : pos + 1);
+      if (!line.empty())
+         AddDevice(line);
+   } // while
+   return 1;
+} // DeviceBatch::AddDeviceList()
+
+// Set the most devices to work on at once.
+void DeviceBatch::SetMaxJobs(int jobs) {
+   maxJobs = (jobs > 0) ? jobs : 1;
+} // DeviceBatch::SetMaxJobs()
+
+// Start a child process for device num, with its output going to temporary
+// files. Returns 1 in the child, 0 in the parent if the child started, or
+// -1 if it couldn't be started.
+int DeviceBatch::StartDevice(size_t num) {
+   BatchDevice & device = devices[num];
+   int nullFD;
+
+   device.output = tmpfile();
+   device.errors = tmpfile();
+   if ((device.output != NULL) && (device.errors != NULL))
+      device.pid = fork();
+   else
+      device.pid = -1;
+   if (device.pid < 0) {
+      if (device.output != NULL)
+         fclose(device.output);
+      if (device.errors != NULL)
+         fclose(device.errors);
+      device.output = device.errors = NULL;
+      device.pid = 0;
+      return -1;
+   } // if
+   if (device.pid == 0) {
+      // The options are the same for every device, so none of them may
+      // read standard input....
+      nullFD = open("/dev/null", O_RDONLY);
+      if (nullFD >= 0) {
+         dup2(nullFD, STDIN_FILENO);
+         close(nullFD);
+      } // if
+      dup2(fileno(device.output), STDOUT_FILENO);
+      dup2(fileno(device.errors), STDERR_FILENO);
+      return 1;
+   } // if
+   return 0;
+} // DeviceBatch::StartDevice()
+
+// Copy everything written to from (a temporary file) to to.
+void DeviceBatch::Copy(FILE* from, FILE* to) {
+   char buffer[65536];
+   size_t numRead;
+
+   rewind(from);
+   while ((numRead = fread(buffer, 1, sizeof(buffer), from)) > 0)
+      fwrite(buffer, 1, numRead, to);
+   fflush(to);
+} // DeviceBatch::Copy()
+
+// Show the output of the (finished) child that handled device num.
+void DeviceBatch::ReportDevice(size_t num) {
+   BatchDevice & device = devices[num];
+
+   cout << ((num > 0) ? "\n" : "") << "==> " << device.name << " <==\n";
+   cout.flush();
+   if (device.output != NULL) {
+      Copy(device.output, stdout);
+      fclose(device.output);
+      device.output = NULL;
+   } // if
+   if (device.errors != NULL) {
+      Copy(device.errors, stderr);
+      fclose(device.errors);
+      device.errors = NULL;
+   } // if
+} // DeviceBatch::ReportDevice()
+
+// Work on every device in the list, at most maxJobs at a time. In each
+// child, returns the name of the device that the child is to work on (the
+// caller should do so, with standard output and standard error as they
+// are, and then exit with the usual return value). In the parent, returns
+// NULL once every device has been reported on, with *retval set to the
+// highest of the children's return values; GetRetval() gives each one.
+const char* DeviceBatch::Run(int *retval) {
+   size_t next = 0, reported = 0, i;
+   int running = 0, started, status;
+   pid_t pid;
+
+   *retval = 0;
+   // Anything still buffered would be written again by every child....
+   cout.flush();
+   cerr.flush();
+   fflush(stdout);
+   fflush(stderr);
+   while (reported < devices.size()) {
+      while ((running < maxJobs) && (next < devices.size())) {
+         started = StartDevice(next);
+         if (started == 1)
+            return devices[next].name.c_str();
+         if (started == 0) {
+            running++;
+         } else if (running > 0) {
+            break; // try again once a child has finished
+         } else {
+            cerr << "Unable to start work on " << devices[next].name << "!\n";
+            devices[next].done = 1;
+            devices[next].retval = 1;
+         } // if/else
+         next++;
+      } // while
+      if (running > 0) {
+         pid = waitpid(-1, &status, 0);
+         if ((pid < 0) && (errno == ECHILD)) {
+            // Shouldn't happen, but don't wait forever if it does....
+            for (i = 0; i < devices.size(); i++) {
+               if ((devices[i].pid != 0) && !devices[i].done) {
+                  devices[i].done = 1;
+                  devices[i].retval = 1;
+               } // if
+            } // for
+            running = 0;
+         } else if (pid > 0) {
+            for (i = 0; i < devices.size(); i++) {
+               if ((devices[i].pid == pid) && !devices[i].done) {
+                  devices[i].done = 1;
+                  if (WIFEXITED(status))
+                     devices[i].retval = WEXITSTATUS(status);
+                  else
+                     devices[i].retval = 128 + WTERMSIG(status);
+                  running--;
+               } // if
+            } // for
+         } // if
+      } // if
+      while ((reported < devices.size()) && devices[reported].done)
+         ReportDevice(reported++);
+   } // while
+
+   for (const BatchDevice & device : devices) {
+      if (device.retval > *retval)
+         *retval = device.retval;
+   } // for
+   return NULL;
+} // DeviceBatch::Run()
+
+// Show the return value of each device's child, after Run().
+void DeviceBatch::ShowReturnValues(void) {
+   cout << "\nReturn values:\n";
+   for (const BatchDevice & device : devices)
+      cout << "   " << device.name << ": " << device.retval << "\n";
+} // DeviceBatch::ShowReturnValues()
@@ -0,0 +1,62 @@
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+// Batch mode for sgdisk. A DeviceBatch holds a list of devices (given as
+// glob patterns or read from a file) and applies one set of options to all
+// of them at once, in a pool of up to maxJobs child processes; each idle
+// slot takes the next device in the list as soon as it's free. Each
+// child's output is held until every device before it has been reported,
+// so the combined output is in list order however the children finish.
+//
+// Children, rather than threads, do the work because GPTDataCL, which
+// carries out the options, writes its listings, prompts, and reports
+// straight to the process-wide cout and cerr (and changes cout's format
+// flags), so its output for one disk can't be told apart from another's
+// in a shared process. Diagnostics could be kept per thread with a
+// DiagSink, but the rest of its output can't.
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+#ifndef __GPT_BATCH
+#define __GPT_BATCH
+
+using namespace std;
+
+#define BATCH_DEFAULT_JOBS 32
+
+class DeviceBatch {
+protected:
+   // One device and the state of the child handling it
+   struct BatchDevice {
+      string name;
+      pid_t pid; // 0 if not started
+      int done;
+      int retval;
+      FILE* output; // the child's standard output...
+      FILE* errors; // ...and standard error
+   }; // struct BatchDevice
+   vector<BatchDevice> devices;
+   int maxJobs;
+
+   int StartDevice(size_t num);
+   void ReportDevice(size_t num);
+   void Copy(FILE* from, FILE* to);
+public:
+   DeviceBatch(void);
+   ~DeviceBatch(void);
+
+   void AddDevice(const string & name);
+   int AddDevices(const string & patterns);
+   int AddDeviceList(const string & filename);
+   size_t NumDevices(void) const {return devices.size();}
+   const string & GetName(size_t num) const {return devices[num].name;}
+   int GetRetval(size_t num) const {return devices[num].retval;}
+   void SetMaxJobs(int jobs);
+   const char* Run(int *retval);
+   void ShowReturnValues(void);
+}; // class DeviceBatch
+
+#endif
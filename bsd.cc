@@ -19,7 +19,9 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <iostream>
+#include <new>
 #include <string>
+#include "diag.h"
 #include "support.h"
 #include "bsd.h"
 
@@ -137,8 +139,8 @@ int BSDData::ReadBSDData(DiskIO *theDisk, uint64_t startSector, uint64_t endSect
    if (state == bsd) {
       partitions = new struct BSDRecord[numParts * sizeof(struct BSDRecord)];
       if (partitions == NULL) {
-         cerr << "Unable to allocate memory in BSDData::ReadBSDData()! Terminating!\n";
-         exit(1);
+         DIAG(diag_no_memory, "Unable to allocate memory in BSDData::ReadBSDData()! Terminating!\n");
+         throw bad_alloc();
       } // if
       for (i = 0; i < numParts; i++) {
          // Once again, we use the buffer, but index it using a BSDRecord
@@ -33,6 +33,7 @@ int main(int argc, char *argv[]) {
 
    if (!SizesOK())
       exit(1);
+   cout.setf(ios::uppercase); // hex values are shown in upper case
 
    switch (argc) {
       case 1:
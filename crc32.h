@@ -15,6 +15,5 @@
 
 #include <stdint.h>
 
-void chksum_crc32gentab ();
 uint32_t chksum_crc32 (unsigned char *block, unsigned int length);
-extern unsigned int crc_tab[256];
+uint32_t chksum_crc32_continue (uint32_t prev, unsigned char *block, unsigned int length);
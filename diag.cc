@@ -0,0 +1,207 @@
+// diag.cc
+// Classes and functions to pass the partition-table code's warnings, errors,
+// and notes on to a sink that shows, keeps, or discards them.
+
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+#include <stdint.h>
+#include <iostream>
+#include "diag.h"
+#include "verifyreport.h"
+
+using namespace std;
+
+// Indexed by DiagID
+static const DiagIDInfo idInfo[] = {
+   {"no_memory", diag_error, 1},
+   {"internal", diag_error, 1},
+   {"open_error", diag_error, 1},
+   {"not_a_disk", diag_error, 1},
+   {"read_error", diag_error, 1},
+   {"seek_error", diag_error, 1},
+   {"write_error", diag_error, 1},
+   {"close_error", diag_warning, 1},
+   {"shared_lock", diag_warning, 1},
+   {"sector_size_unknown", diag_warning, 1},
+   {"odd_file_size", diag_warning, 1},
+   {"unknown_platform", diag_warning, 1},
+   {"kernel_not_updated", diag_warning, 0},
+   {"kernel_updated", diag_info, 0},
+   {"write_test_failed", diag_warning, 0},
+   {"read_only", diag_warning, 0},
+   {"gpt_version", diag_warning, 0},
+   {"header_size_invalid", diag_warning, 1},
+   {"header_size_large", diag_warning, 0},
+   {"disk_smaller_than_header", diag_warning, 0},
+   {"backup_header_rebuilt", diag_warning, 1},
+   {"main_header_rebuilt", diag_warning, 1},
+   {"loaded_backup_table", diag_warning, 1},
+   {"no_table_loaded", diag_error, 1},
+   {"crc_mismatch", diag_warning, 1},
+   {"table_crc", diag_warning, 0},
+   {"tables_differ", diag_warning, 1},
+   {"bad_entry_size", diag_error, 1},
+   {"table_too_big", diag_error, 1},
+   {"table_too_small", diag_error, 0},
+   {"table_size_adjusted", diag_info, 0},
+   {"table_location", diag_error, 1},
+   {"invalid_partition_data", diag_error, 1},
+   {"mbr_ee_oversized", diag_warning, 1},
+   {"apm_found", diag_warning, 0},
+   {"converting_mbr", diag_warning, 0},
+   {"converting_bsd", diag_warning, 0},
+   {"found_gpt", diag_info, 0},
+   {"found_gpt_bad_mbr", diag_warning, 0},
+   {"found_damaged_gpt", diag_warning, 0},
+   {"new_gpt", diag_info, 0},
+   {"check_failed", diag_warning, 0},
+   {"backup_header_moved", diag_warning, 1},
+   {"mbr_too_big", diag_warning, 1},
+   {"write_refused", diag_error, 1},
+   {"write_aborted", diag_info, 0},
+   {"write_done", diag_info, 0},
+   {"backup_size_mismatch", diag_warning, 0},
+   {"bad_backup_file", diag_error, 1},
+   {"gpt_destroyed", diag_info, 0},
+   {"no_partitions", diag_error, 0},
+   {"no_such_partition", diag_error, 0},
+   {"partition_out_of_range", diag_error, 1},
+   {"bsd_converted", diag_info, 0},
+   {"bsd_unrecognized", diag_error, 0},
+   {"too_many_partitions", diag_warning, 1},
+   {"partition_omitted", diag_warning, 0},
+   {"past_32_bits", diag_warning, 0},
+   {"start_aligned", diag_info, 0},
+   {"end_aligned", diag_info, 0},
+   {"guid_in_use", diag_error, 1},
+   {"alignment_mismatch", diag_warning, 0},
+   {"zero_alignment", diag_error, 1},
+   {"bad_uuid", diag_warning, 1},
+   {"unknown_type", diag_warning, 0},
+   {"bad_logicals", diag_warning, 1},
+   {"hybrid_logicals", diag_warning, 1},
+   {"ebr_loop", diag_warning, 1},
+   {"bad_ebr", diag_warning, 1},
+   {"ebr_to_ebr", diag_info, 0},
+   {"mbr_change_illegal", diag_error, 1},
+   {"mbr_oversized_deleted", diag_warning, 1},
+   {"mbr_out_of_range", diag_warning, 1},
+   {"no_extended", diag_error, 1}
+}; // idInfo[]
+
+static_assert(sizeof(idInfo) / sizeof(idInfo[0]) == diag_no_extended + 1,
+              "idInfo[] must have an entry for each DiagID");
+
+// Each thread's choice of sink is its own
+static thread_local DiagSink* currentSink = NULL;
+
+void StreamDiagSink::Write(DiagID id, DiagLevel, const string & text) {
+   if (idInfo[id].toStderr || allToStderr)
+      cerr << text;
+   else
+      cout << text;
+} // StreamDiagSink::Write()
+
+/***********************************************
+ *                                             *
+ * RingDiagSink: keep the most recent messages *
+ *                                             *
+ ***********************************************/
+
+RingDiagSink::RingDiagSink(size_t size, DiagLevel level) : DiagSink(level) {
+   capacity = (size > 0) ? size : 1;
+   next = 0;
+   numDropped = 0;
+} // RingDiagSink constructor
+
+void RingDiagSink::Write(DiagID id, DiagLevel level, const string & text) {
+   DiagMessage message = {id, level, text};
+
+   if (ring.size() < capacity) {
+      ring.push_back(message);
+   } else {
+      ring[next] = message;
+      next = (next + 1) % capacity;
+      numDropped++;
+   } // if/else
+} // RingDiagSink::Write()
+
+void RingDiagSink::Clear(void) {
+   ring.clear();
+   next = 0;
+   numDropped = 0;
+} // RingDiagSink::Clear()
+
+// Return the messages held, oldest first.
+vector<DiagMessage> RingDiagSink::GetMessages(void) const {
+   vector<DiagMessage> messages;
+   size_t i;
+
+   for (i = 0; i < ring.size(); i++)
+      messages.push_back(ring[(next + i) % ring.size()]);
+   return messages;
+} // RingDiagSink::GetMessages()
+
+// Return the text of the messages held, oldest first, run together as the
+// default sink would have shown them.
+string RingDiagSink::GetText(void) const {
+   string text;
+   size_t i;
+
+   for (i = 0; i < ring.size(); i++)
+      text += ring[(next + i) % ring.size()].text;
+   return text;
+} // RingDiagSink::GetText()
+
+/***************************************
+ *                                     *
+ * Choosing the sink and writing to it *
+ *                                     *
+ ***************************************/
+
+DiagSink* SetDiagSink(DiagSink* sink) {
+   DiagSink* previous = currentSink;
+
+   currentSink = sink;
+   return previous;
+} // SetDiagSink()
+
+// The default sink has no state of its own, so every thread may share it.
+// It's made on first use, in case a message turns up while other static
+// objects are being constructed.
+DiagSink & GetDiagSink(void) {
+   static StreamDiagSink defaultSink;
+
+   if (currentSink != NULL)
+      return *currentSink;
+   return defaultSink;
+} // GetDiagSink()
+
+const DiagIDInfo & DescribeDiag(DiagID id) {
+   return idInfo[id];
+} // DescribeDiag()
+
+// Returns 1 if the calling thread's sink would take message id, so that
+// its text is worth building, 0 if not.
+int DiagWanted(DiagID id) {
+   return GetDiagSink().Accepts(idInfo[id].level);
+} // DiagWanted()
+
+void DiagWrite(DiagID id, const string & text) {
+   DiagSink & sink = GetDiagSink();
+
+   if (sink.Accepts(idInfo[id].level) && !text.empty())
+      sink.Write(id, idInfo[id].level, text);
+} // DiagWrite()
+
+// Pass the problems found by a check made along the way (as when loading
+// or saving a disk) on to the sink, in the traditional text form.
+void DiagReport(const VerifyReport & report) {
+   if (!report.GetProblems().empty() && DiagWanted(diag_check_failed)) {
+      ostringstream text;
+
+      report.ShowText(text);
+      DiagWrite(diag_check_failed, text.str());
+   } // if
+} // DiagReport()
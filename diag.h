@@ -0,0 +1,138 @@
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+// Diagnostic messages: the warnings, errors, and notes on what's been done
+// that the partition-table code produces as it works (as opposed to the
+// listings and prompts that the user asks for). Each message has an ID,
+// which gives it a level and the stream (standard output or standard
+// error) that GPT fdisk has always written it to, and goes to the calling
+// thread's DiagSink. The default sink writes messages to those streams, as
+// before; library users can install a NullDiagSink to discard them, a
+// RingDiagSink to keep the most recent ones, or a sink of their own.
+//
+// Messages are written with the DIAG() macro, which builds the text only if
+// the sink accepts the message's level, so that a quiet sink costs no
+// formatting at all.
+
+#include <stdint.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef __GPT_DIAG
+#define __GPT_DIAG
+
+using namespace std;
+
+class VerifyReport;
+
+// A sink takes messages at or above its level; diag_silent takes none.
+enum DiagLevel {diag_info, diag_warning, diag_error, diag_silent};
+
+// Which message this is. Keep in step with the table in diag.cc.
+enum DiagID {
+   diag_no_memory, diag_internal, diag_open_error, diag_not_a_disk, diag_read_error,
+   diag_seek_error, diag_write_error, diag_close_error, diag_shared_lock,
+   diag_sector_size_unknown, diag_odd_file_size, diag_unknown_platform,
+   diag_kernel_not_updated, diag_kernel_updated, diag_write_test_failed,
+   diag_read_only, diag_gpt_version, diag_header_size_invalid, diag_header_size_large,
+   diag_disk_smaller_than_header, diag_backup_header_rebuilt, diag_main_header_rebuilt,
+   diag_loaded_backup_table, diag_no_table_loaded, diag_crc_mismatch, diag_table_crc,
+   diag_tables_differ, diag_bad_entry_size, diag_table_too_big, diag_table_too_small,
+   diag_table_size_adjusted, diag_table_location, diag_invalid_partition_data,
+   diag_mbr_ee_oversized, diag_apm_found, diag_converting_mbr, diag_converting_bsd,
+   diag_found_gpt, diag_found_gpt_bad_mbr, diag_found_damaged_gpt, diag_new_gpt,
+   diag_check_failed, diag_backup_header_moved, diag_mbr_too_big, diag_write_refused,
+   diag_write_aborted, diag_write_done, diag_backup_size_mismatch, diag_bad_backup_file,
+   diag_gpt_destroyed, diag_no_partitions, diag_no_such_partition,
+   diag_partition_out_of_range, diag_bsd_converted, diag_bsd_unrecognized,
+   diag_too_many_partitions, diag_partition_omitted, diag_past_32_bits,
+   diag_start_aligned, diag_end_aligned, diag_guid_in_use, diag_alignment_mismatch,
+   diag_zero_alignment, diag_bad_uuid, diag_unknown_type, diag_bad_logicals,
+   diag_hybrid_logicals, diag_ebr_loop, diag_bad_ebr, diag_ebr_to_ebr,
+   diag_mbr_change_illegal, diag_mbr_oversized_deleted, diag_mbr_out_of_range,
+   diag_no_extended
+}; // enum DiagID
+
+struct DiagIDInfo {
+   const char* name;
+   DiagLevel level;
+   int toStderr; // written to standard error, rather than standard output, by default
+}; // struct DiagIDInfo
+
+struct DiagMessage {
+   DiagID id;
+   DiagLevel level;
+   string text;
+}; // struct DiagMessage
+
+class DiagSink {
+protected:
+   DiagLevel minLevel;
+public:
+   DiagSink(DiagLevel level = diag_info) {minLevel = level;}
+   virtual ~DiagSink(void) {}
+
+   void SetLevel(DiagLevel level) {minLevel = level;}
+   DiagLevel GetLevel(void) const {return minLevel;}
+   int Accepts(DiagLevel level) const {return level >= minLevel;}
+   virtual void Write(DiagID id, DiagLevel level, const string & text) = 0;
+}; // class DiagSink
+
+// Writes each message to standard output or standard error, as its ID says,
+// or (with allToStderr, for when standard output carries something a
+// program will read, such as JSON) to standard error
+class StreamDiagSink : public DiagSink {
+protected:
+   int allToStderr;
+public:
+   StreamDiagSink(DiagLevel level = diag_info, int toStderr = 0) : DiagSink(level) {
+      allToStderr = toStderr;
+   }
+   void Write(DiagID id, DiagLevel level, const string & text);
+}; // class StreamDiagSink
+
+class NullDiagSink : public DiagSink {
+public:
+   NullDiagSink(void) : DiagSink(diag_silent) {}
+   void Write(DiagID, DiagLevel, const string &) {}
+}; // class NullDiagSink
+
+// Keeps the last capacity messages, dropping the oldest as new ones arrive
+class RingDiagSink : public DiagSink {
+protected:
+   vector<DiagMessage> ring;
+   size_t capacity;
+   size_t next; // where the next message goes, once the ring is full
+   uint64_t numDropped;
+public:
+   RingDiagSink(size_t size = 64, DiagLevel level = diag_info);
+
+   void Write(DiagID id, DiagLevel level, const string & text);
+   void Clear(void);
+   vector<DiagMessage> GetMessages(void) const;
+   string GetText(void) const;
+   uint64_t NumDropped(void) const {return numDropped;}
+}; // class RingDiagSink
+
+// Install sink for the calling thread, returning the one it replaces; NULL
+// restores the default (a StreamDiagSink), and is returned if the default
+// was in use.
+DiagSink* SetDiagSink(DiagSink* sink);
+DiagSink & GetDiagSink(void);
+
+const DiagIDInfo & DescribeDiag(DiagID id);
+int DiagWanted(DiagID id);
+void DiagWrite(DiagID id, const string & text);
+void DiagReport(const VerifyReport & report);
+
+#define DIAG(id, text) \
+   do { \
+      if (DiagWanted(id)) { \
+         ostringstream diagText; \
+         diagText << text; \
+         DiagWrite(id, diagText.str()); \
+      } \
+   } while (0)
+
+#endif
@@ -29,12 +29,20 @@
 
 #ifdef __linux__
 #include "linux/hdreg.h"
+#include <sys/sysmacros.h>
+#if defined(__has_include)
+#if __has_include(<linux/blkzoned.h>)
+#include <linux/blkzoned.h>
+#endif
+#endif
 #endif
 
 #include <iostream>
+#include <new>
 #include <fstream>
 #include <sstream>
 
+#include "diag.h"
 #include "diskio.h"
 
 using namespace std;
@@ -63,11 +71,11 @@ int DiskIO::OpenForRead(void) {
    if (shouldOpen) {
       fd = open(realFilename.c_str(), O_RDONLY);
       if (fd == -1) {
-         cerr << "Problem opening " << realFilename << " for reading! Error is " << errno << ".\n";
-         if (errno == EACCES) // User is probably not running as root
-            cerr << "You must run this program as root or use sudo!\n";
-         if (errno == ENOENT)
-            cerr << "The specified file does not exist!\n";
+         // EACCES probably means the user isn't running as root
+         DIAG(diag_open_error, "Problem opening " << realFilename << " for reading! Error is "
+              << errno << ".\n"
+              << ((errno == EACCES) ? "You must run this program as root or use sudo!\n" : "")
+              << ((errno == ENOENT) ? "The specified file does not exist!\n" : ""));
          realFilename = "";
          userFilename = "";
          modelName = "";
@@ -78,16 +86,16 @@ int DiskIO::OpenForRead(void) {
          openForWrite = 0;
          if (fstat64(fd, &st) == 0) {
             if (S_ISDIR(st.st_mode))
-               cerr << "The specified path is a directory!\n";
+               DIAG(diag_not_a_disk, "The specified path is a directory!\n");
 #if !(defined(__FreeBSD__) || defined(__FreeBSD_kernel__)) \
                        && !defined(__APPLE__)
             else if (S_ISCHR(st.st_mode))
-               cerr << "The specified path is a character device!\n";
+               DIAG(diag_not_a_disk, "The specified path is a character device!\n");
 #endif
             else if (S_ISFIFO(st.st_mode))
-               cerr << "The specified path is a FIFO!\n";
+               DIAG(diag_not_a_disk, "The specified path is a FIFO!\n");
             else if (S_ISSOCK(st.st_mode))
-               cerr << "The specified path is a socket!\n";
+               DIAG(diag_not_a_disk, "The specified path is a socket!\n");
             else
                isOpen = 1;
          } // if (fstat64()...)
@@ -121,7 +129,8 @@ int DiskIO::OpenForWrite(void) {
 #ifdef __APPLE__
    // MacOS X requires a shared lock under some circumstances....
    if (fd < 0) {
-      cerr << "Warning: Devices opened with shared lock will not have their\npartition table automatically reloaded!\n";
+      DIAG(diag_shared_lock, "Warning: Devices opened with shared lock will not have their\n"
+           << "partition table automatically reloaded!\n");
       fd = open(realFilename.c_str(), O_WRONLY | O_SHLOCK);
    } // if
 #endif
@@ -140,7 +149,7 @@ int DiskIO::OpenForWrite(void) {
 void DiskIO::Close(void) {
    if (isOpen)
       if (close(fd) < 0)
-         cerr << "Warning! Problem closing file!\n";
+         DIAG(diag_close_error, "Warning! Problem closing file!\n");
    isOpen = 0;
    openForWrite = 0;
 } // DiskIO::Close()
@@ -182,9 +191,9 @@ int DiskIO::GetBlockSize(void) {
          // 32-bit code returns EINVAL, I don't know why. I know I'm treading on
          // thin ice here, but it should be OK in all but very weird cases....
          if ((errno != ENOTTY) && (errno != EINVAL)) {
-            cerr << "\aError " << errno << " when determining sector size! Setting sector size to "
-                 << SECTOR_SIZE << "\n";
-            cout << "Disk device is " << realFilename << "\n";
+            DIAG(diag_sector_size_unknown, "\aError " << errno
+                 << " when determining sector size! Setting sector size to "
+                 << SECTOR_SIZE << "\nDisk device is " << realFilename << "\n");
          } // if
       } // if (err == -1)
    } // if (isOpen)
@@ -213,6 +222,121 @@ int DiskIO::GetPhysBlockSize(void) {
    return (physBlockSize);
 } // DiskIO::GetPhysBlockSize(void)
 
+#if defined __linux__ && !defined(EFI)
+// Returns the number in the named file within a /sys/dev/block device
+// directory, or in its parent directory (which is where the whole disk's
+// files are when the device is a partition), or 0 if neither can be read.
+static uint64_t ReadSysBlockValue(const string & sysDir, const string & name) {
+   uint64_t value = 0;
+   ifstream sysFile((sysDir + name).c_str());
+
+   if (!sysFile.is_open())
+      sysFile.open((sysDir + "../" + name).c_str());
+   if (!(sysFile >> value))
+      value = 0;
+   return value;
+} // ReadSysBlockValue()
+#endif
+
+// Fills topology with the device's I/O topology hints: the logical and
+// physical block sizes, the minimum and optimal I/O sizes and alignment
+// offset (from the BLKIOMIN, BLKIOOPT, and BLKALIGNOFF ioctls or, failing
+// those, the device's queue directory in /sys), and the preferred erase
+// size that eMMC and SD devices report in /sys, and the zone size and
+// number of zones of zoned devices. Disk image files have none of these.
+// Unknown values are set to 0; on OSes other than Linux, everything but
+// the block sizes is unknown.
+// Returns 1 if any hints beyond the block sizes are found, 0 if not.
+int DiskIO::GetTopology(DiskTopology* topology) {
+   memset(topology, 0, sizeof(DiskTopology));
+   if (!isOpen)
+      OpenForRead();
+   if (!isOpen)
+      return 0;
+   topology->logicalBlockSize = (uint32_t) GetBlockSize();
+   topology->physBlockSize = (uint32_t) GetPhysBlockSize();
+#if defined __linux__ && !defined(EFI)
+   unsigned int ioSize;
+   int offset;
+#ifdef BLKGETZONESZ
+   uint32_t zoneInfo;
+#endif
+   struct stat64 st;
+   ostringstream sysDir;
+
+   if (ioctl(fd, BLKIOMIN, &ioSize) == 0)
+      topology->minIOSize = ioSize;
+   if (ioctl(fd, BLKIOOPT, &ioSize) == 0)
+      topology->optIOSize = ioSize;
+   if ((ioctl(fd, BLKALIGNOFF, &offset) == 0) && (offset > 0))
+      topology->alignOffset = offset;
+#ifdef BLKGETZONESZ
+   // Zone sizes are given in 512-byte units, whatever the sector size....
+   if ((ioctl(fd, BLKGETZONESZ, &zoneInfo) == 0) && (zoneInfo > 0)) {
+      topology->zoneSize = (uint64_t) zoneInfo * 512;
+      if (ioctl(fd, BLKGETNRZONES, &zoneInfo) == 0)
+         topology->numZones = zoneInfo;
+   } // if
+#endif
+   if ((fstat64(fd, &st) == 0) && S_ISBLK(st.st_mode)) {
+      sysDir << "/sys/dev/block/" << major(st.st_rdev) << ":" << minor(st.st_rdev) << "/";
+      if (topology->minIOSize == 0)
+         topology->minIOSize = (uint32_t) ReadSysBlockValue(sysDir.str(), "queue/minimum_io_size");
+      if (topology->optIOSize == 0)
+         topology->optIOSize = (uint32_t) ReadSysBlockValue(sysDir.str(), "queue/optimal_io_size");
+      if (topology->alignOffset == 0)
+         topology->alignOffset = (uint32_t) ReadSysBlockValue(sysDir.str(), "alignment_offset");
+      topology->eraseSize = ReadSysBlockValue(sysDir.str(), "device/preferred_erase_size");
+      if ((topology->zoneSize == 0) && (ReadSysBlockValue(sysDir.str(), "queue/nr_zones") > 0)) {
+         topology->zoneSize = ReadSysBlockValue(sysDir.str(), "queue/chunk_sectors") * 512;
+         topology->numZones = (uint32_t) ReadSysBlockValue(sysDir.str(), "queue/nr_zones");
+      } // if
+   } // if
+#endif
+   return (topology->minIOSize > topology->physBlockSize) || (topology->optIOSize != 0) ||
+          (topology->alignOffset != 0) || (topology->eraseSize != 0) || (topology->zoneSize != 0);
+} // DiskIO::GetTopology()
+
+// Reports the layout of a zoned device's zones, from the BLKREPORTZONE
+// ioctl. Returns 1 if zones were found, 0 if the device isn't zoned (or
+// if this isn't supported on this OS).
+int DiskIO::ReportZones(vector<DiskZone> & zones) {
+   zones.clear();
+   if (!isOpen)
+      OpenForRead();
+#if defined __linux__ && !defined(EFI) && defined(BLKREPORTZONE)
+   const uint32_t batchSize = 256;
+   struct blk_zone_report* report;
+   DiskZone zone;
+   uint64_t sector = 0;
+   uint32_t i;
+
+   if (!isOpen)
+      return 0;
+   report = (struct blk_zone_report*) calloc(1, sizeof(struct blk_zone_report) +
+                                             batchSize * sizeof(struct blk_zone));
+   if (report == NULL) {
+      DIAG(diag_no_memory, "Could not allocate memory in DiskIO::ReportZones()!\n");
+      return 0;
+   } // if
+   do {
+      report->sector = sector;
+      report->nr_zones = batchSize;
+      if (ioctl(fd, BLKREPORTZONE, report) != 0)
+         report->nr_zones = 0;
+      for (i = 0; i < report->nr_zones; i++) {
+         zone.start = report->zones[i].start * 512;
+         zone.length = report->zones[i].len * 512;
+         zone.sequential = (report->zones[i].type != BLK_ZONE_TYPE_CONVENTIONAL);
+         zones.push_back(zone);
+         sector = report->zones[i].start + report->zones[i].len;
+      } // for
+   } while (report->nr_zones > 0);
+   free(report);
+#endif
+   return (zones.size() > 0);
+} // DiskIO::ReportZones()
+
 // Returns the number of heads, according to the kernel, or 255 if the
 // correct value can't be determined.
 uint32_t DiskIO::GetNumHeads(void) {
@@ -265,8 +389,9 @@ int DiskIO::DiskSync(void) {
    if (isOpen) {
       sync();
 #if defined(__APPLE__) || defined(__sun__)
-      cout << "Warning: The kernel may continue to use old or deleted partitions.\n"
-           << "You should reboot or remove the drive.\n";
+      DIAG(diag_kernel_not_updated,
+           "Warning: The kernel may continue to use old or deleted partitions.\n"
+           << "You should reboot or remove the drive.\n");
                /* don't know if this helps
                * it definitely will get things on disk though:
                * http://topiks.org/mac-os-x/0321278542/ch12lev1sec8.html */
@@ -280,8 +405,9 @@ int DiskIO::DiskSync(void) {
 #if defined (__FreeBSD__) || defined (__FreeBSD_kernel__)
       sleep(2);
       i = ioctl(fd, DIOCGFLUSH);
-      cout << "Warning: The kernel may continue to use old or deleted partitions.\n"
-           << "You should reboot or remove the drive.\n";
+      DIAG(diag_kernel_not_updated,
+           "Warning: The kernel may continue to use old or deleted partitions.\n"
+           << "You should reboot or remove the drive.\n");
       platformFound++;
 #endif
 #ifdef __linux__
@@ -289,18 +415,19 @@ int DiskIO::DiskSync(void) {
       fsync(fd);
       i = ioctl(fd, BLKRRPART);
       if (i) {
-         cout << "Warning: The kernel is still using the old partition table.\n"
+         DIAG(diag_kernel_not_updated,
+              "Warning: The kernel is still using the old partition table.\n"
               << "The new table will be used at the next reboot or after you\n"
-              << "run partprobe(8) or kpartx(8)\n";
+              << "run partprobe(8) or kpartx(8)\n");
       } else {
          retval = 1;
       } // if/else
       platformFound++;
 #endif
       if (platformFound == 0)
-         cerr << "Warning: Platform not recognized!\n";
+         DIAG(diag_unknown_platform, "Warning: Platform not recognized!\n");
       if (platformFound > 1)
-         cerr << "\nWarning: We seem to be running on multiple platforms!\n";
+         DIAG(diag_unknown_platform, "\nWarning: We seem to be running on multiple platforms!\n");
    } // if (isOpen)
    return retval;
 } // DiskIO::DiskSync()
@@ -352,8 +479,8 @@ int DiskIO::Read(void* buffer, int numBytes) {
          tempSpace = new char [numBlocks * blockSize];
       } // if/else
       if (tempSpace == NULL) {
-         cerr << "Unable to allocate memory in DiskIO::Read()! Terminating!\n";
-         exit(1);
+         DIAG(diag_no_memory, "Unable to allocate memory in DiskIO::Read()! Terminating!\n");
+         throw bad_alloc();
       } // if
 
       // Read the data into temporary space, then copy it to buffer
@@ -394,8 +521,8 @@ int DiskIO::Write(void* buffer, int numBytes) {
          tempSpace = new char [numBlocks * blockSize];
       } // if/else
       if (tempSpace == NULL) {
-         cerr << "Unable to allocate memory in DiskIO::Write()! Terminating!\n";
-         exit(1);
+         DIAG(diag_no_memory, "Unable to allocate memory in DiskIO::Write()! Terminating!\n");
+         throw bad_alloc();
       } // if
       
       // Copy the data to my own buffer, then write it
@@ -480,7 +607,7 @@ uint64_t DiskIO::DiskSize(int *err) {
       platformFound++;
 #endif
       if (platformFound != 1)
-         cerr << "Warning! We seem to be running on no known platform!\n";
+         DIAG(diag_unknown_platform, "Warning! We seem to be running on no known platform!\n");
 
       // The above methods have failed, so let's assume it's a regular
       // file (a QEMU image, dd backup, or what have you) and see what
@@ -489,8 +616,8 @@ uint64_t DiskIO::DiskSize(int *err) {
          if (fstat64(fd, &st) == 0) {
             bytes = st.st_size;
             if ((bytes % UINT64_C(512)) != 0)
-               cerr << "Warning: File size is not a multiple of 512 bytes!"
-                    << " Misbehavior is likely!\n\a";
+               DIAG(diag_odd_file_size, "Warning: File size is not a multiple of 512 bytes!"
+                    << " Misbehavior is likely!\n\a");
             sectors = bytes / UINT64_C(512);
          } // if
       } // if
@@ -22,13 +22,16 @@
 #define S_IRGRP 0
 #define S_IROTH 0
 #include <stdio.h>
+#include <string.h>
 #include <string>
 #include <stdint.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <iostream>
+#include <new>
 
+#include "diag.h"
 #include "support.h"
 #include "diskio.h"
 
@@ -64,7 +67,7 @@ int DiskIO::OpenForRead(void) {
                       NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
       if (fd == INVALID_HANDLE_VALUE) {
          CloseHandle(fd);
-         cerr << "Problem opening " << realFilename << " for reading!\n";
+         DIAG(diag_open_error, "Problem opening " << realFilename << " for reading!\n");
          realFilename = "";
          userFilename = "";
          isOpen = 0;
@@ -151,6 +154,23 @@ int DiskIO::GetPhysBlockSize(void) {
    return 0;
 } // DiskIO::GetPhysBlockSize()
 
+// Fills topology with the device's I/O topology hints. Only the block
+// sizes are supported in Windows, as of yet. Returns 1 if any hints beyond
+// the block sizes are found, 0 if not.
+int DiskIO::GetTopology(DiskTopology* topology) {
+   memset(topology, 0, sizeof(DiskTopology));
+   topology->logicalBlockSize = (uint32_t) GetBlockSize();
+   topology->physBlockSize = (uint32_t) GetPhysBlockSize();
+   return 0;
+} // DiskIO::GetTopology()
+
+// Reports the layout of a zoned device's zones. Zoned devices aren't
+// supported in Windows, as of yet, so this always returns 0 (no zones).
+int DiskIO::ReportZones(vector<DiskZone> & zones) {
+   zones.clear();
+   return 0;
+} // DiskIO::ReportZones()
+
 // Returns the number of heads, according to the kernel, or 255 if the
 // correct value can't be determined.
 uint32_t DiskIO::GetNumHeads(void) {
@@ -178,17 +198,20 @@ int DiskIO::DiskSync(void) {
 
    if (isOpen) {
       if (DeviceIoControl(fd, IOCTL_DISK_UPDATE_PROPERTIES, NULL, 0, &buf, sizeof(buf), &i, NULL) == 0) {
-         cout << "Disk synchronization failed! The computer may use the old partition table\n"
-              << "until you reboot or remove and re-insert the disk!\n";
+         DIAG(diag_kernel_not_updated,
+              "Disk synchronization failed! The computer may use the old partition table\n"
+              << "until you reboot or remove and re-insert the disk!\n");
       } else {
-         cout << "Disk synchronization succeeded! The computer should now use the new\n"
-              << "partition table.\n";
+         DIAG(diag_kernel_updated,
+              "Disk synchronization succeeded! The computer should now use the new\n"
+              << "partition table.\n");
          retval = 1;
       } // if/else
    } else {
-      cout << "Unable to open the disk for synchronization operation! The computer will\n"
+      DIAG(diag_kernel_not_updated,
+           "Unable to open the disk for synchronization operation! The computer will\n"
            << "continue to use the old partition table until you reboot or remove and\n"
-           << "re-insert the disk!\n";
+           << "re-insert the disk!\n");
    } // if (isOpen)
    return retval;
 } // DiskIO::DiskSync()
@@ -208,7 +231,8 @@ int DiskIO::Seek(uint64_t sector) {
       retval = SetFilePointerEx(fd, seekTo, NULL, FILE_BEGIN);
       if (retval == 0) {
          errno = GetLastError();
-         cerr << "Error when seeking to " << seekTo.QuadPart << "! Error is " << errno << "\n";
+         DIAG(diag_seek_error, "Error when seeking to " << seekTo.QuadPart << "! Error is "
+              << errno << "\n");
          retval = 0;
       } // if
    } // if
@@ -242,8 +266,8 @@ int DiskIO::Read(void* buffer, int numBytes) {
          tempSpace = new char [numBlocks * blockSize];
       } // if/else
       if (tempSpace == NULL) {
-         cerr << "Unable to allocate memory in DiskIO::Read()! Terminating!\n";
-         exit(1);
+         DIAG(diag_no_memory, "Unable to allocate memory in DiskIO::Read()! Terminating!\n");
+         throw bad_alloc();
       } // if
 
       // Read the data into temporary space, then copy it to buffer
@@ -285,8 +309,8 @@ int DiskIO::Write(void* buffer, int numBytes) {
          tempSpace = new char [numBlocks * blockSize];
       } // if/else
       if (tempSpace == NULL) {
-         cerr << "Unable to allocate memory in DiskIO::Write()! Terminating!\n";
-         exit(1);
+         DIAG(diag_no_memory, "Unable to allocate memory in DiskIO::Write()! Terminating!\n");
+         throw bad_alloc();
       } // if
 
       // Copy the data to my own buffer, then write it
@@ -48,10 +48,43 @@ DiskIO::DiskIO(void) {
    openForWrite = 0;
 } // constructor
 
+// Move constructor; takes over orig's open device, if any, leaving orig
+// closed. (A DiskIO can't be copied, since two objects would then close
+// the same file descriptor.)
+DiskIO::DiskIO(DiskIO && orig) {
+   userFilename = move(orig.userFilename);
+   realFilename = move(orig.realFilename);
+   modelName = move(orig.modelName);
+   isOpen = orig.isOpen;
+   openForWrite = orig.openForWrite;
+   if (isOpen)
+      fd = orig.fd;
+   orig.isOpen = 0;
+   orig.openForWrite = 0;
+} // move constructor
+
 DiskIO::~DiskIO(void) {
    Close();
 } // destructor
 
+// Move assignment; closes this object's device, if it's open, and then
+// takes over orig's, leaving orig closed.
+DiskIO & DiskIO::operator=(DiskIO && orig) {
+   if (&orig != this) {
+      Close();
+      userFilename = move(orig.userFilename);
+      realFilename = move(orig.realFilename);
+      modelName = move(orig.modelName);
+      isOpen = orig.isOpen;
+      openForWrite = orig.openForWrite;
+      if (isOpen)
+         fd = orig.fd;
+      orig.isOpen = 0;
+      orig.openForWrite = 0;
+   } // if
+   return *this;
+} // DiskIO::operator=()
+
 // Open a disk device for reading. Returns 1 on success, 0 on failure.
 int DiskIO::OpenForRead(const string & filename) {
    int shouldOpen = 1;
@@ -16,6 +16,7 @@
 #define __DISKIO_H
 
 #include <string>
+#include <vector>
 #include <stdint.h>
 #include <sys/types.h>
 #ifdef _WIN32
@@ -45,6 +46,31 @@ using namespace std;
  *                                     *
  ***************************************/
 
+// I/O topology hints for a device, in bytes; 0 means "unknown." For RAID
+// devices, the minimum and optimal I/O sizes are the chunk size and the
+// stripe width; for eMMC and SD cards, the erase size is the erase-group
+// size. alignOffset is how far the start of the device lies from its
+// natural alignment. On zoned (SMR or ZNS) devices, zoneSize is the size of
+// each zone (the last zone may be smaller) and numZones their number.
+struct DiskTopology {
+   uint32_t logicalBlockSize;
+   uint32_t physBlockSize;
+   uint32_t minIOSize;
+   uint32_t optIOSize;
+   uint32_t alignOffset;
+   uint64_t eraseSize;
+   uint64_t zoneSize;
+   uint32_t numZones;
+}; // struct DiskTopology
+
+// One zone of a zoned device, as reported by DiskIO::ReportZones(); start
+// and length are in bytes.
+struct DiskZone {
+   uint64_t start;
+   uint64_t length;
+   int sequential; // 1 if the zone must (or should) be written sequentially
+}; // struct DiskZone
+
 class DiskIO {
    protected:
       string userFilename;
@@ -59,7 +85,9 @@ class DiskIO {
 #endif
    public:
       DiskIO(void);
+      DiskIO(DiskIO && orig);
       ~DiskIO(void);
+      DiskIO & operator=(DiskIO && orig);
 
       void MakeRealName(void);
       int OpenForRead(const string & filename);
@@ -73,6 +101,8 @@ class DiskIO {
       int DiskSync(void); // resync disk caches to use new partitions
       int GetBlockSize(void);
       int GetPhysBlockSize(void);
+      int GetTopology(DiskTopology* topology);
+      int ReportZones(vector<DiskZone> & zones);
       string GetModel(void) {return modelName;}
       uint32_t GetNumHeads(void);
       uint32_t GetNumSecsPerTrack(void);
@@ -24,10 +24,24 @@
 # - Create a single Linux partition
 # - Change name of partition
 # - Change type of partition
+# - Undo and redo changes
 # - Backup to file the GPT table
 # - Delete the single partition
 # - Restore from backup file the GPT table
+# - Converge on a declarative layout
+# - Verify the disk, with JSON output
+# - Print the partition table as JSON
+# - Print a damaged partition table as JSON
+# - Edit the partition table with a script
+# - Verify two disks in batch mode
+# - Replicate a table with 256-byte entries
 # - Wipe the GPT table
+# - Process many disk images at once in separate threads (if gptthreads,
+#   from "make threads" or "make tsan", has been built)
+# - Place partitions on an image made to look like a zoned disk (if
+#   gptzones, from "make zones", has been built)
+# - Drive the C API from C (if gptapi_test, from "make apitest", has been
+#   built)
 
 # TODO
 # Try to generate a wrong GPT table to detect problems (test --verify)
@@ -35,6 +49,9 @@
 
 GDISK_BIN=./gdisk
 SGDISK_BIN=./sgdisk
+GPTTHREADS_BIN=./gptthreads
+GPTZONES_BIN=./gptzones
+GPTAPI_TEST_BIN=./gptapi_test
 
 OPT_CLEAR="o"
 OPT_NEW="n"
@@ -61,6 +78,15 @@ TEST_PART_NEWTYPE="8200"
 # GPT data backup to filename
 GPT_BACKUP_FILENAME=$(mktemp)
 
+# layout file for sgdisk --layout
+LAYOUT_FILENAME=$(mktemp)
+
+# copy of the temp disk for sgdisk --devices
+TEMP_DISK_COPY=$(mktemp)
+
+# target for replicating TEMP_DISK_COPY
+TEMP_DISK_REPLICA=$(mktemp)
+
 # Pretty print string (Red if FAILED or green if SUCCESS)
 # $1: string to pretty print
 pretty_print() {
@@ -218,6 +244,27 @@ EOF
 }
 
 
+#####################################
+# Undo and redo changes
+#####################################
+undo_redo() {
+	$GDISK_BIN $TEMP_DISK << EOF
+$OPT_DELETE
+u
+$OPT_CHANGE_TYPE
+$TEST_PART_TYPE
+u
+y
+u
+w
+Y
+EOF
+
+	verify_part "$TEST_PART_NEWTYPE" "$TEST_PART_NEWNAME" "Undo and redo changes"
+	echo ""
+}
+
+
 #####################################
 # Backup GPT data to file
 #####################################
@@ -291,6 +338,259 @@ EOF
 }
 
 
+#####################################
+# Converge on a layout, then check that
+# a second run finds nothing to do
+#####################################
+converge_layout() {
+	echo "1:*:$TEST_PART_TYPE:$TEST_PART_NEWNAME" > $LAYOUT_FILENAME
+	$SGDISK_BIN $TEMP_DISK --layout=$LAYOUT_FILENAME
+
+	verify_part "$TEST_PART_TYPE" "$TEST_PART_NEWNAME" "Converge on a layout"
+
+	$SGDISK_BIN $TEMP_DISK --layout=$LAYOUT_FILENAME | grep -q "nothing to do"
+	if [ $? -eq 0 ]
+	then
+		pretty_print "SUCCESS" "Layout already matches; nothing to do"
+	else
+		pretty_print "FAILED" "Matching layout was applied again"
+		exit 1
+	fi
+	echo ""
+}
+
+
+#####################################
+# Print the partition table as JSON
+# and check partition 1 against it
+#####################################
+print_json() {
+	json=$($SGDISK_BIN $TEMP_DISK -p --format=json)
+	disk_guid=$($SGDISK_BIN -p $TEMP_DISK | grep "^Disk identifier (GUID):" | awk '{print $4}')
+	if echo "$json" | grep -q "\"disk_guid\": \"$disk_guid\"" &&
+	   echo "$json" | grep "\"number\": 1," | grep -q "\"type_code\": \"$TEST_PART_TYPE\""
+	then
+		pretty_print "SUCCESS" "Print partition table as JSON"
+	else
+		pretty_print "FAILED" "JSON partition table doesn't match the text one"
+		exit 1
+	fi
+	echo ""
+}
+
+#####################################
+# Print a table with an entry that ends
+# before it starts as JSON; its size
+# should be 0, not a wrapped-around one
+#####################################
+json_backwards_entry() {
+	dd if=/dev/zero of=$TEMP_DISK_COPY bs=1024 count=$TEMP_DISK_SIZE > /dev/null 2>&1
+	$SGDISK_BIN -n 1:0:+1M $TEMP_DISK_COPY > /dev/null
+	# Set the last LBA of entry 1 to 1 in the main and backup tables
+	# (at sectors 2 and 33 from the end)
+	for offset in $((1024 + 40)) $(((TEMP_DISK_SIZE * 2 - 33) * 512 + 40))
+	do
+		printf '\001\000\000\000\000\000\000\000' | dd of=$TEMP_DISK_COPY bs=1 seek=$offset conv=notrunc > /dev/null 2>&1
+	done
+	$SGDISK_BIN $TEMP_DISK_COPY -p --format=json 2> /dev/null | grep "\"number\": 1," |
+		grep -q '"last_lba": 1, "sectors": 0, "bytes": 0,'
+	if [ $? -eq 0 ]
+	then
+		pretty_print "SUCCESS" "Backwards entry has no size in JSON"
+	else
+		pretty_print "FAILED" "JSON size of a backwards entry wrapped around"
+		exit 1
+	fi
+	echo ""
+}
+
+#####################################
+# Verify the disk and check the JSON
+# report for a clean result
+#####################################
+verify_json() {
+	$SGDISK_BIN $TEMP_DISK -v --format=json | grep -q '"problems": 0,'
+	if [ $? -eq 0 ]
+	then
+		pretty_print "SUCCESS" "Verify with JSON output"
+	else
+		pretty_print "FAILED" "JSON verification report shows problems"
+		exit 1
+	fi
+	echo ""
+}
+
+
+#####################################
+# Rename a partition with a script,
+# check that an aborted script changes
+# nothing and that a failed line is
+# undone whole, then restore the old name
+#####################################
+script_edit() {
+	printf '# rename a partition\n-c 1:"scripted part"\n-i 1\ncommit\n' | $SGDISK_BIN $TEMP_DISK --script=-
+	$SGDISK_BIN $TEMP_DISK -i 1 | grep -q "^Partition name: 'scripted part'"
+	if [ $? -ne 0 ]
+	then
+		pretty_print "FAILED" "Script didn't rename partition 1"
+		exit 1
+	fi
+	printf -- '-c 1:other\nabort\n' | $SGDISK_BIN $TEMP_DISK --script=-
+	$SGDISK_BIN $TEMP_DISK -i 1 | grep -q "^Partition name: 'scripted part'"
+	if [ $? -ne 0 ]
+	then
+		pretty_print "FAILED" "Aborted script changed the partition table"
+		exit 1
+	fi
+	info=$(printf -- '-n 100:0:+1M -t 100:bogus\n-i 100\nabort\n' |
+	       $SGDISK_BIN $TEMP_DISK --script=- 2> /dev/null)
+	if ! echo "$info" | grep -q "^Partition #100 does not exist"
+	then
+		pretty_print "FAILED" "Failed script line wasn't undone as a whole"
+		exit 1
+	fi
+	printf -- '-c 1:"%s"\ncommit\n' "$TEST_PART_NEWNAME" | $SGDISK_BIN $TEMP_DISK --script=-
+	$SGDISK_BIN $TEMP_DISK -i 1 | grep -q "^Partition name: '$TEST_PART_NEWNAME'"
+	if [ $? -eq 0 ]
+	then
+		pretty_print "SUCCESS" "Edit the partition table with a script"
+	else
+		pretty_print "FAILED" "Script didn't restore partition 1's name"
+		exit 1
+	fi
+	echo ""
+}
+
+#####################################
+# Verify the temp disk and a copy of it
+# in one batch
+#####################################
+batch_verify() {
+	cp $TEMP_DISK $TEMP_DISK_COPY
+	found=$($SGDISK_BIN --devices=$TEMP_DISK,$TEMP_DISK_COPY -v | grep -c "No problems found")
+	if [ $? -eq 0 ] && [ "$found" -eq 2 ]
+	then
+		pretty_print "SUCCESS" "Verify two disks in batch mode"
+	else
+		pretty_print "FAILED" "Batch verification found problems"
+		exit 1
+	fi
+	echo ""
+}
+
+
+#####################################
+# Replicate the table onto a blank disk,
+# with new GUIDs
+#####################################
+replicate_table() {
+	dd if=/dev/zero of=$TEMP_DISK_COPY bs=1024 count=$TEMP_DISK_SIZE > /dev/null 2>&1
+	checked=$($SGDISK_BIN --replica-guids=randomize -R $TEMP_DISK_COPY $TEMP_DISK | grep -c "written and checked")
+	old_guid=$($SGDISK_BIN -p $TEMP_DISK | grep GUID)
+	new_guid=$($SGDISK_BIN -p $TEMP_DISK_COPY | grep GUID)
+	if [ "$checked" -eq 1 ] && [ -n "$new_guid" ] && [ "$old_guid" != "$new_guid" ]
+	then
+		pretty_print "SUCCESS" "Replicate table with new GUIDs"
+	else
+		pretty_print "FAILED" "Replication failed"
+		exit 1
+	fi
+	echo ""
+}
+
+#####################################
+# Write the little-endian 32-bit value $2
+# at byte offset $3 of file $1
+#####################################
+put_le32() {
+	printf "$(printf '\\%03o\\%03o\\%03o\\%03o' $(($2 & 255)) $((($2 >> 8) & 255)) \
+		$((($2 >> 16) & 255)) $((($2 >> 24) & 255)))" |
+		dd of=$1 bs=1 seek=$3 conv=notrunc > /dev/null 2>&1
+}
+
+#####################################
+# Print the CRC-32 of the first $3 bytes
+# of file $1 from sector $2 on (gzip
+# stores it at the end of its output)
+#####################################
+crc32_of() {
+	dd if=$1 bs=512 skip=$2 count=$((($3 + 511) / 512)) 2> /dev/null | head -c $3 |
+		gzip -c | tail -c 8 | head -c 4 | od -An -tu4 | tr -d ' '
+}
+
+#####################################
+# Turn a table into one with 64 256-byte
+# entries, with vendor data in the tail
+# of the first, and replicate it; the
+# replica must be checked and identical
+#####################################
+replicate_wide() {
+	dd if=/dev/zero of=$TEMP_DISK_COPY bs=1024 count=$TEMP_DISK_SIZE > /dev/null 2>&1
+	dd if=/dev/zero of=$TEMP_DISK_REPLICA bs=1024 count=$TEMP_DISK_SIZE > /dev/null 2>&1
+	$SGDISK_BIN -n 1:0:+1M $TEMP_DISK_COPY > /dev/null
+	# Main header and table at sectors 1 and 2, backups at the last
+	# sector and 33 from the end
+	for sectors in "1 2" "$((TEMP_DISK_SIZE * 2 - 1)) $((TEMP_DISK_SIZE * 2 - 33))"
+	do
+		set -- $sectors
+		printf 'vendor data' | dd of=$TEMP_DISK_COPY bs=1 seek=$(($2 * 512 + 200)) conv=notrunc > /dev/null 2>&1
+		put_le32 $TEMP_DISK_COPY 64 $(($1 * 512 + 80))
+		put_le32 $TEMP_DISK_COPY 256 $(($1 * 512 + 84))
+		put_le32 $TEMP_DISK_COPY $(crc32_of $TEMP_DISK_COPY $2 16384) $(($1 * 512 + 88))
+		put_le32 $TEMP_DISK_COPY 0 $(($1 * 512 + 16))
+		put_le32 $TEMP_DISK_COPY $(crc32_of $TEMP_DISK_COPY $1 92) $(($1 * 512 + 16))
+	done
+	verified=$($SGDISK_BIN -v $TEMP_DISK_COPY | grep -c "No problems found")
+	checked=$($SGDISK_BIN -R $TEMP_DISK_REPLICA $TEMP_DISK_COPY | grep -c "written and checked")
+	if [ "$verified" -eq 1 ] && [ "$checked" -eq 1 ] &&
+	   cmp -s -i 512 -n $((33 * 512)) $TEMP_DISK_COPY $TEMP_DISK_REPLICA
+	then
+		pretty_print "SUCCESS" "Replicate table with 256-byte entries"
+	else
+		pretty_print "FAILED" "Replication of 256-byte entries failed"
+		exit 1
+	fi
+	echo ""
+}
+
+#####################################
+# Dump the table in Android's format and
+# compare it with sgdisk's listing
+#####################################
+android_dump() {
+	dump=$($SGDISK_BIN --android-dump $TEMP_DISK)
+	disk_guid=$($SGDISK_BIN -p $TEMP_DISK | grep "^Disk identifier (GUID):" | awk '{print $4}')
+	listed=$($SGDISK_BIN -p $TEMP_DISK | awk '/^Number/ {found=1; next} found && NF' | wc -l)
+	if [ "$(echo "$dump" | head -n 1)" = "DISK gpt $disk_guid" ] &&
+	   [ "$(echo "$dump" | grep -c "^PART ")" -eq "$listed" ]
+	then
+		pretty_print "SUCCESS" "Android dump matches the partition table"
+	else
+		pretty_print "FAILED" "Android dump doesn't match the partition table"
+		exit 1
+	fi
+	echo ""
+}
+
+#####################################
+# Dump the table in JSON, with --format
+# given before the device and after it
+#####################################
+android_dump_json() {
+	before=$($SGDISK_BIN --android-dump --format=json $TEMP_DISK) &&
+	spaced=$($SGDISK_BIN --format json --android-dump $TEMP_DISK) &&
+	after=$($SGDISK_BIN --android-dump $TEMP_DISK --format=json)
+	if [ $? -eq 0 ] && echo "$before" | grep -q '"table": "gpt"' &&
+	   [ "$before" = "$spaced" ] && [ "$before" = "$after" ]
+	then
+		pretty_print "SUCCESS" "Android JSON dump with --format anywhere"
+	else
+		pretty_print "FAILED" "Android JSON dump depends on where --format is"
+		exit 1
+	fi
+	echo ""
+}
+
 #####################################
 # Change UID of disk
 #####################################
@@ -363,6 +663,67 @@ EOF
 	pretty_print "SUCCESS" "EOF successfully exit gdisk"
 }
 
+#####################################
+# Make and check partition tables on
+# many images at once, in separate
+# threads of one process
+#####################################
+thread_images() {
+	if [ ! -x $GPTTHREADS_BIN ]
+	then
+		return
+	fi
+	echo ""
+	$GPTTHREADS_BIN 8 $TEMP_DISK
+	if [ $? -eq 0 ]
+	then
+		pretty_print "SUCCESS" "Process disk images in parallel threads"
+	else
+		pretty_print "FAILED" "Parallel threads damaged a partition table"
+		exit 1
+	fi
+}
+
+#####################################
+# Create partitions on an image that's
+# treated as a zoned disk
+#####################################
+zoned_image() {
+	if [ ! -x $GPTZONES_BIN ]
+	then
+		return
+	fi
+	echo ""
+	$GPTZONES_BIN $TEMP_DISK_COPY
+	if [ $? -eq 0 ]
+	then
+		pretty_print "SUCCESS" "Place partitions on zone boundaries"
+	else
+		pretty_print "FAILED" "Partitions misplaced on a zoned disk"
+		exit 1
+	fi
+}
+
+#####################################
+# Make and read back a partition table
+# through the C API, from a C program
+#####################################
+api_checks() {
+	if [ ! -x $GPTAPI_TEST_BIN ]
+	then
+		return
+	fi
+	echo ""
+	$GPTAPI_TEST_BIN $TEMP_DISK_COPY
+	if [ $? -eq 0 ]
+	then
+		pretty_print "SUCCESS" "Drive the C API from C"
+	else
+		pretty_print "FAILED" "C API checks failed"
+		exit 1
+	fi
+}
+
 ###################################
 # Main
 ###################################
@@ -388,15 +749,30 @@ do
 	create_partition      "$binary"
 	change_partition_name "$binary"
 	change_partition_type "$binary"
+	undo_redo             # only with gdisk
 	backup_table          "$binary"
 	delete_partition      "$binary"
 	restore_table         # only with gdisk
+	converge_layout       # only with sgdisk
+	verify_json           # only with sgdisk
+	print_json            # only with sgdisk
+	json_backwards_entry  # only with sgdisk
+	script_edit           # only with sgdisk
+	batch_verify          # only with sgdisk
+	replicate_table       # only with sgdisk
+	replicate_wide        # only with sgdisk
+	android_dump          # only with sgdisk
+	android_dump_json     # only with sgdisk
 	change_disk_uid       "$binary"
 	wipe_table            "$binary"
 	eof_stdin             # only with gdisk
 done
 
+thread_images
+zoned_image
+api_checks
+
 # remove temp files
-rm -f $TEMP_DISK $GPT_BACKUP_FILENAME
+rm -f $TEMP_DISK $GPT_BACKUP_FILENAME $LAYOUT_FILENAME $TEMP_DISK_COPY $TEMP_DISK_REPLICA
 
 exit 0
@@ -21,14 +21,19 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <iostream>
+#include <iomanip>
+#include <new>
 #include <algorithm>
+#include <vector>
 #include "crc32.h"
+#include "diag.h"
 #include "gpt.h"
 #include "bsd.h"
 #include "support.h"
 #include "parttypes.h"
 #include "attributes.h"
 #include "diskio.h"
+#include "jsonout.h"
 
 using namespace std;
 
@@ -67,8 +72,9 @@ static inline uint32_t log2_32(uint32_t v) {
 GPTData::GPTData(void) {
    blockSize = SECTOR_SIZE; // set a default
    physBlockSize = 0; // 0 = can't be determined
+   memset(&topology, 0, sizeof(topology));
    diskSize = 0;
-   partitions = NULL;
+   partEntrySize = GPT_SIZE;
    state = gpt_valid;
    device = "";
    justLooking = 0;
@@ -79,26 +85,31 @@ GPTData::GPTData(void) {
    apmFound = 0;
    bsdFound = 0;
    sectorAlignment = MIN_AF_ALIGNMENT; // Align partitions on 4096-byte boundaries by default
+   placement = place_largest;
    beQuiet = 0;
    whichWasUsed = use_new;
+   nameIndexValid = 0;
+   guidIndexValid = 0;
+   usedSlotsValid = 0;
+   freeExtentsValid = 0;
+   inTransaction = 0;
+   journaledTable = 0;
    mainHeader.numParts = 0;
    numParts = 0;
    SetGPTSize(NUM_GPT_ENTRIES);
-   // Initialize CRC functions...
-   chksum_crc32gentab();
 } // GPTData default constructor
 
 GPTData::GPTData(const GPTData & orig) {
-   uint32_t i;
-
    if (&orig != this) {
       mainHeader = orig.mainHeader;
       numParts = orig.numParts;
+      partEntrySize = orig.partEntrySize;
       secondHeader = orig.secondHeader;
       protectiveMBR = orig.protectiveMBR;
       device = orig.device;
       blockSize = orig.blockSize;
       physBlockSize = orig.physBlockSize;
+      topology = orig.topology;
       diskSize = orig.diskSize;
       state = orig.state;
       justLooking = orig.justLooking;
@@ -109,29 +120,35 @@ GPTData::GPTData(const GPTData & orig) {
       apmFound = orig.apmFound;
       bsdFound = orig.bsdFound;
       sectorAlignment = orig.sectorAlignment;
+      placement = orig.placement;
       beQuiet = orig.beQuiet;
       whichWasUsed = orig.whichWasUsed;
+      nameIndexValid = 0;
+      guidIndexValid = 0;
+      usedSlotsValid = 0;
+      freeExtentsValid = 0;
+      // The undo journal describes orig's history, not this object's....
+      inTransaction = 0;
+      journaledTable = 0;
 
       myDisk.OpenForRead(orig.myDisk.GetName());
 
-      delete[] partitions;
-      partitions = new GPTPart [numParts];
-      if (partitions == NULL) {
-         cerr << "Error! Could not allocate memory for partitions in GPTData::operator=()!\n"
-              << "Terminating!\n";
-         exit(1);
-      } // if
-      for (i = 0; i < numParts; i++) {
-         partitions[i] = orig.partitions[i];
-      } // for
+      // Share orig's partition entries; whichever object next modifies
+      // them will make its own copy first.
+      partitions = orig.partitions;
    } // if
 } // GPTData copy constructor
 
+// Move constructor
+GPTData::GPTData(GPTData && orig) {
+   *this = move(orig);
+} // GPTData move constructor
+
 // The following constructor loads GPT data from a device file
 GPTData::GPTData(string filename) {
    blockSize = SECTOR_SIZE; // set a default
    diskSize = 0;
-   partitions = NULL;
+   partEntrySize = GPT_SIZE;
    state = gpt_invalid;
    device = "";
    justLooking = 0;
@@ -142,33 +159,37 @@ GPTData::GPTData(string filename) {
    apmFound = 0;
    bsdFound = 0;
    sectorAlignment = MIN_AF_ALIGNMENT; // Align partitions on 4096-byte boundaries by default
+   placement = place_largest;
    beQuiet = 0;
    whichWasUsed = use_new;
+   nameIndexValid = 0;
+   guidIndexValid = 0;
+   usedSlotsValid = 0;
+   freeExtentsValid = 0;
+   inTransaction = 0;
+   journaledTable = 0;
    mainHeader.numParts = 0;
    numParts = 0;
-   // Initialize CRC functions...
-   chksum_crc32gentab();
    if (!LoadPartitions(filename))
       exit(2);
 } // GPTData(string filename) constructor
 
 // Destructor
 GPTData::~GPTData(void) {
-   delete[] partitions;
 } // GPTData destructor
 
 // Assignment operator
 GPTData & GPTData::operator=(const GPTData & orig) {
-   uint32_t i;
-
    if (&orig != this) {
       mainHeader = orig.mainHeader;
       numParts = orig.numParts;
+      partEntrySize = orig.partEntrySize;
       secondHeader = orig.secondHeader;
       protectiveMBR = orig.protectiveMBR;
       device = orig.device;
       blockSize = orig.blockSize;
       physBlockSize = orig.physBlockSize;
+      topology = orig.topology;
       diskSize = orig.diskSize;
       state = orig.state;
       justLooking = orig.justLooking;
@@ -179,26 +200,84 @@ GPTData & GPTData::operator=(const GPTData & orig) {
       apmFound = orig.apmFound;
       bsdFound = orig.bsdFound;
       sectorAlignment = orig.sectorAlignment;
+      placement = orig.placement;
       beQuiet = orig.beQuiet;
       whichWasUsed = orig.whichWasUsed;
+      nameIndexValid = 0;
+      guidIndexValid = 0;
+      usedSlotsValid = 0;
+      freeExtentsValid = 0;
+      verifyCache.Invalidate();
+      ClearJournal();
 
       myDisk.OpenForRead(orig.myDisk.GetName());
 
-      delete[] partitions;
-      partitions = new GPTPart [numParts];
-      if (partitions == NULL) {
-         cerr << "Error! Could not allocate memory for partitions in GPTData::operator=()!\n"
-              << "Terminating!\n";
-         exit(1);
-      } // if
-      for (i = 0; i < numParts; i++) {
-         partitions[i] = orig.partitions[i];
-      } // for
+      // Share orig's partition entries, as in the copy constructor....
+      partitions = orig.partitions;
    } // if
 
    return *this;
 } // GPTData::operator=()
 
+// Move assignment. Takes over orig's open device, partition storage, lookup
+// indexes, and undo journal, leaving orig with an empty (zero-entry)
+// partition table.
+GPTData & GPTData::operator=(GPTData && orig) {
+   if (&orig != this) {
+      mainHeader = orig.mainHeader;
+      numParts = orig.numParts;
+      partEntrySize = orig.partEntrySize;
+      secondHeader = orig.secondHeader;
+      device = move(orig.device);
+      blockSize = orig.blockSize;
+      physBlockSize = orig.physBlockSize;
+      topology = orig.topology;
+      diskSize = orig.diskSize;
+      state = orig.state;
+      justLooking = orig.justLooking;
+      mainCrcOk = orig.mainCrcOk;
+      secondCrcOk = orig.secondCrcOk;
+      mainPartsCrcOk = orig.mainPartsCrcOk;
+      secondPartsCrcOk = orig.secondPartsCrcOk;
+      apmFound = orig.apmFound;
+      bsdFound = orig.bsdFound;
+      sectorAlignment = orig.sectorAlignment;
+      placement = orig.placement;
+      beQuiet = orig.beQuiet;
+      whichWasUsed = orig.whichWasUsed;
+
+      myDisk = move(orig.myDisk);
+      // The protective MBR normally uses orig's DiskIO object, which now
+      // lives in this object....
+      protectiveMBR = move(orig.protectiveMBR);
+      protectiveMBR.RelinkDisk(&orig.myDisk, &myDisk);
+
+      partitions = move(orig.partitions);
+      nameIndex = move(orig.nameIndex);
+      nameIndexValid = orig.nameIndexValid;
+      guidIndex = move(orig.guidIndex);
+      guidIndexValid = orig.guidIndexValid;
+      usedSlots = move(orig.usedSlots);
+      usedSlotsValid = orig.usedSlotsValid;
+      freeExtentsValid = 0;
+      verifyCache = move(orig.verifyCache);
+      inTransaction = orig.inTransaction;
+      openStep = move(orig.openStep);
+      journaled = move(orig.journaled);
+      journaledTable = orig.journaledTable;
+      undoSteps = move(orig.undoSteps);
+      redoSteps = move(orig.redoSteps);
+
+      orig.partitions = PartitionStore();
+      orig.numParts = orig.mainHeader.numParts = orig.secondHeader.numParts = 0;
+      orig.nameIndexValid = orig.guidIndexValid = orig.usedSlotsValid = 0;
+      orig.verifyCache.Invalidate();
+      orig.ClearJournal();
+   } // if
+
+   return *this;
+} // GPTData::operator=(GPTData &&)
+
 /*********************************************************************
  *                                                                   *
  * Begin functions that verify data, or that adjust the verification *
@@ -210,281 +289,264 @@ GPTData & GPTData::operator=(const GPTData & orig) {
 // do *NOT* recover from these problems. Returns the total number of
 // problems identified.
 int GPTData::Verify(void) {
+   VerifyReport report;
+   int problems;
+
+   problems = Verify(report);
+   report.ShowText(cout);
+   if (problems > 0)
+      cout << "\nIdentified " << problems << " problems!\n";
+   return (problems);
+} // GPTData::Verify()
+
+// As Verify(), but record the results in report rather than displaying
+// them. (The one exception is the main header's self-pointer, which is
+// corrected, as in Verify().) Returns the number of problems identified.
+int GPTData::Verify(VerifyReport & report) {
    int problems = 0, alignProbs = 0;
-   uint32_t i, numSegments, testAlignment = sectorAlignment;
+   uint32_t numSegments, testAlignment = sectorAlignment;
    uint64_t totalFree, largestSegment;
 
    // First, check for CRC errors in the GPT data....
    if (!mainCrcOk) {
       problems++;
-      cout << "\nProblem: The CRC for the main GPT header is invalid. The main GPT header may\n"
-           << "be corrupt. Consider loading the backup GPT header to rebuild the main GPT\n"
-           << "header ('b' on the recovery & transformation menu). This report may be a false\n"
-           << "alarm if you've already corrected other problems.\n";
+      report.Add(verify_main_header_crc);
    } // if
    if (!mainPartsCrcOk) {
       problems++;
-      cout << "\nProblem: The CRC for the main partition table is invalid. This table may be\n"
-           << "corrupt. Consider loading the backup partition table ('c' on the recovery &\n"
-           << "transformation menu). This report may be a false alarm if you've already\n"
-           << "corrected other problems.\n";
+      report.Add(verify_main_table_crc);
    } // if
    if (!secondCrcOk) {
       problems++;
-      cout << "\nProblem: The CRC for the backup GPT header is invalid. The backup GPT header\n"
-           << "may be corrupt. Consider using the main GPT header to rebuild the backup GPT\n"
-           << "header ('d' on the recovery & transformation menu). This report may be a false\n"
-           << "alarm if you've already corrected other problems.\n";
+      report.Add(verify_backup_header_crc);
    } // if
    if (!secondPartsCrcOk) {
       problems++;
-      cout << "\nCaution: The CRC for the backup partition table is invalid. This table may\n"
-           << "be corrupt. This program will automatically create a new backup partition\n"
-           << "table when you save your partitions.\n";
+      report.Add(verify_backup_table_crc);
    } // if
 
    // Now check that the main and backup headers both point to themselves....
    if (mainHeader.currentLBA != 1) {
       problems++;
-      cout << "\nProblem: The main header's self-pointer doesn't point to itself. This problem\n"
-           << "is being automatically corrected, but it may be a symptom of more serious\n"
-           << "problems. Think carefully before saving changes with 'w' or using this disk.\n";
+      report.Add(verify_main_self_pointer);
       mainHeader.currentLBA = 1;
    } // if
    if (secondHeader.currentLBA != (diskSize - UINT64_C(1))) {
       problems++;
-      cout << "\nProblem: The secondary header's self-pointer indicates that it doesn't reside\n"
-           << "at the end of the disk. If you've added a disk to a RAID array, use the 'e'\n"
-           << "option on the experts' menu to adjust the secondary header's and partition\n"
-           << "table's locations.\n";
+      report.Add(verify_backup_self_pointer);
    } // if
 
    // Now check that critical main and backup GPT entries match each other
    if (mainHeader.currentLBA != secondHeader.backupLBA) {
       problems++;
-      cout << "\nProblem: main GPT header's current LBA pointer (" << mainHeader.currentLBA
-           << ") doesn't\nmatch the backup GPT header's alternate LBA pointer("
-           << secondHeader.backupLBA << ").\n";
+      report.Add(verify_main_current_lba, VERIFY_NO_PART, VERIFY_NO_PART,
+                 mainHeader.currentLBA, secondHeader.backupLBA);
    } // if
    if (mainHeader.backupLBA != secondHeader.currentLBA) {
       problems++;
-      cout << "\nProblem: main GPT header's backup LBA pointer (" << mainHeader.backupLBA
-           << ") doesn't\nmatch the backup GPT header's current LBA pointer ("
-           << secondHeader.currentLBA << ").\n"
-           << "The 'e' option on the experts' menu may fix this problem.\n";
+      report.Add(verify_main_backup_lba, VERIFY_NO_PART, VERIFY_NO_PART,
+                 mainHeader.backupLBA, secondHeader.currentLBA);
    } // if
    if (mainHeader.firstUsableLBA != secondHeader.firstUsableLBA) {
       problems++;
-      cout << "\nProblem: main GPT header's first usable LBA pointer (" << mainHeader.firstUsableLBA
-           << ") doesn't\nmatch the backup GPT header's first usable LBA pointer ("
-           << secondHeader.firstUsableLBA << ")\n";
+      report.Add(verify_first_usable_mismatch, VERIFY_NO_PART, VERIFY_NO_PART,
+                 mainHeader.firstUsableLBA, secondHeader.firstUsableLBA);
    } // if
    if (mainHeader.lastUsableLBA != secondHeader.lastUsableLBA) {
       problems++;
-      cout << "\nProblem: main GPT header's last usable LBA pointer (" << mainHeader.lastUsableLBA
-           << ") doesn't\nmatch the backup GPT header's last usable LBA pointer ("
-           << secondHeader.lastUsableLBA << ")\n"
-           << "The 'e' option on the experts' menu can probably fix this problem.\n";
+      report.Add(verify_last_usable_mismatch, VERIFY_NO_PART, VERIFY_NO_PART,
+                 mainHeader.lastUsableLBA, secondHeader.lastUsableLBA);
    } // if
    if ((mainHeader.diskGUID != secondHeader.diskGUID)) {
       problems++;
-      cout << "\nProblem: main header's disk GUID (" << mainHeader.diskGUID
-           << ") doesn't\nmatch the backup GPT header's disk GUID ("
-           << secondHeader.diskGUID << ")\n"
-           << "You should use the 'b' or 'd' option on the recovery & transformation menu to\n"
-           << "select one or the other header.\n";
+      VerifyProblem & problem = report.Add(verify_disk_guid_mismatch);
+      problem.guids[0] = mainHeader.diskGUID.AsString();
+      problem.guids[1] = secondHeader.diskGUID.AsString();
    } // if
    if (mainHeader.numParts != secondHeader.numParts) {
       problems++;
-      cout << "\nProblem: main GPT header's number of partitions (" << mainHeader.numParts
-           << ") doesn't\nmatch the backup GPT header's number of partitions ("
-           << secondHeader.numParts << ")\n"
-           << "Resizing the partition table ('s' on the experts' menu) may help.\n";
+      report.Add(verify_num_parts_mismatch, VERIFY_NO_PART, VERIFY_NO_PART,
+                 mainHeader.numParts, secondHeader.numParts);
    } // if
    if (mainHeader.sizeOfPartitionEntries != secondHeader.sizeOfPartitionEntries) {
       problems++;
-      cout << "\nProblem: main GPT header's size of partition entries ("
-           << mainHeader.sizeOfPartitionEntries << ") doesn't\n"
-           << "match the backup GPT header's size of partition entries ("
-           << secondHeader.sizeOfPartitionEntries << ")\n"
-           << "You should use the 'b' or 'd' option on the recovery & transformation menu to\n"
-           << "select one or the other header.\n";
+      report.Add(verify_entry_size_mismatch, VERIFY_NO_PART, VERIFY_NO_PART,
+                 mainHeader.sizeOfPartitionEntries, secondHeader.sizeOfPartitionEntries);
    } // if
 
    // Now check for a few other miscellaneous problems...
    // Check that the disk size will hold the data...
    if (mainHeader.backupLBA >= diskSize) {
       problems++;
-      cout << "\nProblem: Disk is too small to hold all the data!\n"
-           << "(Disk size is " << diskSize << " sectors, needs to be "
-           << mainHeader.backupLBA + UINT64_C(1) << " sectors.)\n"
-           << "The 'e' option on the experts' menu may fix this problem.\n";
+      report.Add(verify_disk_too_small, VERIFY_NO_PART, VERIFY_NO_PART,
+                 diskSize, mainHeader.backupLBA + UINT64_C(1));
    } // if
 
    // Check the main and backup partition tables for overlap with things and unusual gaps
    if (mainHeader.partitionEntriesLBA + GetTableSizeInSectors() > mainHeader.firstUsableLBA) {
        problems++;
-       cout << "\nProblem: Main partition table extends past the first usable LBA.\n"
-            << "Using 'j' on the experts' menu may enable fixing this problem.\n";
+       report.Add(verify_main_table_past_first_usable);
    } // if
    if (mainHeader.partitionEntriesLBA < 2) {
        problems++;
-       cout << "\nProblem: Main partition table appears impossibly early on the disk.\n"
-            << "Using 'j' on the experts' menu may enable fixing this problem.\n";
+       report.Add(verify_main_table_too_early);
    } // if
    if (secondHeader.partitionEntriesLBA + GetTableSizeInSectors() > secondHeader.currentLBA) {
        problems++;
-       cout << "\nProblem: The backup partition table overlaps the backup header.\n"
-            << "Using 'e' on the experts' menu may fix this problem.\n";
+       report.Add(verify_backup_table_overlaps_header);
    } // if
    if (mainHeader.partitionEntriesLBA != 2) {
-       cout << "\nWarning: There is a gap between the main metadata (sector 1) and the main\n"
-            << "partition table (sector " << mainHeader.partitionEntriesLBA
-            << "). This is helpful in some exotic configurations,\n"
-            << "but is generally ill-advised. Using 'j' on the experts' menu can adjust this\n"
-            << "gap.\n";
+       report.Add(verify_main_table_gap, VERIFY_NO_PART, VERIFY_NO_PART,
+                  mainHeader.partitionEntriesLBA);
    } // if
    if (mainHeader.partitionEntriesLBA + GetTableSizeInSectors() != mainHeader.firstUsableLBA) {
-       cout << "\nWarning: There is a gap between the main partition table (ending sector "
-            << mainHeader.partitionEntriesLBA + GetTableSizeInSectors() - 1 << ")\n"
-            << "and the first usable sector (" << mainHeader.firstUsableLBA << "). This is helpful in some exotic configurations,\n"
-            << "but is unusual. The util-linux fdisk program often creates disks like this.\n"
-            << "Using 'j' on the experts' menu can adjust this gap.\n";
+       report.Add(verify_first_usable_gap, VERIFY_NO_PART, VERIFY_NO_PART,
+                  mainHeader.partitionEntriesLBA + GetTableSizeInSectors() - 1,
+                  mainHeader.firstUsableLBA);
    } // if
 
-   if (mainHeader.sizeOfPartitionEntries * mainHeader.numParts < 16384) {
-      cout << "\nWarning: The size of the partition table (" << mainHeader.sizeOfPartitionEntries * mainHeader.numParts
-           << " bytes) is less than the minimum\n"
-           << "required by the GPT specification. Most OSes and tools seem to work fine on\n"
-           << "such disks, but this is a violation of the GPT specification and so may cause\n"
-           << "problems.\n";
+   if ((uint64_t) mainHeader.sizeOfPartitionEntries * mainHeader.numParts < 16384) {
+      report.Add(verify_table_too_small, VERIFY_NO_PART, VERIFY_NO_PART,
+                 mainHeader.sizeOfPartitionEntries * mainHeader.numParts);
    } // if
 
    if ((mainHeader.lastUsableLBA >= diskSize) || (mainHeader.lastUsableLBA > mainHeader.backupLBA)) {
       problems++;
-      cout << "\nProblem: GPT claims the disk is larger than it is! (Claimed last usable\n"
-           << "sector is " << mainHeader.lastUsableLBA << ", but backup header is at\n"
-           << mainHeader.backupLBA << " and disk size is " << diskSize << " sectors.\n"
-           << "The 'e' option on the experts' menu will probably fix this problem\n";
+      report.Add(verify_last_usable_too_big, VERIFY_NO_PART, VERIFY_NO_PART,
+                 mainHeader.lastUsableLBA, mainHeader.backupLBA, diskSize);
    }
 
    // Check for overlapping partitions....
-   problems += FindOverlaps();
+   problems += FindOverlaps(report);
+
+   // Check for partitions that share a unique GUID (as on cloned disks)....
+   problems += FindDuplicateGUIDs(report);
 
    // Check for insane partitions (start after end, hugely big, etc.)
-   problems += FindInsanePartitions();
+   problems += FindInsanePartitions(report);
 
    // Check for mismatched MBR and GPT partitions...
-   problems += FindHybridMismatches();
+   problems += FindHybridMismatches(report);
 
    // Check for MBR-specific problems....
-   problems += VerifyMBR();
+   problems += VerifyMBR(report);
 
    // Check for a 0xEE protective partition that's marked as active....
    if (protectiveMBR.IsEEActive()) {
-      cout << "\nWarning: The 0xEE protective partition in the MBR is marked as active. This is\n"
-           << "technically a violation of the GPT specification, and can cause some EFIs to\n"
-           << "ignore the disk, but it is required to boot from a GPT disk on some BIOS-based\n"
-           << "computers. You can clear this flag by creating a fresh protective MBR using\n"
-           << "the 'n' option on the experts' menu.\n";
+      report.Add(verify_ee_active);
    }
 
    // Verify that partitions don't run into GPT data areas....
-   problems += CheckGPTSize();
+   problems += CheckUsedRange(verifyCache.FirstUsed(), verifyCache.LastUsed(), report);
 
    if (!protectiveMBR.DoTheyFit()) {
-      cout << "\nPartition(s) in the protective MBR are too big for the disk! Creating a\n"
-           << "fresh protective or hybrid MBR is recommended.\n";
+      report.Add(verify_mbr_too_big);
       problems++;
    }
 
    // Check that partitions are aligned on proper boundaries (for WD Advanced
    // Format and similar disks)....
-   if ((physBlockSize != 0) && (blockSize != 0))
-      testAlignment = physBlockSize / blockSize;
-   testAlignment = max(testAlignment, sectorAlignment);
+   testAlignment = CheckedAlignment();
    if (testAlignment == 0) // Should not happen; just being paranoid.
       testAlignment = sectorAlignment;
-   for (i = 0; i < numParts; i++) {
-      if ((partitions[i].IsUsed()) && (partitions[i].GetFirstLBA() % testAlignment) != 0) {
-         cout << "\nCaution: Partition " << i + 1 << " doesn't begin on a "
-              << testAlignment << "-sector boundary. This may\nresult "
-              << "in degraded performance on some modern (2009 and later) hard disks.\n";
+   for (const pair<const uint32_t, uint32_t> & flagged : verifyCache.Flagged()) {
+      if (flagged.second & VERIFY_MISALIGNED) {
+         report.Add(verify_misaligned, flagged.first, VERIFY_NO_PART, testAlignment);
          alignProbs++;
       } // if
    } // for
+   if ((alignProbs > 0) && (TopologyAlignment() > 1) &&
+       ((topology.minIOSize > physBlockSize) || topology.optIOSize || topology.eraseSize)) {
+      report.Add(verify_topology_hint, VERIFY_NO_PART, VERIFY_NO_PART, topology.minIOSize,
+                 topology.optIOSize, topology.eraseSize, TopologyAlignment());
+   } // if
    if (alignProbs > 0)
-      cout << "\nConsult http://www.ibm.com/developerworks/linux/library/l-4kb-sector-disks/\n"
-      << "for information on disk alignment.\n";
+      report.Add(verify_alignment_advice);
+
+   // On zoned devices, check that partitions begin and end on zone boundaries....
+   if (ZoneSectors() > 0) {
+      for (const pair<const uint32_t, uint32_t> & flagged : verifyCache.Flagged()) {
+         if (flagged.second & VERIFY_OFF_ZONE)
+            report.Add(verify_off_zone, flagged.first, VERIFY_NO_PART, ZoneSectors());
+      } // for
+   } // if
+   if (topology.alignOffset != 0) {
+      report.Add(verify_align_offset, VERIFY_NO_PART, VERIFY_NO_PART, topology.alignOffset);
+   } // if
 
    // Now compute available space, but only if no problems found, since
    // problems could affect the results
    if (problems == 0) {
-      totalFree = FindFreeBlocks(&numSegments, &largestSegment);
-      cout << "\nNo problems found. " << totalFree << " free sectors ("
-           << BytesToIeee(totalFree, blockSize) << ") available in "
-           << numSegments << "\nsegments, the largest of which is "
-           << largestSegment << " (" << BytesToIeee(largestSegment, blockSize)
-           << ") in size.\n";
-   } else {
-      cout << "\nIdentified " << problems << " problems!\n";
-   } // if/else
+      if (diskSize > 0) {
+         totalFree = verifyCache.FreeSummary(&numSegments, &largestSegment);
+      } else {
+         totalFree = largestSegment = 0;
+         numSegments = 0;
+      } // if/else
+      report.Add(verify_free_space, VERIFY_NO_PART, VERIFY_NO_PART, totalFree,
+                 numSegments, largestSegment, blockSize);
+   } // if
 
    return (problems);
-} // GPTData::Verify()
+} // GPTData::Verify(VerifyReport &)
 
 // Checks to see if the GPT tables overrun existing partitions; if they
 // do, issues a warning but takes no action. Returns number of problems
 // detected (0 if OK, 1 to 2 if problems).
 int GPTData::CheckGPTSize(void) {
-   uint64_t overlap, firstUsedBlock, lastUsedBlock;
-   uint32_t i;
-   int numProbs = 0;
+   VerifyReport report;
+   int numProbs;
+
+   numProbs = CheckGPTSize(report);
+   DiagReport(report);
+   return numProbs;
+} // GPTData::CheckGPTSize()
+
+// As CheckGPTSize(), but record any problems in report rather than
+// displaying them.
+int GPTData::CheckGPTSize(VerifyReport & report) {
+   uint64_t firstUsedBlock, lastUsedBlock;
+   PartitionStore::StoredIterator it;
 
    // first, locate the first & last used blocks
    firstUsedBlock = UINT64_MAX;
    lastUsedBlock = 0;
-   for (i = 0; i < numParts; i++) {
-      if (partitions[i].IsUsed()) {
-         if (partitions[i].GetFirstLBA() < firstUsedBlock)
-            firstUsedBlock = partitions[i].GetFirstLBA();
-         if (partitions[i].GetLastLBA() > lastUsedBlock) {
-            lastUsedBlock = partitions[i].GetLastLBA();
-         } // if
+   for (it = partitions.BeginStored(); it != partitions.EndStored(); it++) {
+      const GPTPart & part = partitions.Stored(it);
+      if (!part.IsUsed())
+         continue;
+      if (part.GetFirstLBA() < firstUsedBlock)
+         firstUsedBlock = part.GetFirstLBA();
+      if (part.GetLastLBA() > lastUsedBlock) {
+         lastUsedBlock = part.GetLastLBA();
       } // if
    } // for
+   return CheckUsedRange(firstUsedBlock, lastUsedBlock, report);
+} // GPTData::CheckGPTSize(VerifyReport &)
+
+// As CheckGPTSize(VerifyReport &), given the first and last blocks used by
+// partitions (or UINT64_MAX and 0 if there are no partitions).
+int GPTData::CheckUsedRange(uint64_t firstUsedBlock, uint64_t lastUsedBlock,
+                            VerifyReport & report) {
+   int numProbs = 0;
 
    // If the disk size is 0 (the default), then it means that various
    // variables aren't yet set, so the below tests will be useless;
    // therefore we should skip everything
    if (diskSize != 0) {
       if (mainHeader.firstUsableLBA > firstUsedBlock) {
-         overlap = mainHeader.firstUsableLBA - firstUsedBlock;
-         cout << "Warning! Main partition table overlaps the first partition by "
-              << overlap << " blocks!\n";
-         if (firstUsedBlock > 2) {
-            cout << "Try reducing the partition table size by " << overlap * 4
-                 << " entries.\n(Use the 's' item on the experts' menu.)\n";
-         } else {
-            cout << "You will need to delete this partition or resize it in another utility.\n";
-         } // if/else
+         report.Add(verify_main_table_overlaps_partition, VERIFY_NO_PART, VERIFY_NO_PART,
+                    mainHeader.firstUsableLBA - firstUsedBlock, firstUsedBlock);
          numProbs++;
       } // Problem at start of disk
       if (mainHeader.lastUsableLBA < lastUsedBlock) {
-         overlap = lastUsedBlock - mainHeader.lastUsableLBA;
-         cout << "\nWarning! Secondary partition table overlaps the last partition by\n"
-              << overlap << " blocks!\n";
-         if (lastUsedBlock > (diskSize - 2)) {
-            cout << "You will need to delete this partition or resize it in another utility.\n";
-         } else {
-            cout << "Try reducing the partition table size by " << overlap * 4
-                 << " entries.\n(Use the 's' item on the experts' menu.)\n";
-         } // if/else
+         report.Add(verify_backup_table_overlaps_partition, VERIFY_NO_PART, VERIFY_NO_PART,
+                    lastUsedBlock - mainHeader.lastUsableLBA, lastUsedBlock, diskSize);
          numProbs++;
       } // Problem at end of disk
    } // if (diskSize != 0)
    return numProbs;
-} // GPTData::CheckGPTSize()
+} // GPTData::CheckUsedRange()
 
 // Check the validity of the GPT header. Returns 1 if the main header
 // is valid, 2 if the backup header is valid, 3 if both are valid, and
@@ -493,31 +555,24 @@ int GPTData::CheckGPTSize(void) {
 int GPTData::CheckHeaderValidity(void) {
    int valid = 3;
 
-   cout.setf(ios::uppercase);
-   cout.fill('0');
-
    // Note: failed GPT signature checks produce no error message because
    // a message is displayed in the ReversePartitionBytes() function
    if ((mainHeader.signature != GPT_SIGNATURE) || (!CheckHeaderCRC(&mainHeader, 1))) {
       valid -= 1;
    } else if ((mainHeader.revision != 0x00010000) && valid) {
       valid -= 1;
-      cout << "Unsupported GPT version in main header; read 0x";
-      cout.width(8);
-      cout << hex << mainHeader.revision << ", should be\n0x";
-      cout.width(8);
-      cout << UINT32_C(0x00010000) << dec << "\n";
+      DIAG(diag_gpt_version, "Unsupported GPT version in main header; read 0x" << uppercase
+           << hex << setfill('0') << setw(8) << mainHeader.revision << ", should be\n0x"
+           << setw(8) << UINT32_C(0x00010000) << "\n");
    } // if/else/if
 
    if ((secondHeader.signature != GPT_SIGNATURE) || (!CheckHeaderCRC(&secondHeader))) {
       valid -= 2;
    } else if ((secondHeader.revision != 0x00010000) && valid) {
       valid -= 2;
-      cout << "Unsupported GPT version in backup header; read 0x";
-      cout.width(8);
-      cout << hex << secondHeader.revision << ", should be\n0x";
-      cout.width(8);
-      cout << UINT32_C(0x00010000) << dec << "\n";
+      DIAG(diag_gpt_version, "Unsupported GPT version in backup header; read 0x" << uppercase
+           << hex << setfill('0') << setw(8) << secondHeader.revision << ", should be\n0x"
+           << setw(8) << UINT32_C(0x00010000) << "\n");
    } // if/else/if
 
    // Check for an Apple disk signature
@@ -525,7 +580,6 @@ int GPTData::CheckHeaderValidity(void) {
         (mainHeader.signature << 32) == APM_SIGNATURE2) {
       apmFound = 1; // Will display warning message later
    } // if
-   cout.fill(' ');
 
    return valid;
 } // GPTData::CheckHeaderValidity()
@@ -550,14 +604,16 @@ int GPTData::CheckHeaderCRC(struct GPTHeader* header, int warn) {
 
    if ((hSize > blockSize) || (hSize < HEADER_SIZE)) {
       if (warn) {
-         cerr << "\aWarning! Header size is specified as " << hSize << ", which is invalid.\n";
-         cerr << "Setting the header size for CRC computation to " << HEADER_SIZE << "\n";
+         DIAG(diag_header_size_invalid, "\aWarning! Header size is specified as " << hSize
+              << ", which is invalid.\nSetting the header size for CRC computation to "
+              << HEADER_SIZE << "\n");
       } // if
       hSize = HEADER_SIZE;
    } else if ((hSize > sizeof(GPTHeader)) && warn) {
-      cout << "\aCaution! Header size for CRC check is " << hSize << ", which is greater than " << sizeof(GPTHeader) << ".\n";
-      cout << "If stray data exists after the header on the header sector, it will be ignored,\n"
-           << "which may result in a CRC false alarm.\n";
+      DIAG(diag_header_size_large, "\aCaution! Header size for CRC check is " << hSize
+           << ", which is greater than " << sizeof(GPTHeader) << ".\n"
+           << "If stray data exists after the header on the header sector, it will be ignored,\n"
+           << "which may result in a CRC false alarm.\n");
    } // if/elseif
    temp = new uint8_t[hSize];
    if (temp != NULL) {
@@ -570,8 +626,8 @@ int GPTData::CheckHeaderCRC(struct GPTHeader* header, int warn) {
       newCRC = chksum_crc32((unsigned char*) temp, hSize);
       delete[] temp;
    } else {
-      cerr << "Could not allocate memory in GPTData::CheckHeaderCRC()! Aborting!\n";
-      exit(1);
+      DIAG(diag_no_memory, "Could not allocate memory in GPTData::CheckHeaderCRC()! Aborting!\n");
+      throw bad_alloc();
    }
    if (IsLittleEndian() == 0)
       ReverseHeaderBytes(header);
@@ -579,6 +635,14 @@ int GPTData::CheckHeaderCRC(struct GPTHeader* header, int warn) {
    return (oldCRC == newCRC);
 } // GPTData::CheckHeaderCRC()
 
+// Compute the CRC of the partition table as it appears on disk. The stored
+// entries are checksummed in place and the blank ones between them as runs
+// of zeros, rather than assembling an on-disk image first. Must be called
+// on little-endian data.
+uint32_t GPTData::ComputeTableCRC(void) {
+   return partitions.ComputeCRC();
+} // GPTData::ComputeTableCRC()
+
 // Recompute all the CRCs. Must be called before saving if any changes have
 // been made. Must be called on platform-ordered data (this function reverses
 // byte order and then undoes that reversal.)
@@ -592,6 +656,7 @@ void GPTData::RecomputeCRCs(void) {
       hSize = secondHeader.headerSize = mainHeader.headerSize = HEADER_SIZE;
    else
       hSize = secondHeader.headerSize = mainHeader.headerSize;
+   mainHeader.sizeOfPartitionEntries = secondHeader.sizeOfPartitionEntries = partEntrySize;
 
    if ((littleEndian = IsLittleEndian()) == 0) {
       ReversePartitionBytes();
@@ -600,7 +665,7 @@ void GPTData::RecomputeCRCs(void) {
    } // if
 
    // Compute CRC of partition tables & store in main and secondary headers
-   crc = chksum_crc32((unsigned char*) partitions, numParts * GPT_SIZE);
+   crc = ComputeTableCRC();
    mainHeader.partitionEntriesCRC = crc;
    secondHeader.partitionEntriesCRC = crc;
    if (littleEndian == 0) {
@@ -642,6 +707,7 @@ void GPTData::RebuildMainHeader(void) {
    mainHeader.lastUsableLBA = secondHeader.lastUsableLBA;
    mainHeader.diskGUID = secondHeader.diskGUID;
    mainHeader.numParts = secondHeader.numParts;
+   SetEntrySize(secondHeader.sizeOfPartitionEntries);
    mainHeader.partitionEntriesLBA = secondHeader.firstUsableLBA - GetTableSizeInSectors();
    mainHeader.sizeOfPartitionEntries = secondHeader.sizeOfPartitionEntries;
    mainHeader.partitionEntriesCRC = secondHeader.partitionEntriesCRC;
@@ -674,61 +740,93 @@ void GPTData::RebuildSecondHeader(void) {
 // Search for hybrid MBR entries that have no corresponding GPT partition.
 // Returns number of such mismatches found
 int GPTData::FindHybridMismatches(void) {
-   int i, found, numFound = 0;
-   uint32_t j;
+   VerifyReport report;
+   int numFound;
+
+   numFound = FindHybridMismatches(report);
+   DiagReport(report);
+   return numFound;
+} // GPTData::FindHybridMismatches
+
+// As FindHybridMismatches(), but record the mismatches in report rather
+// than displaying them.
+int GPTData::FindHybridMismatches(VerifyReport & report) {
+   int i, numFound = 0;
    uint64_t mbrFirst, mbrLast;
 
+   UpdateVerifyCache();
    for (i = 0; i < 4; i++) {
       if ((protectiveMBR.GetType(i) != 0xEE) && (protectiveMBR.GetType(i) != 0x00)) {
-         j = 0;
-         found = 0;
          mbrFirst = (uint64_t) protectiveMBR.GetFirstSector(i);
          mbrLast = mbrFirst + (uint64_t) protectiveMBR.GetLength(i) - UINT64_C(1);
-         do {
-            if ((j < numParts) && (partitions[j].GetFirstLBA() == mbrFirst) &&
-                (partitions[j].GetLastLBA() == mbrLast) && (partitions[j].IsUsed()))
-               found = 1;
-            j++;
-         } while ((!found) && (j < numParts));
-         if (!found) {
+         if (!verifyCache.HasExtent(mbrFirst, mbrLast)) {
             numFound++;
-            cout << "\nWarning! Mismatched GPT and MBR partition! MBR partition "
-                 << i + 1 << ", of type 0x";
-            cout.fill('0');
-            cout.setf(ios::uppercase);
-            cout.width(2);
-            cout << hex << (int) protectiveMBR.GetType(i) << ",\n"
-                 << "has no corresponding GPT partition! You may continue, but this condition\n"
-                 << "might cause data loss in the future!\a\n" << dec;
-            cout.fill(' ');
+            report.Add(verify_hybrid_mismatch, i, VERIFY_NO_PART, protectiveMBR.GetType(i));
          } // if
       } // if
    } // for
    return numFound;
-} // GPTData::FindHybridMismatches
+} // GPTData::FindHybridMismatches(VerifyReport &)
 
 // Find overlapping partitions and warn user about them. Returns number of
 // overlapping partitions.
 // Returns number of overlapping segments found.
 int GPTData::FindOverlaps(void) {
+   VerifyReport report;
+   int problems;
+
+   problems = FindOverlaps(report);
+   DiagReport(report);
+   return problems;
+} // GPTData::FindOverlaps()
+
+// As FindOverlaps(), but record the overlaps in report rather than
+// displaying them.
+int GPTData::FindOverlaps(VerifyReport & report) {
    int problems = 0;
    uint32_t i, j;
 
-   for (i = 1; i < numParts; i++) {
-      for (j = 0; j < i; j++) {
-         if ((partitions[i].IsUsed()) && (partitions[j].IsUsed()) &&
-             (partitions[i].DoTheyOverlap(partitions[j]))) {
-            problems++;
-            cout << "\nProblem: partitions " << i + 1 << " and " << j + 1 << " overlap:\n";
-            cout << "  Partition " << i + 1 << ": " << partitions[i].GetFirstLBA()
-                 << " to " << partitions[i].GetLastLBA() << "\n";
-            cout << "  Partition " << j + 1 << ": " << partitions[j].GetFirstLBA()
-                 << " to " << partitions[j].GetLastLBA() << "\n";
-         } // if
-      } // for j...
-   } // for i...
+   UpdateVerifyCache();
+   for (const pair<uint32_t, uint32_t> & overlap : verifyCache.Overlaps()) {
+      i = overlap.first;
+      j = overlap.second;
+      problems++;
+      report.Add(verify_overlap, i, j, partitions[i].GetFirstLBA(), partitions[i].GetLastLBA(),
+                 partitions[j].GetFirstLBA(), partitions[j].GetLastLBA());
+   } // for
    return problems;
-} // GPTData::FindOverlaps()
+} // GPTData::FindOverlaps(VerifyReport &)
+
+// Find partitions whose unique GUIDs duplicate those of lower-numbered
+// partitions and warn the user about them. Such duplicates confuse OSes
+// that identify partitions by GUID (e.g., Linux's /dev/disk/by-partuuid).
+// Returns number of duplicates found.
+int GPTData::FindDuplicateGUIDs(void) {
+   VerifyReport report;
+   int problems;
+
+   problems = FindDuplicateGUIDs(report);
+   DiagReport(report);
+   return problems;
+} // GPTData::FindDuplicateGUIDs()
+
+// As FindDuplicateGUIDs(), but record the duplicates in report rather than
+// displaying them.
+int GPTData::FindDuplicateGUIDs(VerifyReport & report) {
+   int problems = 0;
+   uint32_t first;
+
+   UpdateVerifyCache();
+   for (const uint32_t i : verifyCache.DuplicateGUIDs()) {
+      first = verifyCache.FirstWithGUID(i);
+      if (first != i) {
+         problems++;
+         report.Add(verify_duplicate_guid, i, first).guids[0] =
+            partitions[i].GetUniqueGUID().AsString();
+      } // if
+   } // for
+   return problems;
+} // GPTData::FindDuplicateGUIDs(VerifyReport &)
 
 // Find partitions that are insane -- they start after they end or are too
 // big for the disk. (The latter should duplicate detection of overlaps
@@ -736,23 +834,47 @@ int GPTData::FindOverlaps(void) {
 // redundant tests than to miss something....)
 // Returns number of problems found.
 int GPTData::FindInsanePartitions(void) {
-   uint32_t i;
+   VerifyReport report;
+   int problems;
+
+   problems = FindInsanePartitions(report);
+   DiagReport(report);
+   return problems;
+} // GPTData::FindInsanePartitions(void)
+
+// As FindInsanePartitions(), but record the problems in report rather than
+// displaying them.
+int GPTData::FindInsanePartitions(VerifyReport & report) {
    int problems = 0;
 
-   for (i = 0; i < numParts; i++) {
-      if (partitions[i].IsUsed()) {
-         if (partitions[i].GetFirstLBA() > partitions[i].GetLastLBA()) {
-            problems++;
-            cout << "\nProblem: partition " << i + 1 << " ends before it begins.\n";
-         } // if
-         if (partitions[i].GetLastLBA() >= diskSize) {
-            problems++;
-            cout << "\nProblem: partition " << i + 1 << " is too big for the disk.\n";
-         } // if
+   UpdateVerifyCache();
+   for (const pair<const uint32_t, uint32_t> & flagged : verifyCache.Flagged()) {
+      if (flagged.second & VERIFY_BACKWARDS) {
+         problems++;
+         report.Add(verify_backwards, flagged.first);
+      } // if
+      if (flagged.second & VERIFY_TOO_BIG) {
+         problems++;
+         report.Add(verify_too_big, flagged.first);
       } // if
    } // for
    return problems;
-} // GPTData::FindInsanePartitions(void)
+} // GPTData::FindInsanePartitions(VerifyReport &)
+
+// Bring the cached verification results up to date with the partition
+// table and the disk's current size, usable area, alignment, and zones.
+// Normally only the entries changed since the last call are re-checked.
+void GPTData::UpdateVerifyCache(void) {
+   VerifyParams params;
+
+   params.diskSize = diskSize;
+   params.firstUsable = mainHeader.firstUsableLBA;
+   params.lastUsable = mainHeader.lastUsableLBA;
+   params.alignment = CheckedAlignment();
+   params.zoneSectors = ZoneSectors();
+   params.numParts = numParts;
+   verifyCache.Update(partitions, params);
+} // GPTData::UpdateVerifyCache()
 
 
 /******************************************************************
@@ -769,10 +891,12 @@ int GPTData::SetDisk(const string & deviceFilename) {
 
    device = deviceFilename;
    if (allOK && myDisk.OpenForRead(deviceFilename)) {
+      ClearJournal(); // changes to some other disk can't be undone here
       // store disk information....
       diskSize = myDisk.DiskSize(&err);
       blockSize = (uint32_t) myDisk.GetBlockSize();
       physBlockSize = (uint32_t) myDisk.GetPhysBlockSize();
+      ReadTopology();
    } // if
    protectiveMBR.SetDisk(&myDisk);
    protectiveMBR.SetDiskSize(diskSize);
@@ -798,7 +922,8 @@ void GPTData::PartitionScan(void) {
    // normalize it....
    if ((state == gpt_valid) && !protectiveMBR.DoTheyFit() && (protectiveMBR.GetValidity() == gpt)) {
       if (!beQuiet) {
-         cerr << "\aThe protective MBR's 0xEE partition is oversized! Auto-repairing.\n\n";
+         DIAG(diag_mbr_ee_oversized,
+              "\aThe protective MBR's 0xEE partition is oversized! Auto-repairing.\n\n");
       } // if
       protectiveMBR.MakeProtectiveMBR();
    } // if
@@ -813,12 +938,10 @@ void GPTData::PartitionScan(void) {
    } // if
 
    if (apmFound) {
-      cout << "\n*******************************************************************\n"
-           << "This disk appears to contain an Apple-format (APM) partition table!\n";
-      if (!justLooking) {
-         cout << "It will be destroyed if you continue!\n";
-      } // if
-      cout << "*******************************************************************\n\n\a";
+      DIAG(diag_apm_found, "\n*******************************************************************\n"
+           << "This disk appears to contain an Apple-format (APM) partition table!\n"
+           << (justLooking ? "" : "It will be destroyed if you continue!\n")
+           << "*******************************************************************\n\n\a");
    } // if
 } // GPTData::PartitionScan()
 
@@ -831,28 +954,31 @@ int GPTData::LoadPartitions(const string & deviceFilename) {
    if (myDisk.OpenForRead(deviceFilename)) {
       err = myDisk.OpenForWrite(deviceFilename);
       if ((err == 0) && (!justLooking)) {
-         cout << "\aNOTE: Write test failed with error number " << errno
-              << ". It will be impossible to save\nchanges to this disk's partition table!\n";
+         const char* advice = "";
 #if defined (__FreeBSD__) || defined (__FreeBSD_kernel__)
-         cout << "You may be able to enable writes by exiting this program, typing\n"
-              << "'sysctl kern.geom.debugflags=16' at a shell prompt, and re-running this\n"
-              << "program.\n";
+         advice = "You may be able to enable writes by exiting this program, typing\n"
+                  "'sysctl kern.geom.debugflags=16' at a shell prompt, and re-running this\n"
+                  "program.\n";
 #endif
 #if defined (__APPLE__)
-         cout << "You may need to deactivate System Integrity Protection to use this program. See\n"
-              << "https://www.quora.com/How-do-I-turn-off-the-rootless-in-OS-X-El-Capitan-10-11\n"
-              << "for more information.\n";
+         advice = "You may need to deactivate System Integrity Protection to use this program. See\n"
+                  "https://www.quora.com/How-do-I-turn-off-the-rootless-in-OS-X-El-Capitan-10-11\n"
+                  "for more information.\n";
 #endif
-              cout << "\n";
+         DIAG(diag_write_test_failed, "\aNOTE: Write test failed with error number " << errno
+              << ". It will be impossible to save\nchanges to this disk's partition table!\n"
+              << advice << "\n");
       } // if
       myDisk.Close(); // Close and re-open read-only in case of bugs
    } else allOK = 0; // if
 
    if (allOK && myDisk.OpenForRead(deviceFilename)) {
+      ClearJournal(); // changes to some other disk can't be undone here
       // store disk information....
       diskSize = myDisk.DiskSize(&err);
       blockSize = (uint32_t) myDisk.GetBlockSize();
       physBlockSize = (uint32_t) myDisk.GetPhysBlockSize();
+      ReadTopology();
       device = deviceFilename;
       PartitionScan(); // Check for partition types, load GPT, & print summary
 
@@ -879,7 +1005,7 @@ int GPTData::LoadPartitions(const string & deviceFilename) {
             break;
          case use_abort:
             allOK = 0;
-            cerr << "Invalid partition data!\n";
+            DIAG(diag_invalid_partition_data, "Invalid partition data!\n");
             break;
       } // switch
 
@@ -905,10 +1031,11 @@ int GPTData::ForceLoadGPTData(void) {
    } else {
       allOK = LoadHeader(&secondHeader, myDisk, diskSize - UINT64_C(1), &secondCrcOk) && allOK;
       if (mainCrcOk && (mainHeader.backupLBA >= diskSize))
-         cout << "Warning! Disk size is smaller than the main header indicates! Loading\n"
+         DIAG(diag_disk_smaller_than_header,
+              "Warning! Disk size is smaller than the main header indicates! Loading\n"
               << "secondary header from the last sector of the disk! You should use 'v' to\n"
               << "verify disk integrity, and perhaps options on the experts' menu to repair\n"
-              << "the disk.\n";
+              << "the disk.\n");
    } // if/else
    if (!allOK)
       state = gpt_invalid;
@@ -928,14 +1055,16 @@ int GPTData::ForceLoadGPTData(void) {
       // of the two headers is corrupt. If so, use the one that seems to
       // be in better shape to regenerate the bad one
       if (validHeaders == 1) { // valid main header, invalid backup header
-         cerr << "\aCaution: invalid backup GPT header, but valid main header; regenerating\n"
-              << "backup header from main header.\n\n";
+         DIAG(diag_backup_header_rebuilt,
+              "\aCaution: invalid backup GPT header, but valid main header; regenerating\n"
+              << "backup header from main header.\n\n");
          RebuildSecondHeader();
          state = gpt_corrupt;
          secondCrcOk = mainCrcOk; // Since regenerated, use CRC validity of main
       } else if (validHeaders == 2) { // valid backup header, invalid main header
-         cerr << "\aCaution: invalid main GPT header, but valid backup; regenerating main header\n"
-              << "from backup!\n\n";
+         DIAG(diag_main_header_rebuilt,
+              "\aCaution: invalid main GPT header, but valid backup; regenerating main header\n"
+              << "from backup!\n\n");
          RebuildMainHeader();
          state = gpt_corrupt;
          mainCrcOk = secondCrcOk; // Since copied, use CRC validity of backup
@@ -950,12 +1079,14 @@ int GPTData::ForceLoadGPTData(void) {
          state = gpt_corrupt;
          if (LoadSecondTableAsMain()) {
             loadedTable = 2;
-            cerr << "\aWarning: Invalid CRC on main header data; loaded backup partition table.\n";
+            DIAG(diag_loaded_backup_table,
+                 "\aWarning: Invalid CRC on main header data; loaded backup partition table.\n");
          } else { // backup table bad, bad main header CRC, but try main table in desperation....
             if (LoadMainTable() == 0) {
                allOK = 0;
                loadedTable = 0;
-               cerr << "\a\aWarning! Unable to load either main or backup partition table!\n";
+               DIAG(diag_no_table_loaded,
+                    "\a\aWarning! Unable to load either main or backup partition table!\n");
             } // if
          } // if/else (LoadSecondTableAsMain())
       } // if/else (load partition table)
@@ -972,32 +1103,20 @@ int GPTData::ForceLoadGPTData(void) {
          state = gpt_corrupt;
          allOK = allOK && LoadSecondTableAsMain();
          mainPartsCrcOk = 0; // LoadSecondTableAsMain() resets this, so re-flag as bad
-         cerr << "\aWarning! Main partition table CRC mismatch! Loaded backup "
-              << "partition table\ninstead of main partition table!\n\n";
+         DIAG(diag_loaded_backup_table, "\aWarning! Main partition table CRC mismatch! Loaded backup "
+              << "partition table\ninstead of main partition table!\n\n");
       } // if */
 
       // Check for valid CRCs and warn if there are problems
       if ((validHeaders != 3) || (mainPartsCrcOk == 0) ||
            (secondPartsCrcOk == 0)) {
-         cerr << "Warning! One or more CRCs don't match. You should repair the disk!\n";
          // Show detail status of header and table
-         if (validHeaders & 0x1)
-            cerr << "Main header: OK\n";
-         else
-            cerr << "Main header: ERROR\n";
-         if (validHeaders & 0x2)
-            cerr << "Backup header: OK\n";
-         else
-            cerr << "Backup header: ERROR\n";
-         if (mainPartsCrcOk)
-            cerr << "Main partition table: OK\n";
-         else
-            cerr << "Main partition table: ERROR\n";
-         if (secondPartsCrcOk)
-            cerr << "Backup partition table: OK\n";
-         else
-            cerr << "Backup partition table: ERROR\n";
-         cerr << "\n";
+         DIAG(diag_crc_mismatch,
+              "Warning! One or more CRCs don't match. You should repair the disk!\n"
+              << "Main header: " << ((validHeaders & 0x1) ? "OK" : "ERROR") << "\n"
+              << "Backup header: " << ((validHeaders & 0x2) ? "OK" : "ERROR") << "\n"
+              << "Main partition table: " << (mainPartsCrcOk ? "OK" : "ERROR") << "\n"
+              << "Backup partition table: " << (secondPartsCrcOk ? "OK" : "ERROR") << "\n\n");
          state = gpt_corrupt;
       } // if
    } else {
@@ -1033,7 +1152,7 @@ int GPTData::LoadHeader(struct GPTHeader *header, DiskIO & disk, uint64_t sector
 
    disk.Seek(sector);
    if (disk.Read(&tempHeader, 512) != 512) {
-      cerr << "Warning! Read error " << errno << "; strange behavior now likely!\n";
+      DIAG(diag_read_error, "Warning! Read error " << errno << "; strange behavior now likely!\n");
       allOK = 0;
    } // if
 
@@ -1057,11 +1176,13 @@ int GPTData::LoadHeader(struct GPTHeader *header, DiskIO & disk, uint64_t sector
 // indicated in header.
 // Returns 1 on success, 0 on failure. CRC errors do NOT count as failure.
 int GPTData::LoadPartitionTable(const struct GPTHeader & header, DiskIO & disk, uint64_t sector) {
-   uint32_t sizeOfParts, newCRC;
+   uint64_t sizeOfParts;
+   uint32_t newCRC;
+   uint8_t *table;
    int retval;
 
-   if (header.sizeOfPartitionEntries != sizeof(GPTPart)) {
-      cerr << "Error! GPT header contains invalid partition entry size!\n";
+   if (!SetEntrySize(header.sizeOfPartitionEntries)) {
+      DIAG(diag_bad_entry_size, "Error! GPT header contains invalid partition entry size!\n");
       retval = 0;
    } else if (disk.OpenForRead()) {
       if (sector == 0) {
@@ -1072,24 +1193,30 @@ int GPTData::LoadPartitionTable(const struct GPTHeader & header, DiskIO & disk,
       if (retval == 1)
          retval = SetGPTSize(header.numParts, 0);
       if (retval == 1) {
-         sizeOfParts = header.numParts * header.sizeOfPartitionEntries;
-         if (disk.Read(partitions, sizeOfParts) != (int) sizeOfParts) {
-            cerr << "Warning! Read error " << errno << "! Misbehavior now likely!\n";
+         TouchPartitions();
+         sizeOfParts = (uint64_t) header.numParts * header.sizeOfPartitionEntries;
+         // The table is read whole, and then only its non-blank entries
+         // are kept....
+         table = new uint8_t[sizeOfParts]();
+         if (disk.Read(table, (int) sizeOfParts) != (int) sizeOfParts) {
+            DIAG(diag_read_error, "Warning! Read error " << errno << "! Misbehavior now likely!\n");
             retval = 0;
          } // if
-         newCRC = chksum_crc32((unsigned char*) partitions, sizeOfParts);
+         newCRC = chksum_crc32(table, sizeOfParts);
          mainPartsCrcOk = secondPartsCrcOk = (newCRC == header.partitionEntriesCRC);
+         partitions.Unpack(table);
+         delete[] table;
          if (IsLittleEndian() == 0)
             ReversePartitionBytes();
          if (!mainPartsCrcOk) {
-            cout << "Caution! After loading partitions, the CRC doesn't check out!\n";
+            DIAG(diag_table_crc, "Caution! After loading partitions, the CRC doesn't check out!\n");
          } // if
       } else {
-         cerr << "Error! Couldn't seek to partition table!\n";
+         DIAG(diag_seek_error, "Error! Couldn't seek to partition table!\n");
       } // if/else
    } else {
-      cerr << "Error! Couldn't open device " << device
-           << " when reading partition table!\n";
+      DIAG(diag_open_error, "Error! Couldn't open device " << device
+           << " when reading partition table!\n");
       retval = 0;
    } // if/else
    return retval;
@@ -1100,33 +1227,38 @@ int GPTData::LoadPartitionTable(const struct GPTHeader & header, DiskIO & disk,
 // Returns 1 if the CRC is OK & this table matches the one already in memory,
 // 0 if not or if there was a read error.
 int GPTData::CheckTable(struct GPTHeader *header) {
-   uint32_t sizeOfParts, newCRC;
-   GPTPart *partsToCheck;
+   uint64_t sizeOfParts;
+   uint32_t newCRC;
+   uint8_t *partsToCheck;
    GPTHeader *otherHeader;
    int allOK = 0;
 
    // Load partition table into temporary storage to check
    // its CRC and store the results, then discard this temporary
    // storage, since we don't use it in any but recovery operations
-   if (myDisk.Seek(header->partitionEntriesLBA)) {
-      partsToCheck = new GPTPart[header->numParts];
-      sizeOfParts = header->numParts * header->sizeOfPartitionEntries;
+   sizeOfParts = (uint64_t) header->numParts * header->sizeOfPartitionEntries;
+   if (sizeOfParts > MAX_GPT_TABLE_SIZE) {
+      DIAG(diag_table_too_big, "Warning! Partition table is too big (" << sizeOfParts
+           << " bytes) for a CRC check!\n");
+   } else if (myDisk.Seek(header->partitionEntriesLBA)) {
+      partsToCheck = new uint8_t[sizeOfParts];
       if (partsToCheck == NULL) {
-         cerr << "Could not allocate memory in GPTData::CheckTable()! Terminating!\n";
-         exit(1);
+         DIAG(diag_no_memory, "Could not allocate memory in GPTData::CheckTable()! Terminating!\n");
+         throw bad_alloc();
       } // if
-      if (myDisk.Read(partsToCheck, sizeOfParts) != (int) sizeOfParts) {
-         cerr << "Warning! Error " << errno << " reading partition table for CRC check!\n";
+      if (myDisk.Read(partsToCheck, (int) sizeOfParts) != (int) sizeOfParts) {
+         DIAG(diag_read_error, "Warning! Error " << errno << " reading partition table for CRC check!\n");
       } else {
-         newCRC = chksum_crc32((unsigned char*) partsToCheck, sizeOfParts);
+         newCRC = chksum_crc32(partsToCheck, sizeOfParts);
          allOK = (newCRC == header->partitionEntriesCRC);
          if (header == &mainHeader)
             otherHeader = &secondHeader;
          else
             otherHeader = &mainHeader;
          if (newCRC != otherHeader->partitionEntriesCRC) {
-            cerr << "Warning! Main and backup partition tables differ! Use the 'c' and 'e' options\n"
-                 << "on the recovery & transformation menu to examine the two tables.\n\n";
+            DIAG(diag_tables_differ,
+                 "Warning! Main and backup partition tables differ! Use the 'c' and 'e' options\n"
+                 << "on the recovery & transformation menu to examine the two tables.\n\n");
             allOK = 0;
          } // if
       } // if/else
@@ -1149,14 +1281,16 @@ int GPTData::SaveGPTData(int quiet) {
 
    // This test should only fail on read-only disks....
    if (justLooking) {
-      cout << "The justLooking flag is set. This probably means you can't write to the disk.\n";
+      DIAG(diag_read_only,
+           "The justLooking flag is set. This probably means you can't write to the disk.\n");
       allOK = 0;
    } // if
 
    // Check that disk is really big enough to handle the second header...
    if (mainHeader.backupLBA >= diskSize) {
-      cerr << "Caution! Secondary header was placed beyond the disk's limits! Moving the\n"
-           << "header, but other problems may occur!\n";
+      DIAG(diag_backup_header_moved,
+           "Caution! Secondary header was placed beyond the disk's limits! Moving the\n"
+           << "header, but other problems may occur!\n");
       MoveSecondHeaderToEnd();
    } // if
 
@@ -1201,13 +1335,14 @@ int GPTData::SaveGPTData(int quiet) {
    // Check for overlapping or insane partitions....
    if ((FindOverlaps() > 0) || (FindInsanePartitions() > 0)) {
       allOK = 0;
-      cerr << "Aborting write operation!\n";
+      DIAG(diag_write_refused, "Aborting write operation!\n");
    } // if
 
    // Check that protective MBR fits, and warn if it doesn't....
    if (!protectiveMBR.DoTheyFit()) {
-      cerr << "\nPartition(s) in the protective MBR are too big for the disk! Creating a\n"
-           << "fresh protective or hybrid MBR is recommended.\n";
+      DIAG(diag_mbr_too_big,
+           "\nPartition(s) in the protective MBR are too big for the disk! Creating a\n"
+           << "fresh protective or hybrid MBR is recommended.\n");
    }
 
    // Check for mismatched MBR and GPT data, but let it pass if found
@@ -1233,8 +1368,9 @@ int GPTData::SaveGPTData(int quiet) {
          // As per UEFI specs, write the secondary table and GPT first....
          allOK = SavePartitionTable(myDisk, secondHeader.partitionEntriesLBA);
          if (!allOK) {
-            cerr << "Unable to save backup partition table! Perhaps the 'e' option on the experts'\n"
-                 << "menu will resolve this problem.\n";
+            DIAG(diag_write_error,
+                 "Unable to save backup partition table! Perhaps the 'e' option on the experts'\n"
+                 << "menu will resolve this problem.\n");
             syncIt = 0;
          } // if
 
@@ -1262,25 +1398,49 @@ int GPTData::SaveGPTData(int quiet) {
             myDisk.DiskSync();
 
          if (allOK) { // writes completed OK
-            cout << "The operation has completed successfully.\n";
+            DIAG(diag_write_done, "The operation has completed successfully.\n");
          } else {
-            cerr << "Warning! An error was reported when writing the partition table! This error\n"
-                 << "MIGHT be harmless, or the disk might be damaged! Checking it is advisable.\n";
+            DIAG(diag_write_error,
+                 "Warning! An error was reported when writing the partition table! This error\n"
+                 << "MIGHT be harmless, or the disk might be damaged! Checking it is advisable.\n");
          } // if/else
 
          myDisk.Close();
       } else {
-         cerr << "Unable to open device '" << myDisk.GetName() << "' for writing! Errno is "
-              << errno << "! Aborting write!\n";
+         DIAG(diag_open_error, "Unable to open device '" << myDisk.GetName()
+              << "' for writing! Errno is " << errno << "! Aborting write!\n");
          allOK = 0;
       } // if/else
    } else {
-      cout << "Aborting write of new partition table.\n";
+      DIAG(diag_write_aborted, "Aborting write of new partition table.\n");
    } // if
 
    return (allOK);
 } // GPTData::SaveGPTData()
 
+// Read the GPT data back from the disk and compare it with the data in
+// memory, as a check that SaveGPTData() wrote what it should have. Both
+// headers must be intact and match ours exactly, as must the partition
+// table -- every byte of every on-disk entry, including the tails of
+// entries wider than GPT_SIZE. Returns 1 if all is well, 0 if not.
+int GPTData::CheckWritten(void) {
+   GPTData onDisk;
+   int allOK;
+
+   onDisk.JustLooking();
+   onDisk.BeQuiet();
+   allOK = onDisk.LoadPartitions(device) && (onDisk.whichWasUsed == use_gpt) &&
+           onDisk.mainCrcOk && onDisk.mainPartsCrcOk &&
+           onDisk.secondCrcOk && onDisk.secondPartsCrcOk &&
+           (onDisk.numParts == numParts) && (onDisk.partEntrySize == partEntrySize);
+   if (allOK) {
+      allOK = (memcmp(&onDisk.mainHeader, &mainHeader, sizeof(GPTHeader)) == 0) &&
+              (memcmp(&onDisk.secondHeader, &secondHeader, sizeof(GPTHeader)) == 0) &&
+              onDisk.partitions.SameAs(partitions);
+   } // if
+   return allOK;
+} // GPTData::CheckWritten()
+
 // Save GPT data to a backup file. This function does much less error
 // checking than SaveGPTData(). It can therefore preserve many types of
 // corruption for later analysis; however, it preserves only the MBR,
@@ -1314,14 +1474,14 @@ int GPTData::SaveGPTBackup(const string & filename) {
          allOK = SavePartitionTable(backupFile, 3);
 
       if (allOK) { // writes completed OK
-         cout << "The operation has completed successfully.\n";
+         DIAG(diag_write_done, "The operation has completed successfully.\n");
       } else {
-         cerr << "Warning! An error was reported when writing the backup file.\n"
-              << "It may not be usable!\n";
+         DIAG(diag_write_error, "Warning! An error was reported when writing the backup file.\n"
+              << "It may not be usable!\n");
       } // if/else
       backupFile.Close();
    } else {
-      cerr << "Unable to open file '" << filename << "' for writing! Aborting!\n";
+      DIAG(diag_open_error, "Unable to open file '" << filename << "' for writing! Aborting!\n");
       allOK = 0;
    } // if/else
    return allOK;
@@ -1354,13 +1514,26 @@ int GPTData::SaveHeader(struct GPTHeader *header, DiskIO & disk, uint64_t sector
 // Returns 1 on success, 0 on failure
 int GPTData::SavePartitionTable(DiskIO & disk, uint64_t sector) {
    int littleEndian, allOK = 1;
+   uint32_t first, count, chunk;
+   uint8_t *table;
 
    littleEndian = IsLittleEndian();
    if (disk.Seek(sector)) {
       if (!littleEndian)
          ReversePartitionBytes();
-      if (disk.Write(partitions, mainHeader.sizeOfPartitionEntries * numParts) == -1)
-         allOK = 0;
+      // Only the non-blank entries are held in memory, so the on-disk table
+      // is built and written a chunk at a time. A chunk of as many entries
+      // as there are bytes in a sector fills whole sectors, so only the
+      // last write can be padded....
+      chunk = max(disk.GetBlockSize(), 1);
+      table = new uint8_t[(uint64_t) chunk * partEntrySize];
+      for (first = 0; allOK && (first < numParts); first += count) {
+         count = min(chunk, numParts - first);
+         partitions.Pack(table, first, count);
+         if (disk.Write(table, (int) ((uint64_t) count * partEntrySize)) == -1)
+            allOK = 0;
+      } // for
+      delete[] table;
       if (!littleEndian)
          ReversePartitionBytes();
    } else allOK = 0; // if (myDisk.Seek()...)
@@ -1388,7 +1561,7 @@ int GPTData::LoadGPTBackup(const string & filename) {
       // table; if other size, treat it like a GPT fdisk-generated backup
       // file
       shortBackup = ((backupFile.DiskSize(&err) * backupFile.GetBlockSize()) ==
-                     (mainHeader.numParts * mainHeader.sizeOfPartitionEntries) + 1024);
+                     ((uint64_t) mainHeader.numParts * mainHeader.sizeOfPartitionEntries) + 1024);
       if (shortBackup) {
          RebuildSecondHeader();
          secondCrcOk = mainCrcOk;
@@ -1409,26 +1582,27 @@ int GPTData::LoadGPTBackup(const string & filename) {
          } // if/else
 
          if (secondHeader.currentLBA != diskSize - UINT64_C(1)) {
-            cout << "Warning! Current disk size doesn't match that of the backup!\n"
-                 << "Adjusting sizes to match, but subsequent problems are possible!\n";
+            DIAG(diag_backup_size_mismatch,
+                 "Warning! Current disk size doesn't match that of the backup!\n"
+                 << "Adjusting sizes to match, but subsequent problems are possible!\n");
             MoveSecondHeaderToEnd();
          } // if
 
          if (!LoadPartitionTable(mainHeader, backupFile, (uint64_t) (3 - shortBackup)))
-            cerr << "Warning! Read error " << errno
-                 << " loading partition table; strange behavior now likely!\n";
+            DIAG(diag_read_error, "Warning! Read error " << errno
+                 << " loading partition table; strange behavior now likely!\n");
       } else {
          allOK = 0;
       } // if/else
       // Something went badly wrong, so blank out partitions
       if (allOK == 0) {
-         cerr << "Improper backup file! Clearing all partition data!\n";
+         DIAG(diag_bad_backup_file, "Improper backup file! Clearing all partition data!\n");
          ClearGPTData();
          protectiveMBR.MakeProtectiveMBR();
       } // if
    } else {
       allOK = 0;
-      cerr << "Unable to open file '" << filename << "' for reading! Aborting!\n";
+      DIAG(diag_open_error, "Unable to open file '" << filename << "' for reading! Aborting!\n");
    } // if/else
 
    return allOK;
@@ -1453,7 +1627,7 @@ int GPTData::DestroyGPT(void) {
       if (!myDisk.Seek(mainHeader.currentLBA))
          allOK = 0;
       if (myDisk.Write(blankSector, 512) != 512) { // blank it out
-         cerr << "Warning! GPT main header not overwritten! Error is " << errno << "\n";
+         DIAG(diag_write_error, "Warning! GPT main header not overwritten! Error is " << errno << "\n");
          allOK = 0;
       } // if
       if (!myDisk.Seek(mainHeader.partitionEntriesLBA))
@@ -1461,14 +1635,15 @@ int GPTData::DestroyGPT(void) {
       tableSize = numParts * mainHeader.sizeOfPartitionEntries;
       emptyTable = new uint8_t[tableSize];
       if (emptyTable == NULL) {
-         cerr << "Could not allocate memory in GPTData::DestroyGPT()! Terminating!\n";
-         exit(1);
+         DIAG(diag_no_memory, "Could not allocate memory in GPTData::DestroyGPT()! Terminating!\n");
+         throw bad_alloc();
       } // if
       memset(emptyTable, 0, tableSize);
       if (allOK) {
          sum = myDisk.Write(emptyTable, tableSize);
          if (sum != tableSize) {
-            cerr << "Warning! GPT main partition table not overwritten! Error is " << errno << "\n";
+            DIAG(diag_write_error, "Warning! GPT main partition table not overwritten! Error is "
+                 << errno << "\n");
             allOK = 0;
          } // if write failed
       } // if 
@@ -1477,8 +1652,8 @@ int GPTData::DestroyGPT(void) {
       if (allOK) {
          sum = myDisk.Write(emptyTable, tableSize);
          if (sum != tableSize) {
-            cerr << "Warning! GPT backup partition table not overwritten! Error is "
-                 << errno << "\n";
+            DIAG(diag_write_error, "Warning! GPT backup partition table not overwritten! Error is "
+                 << errno << "\n");
             allOK = 0;
          } // if wrong size written
       } // if
@@ -1486,17 +1661,20 @@ int GPTData::DestroyGPT(void) {
          allOK = 0;
       if (allOK) {
          if (myDisk.Write(blankSector, 512) != 512) { // blank it out
-            cerr << "Warning! GPT backup header not overwritten! Error is " << errno << "\n";
+            DIAG(diag_write_error, "Warning! GPT backup header not overwritten! Error is "
+                 << errno << "\n");
             allOK = 0;
          } // if
       } // if
       myDisk.DiskSync();
       myDisk.Close();
-      cout << "GPT data structures destroyed! You may now partition the disk using fdisk or\n"
-           << "other utilities.\n";
+      DIAG(diag_gpt_destroyed,
+           "GPT data structures destroyed! You may now partition the disk using fdisk or\n"
+           << "other utilities.\n");
       delete[] emptyTable;
    } else {
-      cerr << "Problem opening '" << device << "' for writing! Program will now terminate.\n";
+      DIAG(diag_open_error, "Problem opening '" << device
+           << "' for writing! Program will now terminate.\n");
    } // if/else (fd != -1)
    return (allOK);
 } // GPTDataTextUI::DestroyGPT()
@@ -1512,7 +1690,7 @@ int GPTData::DestroyMBR(void) {
    allOK = myDisk.OpenForWrite() && myDisk.Seek(0) && (myDisk.Write(blankSector, 512) == 512);
 
    if (!allOK)
-      cerr << "Warning! MBR not overwritten! Error is " << errno << "!\n";
+      DIAG(diag_write_error, "Warning! MBR not overwritten! Error is " << errno << "!\n");
    return allOK;
 } // GPTData::DestroyMBR(void)
 
@@ -1545,30 +1723,54 @@ void GPTData::ShowGPTState(void) {
 // Display the basic GPT data
 void GPTData::DisplayGPTData(void) {
    uint32_t i;
+   PartitionStore::StoredIterator it;
    uint64_t temp, totalFree;
+   OutputBuffer out;
+   int shown = 0;
 
-   cout << "Disk " << device << ": " << diskSize << " sectors, "
-        << BytesToIeee(diskSize, blockSize) << "\n";
+   out.Put("Disk ").Put(device).Put(": ").PutDec(diskSize).Put(" sectors, ")
+      .PutIeee(diskSize, blockSize).Put('\n');
    if (myDisk.GetModel() != "")
-      cout << "Model: " << myDisk.GetModel() << "\n";
+      out.Put("Model: ").Put(myDisk.GetModel()).Put('\n');
    if (physBlockSize > 0)
-      cout << "Sector size (logical/physical): " << blockSize << "/" << physBlockSize << " bytes\n";
+      out.Put("Sector size (logical/physical): ").PutDec(blockSize).Put('/')
+         .PutDec(physBlockSize).Put(" bytes\n");
    else
-      cout << "Sector size (logical): " << blockSize << " bytes\n";
-   cout << "Disk identifier (GUID): " << mainHeader.diskGUID << "\n";
-   cout << "Partition table holds up to " << numParts << " entries\n";
-   cout << "Main partition table begins at sector " << mainHeader.partitionEntriesLBA
-        << " and ends at sector " << mainHeader.partitionEntriesLBA + GetTableSizeInSectors() - 1 << "\n";
-   cout << "First usable sector is " << mainHeader.firstUsableLBA
-        << ", last usable sector is " << mainHeader.lastUsableLBA << "\n";
+      out.Put("Sector size (logical): ").PutDec(blockSize).Put(" bytes\n");
+   if ((topology.minIOSize > physBlockSize) || (topology.optIOSize != 0))
+      out.Put("I/O size (minimum/optimal): ").PutDec(topology.minIOSize).Put('/')
+         .PutDec(topology.optIOSize).Put(" bytes\n");
+   if (topology.eraseSize != 0)
+      out.Put("Preferred erase size: ").PutDec(topology.eraseSize).Put(" bytes\n");
+   if (ZoneSectors() > 0) {
+      out.Put("Zoned device: zones are ").PutDec(ZoneSectors()).Put(" sectors (")
+         .PutIeee(ZoneSectors(), blockSize).Put(')');
+      if (topology.numZones > 0)
+         out.Put("; ").PutDec(topology.numZones).Put(" zones");
+      out.Put('\n');
+   } // if
+   out.Put("Disk identifier (GUID): ").Put(mainHeader.diskGUID.AsString()).Put('\n');
+   out.Put("Partition table holds up to ").PutDec(numParts).Put(" entries");
+   if (partEntrySize != GPT_SIZE)
+      out.Put(" of ").PutDec(partEntrySize).Put(" bytes each");
+   out.Put('\n');
+   out.Put("Main partition table begins at sector ").PutDec(mainHeader.partitionEntriesLBA)
+      .Put(" and ends at sector ")
+      .PutDec(mainHeader.partitionEntriesLBA + GetTableSizeInSectors() - 1).Put('\n');
+   out.Put("First usable sector is ").PutDec(mainHeader.firstUsableLBA)
+      .Put(", last usable sector is ").PutDec(mainHeader.lastUsableLBA).Put('\n');
    totalFree = FindFreeBlocks(&i, &temp);
-   cout << "Partitions will be aligned on " << sectorAlignment << "-sector boundaries\n";
-   cout << "Total free space is " << totalFree << " sectors ("
-        << BytesToIeee(totalFree, blockSize) << ")\n";
-   cout << "\nNumber  Start (sector)    End (sector)  Size       Code  Name\n";
-   for (i = 0; i < numParts; i++) {
-      partitions[i].ShowSummary(i, blockSize);
+   out.Put("Partitions will be aligned on ").PutDec(StartAlignment()).Put("-sector boundaries\n");
+   out.Put("Total free space is ").PutDec(totalFree).Put(" sectors (")
+      .PutIeee(totalFree, blockSize).Put(")\n");
+   out.Put("\nNumber  Start (sector)    End (sector)  Size       Code  Name\n");
+   // Blank entries show nothing, so only the stored ones need a look....
+   for (it = partitions.BeginStored(); it != partitions.EndStored(); it++) {
+      shown |= partitions.Stored(it).ShowSummary(it->first, blockSize, out);
    } // for
+   out.Flush(cout);
+   if (shown)
+      cout.setf(ios::uppercase); // as GPTPart::ShowSummary() does
 } // GPTData::DisplayGPTData()
 
 // Show detailed information on the specified partition
@@ -1576,10 +1778,68 @@ void GPTData::ShowPartDetails(uint32_t partNum) {
    if ((partNum < numParts) && !IsFreePartNum(partNum)) {
       partitions[partNum].ShowDetails(blockSize);
    } else {
-      cout << "Partition #" << partNum + 1 << " does not exist.\n";
+      DIAG(diag_no_such_partition, "Partition #" << partNum + 1 << " does not exist.\n");
    } // if
 } // GPTData::ShowPartDetails()
 
+// Indexed by WhichToUse and GPTValidity
+static const char* sourceNames[] = {"gpt", "mbr", "bsd", "new", "abort"};
+static const char* stateNames[] = {"valid", "corrupt", "invalid"};
+
+// Write the fields of a GPT header, and whether its CRC and that of its
+// partition table are good (as Verify() judges them; a header rebuilt from
+// the other one when the disk was read takes on that one's CRC status), as
+// a JSON object.
+static void ShowHeaderJSON(const struct GPTHeader & header, int headerCrcOk, int tableCrcOk,
+                           JSONWriter & json) {
+   json.BeginObject().Put("lba", header.currentLBA).Put("backup_lba", header.backupLBA);
+   json.PutHex("revision", header.revision, 8).Put("header_size", header.headerSize);
+   json.PutHex("header_crc", header.headerCRC, 8).PutBool("header_crc_ok", headerCrcOk);
+   json.Put("first_usable", header.firstUsableLBA).Put("last_usable", header.lastUsableLBA);
+   json.Put("entries_lba", header.partitionEntriesLBA).Put("entries", header.numParts);
+   json.Put("entry_size", header.sizeOfPartitionEntries);
+   json.PutHex("table_crc", header.partitionEntriesCRC, 8).PutBool("table_crc_ok", tableCrcOk);
+   json.EndObject();
+} // ShowHeaderJSON()
+
+// Show what DisplayGPTData() does, plus the contents of both headers, as a
+// JSON object, with exact sizes rather than rounded ones.
+void GPTData::ShowJSON(ostream & os) {
+   JSONWriter json;
+   uint32_t i;
+   PartitionStore::StoredIterator it;
+   uint64_t temp, totalFree;
+
+   totalFree = FindFreeBlocks(&i, &temp);
+   json.BeginObject().Put("device", device).Put("model", myDisk.GetModel());
+   json.Put("sectors", diskSize).Put("sector_size", blockSize);
+   json.Put("physical_sector_size", physBlockSize).Put("bytes", diskSize * blockSize);
+   json.Put("disk_guid", mainHeader.diskGUID.AsString());
+   json.Put("source", sourceNames[whichWasUsed]).Put("state", stateNames[state]);
+   json.Put("alignment", StartAlignment()).Put("free_sectors", totalFree);
+   json.Key("main_header");
+   ShowHeaderJSON(mainHeader, mainCrcOk, mainPartsCrcOk, json);
+   json.Key("backup_header");
+   ShowHeaderJSON(secondHeader, secondCrcOk, secondPartsCrcOk, json);
+   json.Key("partitions").BeginArray();
+   for (it = partitions.BeginStored(); it != partitions.EndStored(); it++)
+      partitions.Stored(it).ShowJSON(it->first, blockSize, json);
+   json.EndArray().EndObject();
+   json.Flush(os);
+} // GPTData::ShowJSON()
+
+// Show what ShowPartDetails() does as a JSON object.
+void GPTData::ShowPartJSON(uint32_t partNum, ostream & os) {
+   JSONWriter json;
+
+   if ((partNum < numParts) && !IsFreePartNum(partNum)) {
+      partitions[partNum].ShowJSON(partNum, blockSize, json, 0);
+      json.Flush(os);
+   } else {
+      DIAG(diag_no_such_partition, "Partition #" << partNum + 1 << " does not exist.\n");
+   } // if
+} // GPTData::ShowPartJSON()
+
 /**************************************************************************
  *                                                                        *
  * Partition table transformation functions (MBR or BSD disklabel to GPT) *
@@ -1599,44 +1859,42 @@ WhichToUse GPTData::UseWhichPartitions(void) {
    mbrState = protectiveMBR.GetValidity();
 
    if ((state == gpt_invalid) && ((mbrState == mbr) || (mbrState == hybrid))) {
-      cout << "\n***************************************************************\n"
+      DIAG(diag_converting_mbr, "\n***************************************************************\n"
            << "Found invalid GPT and valid MBR; converting MBR to GPT format\n"
-           << "in memory. ";
-      if (!justLooking) {
-         cout << "\aTHIS OPERATION IS POTENTIALLY DESTRUCTIVE! Exit by\n"
-              << "typing 'q' if you don't want to convert your MBR partitions\n"
-              << "to GPT format!";
-      } // if
-      cout << "\n***************************************************************\n\n";
+           << "in memory. "
+           << (justLooking ? "" : "\aTHIS OPERATION IS POTENTIALLY DESTRUCTIVE! Exit by\n"
+                                  "typing 'q' if you don't want to convert your MBR partitions\n"
+                                  "to GPT format!")
+           << "\n***************************************************************\n\n");
       which = use_mbr;
    } // if
 
    if ((state == gpt_invalid) && bsdFound) {
-      cout << "\n**********************************************************************\n"
+      DIAG(diag_converting_bsd, "\n**********************************************************************\n"
            << "Found invalid GPT and valid BSD disklabel; converting BSD disklabel\n"
-           << "to GPT format.";
-      if ((!justLooking) && (!beQuiet)) {
-      cout << "\a THIS OPERATION IS POTENTIALLY DESTRUCTIVE! Your first\n"
-           << "BSD partition will likely be unusable. Exit by typing 'q' if you don't\n"
-           << "want to convert your BSD partitions to GPT format!";
-      } // if
-      cout << "\n**********************************************************************\n\n";
+           << "to GPT format."
+           << ((justLooking || beQuiet) ? "" :
+               "\a THIS OPERATION IS POTENTIALLY DESTRUCTIVE! Your first\n"
+               "BSD partition will likely be unusable. Exit by typing 'q' if you don't\n"
+               "want to convert your BSD partitions to GPT format!")
+           << "\n**********************************************************************\n\n");
       which = use_bsd;
    } // if
 
    if ((state == gpt_valid) && (mbrState == gpt)) {
       which = use_gpt;
       if (!beQuiet)
-         cout << "Found valid GPT with protective MBR; using GPT.\n";
+         DIAG(diag_found_gpt, "Found valid GPT with protective MBR; using GPT.\n");
    } // if
    if ((state == gpt_valid) && (mbrState == hybrid)) {
       which = use_gpt;
       if (!beQuiet)
-         cout << "Found valid GPT with hybrid MBR; using GPT.\n";
+         DIAG(diag_found_gpt, "Found valid GPT with hybrid MBR; using GPT.\n");
    } // if
    if ((state == gpt_valid) && (mbrState == invalid)) {
-      cout << "\aFound valid GPT with corrupt MBR; using GPT and will write new\n"
-           << "protective MBR on save.\n";
+      DIAG(diag_found_gpt_bad_mbr,
+           "\aFound valid GPT with corrupt MBR; using GPT and will write new\n"
+           << "protective MBR on save.\n");
       which = use_gpt;
    } // if
    if ((state == gpt_valid) && (mbrState == mbr)) {
@@ -1645,10 +1903,11 @@ WhichToUse GPTData::UseWhichPartitions(void) {
 
    if (state == gpt_corrupt) {
       if (mbrState == gpt) {
-         cout << "\a\a****************************************************************************\n"
+         DIAG(diag_found_damaged_gpt,
+              "\a\a****************************************************************************\n"
               << "Caution: Found protective or hybrid MBR and corrupt GPT. Using GPT, but disk\n"
               << "verification and recovery are STRONGLY recommended.\n"
-              << "****************************************************************************\n";
+              << "****************************************************************************\n");
          which = use_gpt;
       } else {
          which = use_abort;
@@ -1656,7 +1915,7 @@ WhichToUse GPTData::UseWhichPartitions(void) {
    } // if GPT corrupt
 
    if (which == use_new)
-      cout << "Creating new GPT entries in memory.\n";
+      DIAG(diag_new_gpt, "Creating new GPT entries in memory.\n");
 
    return which;
 } // UseWhichPartitions()
@@ -1675,13 +1934,14 @@ void GPTData::XFormPartitions(void) {
    else
       numToConvert = numParts;
 
+   TouchPartitions();
    for (i = 0; i < numToConvert; i++) {
       origType = protectiveMBR.GetType(i);
       // don't waste CPU time trying to convert extended, hybrid protective, or
       // null (non-existent) partitions
       if ((origType != 0x05) && (origType != 0x0f) && (origType != 0x85) &&
           (origType != 0x00) && (origType != 0xEE))
-         partitions[i] = protectiveMBR.AsGPT(i);
+         partitions.Edit(i) = protectiveMBR.AsGPT(i);
    } // for
 
    // Convert MBR into protective MBR
@@ -1702,11 +1962,11 @@ int GPTData::XFormDisklabel(uint32_t partNum) {
 
    if (GetPartRange(&low, &high) == 0) {
       goOn = 0;
-      cout << "No partitions!\n";
+      DIAG(diag_no_partitions, "No partitions!\n");
    } // if
    if (partNum > high) {
       goOn = 0;
-      cout << "Specified partition is invalid!\n";
+      DIAG(diag_no_such_partition, "Specified partition is invalid!\n");
    } // if
 
    // If all is OK, read the disklabel and convert it.
@@ -1716,15 +1976,16 @@ int GPTData::XFormDisklabel(uint32_t partNum) {
       if ((goOn) && (disklabel.IsDisklabel())) {
          numDone = XFormDisklabel(&disklabel);
          if (numDone == 1)
-            cout << "Converted 1 BSD partition.\n";
+            DIAG(diag_bsd_converted, "Converted 1 BSD partition.\n");
          else
-            cout << "Converted " << numDone << " BSD partitions.\n";
+            DIAG(diag_bsd_converted, "Converted " << numDone << " BSD partitions.\n");
       } else {
-         cout << "Unable to convert partitions! Unrecognized BSD disklabel.\n";
+         DIAG(diag_bsd_unrecognized, "Unable to convert partitions! Unrecognized BSD disklabel.\n");
       } // if/else
    } // if
    if (numDone > 0) { // converted partitions; delete carrier
-      partitions[partNum].BlankPartition();
+      TouchPartition(partNum);
+      partitions.Edit(partNum).BlankPartition();
    } // if
    return numDone;
 } // GPTData::XFormDisklabel(uint32_t i)
@@ -1737,13 +1998,14 @@ int GPTData::XFormDisklabel(BSDData* disklabel) {
       for (i = 0; i < disklabel->GetNumParts(); i++) {
          partNum = FindFirstFreePart();
          if (partNum >= 0) {
-            partitions[partNum] = disklabel->AsGPT(i);
+            TouchPartition(partNum);
+            partitions.Edit(partNum) = disklabel->AsGPT(i);
             if (partitions[partNum].IsUsed())
                numDone++;
          } // if
       } // for
       if (partNum == -1)
-         cerr << "Warning! Too many partitions to convert!\n";
+         DIAG(diag_too_many_partitions, "Warning! Too many partitions to convert!\n");
    } // if
 
    // Record that all original CRCs were OK so as not to raise flags
@@ -1762,30 +2024,34 @@ int GPTData::OnePartToMBR(uint32_t gptPart, int mbrPart) {
    int allOK = 1;
 
    if ((mbrPart < 0) || (mbrPart > 3)) {
-      cout << "MBR partition " << mbrPart + 1 << " is out of range; omitting it.\n";
+      DIAG(diag_partition_omitted, "MBR partition " << mbrPart + 1
+           << " is out of range; omitting it.\n");
       allOK = 0;
    } // if
    if (gptPart >= numParts) {
-      cout << "GPT partition " << gptPart + 1 << " is out of range; omitting it.\n";
+      DIAG(diag_partition_omitted, "GPT partition " << gptPart + 1
+           << " is out of range; omitting it.\n");
       allOK = 0;
    } // if
    if (allOK && (partitions[gptPart].GetLastLBA() == UINT64_C(0))) {
-      cout << "GPT partition " << gptPart + 1 << " is undefined; omitting it.\n";
+      DIAG(diag_partition_omitted, "GPT partition " << gptPart + 1
+           << " is undefined; omitting it.\n");
       allOK = 0;
    } // if
    if (allOK && (partitions[gptPart].GetFirstLBA() <= UINT32_MAX) &&
        (partitions[gptPart].GetLengthLBA() <= UINT32_MAX)) {
       if (partitions[gptPart].GetLastLBA() > UINT32_MAX) {
-         cout << "Caution: Partition end point past 32-bit pointer boundary;"
-              << " some OSes may\nreact strangely.\n";
+         DIAG(diag_past_32_bits, "Caution: Partition end point past 32-bit pointer boundary;"
+              << " some OSes may\nreact strangely.\n");
       } // if
       protectiveMBR.MakePart(mbrPart, (uint32_t) partitions[gptPart].GetFirstLBA(),
                              (uint32_t) partitions[gptPart].GetLengthLBA(),
                              partitions[gptPart].GetHexType() / 256, 0);
    } else { // partition out of range
       if (allOK) // Display only if "else" triggered by out-of-bounds condition
-         cout << "Partition " << gptPart + 1 << " begins beyond the 32-bit pointer limit of MBR "
-              << "partitions, or is\n too big; omitting it.\n";
+         DIAG(diag_partition_omitted, "Partition " << gptPart + 1
+              << " begins beyond the 32-bit pointer limit of MBR "
+              << "partitions, or is\n too big; omitting it.\n");
       allOK = 0;
    } // if/else
    return allOK;
@@ -1799,23 +2065,81 @@ int GPTData::OnePartToMBR(uint32_t gptPart, int mbrPart) {
  *                                                                    *
  **********************************************************************/
 
+// Note that the partition array is about to change, so that any lookup
+// indexes built from it are discarded. Must be called before modifying
+// partitions (via partitions.Edit() or other PartitionStore functions),
+// with no lookups between the call and the modification, since a lookup
+// would rebuild an index from the old data. (The PartitionStore itself
+// copies its entries before changing them if they're shared with copies of
+// this object.) If a transaction is open, the whole table is recorded in
+// the undo journal, so use TouchPartition() instead when changing only one
+// entry.
+void GPTData::TouchPartitions(void) {
+   JournalTable();
+   DropIndexes();
+} // GPTData::TouchPartitions()
+
+// Note that partition pn (and nothing else in the partition array) is about
+// to change. As TouchPartitions(), but if a transaction is open, only the
+// one entry is recorded in the undo journal.
+void GPTData::TouchPartition(uint32_t pn) {
+   JournalPart(pn);
+   DropLookupIndexes();
+   verifyCache.MarkDirty(pn);
+} // GPTData::TouchPartition()
+
+// Discard the lookup indexes and verification results built from the
+// partition array.
+void GPTData::DropIndexes(void) {
+   DropLookupIndexes();
+   verifyCache.Invalidate();
+} // GPTData::DropIndexes()
+
+// Discard the lookup indexes, but not the verification results, which are
+// kept current entry by entry.
+void GPTData::DropLookupIndexes(void) {
+   nameIndexValid = 0;
+   guidIndexValid = 0;
+   usedSlotsValid = 0;
+   freeExtentsValid = 0;
+} // GPTData::DropLookupIndexes()
+
+// Returns the numbers of all in-use partitions, in ascending order. The
+// list is built by one pass over the stored (non-blank) entries and then
+// kept until the next TouchPartitions() call, so scans that care only about
+// defined partitions cost O(used) rather than O(table size).
+const vector<uint32_t> & GPTData::UsedSlots(void) {
+   PartitionStore::StoredIterator it;
+
+   if (!usedSlotsValid) {
+      usedSlots.clear();
+      for (it = partitions.BeginStored(); it != partitions.EndStored(); it++) {
+         if (partitions.Stored(it).IsUsed())
+            usedSlots.push_back(it->first);
+      } // for
+      usedSlotsValid = 1;
+   } // if
+   return usedSlots;
+} // GPTData::UsedSlots()
+
 // Resizes GPT to specified number of entries. Creates a new table if
-// necessary, copies data if it already exists. If fillGPTSectors is 1
-// (the default), rounds numEntries to fill all the sectors necessary to
-// hold the GPT.
+// necessary, keeps the existing entries if there are any. Since only
+// non-blank entries take up memory, this costs nothing in proportion to
+// numEntries. If fillGPTSectors is 1 (the default), rounds numEntries to
+// fill all the sectors necessary to hold the GPT.
 // Returns 1 if all goes well, 0 if an error is encountered.
 int GPTData::SetGPTSize(uint32_t numEntries, int fillGPTSectors) {
-   GPTPart* newParts;
-   uint32_t i, high, copyNum, entriesPerSector;
+   uint32_t i, high, entriesPerSector;
    int allOK = 1;
 
    // First, adjust numEntries upward, if necessary, to get a number
    // that fills the allocated sectors
-   entriesPerSector = blockSize / GPT_SIZE;
-   if (fillGPTSectors && ((numEntries % entriesPerSector) != 0)) {
-      cout << "Adjusting GPT size from " << numEntries << " to ";
+   entriesPerSector = blockSize / partEntrySize;
+   if (fillGPTSectors && (entriesPerSector > 0) && ((numEntries % entriesPerSector) != 0)) {
+      i = numEntries;
       numEntries = ((numEntries / entriesPerSector) + 1) * entriesPerSector;
-      cout << numEntries << " to fill the sector\n";
+      DIAG(diag_table_size_adjusted, "Adjusting GPT size from " << i << " to "
+           << numEntries << " to fill the sector\n");
    } // if
 
    // Do the work only if the # of partitions is changing. Along with being
@@ -1823,48 +2147,54 @@ int GPTData::SetGPTSize(uint32_t numEntries, int fillGPTSectors) {
    // partition table, which causes problems when loading data from a RAID
    // array that's been expanded because this function is called when loading
    // data.
-   if (((numEntries != numParts) || (partitions == NULL)) && (numEntries > 0)) {
-      newParts = new GPTPart [numEntries];
-      if (newParts != NULL) {
-         if (partitions != NULL) { // existing partitions; copy them over
-            GetPartRange(&i, &high);
-            if (numEntries < (high + 1)) { // Highest entry too high for new #
-               cout << "The highest-numbered partition is " << high + 1
-                    << ", which is greater than the requested\n"
-                    << "partition table size of " << numEntries
-                    << "; cannot resize. Perhaps sorting will help.\n";
-               allOK = 0;
-               delete[] newParts;
-            } else { // go ahead with copy
-               if (numEntries < numParts)
-                  copyNum = numEntries;
-               else
-                  copyNum = numParts;
-               for (i = 0; i < copyNum; i++) {
-                  newParts[i] = partitions[i];
-               } // for
-               delete[] partitions;
-               partitions = newParts;
-            } // if
-         } else { // No existing partition table; just create it
-            partitions = newParts;
-         } // if/else existing partitions
+   if ((uint64_t) numEntries * partEntrySize > MAX_GPT_TABLE_SIZE) {
+      DIAG(diag_table_too_big, "A partition table of " << numEntries
+           << " entries is too big! Size is unchanged!\n");
+      allOK = 0;
+   } else if (((numEntries != numParts) || (partitions.GetNumSlots() == 0)) && (numEntries > 0)) {
+      if (partitions.GetNumSlots() > 0) { // existing partitions; keep them
+         GetPartRange(&i, &high);
+         if (numEntries < (high + 1)) { // Highest entry too high for new #
+            DIAG(diag_table_too_small, "The highest-numbered partition is " << high + 1
+                 << ", which is greater than the requested\n"
+                 << "partition table size of " << numEntries
+                 << "; cannot resize. Perhaps sorting will help.\n");
+            allOK = 0;
+         } // if
+      } // if
+      if (allOK) {
+         TouchPartitions();
+         partitions.Resize(numEntries);
          numParts = numEntries;
          mainHeader.firstUsableLBA = GetTableSizeInSectors() + mainHeader.partitionEntriesLBA;
          secondHeader.firstUsableLBA = mainHeader.firstUsableLBA;
          MoveSecondHeaderToEnd();
          if (diskSize > 0)
             CheckGPTSize();
-      } else { // Bad memory allocation
-         cerr << "Error allocating memory for partition table! Size is unchanged!\n";
-         allOK = 0;
-      } // if/else
+      } // if
    } // if/else
    mainHeader.numParts = numParts;
    secondHeader.numParts = numParts;
    return (allOK);
 } // GPTData::SetGPTSize()
 
+// Sets the size of on-disk partition entries, which must be a multiple of
+// GPT_SIZE (128) bytes. Bytes past the first 128 of each entry are kept,
+// uninterpreted, with the entry, so that they survive being written back;
+// changing the entry size discards any that were held.
+// Returns 1 if all goes well, 0 if the size is invalid.
+int GPTData::SetEntrySize(uint32_t entrySize) {
+   if ((entrySize < GPT_SIZE) || ((entrySize % GPT_SIZE) != 0) ||
+       ((uint64_t) numParts * entrySize > MAX_GPT_TABLE_SIZE))
+      return 0;
+   if (entrySize != partEntrySize) {
+      JournalTable();
+      partitions.SetTailSize(entrySize - GPT_SIZE);
+      partEntrySize = entrySize;
+   } // if
+   return 1;
+} // GPTData::SetEntrySize()
+
 // Change the start sector for the main partition table.
 // Returns 1 on success, 0 on failure
 int GPTData::MoveMainTable(uint64_t pteSector) {
@@ -1876,7 +2206,8 @@ int GPTData::MoveMainTable(uint64_t pteSector) {
        mainHeader.firstUsableLBA = pteSector + pteSize;
        RebuildSecondHeader();
     } else {
-       cerr << "Unable to set the main partition table's location to " << pteSector << "!\n";
+       DIAG(diag_table_location, "Unable to set the main partition table's location to "
+            << pteSector << "!\n");
        retval = 0;
     } // if/else
     return retval;
@@ -1884,11 +2215,8 @@ int GPTData::MoveMainTable(uint64_t pteSector) {
 
 // Blank the partition array
 void GPTData::BlankPartitions(void) {
-   uint32_t i;
-
-   for (i = 0; i < numParts; i++) {
-      partitions[i].BlankPartition();
-   } // for
+   TouchPartitions();
+   partitions.Clear();
 } // GPTData::BlankPartitions()
 
 // Delete a partition by number. Returns 1 if successful,
@@ -1907,43 +2235,110 @@ int GPTData::DeletePartition(uint32_t partNum) {
       protectiveMBR.DeleteByLocation(startSector, length);
 
       // Now delete the GPT partition
-      partitions[partNum].BlankPartition();
+      TouchPartition(partNum);
+      partitions.Erase(partNum);
    } else {
-      cerr << "Partition number " << partNum + 1 << " out of range!\n";
+      DIAG(diag_partition_out_of_range, "Partition number " << partNum + 1 << " out of range!\n");
       retval = 0;
    } // if/else
    return retval;
 } // GPTData::DeletePartition(uint32_t partNum)
 
-// Non-interactively create a partition.
+// Non-interactively create a partition. If startSector is 0, the placement
+// policy (see SetPlacement() and FindPlacement()) chooses where it goes; if
+// endSector is 0, it runs to the end of the free extent it starts in.
 // Returns 1 if the operation was successful, 0 if a problem was discovered.
 uint32_t GPTData::CreatePartition(uint32_t partNum, uint64_t startSector, uint64_t endSector) {
    int retval = 1; // assume there'll be no problems
-   uint64_t origSector = startSector;
-
-   if (IsFreePartNum(partNum)) {
+   uint64_t origSector, zoneSectors = ZoneSectors();
+
+   if (IsFreePartNum(partNum) && (startSector == 0))
+      startSector = FindPlacement();
+   if (IsFreePartNum(partNum) && (startSector != 0)) {
+      if (endSector == 0)
+         endSector = FindLastInFree(startSector);
+      origSector = startSector;
       if (Align(&startSector)) {
-         cout << "Information: Moved requested sector from " << origSector << " to "
-              << startSector << " in\norder to align on " << sectorAlignment
-              << "-sector boundaries.\n";
+         DIAG(diag_start_aligned, "Information: Moved requested sector from " << origSector
+              << " to " << startSector << " in\norder to align on " << StartAlignment()
+              << "-sector boundaries.\n");
+      } // if
+      // On zoned devices, end the partition at the end of a zone, keeping
+      // at least one zone....
+      if ((zoneSectors > 0) && (((endSector + 1) % zoneSectors) != 0)) {
+         origSector = endSector;
+         endSector = ((endSector + 1) / zoneSectors) * zoneSectors;
+         if (endSector <= startSector)
+            endSector = startSector + zoneSectors;
+         endSector--;
+         DIAG(diag_end_aligned, "Information: Moved requested end sector from " << origSector
+              << " to " << endSector << " in\norder to end on a " << zoneSectors
+              << "-sector zone boundary.\n");
       } // if
       if (IsFree(startSector) && (startSector <= endSector)) {
          if (FindLastInFree(startSector) >= endSector) {
-            partitions[partNum].SetFirstLBA(startSector);
-            partitions[partNum].SetLastLBA(endSector);
-            partitions[partNum].SetType(DEFAULT_GPT_TYPE);
-            partitions[partNum].RandomizeUniqueGUID();
+            TouchPartition(partNum);
+            partitions.Edit(partNum).SetFirstLBA(startSector);
+            partitions.Edit(partNum).SetLastLBA(endSector);
+            partitions.Edit(partNum).SetType(DEFAULT_GPT_TYPE);
+            partitions.Edit(partNum).RandomizeUniqueGUID();
+            EnsureUniqueGUID(partNum);
          } else retval = 0; // if free space until endSector
       } else retval = 0; // if startSector is free
-   } else retval = 0; // if legal partition number
+   } else retval = 0; // if legal partition number and start sector
    return retval;
 } // GPTData::CreatePartition(partNum, startSector, endSector)
 
+// Non-interactively create a partition of numSectors sectors, placed
+// according to the placement policy (see SetPlacement() and
+// FindPlacement()); or, if numSectors is 0, one that fills the free extent
+// the policy chooses.
+// Returns 1 if the operation was successful, 0 if a problem was discovered.
+uint32_t GPTData::CreatePartition(uint32_t partNum, uint64_t numSectors) {
+   uint64_t startSector;
+
+   if (!IsFreePartNum(partNum))
+      return 0;
+   startSector = FindPlacement(numSectors);
+   if (startSector == 0)
+      return 0;
+   return CreatePartition(partNum, startSector, numSectors ? startSector + numSectors - 1 : 0);
+} // GPTData::CreatePartition(partNum, numSectors)
+
 // Sort the GPT entries, eliminating gaps and making for a logical
-// ordering.
+// ordering. Only the stored (non-blank) entries are looked at: their
+// (starting LBA, entry number) keys are sorted and the entries renumbered
+// to match. Ties are broken by entry number, so the result is stable.
+// Entries with a starting LBA of 0 go after the rest, in their original
+// order.
 void GPTData::SortGPT(void) {
-   if (numParts > 0)
-      sort(partitions, partitions + numParts);
+   PartitionStore::StoredIterator it;
+   vector<pair<uint64_t, uint32_t> > keys;
+   vector<uint32_t> newNums;
+   uint32_t i, numStarted = 0;
+
+   if (numParts == 0)
+      return;
+   TouchPartitions();
+   // The stored entries come in order of entry number, so a count of them
+   // stands in for the entry number in the keys....
+   keys.reserve(partitions.NumStored());
+   for (it = partitions.BeginStored(), i = 0; it != partitions.EndStored(); it++, i++)
+      if (partitions.Stored(it).GetFirstLBA() != 0)
+         keys.push_back(make_pair(partitions.Stored(it).GetFirstLBA(), i));
+   sort(keys.begin(), keys.end());
+   newNums.resize(partitions.NumStored());
+   for (i = 0; i < keys.size(); i++)
+      newNums[keys[i].second] = i;
+   // An unstarted entry keeps its place among the unstarted entries (blank
+   // or not), which come after the keys.size() started ones....
+   for (it = partitions.BeginStored(), i = 0; it != partitions.EndStored(); it++, i++) {
+      if (partitions.Stored(it).GetFirstLBA() == 0)
+         newNums[i] = keys.size() + it->first - numStarted;
+      else
+         numStarted++;
+   } // for
+   partitions.Renumber(newNums);
 } // GPTData::SortGPT()
 
 // Swap the contents of two partitions.
@@ -1952,14 +2347,13 @@ void GPTData::SortGPT(void) {
 // Note that if partNum1 = partNum2 and this number is in range,
 // it will be considered successful.
 int GPTData::SwapPartitions(uint32_t partNum1, uint32_t partNum2) {
-   GPTPart temp;
    int allOK = 1;
 
    if ((partNum1 < numParts) && (partNum2 < numParts)) {
       if (partNum1 != partNum2) {
-         temp = partitions[partNum1];
-         partitions[partNum1] = partitions[partNum2];
-         partitions[partNum2] = temp;
+         TouchPartition(partNum1);
+         TouchPartition(partNum2);
+         partitions.Swap(partNum1, partNum2);
       } // if
    } else allOK = 0; // partition numbers are valid
    return allOK;
@@ -1975,8 +2369,9 @@ int GPTData::ClearGPTData(void) {
    int goOn = 1, i;
 
    // Set up the partition table....
-   delete[] partitions;
-   partitions = NULL;
+   JournalTable();
+   partitions = PartitionStore();
+   partEntrySize = GPT_SIZE;
    SetGPTSize(NUM_GPT_ENTRIES);
 
    // Now initialize a bunch of stuff that's static....
@@ -2045,9 +2440,10 @@ void GPTData::MoveSecondHeaderToEnd() {
 int GPTData::SetName(uint32_t partNum, const UnicodeString & theName) {
    int retval = 1;
 
-   if (IsUsedPartNum(partNum))
-      partitions[partNum].SetName(theName);
-   else
+   if (IsUsedPartNum(partNum)) {
+      TouchPartition(partNum);
+      partitions.Edit(partNum).SetName(theName);
+   } else
       retval = 0;
 
    return retval;
@@ -2062,38 +2458,84 @@ void GPTData::SetDiskGUID(GUIDData newGUID) {
 
 // Set the unique GUID of the specified partition. Returns 1 on
 // successful completion, 0 if there were problems (invalid
-// partition number).
+// partition number or GUID already in use by another partition).
 int GPTData::SetPartitionGUID(uint32_t pn, GUIDData theGUID) {
-   int retval = 0;
+   int retval = 0, other;
 
    if (pn < numParts) {
       if (partitions[pn].IsUsed()) {
-         partitions[pn].SetUniqueGUID(theGUID);
-         retval = 1;
+         other = FindByGUID(theGUID);
+         if ((other >= 0) && (partitions[pn].GetUniqueGUID() != theGUID)) {
+            DIAG(diag_guid_in_use, "Unique GUID " << theGUID << " is already in use by partition "
+                 << other + 1 << "!\n");
+         } else {
+            TouchPartition(pn);
+            partitions.Edit(pn).SetUniqueGUID(theGUID);
+            retval = 1;
+         } // if/else
       } // if
    } // if
    return retval;
 } // GPTData::SetPartitionGUID()
 
+// Set all the attribute bits of the specified partition at once. Returns 1
+// on success, 0 if the partition isn't in use.
+int GPTData::SetAttributes(uint32_t pn, uint64_t attributes) {
+   int retval = 1;
+
+   if (IsUsedPartNum(pn)) {
+      TouchPartition(pn);
+      partitions.Edit(pn).SetAttributes(attributes);
+   } else
+      retval = 0;
+
+   return retval;
+} // GPTData::SetAttributes()
+
 // Set new random GUIDs for the disk and all partitions. Intended to be used
 // after disk cloning or similar operations that don't randomize the GUIDs.
 void GPTData::RandomizeGUIDs(void) {
-   uint32_t i;
-
    mainHeader.diskGUID.Randomize();
    secondHeader.diskGUID = mainHeader.diskGUID;
-   for (i = 0; i < numParts; i++)
-      if (partitions[i].IsUsed())
-         partitions[i].RandomizeUniqueGUID();
+   TouchPartitions();
+   // New GUIDs don't change which partitions are in use, so the list of
+   // them stays good throughout....
+   for (const uint32_t pn : UsedSlots())
+      partitions.Edit(pn).RandomizeUniqueGUID();
+   for (const uint32_t pn : UsedSlots())
+      EnsureUniqueGUID(pn);
 } // GPTData::RandomizeGUIDs()
 
+// Re-randomize partition pn's unique GUID until no other partition uses
+// it. Normally a single check, but GUIDData::Randomize() may fall back on
+// its own generator, whose values can repeat. Keeps the GUID index current.
+void GPTData::EnsureUniqueGUID(uint32_t pn) {
+   string key;
+   pair<unordered_multimap<string, uint32_t>::iterator,
+        unordered_multimap<string, uint32_t>::iterator> range;
+
+   if (!guidIndexValid)
+      BuildGUIDIndex();
+   key = string((const char*) partitions[pn].GetUniqueGUID().GetBytes(), sizeof(my_uuid_t));
+   while (guidIndex.count(key) > 1) {
+      range = guidIndex.equal_range(key);
+      while (range.first->second != pn)
+         range.first++;
+      guidIndex.erase(range.first);
+      partitions.Edit(pn).RandomizeUniqueGUID();
+      key = string((const char*) partitions[pn].GetUniqueGUID().GetBytes(), sizeof(my_uuid_t));
+      guidIndex.insert(make_pair(key, pn));
+   } // while
+} // GPTData::EnsureUniqueGUID()
+
 // Change partition type code non-interactively. Returns 1 if
 // successful, 0 if not....
 int GPTData::ChangePartType(uint32_t partNum, PartType theGUID) {
    int retval = 1;
 
    if (!IsFreePartNum(partNum)) {
-      partitions[partNum].SetType(theGUID);
+      TouchPartition(partNum);
+      partitions.Edit(partNum).SetType(theGUID);
    } else retval = 0;
    return retval;
 } // GPTData::ChangePartType()
@@ -2115,17 +2557,18 @@ void GPTData::RecomputeCHS(void) {
 // internally although they translate to 512-byte sectors for the
 // benefit of the OS. If partitions aren't properly aligned on these
 // disks, some filesystem data structures can span multiple physical
-// sectors, degrading performance. This function should be called
-// only on the FIRST sector of the partition, not the last!
+// sectors, degrading performance. On zoned devices, the sector is also
+// moved to a zone boundary (see StartAlignment()). This function should
+// be called only on the FIRST sector of the partition, not the last!
 // This function returns 1 if the alignment was altered, 0 if it
 // was unchanged.
 int GPTData::Align(uint64_t* sector) {
    int retval = 0, sectorOK = 0;
-   uint64_t earlier, later, testSector;
+   uint64_t earlier, later, testSector, alignment = StartAlignment();
 
-   if ((*sector % sectorAlignment) != 0) {
-      earlier = (*sector / sectorAlignment) * sectorAlignment;
-      later = earlier + (uint64_t) sectorAlignment;
+   if ((*sector % alignment) != 0) {
+      earlier = (*sector / alignment) * alignment;
+      later = earlier + alignment;
 
       // Check to see that every sector between the earlier one and the
       // requested one is clear, and that it's not too early....
@@ -2157,6 +2600,189 @@ int GPTData::Align(uint64_t* sector) {
    return retval;
 } // GPTData::Align()
 
+/**************************************
+ *                                    *
+ * Transactions and undo/redo support *
+ *                                    *
+ **************************************/
+
+// Changes made between calls to BeginTransaction() and CommitTransaction()
+// form one step that can be undone (and redone); RollbackTransaction()
+// undoes them at once. Each step records the headers plus the prior
+// contents of only the entries that changed, so undoing a step takes time
+// in proportion to what it changed, not to the size of the table.
+
+// If a transaction is open, record the whole partition table in it, unless
+// that's already been done.
+void GPTData::JournalTable(void) {
+   if (inTransaction && !journaledTable) {
+      openStep.records.push_back(GPTJournalRecord());
+      MakeTableRecord(openStep.records.back());
+      journaledTable = 1;
+   } // if
+} // GPTData::JournalTable()
+
+// If a transaction is open, record partition pn in it, unless it (or the
+// whole table) has already been recorded.
+void GPTData::JournalPart(uint32_t pn) {
+   if (inTransaction && !journaledTable && (pn < numParts) && journaled.insert(pn).second) {
+      openStep.records.push_back(GPTJournalRecord());
+      MakePartRecord(pn, openStep.records.back());
+   } // if
+} // GPTData::JournalPart()
+
+// Fill rec with a reference to the current partition table.
+void GPTData::MakeTableRecord(GPTJournalRecord & rec) {
+   rec.partNum = GPT_JOURNAL_TABLE;
+   rec.numParts = numParts;
+   rec.partEntrySize = partEntrySize;
+   rec.table = partitions;
+} // GPTData::MakeTableRecord()
+
+// Fill rec with a copy of partition pn.
+void GPTData::MakePartRecord(uint32_t pn, GPTJournalRecord & rec) {
+   rec.partNum = pn;
+   rec.part = partitions[pn];
+   if (TailSize() > 0)
+      rec.tail = partitions.GetTail(pn);
+   rec.numParts = numParts;
+   rec.partEntrySize = partEntrySize;
+} // GPTData::MakePartRecord()
+
+// Put back the data recorded in step, newest record first, and build in
+// inverse the step that will reverse the change.
+void GPTData::ApplyJournalStep(const GPTJournalStep & step, GPTJournalStep & inverse) {
+   size_t i;
+   uint32_t pn;
+
+   inverse.mainHeader = mainHeader;
+   inverse.secondHeader = secondHeader;
+   inverse.records.clear();
+   inverse.records.reserve(step.records.size());
+   for (i = step.records.size(); i-- > 0;) {
+      const GPTJournalRecord & rec = step.records[i];
+      inverse.records.push_back(GPTJournalRecord());
+      if (rec.partNum == GPT_JOURNAL_TABLE) {
+         MakeTableRecord(inverse.records.back());
+         partitions = rec.table;
+         numParts = rec.numParts;
+         partEntrySize = rec.partEntrySize;
+         verifyCache.Invalidate();
+      } else if (rec.partNum < numParts) {
+         pn = rec.partNum;
+         MakePartRecord(pn, inverse.records.back());
+         verifyCache.MarkDirty(pn);
+         partitions.SetEntry(pn, rec.part, rec.tail);
+      } else {
+         inverse.records.pop_back();
+      } // if/else
+   } // for
+   mainHeader = step.mainHeader;
+   secondHeader = step.secondHeader;
+   DropLookupIndexes();
+} // GPTData::ApplyJournalStep()
+
+// Returns 1 if step records no change, 0 if it does. Changes to the header
+// CRCs alone don't count, since those are recomputed when saving.
+static int StepIsEmpty(const GPTJournalStep & step, const struct GPTHeader & mainHeader,
+                       const struct GPTHeader & secondHeader) {
+   struct GPTHeader before[2] = {step.mainHeader, step.secondHeader};
+   struct GPTHeader after[2] = {mainHeader, secondHeader};
+   int i;
+
+   for (i = 0; i < 2; i++) {
+      before[i].headerCRC = after[i].headerCRC = 0;
+      before[i].partitionEntriesCRC = after[i].partitionEntriesCRC = 0;
+   } // for
+   return (step.records.empty() && (memcmp(before, after, sizeof(before)) == 0));
+} // StepIsEmpty()
+
+// Begin recording changes as a single step. Transactions don't nest.
+// Returns 1 if a transaction was begun, 0 if one was already open.
+int GPTData::BeginTransaction(void) {
+   if (inTransaction)
+      return 0;
+   openStep.mainHeader = mainHeader;
+   openStep.secondHeader = secondHeader;
+   openStep.records.clear();
+   journaled.clear();
+   journaledTable = 0;
+   inTransaction = 1;
+   return 1;
+} // GPTData::BeginTransaction()
+
+// End the open transaction, keeping its changes. Unless it changed nothing,
+// it becomes the step that Undo() reverses, and anything that had been
+// undone can no longer be redone.
+// Returns 1 if a transaction was committed, 0 if none was open.
+int GPTData::CommitTransaction(void) {
+   if (!inTransaction)
+      return 0;
+   inTransaction = 0;
+   if (!StepIsEmpty(openStep, mainHeader, secondHeader)) {
+      undoSteps.push_back(move(openStep));
+      if (undoSteps.size() > MAX_UNDO_STEPS)
+         undoSteps.pop_front();
+      redoSteps.clear();
+   } // if
+   openStep.records.clear();
+   journaled.clear();
+   return 1;
+} // GPTData::CommitTransaction()
+
+// End the open transaction, discarding its changes.
+// Returns 1 if a transaction was rolled back, 0 if none was open.
+int GPTData::RollbackTransaction(void) {
+   GPTJournalStep discard;
+
+   if (!inTransaction)
+      return 0;
+   inTransaction = 0;
+   ApplyJournalStep(openStep, discard);
+   openStep.records.clear();
+   journaled.clear();
+   return 1;
+} // GPTData::RollbackTransaction()
+
+// Reverse the most recently committed (and not yet undone) step.
+// Returns 1 on success, 0 if there's nothing to undo or a transaction
+// is open.
+int GPTData::Undo(void) {
+   GPTJournalStep inverse;
+
+   if (inTransaction || undoSteps.empty())
+      return 0;
+   ApplyJournalStep(undoSteps.back(), inverse);
+   undoSteps.pop_back();
+   redoSteps.push_back(move(inverse));
+   return 1;
+} // GPTData::Undo()
+
+// Reapply the most recently undone step.
+// Returns 1 on success, 0 if there's nothing to redo or a transaction
+// is open.
+int GPTData::Redo(void) {
+   GPTJournalStep inverse;
+
+   if (inTransaction || redoSteps.empty())
+      return 0;
+   ApplyJournalStep(redoSteps.back(), inverse);
+   redoSteps.pop_back();
+   undoSteps.push_back(move(inverse));
+   return 1;
+} // GPTData::Redo()
+
+// Forget all undo and redo history, and abandon (without rolling back) any
+// open transaction.
+void GPTData::ClearJournal(void) {
+   inTransaction = 0;
+   openStep.records.clear();
+   journaled.clear();
+   journaledTable = 0;
+   undoSteps.clear();
+   redoSteps.clear();
+} // GPTData::ClearJournal()
+
 /********************************************************
  *                                                      *
  * Functions that return data about GPT data structures *
@@ -2171,50 +2797,107 @@ int GPTData::Align(uint64_t* sector) {
 // position exists. Thus, the return value is the only way to
 // tell when no partitions exist.
 int GPTData::GetPartRange(uint32_t *low, uint32_t *high) {
-   uint32_t i;
-   int numFound = 0;
-
-   *low = numParts + 1; // code for "not found"
-   *high = 0;
-   for (i = 0; i < numParts; i++) {
-      if (partitions[i].IsUsed()) { // it exists
-         *high = i; // since we're counting up, set the high value
-         // Set the low value only if it's not yet found...
-         if (*low == (numParts + 1)) *low = i;
-            numFound++;
-      } // if
-   } // for
+   const vector<uint32_t> & used = UsedSlots();
 
-   // Above will leave *low pointing to its "not found" value if no partitions
-   // are defined, so reset to 0 if this is the case....
-   if (*low == (numParts + 1))
-      *low = 0;
-   return numFound;
+   // The used-slot list is in ascending order, so the ends of it are the
+   // lowest- and highest-numbered partitions. If no partitions are defined,
+   // both values are 0.
+   *low = *high = 0;
+   if (!used.empty()) {
+      *low = used.front();
+      *high = used.back();
+   } // if
+   return (int) used.size();
 } // GPTData::GetPartRange()
 
 // Returns the value of the first free partition, or -1 if none is
 // unused.
 int GPTData::FindFirstFreePart(void) {
-   int i = 0;
-
-   if (partitions != NULL) {
-      while ((i < (int) numParts) && (partitions[i].IsUsed()))
-         i++;
-      if (i >= (int) numParts)
-         i = -1;
-   } else i = -1;
-   return i;
+   uint32_t i = 0;
+
+   // Partitions 0 to i - 1 are all in use as long as the ith used slot is
+   // partition i, so the first free one is where that stops being true.
+   for (const uint32_t used : UsedSlots()) {
+      if (used != i)
+         break;
+      i++;
+   } // for
+   if (i >= numParts)
+      return -1;
+   return (int) i;
 } // GPTData::FindFirstFreePart()
 
-// Returns the number of defined partitions.
-uint32_t GPTData::CountParts(void) {
-   uint32_t i, counted = 0;
+// Build the partition-name lookup index. Names are hashed in their raw
+// on-disk (UTF-16LE) form, so no character-set conversion is needed to
+// build the index. When two partitions share a name, the lower-numbered
+// one wins, as with a linear search.
+void GPTData::BuildNameIndex(void) {
+   uint32_t len;
+   const uint16_t *name;
+   PartitionStore::StoredIterator it;
+
+   nameIndex.clear();
+   for (it = partitions.BeginStored(); it != partitions.EndStored(); it++) {
+      if (!partitions.Stored(it).IsUsed())
+         continue;
+      name = partitions.Stored(it).GetRawName();
+      for (len = 0; (len < NAME_SIZE) && (name[len] != 0); len++) ;
+      nameIndex.insert(make_pair(string((const char*) name, len * sizeof(name[0])), it->first));
+   } // for
+   nameIndexValid = 1;
+} // GPTData::BuildNameIndex()
 
-   for (i = 0; i < numParts; i++) {
-      if (partitions[i].IsUsed())
-         counted++;
+// Returns the number of the in-use partition whose name is theName, or -1
+// if there's no such partition.
+int GPTData::FindByName(const UnicodeString & theName) {
+   GPTPart temp;
+   uint32_t len;
+   const uint16_t *name;
+   unordered_map<string, uint32_t>::const_iterator it;
+
+   if (!nameIndexValid)
+      BuildNameIndex();
+   temp.SetName(theName);
+   name = temp.GetRawName();
+   for (len = 0; (len < NAME_SIZE) && (name[len] != 0); len++) ;
+   it = nameIndex.find(string((const char*) name, len * sizeof(name[0])));
+   if (it == nameIndex.end())
+      return -1;
+   return (int) it->second;
+} // GPTData::FindByName()
+
+// Build the unique-GUID lookup index from all in-use partitions.
+void GPTData::BuildGUIDIndex(void) {
+   PartitionStore::StoredIterator it;
+
+   guidIndex.clear();
+   for (it = partitions.BeginStored(); it != partitions.EndStored(); it++) {
+      if (partitions.Stored(it).IsUsed())
+         guidIndex.insert(make_pair(string((const char*) partitions.Stored(it).GetUniqueGUID().GetBytes(),
+                                           sizeof(my_uuid_t)), it->first));
    } // for
-   return counted;
+   guidIndexValid = 1;
+} // GPTData::BuildGUIDIndex()
+
+// Returns the number of the lowest-numbered in-use partition whose unique
+// GUID is theGUID, or -1 if there's no such partition.
+int GPTData::FindByGUID(const GUIDData & theGUID) {
+   int found = -1;
+   pair<unordered_multimap<string, uint32_t>::const_iterator,
+        unordered_multimap<string, uint32_t>::const_iterator> range;
+
+   if (!guidIndexValid)
+      BuildGUIDIndex();
+   range = guidIndex.equal_range(string((const char*) theGUID.GetBytes(), sizeof(my_uuid_t)));
+   for (; range.first != range.second; range.first++)
+      if ((found < 0) || (range.first->second < (uint32_t) found))
+         found = (int) range.first->second;
+   return found;
+} // GPTData::FindByGUID()
+
+// Returns the number of defined partitions.
+uint32_t GPTData::CountParts(void) {
+   return (uint32_t) UsedSlots().size();
 } // GPTData::CountParts()
 
 /****************************************************
@@ -2227,8 +2910,8 @@ uint32_t GPTData::CountParts(void) {
 // there are no available blocks left
 uint64_t GPTData::FindFirstAvailable(uint64_t start) {
    uint64_t first;
-   uint32_t i;
    int firstMoved = 0;
+   PartitionStore::StoredIterator it;
 
    // Begin from the specified starting point or from the first usable
    // LBA, whichever is greater...
@@ -2244,10 +2927,11 @@ uint64_t GPTData::FindFirstAvailable(uint64_t start) {
    // cases where partitions are out of sequential order....
    do {
       firstMoved = 0;
-      for (i = 0; i < numParts; i++) {
-         if ((partitions[i].IsUsed()) && (first >= partitions[i].GetFirstLBA()) &&
-             (first <= partitions[i].GetLastLBA())) { // in existing part.
-            first = partitions[i].GetLastLBA() + 1;
+      for (it = partitions.BeginStored(); it != partitions.EndStored(); it++) {
+         const GPTPart & part = partitions.Stored(it);
+         if (part.IsUsed() && (first >= part.GetFirstLBA()) &&
+             (first <= part.GetLastLBA())) { // in existing part.
+            first = part.GetLastLBA() + 1;
             firstMoved = 1;
          } // if
       } // for
@@ -2260,12 +2944,13 @@ uint64_t GPTData::FindFirstAvailable(uint64_t start) {
 // Returns the LBA of the start of the first partition on the disk (by
 // sector number), or 0 if there are no partitions defined.
 uint64_t GPTData::FindFirstUsedLBA(void) {
-    uint32_t i;
     uint64_t firstFound = UINT64_MAX;
+    PartitionStore::StoredIterator it;
 
-    for (i = 0; i < numParts; i++) {
-        if ((partitions[i].IsUsed()) && (partitions[i].GetFirstLBA() < firstFound)) {
-            firstFound = partitions[i].GetFirstLBA();
+    for (it = partitions.BeginStored(); it != partitions.EndStored(); it++) {
+        const GPTPart & part = partitions.Stored(it);
+        if (part.IsUsed() && (part.GetFirstLBA() < firstFound)) {
+            firstFound = part.GetFirstLBA();
         } // if
     } // for
     return firstFound;
@@ -2296,8 +2981,8 @@ uint64_t GPTData::FindFirstInLargest(void) {
 // Returns 0 if there are no available sectors
 uint64_t GPTData::FindLastAvailable(void) {
    uint64_t last;
-   uint32_t i;
    int lastMoved = 0;
+   PartitionStore::StoredIterator it;
 
    // Start by assuming the last usable LBA is available....
    last = mainHeader.lastUsableLBA;
@@ -2308,10 +2993,11 @@ uint64_t GPTData::FindLastAvailable(void) {
    // where partitions are out of logical order.
    do {
       lastMoved = 0;
-      for (i = 0; i < numParts; i++) {
-         if ((last >= partitions[i].GetFirstLBA()) &&
-             (last <= partitions[i].GetLastLBA())) { // in existing part.
-            last = partitions[i].GetFirstLBA() - 1;
+      for (it = partitions.BeginStored(); it != partitions.EndStored(); it++) {
+         const GPTPart & part = partitions.Stored(it);
+         if (part.IsUsed() && (last >= part.GetFirstLBA()) &&
+             (last <= part.GetLastLBA())) { // in existing part.
+            last = part.GetFirstLBA() - 1;
             lastMoved = 1;
          } // if
       } // for
@@ -2323,16 +3009,23 @@ uint64_t GPTData::FindLastAvailable(void) {
 
 // Find the last available block in the free space pointed to by start.
 uint64_t GPTData::FindLastInFree(uint64_t start) {
-   uint64_t nearestStart;
-   uint32_t i;
+   uint64_t nearestStart, zoneSectors = ZoneSectors(), zoneEnd;
+   PartitionStore::StoredIterator it;
 
    nearestStart = mainHeader.lastUsableLBA;
-   for (i = 0; i < numParts; i++) {
-      if ((nearestStart > partitions[i].GetFirstLBA()) &&
-          (partitions[i].GetFirstLBA() > start)) {
-         nearestStart = partitions[i].GetFirstLBA() - 1;
+   for (it = partitions.BeginStored(); it != partitions.EndStored(); it++) {
+      const GPTPart & part = partitions.Stored(it);
+      if (part.IsUsed() && (nearestStart >= part.GetFirstLBA()) &&
+          (part.GetFirstLBA() > start)) {
+         nearestStart = part.GetFirstLBA() - 1;
       } // if
    } // for
+   // On zoned devices, stop at the last zone boundary, if there is one....
+   if (zoneSectors > 0) {
+      zoneEnd = ((nearestStart + 1) / zoneSectors) * zoneSectors;
+      if (zoneEnd > start)
+         nearestStart = zoneEnd - 1;
+   } // if
    return (nearestStart);
 } // GPTData::FindLastInFree()
 
@@ -2366,20 +3059,193 @@ uint64_t GPTData::FindFreeBlocks(uint32_t *numSegments, uint64_t *largestSegment
    return totalFound;
 } // GPTData::FindFreeBlocks()
 
+// Build the free-extent lists (freeExtents, freeMaxTree, and freeBySize),
+// unless they're current. Partitions whose end precedes their start are
+// ignored.
+void GPTData::UpdateFreeExtents(void) {
+   vector<pair<uint64_t, uint64_t> > used;
+   uint64_t cursor, first, last;
+   uint32_t i, leaves;
+   PartitionStore::StoredIterator it;
+
+   if (freeExtentsValid && (freeFirstLBA == mainHeader.firstUsableLBA) &&
+       (freeLastLBA == mainHeader.lastUsableLBA))
+      return;
+   freeFirstLBA = mainHeader.firstUsableLBA;
+   freeLastLBA = mainHeader.lastUsableLBA;
+   freeExtents.clear();
+   freeTotal = 0;
+   used.reserve(UsedSlots().size());
+   for (it = partitions.BeginStored(); it != partitions.EndStored(); it++) {
+      const GPTPart & part = partitions.Stored(it);
+      if (part.IsUsed() && (part.GetFirstLBA() <= part.GetLastLBA()))
+         used.push_back(make_pair(part.GetFirstLBA(), part.GetLastLBA()));
+   } // for
+   sort(used.begin(), used.end());
+   cursor = freeFirstLBA;
+   for (i = 0; (i < used.size()) && (cursor <= freeLastLBA); i++) {
+      if (used[i].first > cursor) {
+         first = cursor;
+         last = min(used[i].first - 1, freeLastLBA);
+         freeExtents.push_back(make_pair(first, last));
+         freeTotal += last - first + 1;
+      } // if
+      if (used[i].second >= cursor) {
+         if (used[i].second == UINT64_MAX)
+            cursor = UINT64_MAX; // nothing more can be free
+         else
+            cursor = used[i].second + 1;
+      } // if
+   } // for
+   if ((cursor <= freeLastLBA) && (cursor != UINT64_MAX)) {
+      freeExtents.push_back(make_pair(cursor, freeLastLBA));
+      freeTotal += freeLastLBA - cursor + 1;
+   } // if
+
+   // The tree is an array-based binary tree with the extents as leaves;
+   // each inner node holds the size of the largest extent below it....
+   leaves = 1;
+   while (leaves < freeExtents.size())
+      leaves *= 2;
+   freeMaxTree.assign(2 * leaves, 0);
+   freeBySize.clear();
+   freeBySize.reserve(freeExtents.size());
+   for (i = 0; i < freeExtents.size(); i++) {
+      freeMaxTree[leaves + i] = freeExtents[i].second - freeExtents[i].first + 1;
+      freeBySize.push_back(make_pair(freeMaxTree[leaves + i], i));
+   } // for
+   for (i = leaves - 1; i > 0; i--)
+      freeMaxTree[i] = max(freeMaxTree[2 * i], freeMaxTree[2 * i + 1]);
+   sort(freeBySize.begin(), freeBySize.end());
+   freeExtentsValid = 1;
+} // GPTData::UpdateFreeExtents()
+
+// Search the subtree of freeMaxTree rooted at node, which covers extents
+// low to high, for the first extent numbered limit or higher (or, if
+// fromEnd, the last extent numbered limit or lower) with at least need
+// sectors. Returns the extent's number, or UINT32_MAX if there's none.
+// Takes O(log n) time.
+uint32_t GPTData::FindFit(uint32_t node, uint32_t low, uint32_t high, uint32_t limit,
+                          uint64_t need, int fromEnd) {
+   uint32_t mid, found;
+
+   if ((freeMaxTree[node] < need) || (!fromEnd && (high < limit)) || (fromEnd && (low > limit)))
+      return UINT32_MAX;
+   if (low == high)
+      return (low < freeExtents.size()) ? low : UINT32_MAX;
+   mid = low + (high - low) / 2;
+   if (fromEnd) {
+      found = FindFit(2 * node + 1, mid + 1, high, limit, need, fromEnd);
+      if (found == UINT32_MAX)
+         found = FindFit(2 * node, low, mid, limit, need, fromEnd);
+   } else {
+      found = FindFit(2 * node, low, mid, limit, need, fromEnd);
+      if (found == UINT32_MAX)
+         found = FindFit(2 * node + 1, mid + 1, high, limit, need, fromEnd);
+   } // if/else
+   return found;
+} // GPTData::FindFit()
+
+// Determine where an aligned partition of numSectors sectors (or, if
+// numSectors is 0, the aligned part of the extent) fits in free extent
+// number extent, putting it as early as possible or, if atEnd, as late as
+// possible. Returns 1 and sets *start if it fits, 0 if it doesn't.
+int GPTData::FitInExtent(uint32_t extent, uint64_t numSectors, int atEnd, uint64_t *start) {
+   uint64_t first = freeExtents[extent].first, last = freeExtents[extent].second;
+   uint64_t align = StartAlignment(), candidate;
+   int fill = (numSectors == 0);
+
+   if (fill)
+      numSectors = 1;
+   if (numSectors > last - first + 1)
+      return 0;
+   if (atEnd && !fill)
+      candidate = ((last - numSectors + 1) / align) * align;
+   else if ((first % align) == 0)
+      candidate = first;
+   else if (first / align < UINT64_MAX / align)
+      candidate = (first / align + 1) * align;
+   else
+      return 0;
+   if ((candidate < first) || (candidate > last) || (last - candidate + 1 < numSectors))
+      return 0;
+   *start = candidate;
+   return 1;
+} // GPTData::FitInExtent()
+
+// Choose the start sector for a new partition of numSectors sectors,
+// following the placement policy (see SetPlacement()). If numSectors is 0,
+// the caller wants a partition that fills whatever free extent is chosen,
+// so any extent with room for an aligned partition will do, and last-fit
+// chooses the start of the last such extent. The place_largest policy is
+// the traditional one: the start of the largest extent, adjusted by Align()
+// (ignoring numSectors). The others use the free-extent lists, so each
+// search takes O(log n) time in the number of free extents (apart from
+// extents passed over because alignment leaves them too small).
+// Returns the start sector, or 0 if no extent is big enough.
+uint64_t GPTData::FindPlacement(uint64_t numSectors) {
+   vector<pair<uint64_t, uint32_t> >::iterator it;
+   uint64_t start = 0, need = (numSectors > 0) ? numSectors : 1;
+   uint32_t extent, leaves;
+
+   if (placement == place_largest) {
+      start = FindFirstInLargest();
+      Align(&start);
+      return start;
+   } // if
+   UpdateFreeExtents();
+   if (freeExtents.empty())
+      return 0;
+   leaves = freeMaxTree.size() / 2;
+   switch (placement) {
+      case place_first_fit:
+         extent = FindFit(1, 0, leaves - 1, 0, need, 0);
+         while ((extent != UINT32_MAX) && !FitInExtent(extent, numSectors, 0, &start))
+            extent = FindFit(1, 0, leaves - 1, extent + 1, need, 0);
+         break;
+      case place_last_fit:
+         extent = FindFit(1, 0, leaves - 1, freeExtents.size() - 1, need, 1);
+         while ((extent != UINT32_MAX) && !FitInExtent(extent, numSectors, 1, &start))
+            extent = (extent > 0) ? FindFit(1, 0, leaves - 1, extent - 1, need, 1) : UINT32_MAX;
+         break;
+      case place_best_fit:
+         it = lower_bound(freeBySize.begin(), freeBySize.end(), make_pair(need, (uint32_t) 0));
+         while ((it != freeBySize.end()) && !FitInExtent(it->second, numSectors, 0, &start))
+            it++;
+         break;
+      default:
+         break;
+   } // switch
+   return start;
+} // GPTData::FindPlacement()
+
+// Returns the total number of free sectors in the usable area, and sets
+// *numExtents to the number of separate runs they form and *largestExtent
+// to the size of the largest of these. Like FindFreeBlocks(), but uses
+// (and, if need be, builds) the free-extent lists, so it's fast when
+// called repeatedly on a big table.
+uint64_t GPTData::FreeExtentSummary(uint32_t *numExtents, uint64_t *largestExtent) {
+   UpdateFreeExtents();
+   *numExtents = freeExtents.size();
+   *largestExtent = freeMaxTree.empty() ? 0 : freeMaxTree[1];
+   return freeTotal;
+} // GPTData::FreeExtentSummary()
+
 // Returns 1 if sector is unallocated, 0 if it's allocated to a partition.
 // If it's allocated, return the partition number to which it's allocated
 // in partNum, if that variable is non-NULL. (A value of UINT32_MAX is
 // returned in partNum if the sector is in use by basic GPT data structures.)
 int GPTData::IsFree(uint64_t sector, uint32_t *partNum) {
    int isFree = 1;
-   uint32_t i;
+   PartitionStore::StoredIterator it;
 
-   for (i = 0; i < numParts; i++) {
-      if ((sector >= partitions[i].GetFirstLBA()) &&
-           (sector <= partitions[i].GetLastLBA())) {
+   for (it = partitions.BeginStored(); it != partitions.EndStored(); it++) {
+      const GPTPart & part = partitions.Stored(it);
+      if (part.IsUsed() && (sector >= part.GetFirstLBA()) &&
+           (sector <= part.GetLastLBA())) {
          isFree = 0;
          if (partNum != NULL)
-            *partNum = i;
+            *partNum = it->first;
       } // if
    } // for
    if ((sector < mainHeader.firstUsableLBA) ||
@@ -2393,14 +3259,12 @@ int GPTData::IsFree(uint64_t sector, uint32_t *partNum) {
 
 // Returns 1 if partNum is unused AND if it's a legal value.
 int GPTData::IsFreePartNum(uint32_t partNum) {
-   return ((partNum < numParts) && (partitions != NULL) &&
-           (!partitions[partNum].IsUsed()));
+   return ((partNum < numParts) && (!partitions[partNum].IsUsed()));
 } // GPTData::IsFreePartNum()
 
 // Returns 1 if partNum is in use.
 int GPTData::IsUsedPartNum(uint32_t partNum) {
-   return ((partNum < numParts) && (partitions != NULL) &&
-           (partitions[partNum].IsUsed()));
+   return ((partNum < numParts) && (partitions[partNum].IsUsed()));
 } // GPTData::IsUsedPartNum()
 
 /***********************************************************
@@ -2414,15 +3278,16 @@ int GPTData::IsUsedPartNum(uint32_t partNum) {
 void GPTData::SetAlignment(uint32_t n) {
    if (n > 0) {
       sectorAlignment = n;
-      if ((physBlockSize > 0) && (n % (physBlockSize / blockSize) != 0)) {
-         cout << "Warning: Setting alignment to a value that does not match the disk's\n"
-              << "physical block size! Performance degradation may result!\n"
+      if ((TopologyAlignment() > 1) && (n % TopologyAlignment() != 0)) {
+         DIAG(diag_alignment_mismatch,
+              "Warning: Setting alignment to a value that does not match the disk's\n"
+              << "physical block size or I/O hints! Performance degradation may result!\n"
               << "Physical block size = " << physBlockSize << "\n"
               << "Logical block size = " << blockSize << "\n"
-              << "Optimal alignment = " << physBlockSize / blockSize << " or multiples thereof.\n";
+              << "Optimal alignment = " << TopologyAlignment() << " or multiples thereof.\n");
       } // if
    } else {
-      cerr << "Attempt to set partition alignment to 0!\n";
+      DIAG(diag_zero_alignment, "Attempt to set partition alignment to 0!\n");
    } // if/else
 } // GPTData::SetAlignment()
 
@@ -2437,34 +3302,117 @@ void GPTData::SetAlignment(uint32_t n) {
 // adjustment of that based on the current sector size). The result is that new
 // drives are aligned to 2048-sector multiples but the program won't complain
 // about other alignments on existing disks unless a smaller-than-8 alignment
-// is used on big disks (as safety for Advanced Format drives).
+// is used on big disks (as safety for Advanced Format drives). Finally, the
+// alignment is raised, if necessary, to a multiple of the alignment that the
+// device's I/O hints call for (see TopologyAlignment()), so that RAID
+// devices, eMMC, and the like get suitable alignment for new partitions.
 // Returns the computed alignment value.
 uint32_t GPTData::ComputeAlignment(void) {
-   uint32_t i = 0, found, exponent = 31;
-   uint32_t align = DEFAULT_ALIGNMENT;
+   uint32_t found, exponent = 31;
+   uint32_t align = DEFAULT_ALIGNMENT, topoAlign;
+   uint64_t multiple;
+   PartitionStore::StoredIterator it;
 
    if (blockSize > 0)
       align = DEFAULT_ALIGNMENT * SECTOR_SIZE / blockSize;
    exponent = (uint32_t) log2(align);
-   for (i = 0; i < numParts; i++) {
-      if (partitions[i].IsUsed()) {
-         found = 0;
-         while (!found) {
-            align = UINT64_C(1) << exponent;
-            if ((partitions[i].GetFirstLBA() % align) == 0) {
-               found = 1;
-            } else {
-               exponent--;
-            } // if/else
-         } // while
-      } // if
+   for (it = partitions.BeginStored(); it != partitions.EndStored(); it++) {
+      if (!partitions.Stored(it).IsUsed())
+         continue;
+      found = 0;
+      while (!found) {
+         align = UINT64_C(1) << exponent;
+         if ((partitions.Stored(it).GetFirstLBA() % align) == 0) {
+            found = 1;
+         } else {
+            exponent--;
+         } // if/else
+      } // while
    } // for
    if ((align < MIN_AF_ALIGNMENT) && (diskSize >= SMALLEST_ADVANCED_FORMAT))
       align = MIN_AF_ALIGNMENT;
+   topoAlign = TopologyAlignment();
+   multiple = LeastCommonMultiple(align, topoAlign);
+   if (multiple <= MAX_ALIGNMENT)
+      align = (uint32_t) multiple;
    sectorAlignment = align;
    return align;
 } // GPTData::ComputeAlignment()
 
+// Returns the smallest alignment, in sectors, that satisfies the device's
+// I/O hints: its physical block size, its minimum and optimal I/O sizes
+// (a RAID device's chunk size and stripe width), and its erase size. Hints
+// that are bigger than the physical block size must be multiples of 4 KiB,
+// which weeds out the bogus 0xffff-sector optimal I/O size that some USB
+// bridges report. Hints that would push the alignment past MAX_ALIGNMENT
+// are ignored, too; they're considered in the order just given, so (for
+// instance) an odd RAID stripe width is dropped before the chunk size.
+// Returns 1 if there are no usable hints.
+uint32_t GPTData::TopologyAlignment(void) {
+   uint64_t hints[4], multiple, align = 1;
+   int i;
+
+   hints[0] = physBlockSize;
+   hints[1] = topology.minIOSize;
+   hints[2] = topology.optIOSize;
+   hints[3] = topology.eraseSize;
+   for (i = 0; (i < 4) && (blockSize > 0); i++) {
+      if ((hints[i] > physBlockSize) && ((hints[i] % (MIN_AF_ALIGNMENT * SECTOR_SIZE)) != 0))
+         continue;
+      if ((hints[i] >= blockSize) && ((hints[i] % blockSize) == 0)) {
+         multiple = LeastCommonMultiple(align, hints[i] / blockSize);
+         if (multiple <= MAX_ALIGNMENT)
+            align = multiple;
+      } // if
+   } // for
+   return (uint32_t) align;
+} // GPTData::TopologyAlignment()
+
+// Read the device's I/O topology hints (see DiskIO::GetTopology()). On a
+// zoned device, the zone map from DiskIO::ReportZones() then supplies the
+// zone size, if the kernel didn't give it, and the number of zones.
+void GPTData::ReadTopology(void) {
+   vector<DiskZone> zones;
+
+   myDisk.GetTopology(&topology);
+   if (myDisk.ReportZones(zones)) {
+      if (topology.zoneSize == 0)
+         topology.zoneSize = zones[0].length;
+      topology.numZones = (uint32_t) zones.size();
+   } // if
+} // GPTData::ReadTopology()
+
+// Treat the disk as a zoned one with zones of the given size (or, if bytes
+// is 0, as one that isn't zoned), as when its zones can't be read from the
+// kernel, and work out the number of zones to match.
+void GPTData::SetZoneSize(uint64_t bytes) {
+   uint64_t diskBytes = diskSize * blockSize;
+
+   topology.zoneSize = bytes;
+   topology.numZones = (bytes > 0) ? (uint32_t) ((diskBytes + bytes - 1) / bytes) : 0;
+} // GPTData::SetZoneSize()
+
+// Returns the alignment, in sectors, that Verify() checks partition starts
+// against: the smallest multiple of sectorAlignment and TopologyAlignment(),
+// as ComputeAlignment() picks for new partitions, or just sectorAlignment
+// if that multiple is over MAX_ALIGNMENT.
+uint32_t GPTData::CheckedAlignment(void) {
+   uint64_t multiple = LeastCommonMultiple(sectorAlignment, TopologyAlignment());
+
+   return (multiple <= MAX_ALIGNMENT) ? (uint32_t) multiple : sectorAlignment;
+} // GPTData::CheckedAlignment()
+
+// Returns the alignment, in sectors, for the first sectors of partitions:
+// sectorAlignment or, on zoned devices, the smallest multiple of that and
+// the zone size, so that partitions begin on zone boundaries.
+uint64_t GPTData::StartAlignment(void) {
+   uint64_t align = (sectorAlignment > 0) ? sectorAlignment : 1;
+
+   if (ZoneSectors() > 0)
+      align = LeastCommonMultiple(align, ZoneSectors());
+   return align;
+} // GPTData::StartAlignment()
+
 /********************************
  *                              *
  * Endianness support functions *
@@ -2490,17 +3438,14 @@ void GPTData::ReverseHeaderBytes(struct GPTHeader* header) {
 
 // Reverse byte order for all partitions.
 void GPTData::ReversePartitionBytes() {
-   uint32_t i;
-
-   for (i = 0; i < numParts; i++) {
-      partitions[i].ReversePartBytes();
-   } // for
+   TouchPartitions();
+   partitions.ReverseBytes();
 } // GPTData::ReversePartitionBytes()
 
 // Validate partition number
 bool GPTData::ValidPartNum (const uint32_t partNum) {
    if (partNum >= numParts) {
-      cerr << "Partition number out of range: " << partNum << "\n";
+      DIAG(diag_partition_out_of_range, "Partition number out of range: " << partNum << "\n");
       return false;
    } // if
    return true;
@@ -2510,12 +3455,8 @@ bool GPTData::ValidPartNum (const uint32_t partNum) {
 // functions.
 const GPTPart & GPTData::operator[](uint32_t partNum) const {
    if (partNum >= numParts) {
-      cerr << "Partition number out of range (" << partNum << " requested, but only "
-           << numParts << " available)\n";
-      exit(1);
-   } // if
-   if (partitions == NULL) {
-      cerr << "No partitions defined in GPTData::operator[]; fatal error!\n";
+      DIAG(diag_internal, "Partition number out of range (" << partNum << " requested, but only "
+           << numParts << " available)\n");
       exit(1);
    } // if
    return partitions[partNum];
@@ -2535,7 +3476,7 @@ int GPTData::ManageAttributes(int partNum, const string & command, const string
    Attributes theAttr;
 
    if (partNum >= (int) numParts) {
-      cerr << "Invalid partition number (" << partNum + 1 << ")\n";
+      DIAG(diag_partition_out_of_range, "Invalid partition number (" << partNum + 1 << ")\n");
       retval = -1;
    } else {
       if (command == "show") {
@@ -2545,7 +3486,8 @@ int GPTData::ManageAttributes(int partNum, const string & command, const string
       } else {
          theAttr = partitions[partNum].GetAttributes();
          if (theAttr.OperateOnAttributes(partNum, command, bits)) {
-            partitions[partNum].SetAttributes(theAttr.GetAttributes());
+            TouchPartition(partNum);
+            partitions.Edit(partNum).SetAttributes(theAttr.GetAttributes());
             retval = 1;
          } else {
             retval = -1;
@@ -2559,7 +3501,7 @@ int GPTData::ManageAttributes(int partNum, const string & command, const string
 // Show all attributes for a specified partition....
 void GPTData::ShowAttributes(const uint32_t partNum) {
    if ((partNum < numParts) && partitions[partNum].IsUsed())
-      partitions[partNum].ShowAttributes(partNum);
+      partitions[partNum].GetAttributes().ShowAttributes(partNum);
 } // GPTData::ShowAttributes
 
 // Show whether a single attribute bit is set (terse output)...
@@ -2583,45 +3525,64 @@ int SizesOK(void) {
    int allOK = 1;
 
    if (sizeof(uint8_t) != 1) {
-      cerr << "uint8_t is " << sizeof(uint8_t) << " bytes, should be 1 byte; aborting!\n";
+      DIAG(diag_internal, "uint8_t is " << sizeof(uint8_t) << " bytes, should be 1 byte; aborting!\n");
       allOK = 0;
    } // if
    if (sizeof(uint16_t) != 2) {
-      cerr << "uint16_t is " << sizeof(uint16_t) << " bytes, should be 2 bytes; aborting!\n";
+      DIAG(diag_internal, "uint16_t is " << sizeof(uint16_t) << " bytes, should be 2 bytes; aborting!\n");
       allOK = 0;
    } // if
    if (sizeof(uint32_t) != 4) {
-      cerr << "uint32_t is " << sizeof(uint32_t) << " bytes, should be 4 bytes; aborting!\n";
+      DIAG(diag_internal, "uint32_t is " << sizeof(uint32_t) << " bytes, should be 4 bytes; aborting!\n");
       allOK = 0;
    } // if
    if (sizeof(uint64_t) != 8) {
-      cerr << "uint64_t is " << sizeof(uint64_t) << " bytes, should be 8 bytes; aborting!\n";
+      DIAG(diag_internal, "uint64_t is " << sizeof(uint64_t) << " bytes, should be 8 bytes; aborting!\n");
       allOK = 0;
    } // if
    if (sizeof(struct MBRRecord) != 16) {
-      cerr << "MBRRecord is " << sizeof(MBRRecord) << " bytes, should be 16 bytes; aborting!\n";
+      DIAG(diag_internal, "MBRRecord is " << sizeof(MBRRecord) << " bytes, should be 16 bytes; aborting!\n");
       allOK = 0;
    } // if
    if (sizeof(struct TempMBR) != 512) {
-      cerr << "TempMBR is " <<  sizeof(TempMBR) << " bytes, should be 512 bytes; aborting!\n";
+      DIAG(diag_internal, "TempMBR is " <<  sizeof(TempMBR) << " bytes, should be 512 bytes; aborting!\n");
       allOK = 0;
    } // if
    if (sizeof(struct GPTHeader) != 512) {
-      cerr << "GPTHeader is " << sizeof(GPTHeader) << " bytes, should be 512 bytes; aborting!\n";
+      DIAG(diag_internal, "GPTHeader is " << sizeof(GPTHeader) << " bytes, should be 512 bytes; aborting!\n");
       allOK = 0;
    } // if
    if (sizeof(GPTPart) != 128) {
-      cerr << "GPTPart is " << sizeof(GPTPart) << " bytes, should be 128 bytes; aborting!\n";
+      DIAG(diag_internal, "GPTPart is " << sizeof(GPTPart) << " bytes, should be 128 bytes; aborting!\n");
       allOK = 0;
    } // if
    if (sizeof(GUIDData) != 16) {
-      cerr << "GUIDData is " << sizeof(GUIDData) << " bytes, should be 16 bytes; aborting!\n";
+      DIAG(diag_internal, "GUIDData is " << sizeof(GUIDData) << " bytes, should be 16 bytes; aborting!\n");
       allOK = 0;
    } // if
    if (sizeof(PartType) != 16) {
-      cerr << "PartType is " << sizeof(PartType) << " bytes, should be 16 bytes; aborting!\n";
+      DIAG(diag_internal, "PartType is " << sizeof(PartType) << " bytes, should be 16 bytes; aborting!\n");
       allOK = 0;
    } // if
    return (allOK);
 } // SizesOK()
 
+// Convert a placement policy name ("largest", "first-fit", "best-fit", or
+// "last-fit") to a PlacementPolicy value in *policy.
+// Returns 1 if the name is valid, 0 if it isn't.
+int StringToPlacement(const string & name, PlacementPolicy *policy) {
+   int retval = 1;
+
+   if (name == "largest")
+      *policy = place_largest;
+   else if (name == "first-fit")
+      *policy = place_first_fit;
+   else if (name == "best-fit")
+      *policy = place_best_fit;
+   else if (name == "last-fit")
+      *policy = place_last_fit;
+   else
+      retval = 0;
+   return retval;
+} // StringToPlacement()
+
@@ -6,11 +6,18 @@
 
 #include <stdint.h>
 #include <sys/types.h>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include "gptpart.h"
 #include "support.h"
 #include "mbr.h"
 #include "bsd.h"
-#include "gptpart.h"
+#include "partstore.h"
+#include "verifycache.h"
+#include "verifyreport.h"
 
 #ifndef __GPTSTRUCTS
 #define __GPTSTRUCTS
@@ -20,6 +27,16 @@
 #define MAX_ALIGNMENT 65536
 #define MIN_AF_ALIGNMENT 8
 
+// Largest partition table we'll handle, in bytes. DiskIO transfers are
+// limited to INT_MAX bytes, so the whole table must fit in one of those.
+#define MAX_GPT_TABLE_SIZE INT32_MAX
+
+// Number of changes that can be undone
+#define MAX_UNDO_STEPS 100
+
+// Partition number used in GPTJournalRecord for a whole-table record
+#define GPT_JOURNAL_TABLE UINT32_MAX
+
 // Below constant corresponds to a ~279GiB (300GB) disk, since the
 // smallest Advanced Format drive I know of is 320GB in size
 #define SMALLEST_ADVANCED_FORMAT UINT64_C(585937500)
@@ -38,6 +55,11 @@ enum GPTValidity {gpt_valid, gpt_corrupt, gpt_invalid};
 // Which set of partition data to use
 enum WhichToUse {use_gpt, use_mbr, use_bsd, use_new, use_abort};
 
+// Where FindPlacement() puts new partitions: at the start of the largest
+// free extent, in the first (lowest) or the smallest extent that's big
+// enough, or at the end of the last extent that's big enough
+enum PlacementPolicy {place_largest, place_first_fit, place_best_fit, place_last_fit};
+
 // Header (first 512 bytes) of GPT table
 #pragma pack(push)
 #pragma pack(1)
@@ -60,18 +82,49 @@ struct GPTHeader {
 }; // struct GPTHeader
 #pragma pack ()
 
+// One change recorded in the undo journal: the prior contents of a single
+// partition entry or, for operations that resize, reorder, or replace the
+// whole table (partNum == GPT_JOURNAL_TABLE), the prior table itself. The
+// latter costs only a reference, since a PartitionStore's entries are shared
+// until it's modified.
+struct GPTJournalRecord {
+   uint32_t partNum;
+   GPTPart part;
+   string tail; // bytes past the first GPT_SIZE of the entry, if any
+   uint32_t numParts;
+   uint32_t partEntrySize;
+   PartitionStore table;
+}; // struct GPTJournalRecord
+
+// One undoable step: the headers as they were when the step began, plus
+// the records needed to put the partition table back as it was.
+struct GPTJournalStep {
+   struct GPTHeader mainHeader;
+   struct GPTHeader secondHeader;
+   vector<GPTJournalRecord> records;
+}; // struct GPTJournalStep
+
 // Data in GPT format
 class GPTData {
 protected:
    struct GPTHeader mainHeader;
-   GPTPart *partitions;
+   // The partition entries. Only those that aren't blank take up memory.
+   // When on-disk entries are bigger than GPT_SIZE, the bytes past the first
+   // GPT_SIZE of each (vendor data we don't interpret) are kept here, too.
+   // Copies of a GPTData object share the entries until one of them
+   // modifies them (see TouchPartitions()), so copying a big table is cheap.
+   // Reading partitions[i] gives a const entry; use partitions.Edit(i) to
+   // change one.
+   PartitionStore partitions;
    uint32_t numParts; // # of partitions the table can hold
+   uint32_t partEntrySize; // bytes per on-disk entry; a multiple of GPT_SIZE
    struct GPTHeader secondHeader;
    MBRData protectiveMBR;
    string device; // device filename
    DiskIO myDisk;
    uint32_t blockSize; // device logical block size
    uint32_t physBlockSize; // device physical block size (or 0 if it can't be determined)
+   DiskTopology topology; // device I/O hints (all 0 for disk image files)
    uint64_t diskSize; // size of device, in logical blocks
    GPTValidity state; // is GPT valid?
    int justLooking; // Set to 1 if program launched with "-l" or if read-only
@@ -82,34 +135,106 @@ protected:
    int apmFound; // set to 1 if APM detected
    int bsdFound; // set to 1 if BSD disklabel detected in MBR
    uint32_t sectorAlignment; // Start partitions at multiples of sectorAlignment
+   PlacementPolicy placement;
    int beQuiet;
    WhichToUse whichWasUsed;
 
+   // Partition-name lookup index, keyed on the raw UTF-16LE name field.
+   // Built on demand by FindByName() and discarded by TouchPartitions().
+   unordered_map<string, uint32_t> nameIndex;
+   int nameIndexValid;
+   // Unique-GUID lookup index, keyed on the raw 16-byte GUID. A multimap,
+   // so that duplicate GUIDs (as on cloned disks) can be detected.
+   unordered_multimap<string, uint32_t> guidIndex;
+   int guidIndexValid;
+   // Numbers of the in-use partitions, in ascending order. Lets scans of
+   // big, mostly-empty tables skip the empty entries.
+   vector<uint32_t> usedSlots;
+   int usedSlotsValid;
+   // Runs of unallocated sectors in the usable area, as (first LBA, last
+   // LBA) pairs in ascending order, along with a tree of the largest run in
+   // each range of runs (for first- and last-fit searches) and the runs'
+   // indexes sorted by size (for best-fit searches). Built on demand by
+   // UpdateFreeExtents() for the usable area [freeFirstLBA, freeLastLBA].
+   vector<pair<uint64_t, uint64_t> > freeExtents;
+   vector<uint64_t> freeMaxTree;
+   vector<pair<uint64_t, uint32_t> > freeBySize;
+   uint64_t freeTotal;
+   uint64_t freeFirstLBA;
+   uint64_t freeLastLBA;
+   int freeExtentsValid;
+   // Results of the per-entry verification checks, kept current as entries
+   // change (see TouchPartition()), so that Verify() and the checks made
+   // before saving re-check only what's changed since they last ran.
+   VerifyCache verifyCache;
+   // Undo journal (see BeginTransaction()). While a transaction is open,
+   // TouchPartition() and TouchPartitions() record the data that's about
+   // to change in openStep. The protective/hybrid MBR isn't journaled.
+   int inTransaction;
+   GPTJournalStep openStep;
+   unordered_set<uint32_t> journaled; // entries already recorded in openStep
+   int journaledTable; // openStep holds a whole-table record
+   deque<GPTJournalStep> undoSteps;
+   deque<GPTJournalStep> redoSteps;
+
    int LoadHeader(struct GPTHeader *header, DiskIO & disk, uint64_t sector, int *crcOk);
    int LoadPartitionTable(const struct GPTHeader & header, DiskIO & disk, uint64_t sector = 0);
    int CheckTable(struct GPTHeader *header);
    int SaveHeader(struct GPTHeader *header, DiskIO & disk, uint64_t sector);
    int SavePartitionTable(DiskIO & disk, uint64_t sector);
+   int SetEntrySize(uint32_t entrySize);
+   void ReadTopology(void);
+   uint32_t TailSize(void) {return partEntrySize - GPT_SIZE;}
+   uint32_t ComputeTableCRC(void);
+   void TouchPartitions(void);
+   void TouchPartition(uint32_t pn);
+   void DropIndexes(void);
+   void DropLookupIndexes(void);
+   void BuildNameIndex(void);
+   void BuildGUIDIndex(void);
+   void EnsureUniqueGUID(uint32_t pn);
+   const vector<uint32_t> & UsedSlots(void);
+   void UpdateFreeExtents(void);
+   void UpdateVerifyCache(void);
+   int CheckUsedRange(uint64_t firstUsedBlock, uint64_t lastUsedBlock, VerifyReport & report);
+   uint32_t FindFit(uint32_t node, uint32_t low, uint32_t high, uint32_t limit,
+                    uint64_t need, int fromEnd);
+   int FitInExtent(uint32_t extent, uint64_t numSectors, int atEnd, uint64_t *start);
+   void JournalTable(void);
+   void JournalPart(uint32_t pn);
+   void MakeTableRecord(GPTJournalRecord & rec);
+   void MakePartRecord(uint32_t pn, GPTJournalRecord & rec);
+   void ApplyJournalStep(const GPTJournalStep & step, GPTJournalStep & inverse);
 public:
    // Basic necessary functions....
    GPTData(void);
    GPTData(const GPTData &);
+   GPTData(GPTData && orig);
    GPTData(string deviceFilename);
    virtual ~GPTData(void);
    GPTData & operator=(const GPTData & orig);
+   GPTData & operator=(GPTData && orig);
 
    // Verify (or update) data integrity
    int Verify(void);
+   int Verify(VerifyReport & report);
    int CheckGPTSize(void);
+   int CheckGPTSize(VerifyReport & report);
    int CheckHeaderValidity(void);
    int CheckHeaderCRC(struct GPTHeader* header, int warn = 0);
    void RecomputeCRCs(void);
    void RebuildMainHeader(void);
    void RebuildSecondHeader(void);
    int VerifyMBR(void) {return protectiveMBR.FindOverlaps();}
+   int VerifyMBR(VerifyReport & report) {return protectiveMBR.FindOverlaps(report);}
    int FindHybridMismatches(void);
+   int FindHybridMismatches(VerifyReport & report);
    int FindOverlaps(void);
+   int FindOverlaps(VerifyReport & report);
+   int FindDuplicateGUIDs(void);
+   int FindDuplicateGUIDs(VerifyReport & report);
    int FindInsanePartitions(void);
+   int FindInsanePartitions(VerifyReport & report);
 
    // Load or save data from/to disk
    int SetDisk(const string & deviceFilename);
@@ -122,6 +247,7 @@ public:
    int LoadMainTable(void);
    int LoadSecondTableAsMain(void);
    int SaveGPTData(int quiet = 0);
+   int CheckWritten(void);
    int SaveGPTBackup(const string & filename);
    int LoadGPTBackup(const string & filename);
    int SaveMBR(void);
@@ -134,6 +260,9 @@ public:
    void DisplayGPTData(void);
    void DisplayMBRData(void) {protectiveMBR.DisplayMBRData();}
    void ShowPartDetails(uint32_t partNum);
+   void ShowJSON(ostream & os);
+   void ShowPartJSON(uint32_t partNum, ostream & os);
+   void ShowMBRJSON(ostream & os) {protectiveMBR.ShowJSON(os);}
 
    // Convert between GPT and other formats
    virtual WhichToUse UseWhichPartitions(void);
@@ -148,6 +277,7 @@ public:
    void BlankPartitions(void);
    int DeletePartition(uint32_t partNum);
    uint32_t CreatePartition(uint32_t partNum, uint64_t startSector, uint64_t endSector);
+   uint32_t CreatePartition(uint32_t partNum, uint64_t numSectors);
    void SortGPT(void);
    int SwapPartitions(uint32_t partNum1, uint32_t partNum2);
    int ClearGPTData(void);
@@ -155,20 +285,35 @@ public:
    int SetName(uint32_t partNum, const UnicodeString & theName);
    void SetDiskGUID(GUIDData newGUID);
    int SetPartitionGUID(uint32_t pn, GUIDData theGUID);
+   int SetAttributes(uint32_t pn, uint64_t attributes);
    void RandomizeGUIDs(void);
    int ChangePartType(uint32_t pn, PartType theGUID);
    void MakeProtectiveMBR(void) {protectiveMBR.MakeProtectiveMBR();}
    void RecomputeCHS(void);
    int Align(uint64_t* sector);
    void SetProtectiveMBR(BasicMBRData & newMBR) {protectiveMBR = newMBR;}
-   
+   void SetProtectiveMBR(BasicMBRData && newMBR) {protectiveMBR = move(newMBR);}
+
+   // Group changes into transactions, which can be rolled back or, once
+   // committed, undone and redone....
+   int BeginTransaction(void);
+   int CommitTransaction(void);
+   int RollbackTransaction(void);
+   int Undo(void);
+   int Redo(void);
+   int CanUndo(void) {return !undoSteps.empty();}
+   int CanRedo(void) {return !redoSteps.empty();}
+   void ClearJournal(void);
+
    // Return data about the GPT structures....
    WhichToUse GetState(void) {return whichWasUsed;}
    int GetPartRange(uint32_t* low, uint32_t* high);
    int FindFirstFreePart(void);
+   int FindByName(const UnicodeString & theName);
+   int FindByGUID(const GUIDData & theGUID);
    uint32_t GetNumParts(void) {return mainHeader.numParts;}
-   uint64_t GetTableSizeInSectors(void) {return (((numParts * GPT_SIZE) / blockSize) +
-                                                 (((numParts * GPT_SIZE) % blockSize) != 0)); }
+   uint64_t GetTableSizeInSectors(void) {return (((uint64_t) numParts * partEntrySize) + blockSize - 1) /
+                                                 blockSize; }
    uint64_t GetMainHeaderLBA(void) {return mainHeader.currentLBA;}
    uint64_t GetSecondHeaderLBA(void) {return secondHeader.currentLBA;}
    uint64_t GetMainPartsLBA(void) {return mainHeader.partitionEntriesLBA;}
@@ -180,6 +325,7 @@ public:
    const GPTPart & operator[](uint32_t partNum) const;
    const GUIDData & GetDiskGUID(void) const;
    uint32_t GetBlockSize(void) {return blockSize;}
+   uint64_t GetDiskSize(void) {return diskSize;}
 
    // Find information about free space
    uint64_t FindFirstAvailable(uint64_t start = 0);
@@ -188,6 +334,8 @@ public:
    uint64_t FindLastAvailable();
    uint64_t FindLastInFree(uint64_t start);
    uint64_t FindFreeBlocks(uint32_t *numSegments, uint64_t *largestSegment);
+   uint64_t FindPlacement(uint64_t numSectors = 0);
+   uint64_t FreeExtentSummary(uint32_t *numExtents, uint64_t *largestExtent);
    int IsFree(uint64_t sector, uint32_t *partNum = NULL);
    int IsFreePartNum(uint32_t partNum);
    int IsUsedPartNum(uint32_t partNum);
@@ -195,7 +343,15 @@ public:
    // Change how functions work, or return information on same
    void SetAlignment(uint32_t n);
    uint32_t ComputeAlignment(void); // Set alignment based on current partitions
+   uint32_t TopologyAlignment(void); // Smallest alignment that suits the device's I/O hints
+   uint32_t CheckedAlignment(void); // Alignment that Verify() checks partitions against
+   const DiskTopology & GetTopology(void) const {return topology;}
+   uint64_t ZoneSectors(void) {return (blockSize > 0) ? topology.zoneSize / blockSize : 0;}
+   void SetZoneSize(uint64_t bytes);
+   uint64_t StartAlignment(void); // Alignment for partition starts, allowing for zones
    uint32_t GetAlignment(void) {return sectorAlignment;}
+   void SetPlacement(PlacementPolicy p) {placement = p;}
+   PlacementPolicy GetPlacement(void) {return placement;}
    void JustLooking(int i = 1) {justLooking = i;}
    void BeQuiet(int i = 1) {beQuiet = i;}
    WhichToUse WhichWasUsed(void) {return whichWasUsed;}
@@ -213,6 +369,7 @@ public:
 
 // Function prototypes....
 int SizesOK(void);
+int StringToPlacement(const string & name, PlacementPolicy *policy);
 
 #pragma pack(pop)
 
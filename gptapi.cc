@@ -0,0 +1,435 @@
+// gptapi.cc
+// C interface to the GPTData class, for programs that link with libsgdisk.
+// See gptapi.h for how it's used.
+
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <new>
+#include <string>
+#include "gptapi.h"
+#include "diag.h"
+#include "gpt.h"
+#include "parttypes.h"
+#include "verifyreport.h"
+
+using namespace std;
+
+static_assert(SGDISK_NAME_SIZE == NAME_UTF8_SIZE, "SGDISK_NAME_SIZE must match NAME_UTF8_SIZE");
+
+struct sgdisk_handle {
+   GPTData data;
+   string device;
+   int writable;
+   int loaded;
+   int source; // SGDISK_SOURCE_*
+   string messages; // from the last call
+}; // struct sgdisk_handle
+
+// How many of a call's messages are kept for sgdisk_get_messages()
+#define MAX_MESSAGES 64
+
+// Run func with the GPT code's diagnostic messages kept in messages rather
+// than printed. The GPT code keeps all its state in its objects (what it
+// shares, such as the list of partition types, is read-only once it's set
+// up), and the sink is the calling thread's own, so calls on different
+// handles may run at once. Returns func's return value, or an
+// error code if it throws (as the GPT code does if memory runs out).
+template <typename Func> static int Guarded(string & messages, Func func) {
+   RingDiagSink sink(MAX_MESSAGES);
+   DiagSink* oldSink = SetDiagSink(&sink);
+   int retval;
+
+   try {
+      retval = func();
+   } catch (const bad_alloc &) {
+      retval = SGDISK_ERR_NO_MEMORY;
+   } catch (...) {
+      retval = SGDISK_ERR_INTERNAL;
+   } // try/catch
+   SetDiagSink(oldSink);
+   try {
+      messages = sink.GetText();
+   } catch (const bad_alloc &) {
+      messages.clear();
+   } // try/catch
+   return retval;
+} // Guarded()
+
+// Run func on handle's behalf (see Guarded()), after checking that handle
+// exists and, if needLoaded is set, that it holds a partition table.
+template <typename Func> static int Run(sgdisk_handle* handle, int needLoaded, Func func) {
+   if (handle == NULL)
+      return SGDISK_ERR_INVALID;
+   return Guarded(handle->messages, [&]() {
+      if (needLoaded && !handle->loaded)
+         return SGDISK_ERR_NOT_LOADED;
+      return func(handle->data);
+   });
+} // Run()
+
+// Check that num (numbered from 1) is a partition that's in use.
+static int CheckPart(GPTData & data, uint32_t num) {
+   if ((num == 0) || (num > data.GetNumParts()))
+      return SGDISK_ERR_RANGE;
+   if (!data.IsUsedPartNum(num - 1))
+      return SGDISK_ERR_UNUSED;
+   return SGDISK_OK;
+} // CheckPart()
+
+// Convert text, which must be a GUID in 8-4-4-4-12 form, to guid. Returns
+// 1 on success, 0 if text isn't such a GUID. (GUIDData's own conversion
+// accepts nearly anything.)
+static int ParseGUID(const char* text, GUIDData & guid) {
+   int i;
+
+   if ((text == NULL) || (strlen(text) != SGDISK_GUID_SIZE - 1))
+      return 0;
+   for (i = 0; i < SGDISK_GUID_SIZE - 1; i++) {
+      if ((i == 8) || (i == 13) || (i == 18) || (i == 23)) {
+         if (text[i] != '-')
+            return 0;
+      } else if (!isxdigit((unsigned char) text[i])) {
+         return 0;
+      } // if/else
+   } // for
+   guid = (string) text;
+   return 1;
+} // ParseGUID()
+
+// Copy src into a dest of size bytes, truncating it if need be.
+static void CopyString(char* dest, size_t size, const string & src) {
+   size_t length = (src.length() < size) ? src.length() : size - 1;
+
+   memcpy(dest, src.data(), length);
+   dest[length] = '\0';
+} // CopyString()
+
+// Fill in info for partition num (numbered from 1).
+static void FillPartInfo(GPTData & data, uint32_t num, struct sgdisk_part_info* info) {
+   GPTPart part = data[num - 1];
+
+   memset(info, 0, sizeof(*info));
+   info->num = num;
+   info->first_lba = part.GetFirstLBA();
+   info->last_lba = part.GetLastLBA();
+   info->attributes = part.GetAttributes().GetAttributes();
+   CopyString(info->type_guid, sizeof(info->type_guid), part.GetType().AsString());
+   CopyString(info->unique_guid, sizeof(info->unique_guid), part.GetUniqueGUID().AsString());
+   CopyString(info->name, sizeof(info->name), part.GetDescription());
+} // FillPartInfo()
+
+int sgdisk_open(const char* device, int flags, sgdisk_handle** handle) {
+   sgdisk_handle* newHandle = NULL;
+   string messages;
+   int fd, retval;
+
+   if ((device == NULL) || (handle == NULL) || ((flags & ~SGDISK_OPEN_WRITE) != 0))
+      return SGDISK_ERR_INVALID;
+   *handle = NULL;
+   fd = open(device, (flags & SGDISK_OPEN_WRITE) ? O_RDWR : O_RDONLY);
+   if (fd < 0)
+      return SGDISK_ERR_OPEN;
+   close(fd);
+   retval = Guarded(messages, [&]() {
+      newHandle = new sgdisk_handle;
+      newHandle->device = device;
+      newHandle->writable = (flags & SGDISK_OPEN_WRITE) != 0;
+      newHandle->loaded = 0;
+      newHandle->source = SGDISK_SOURCE_NEW;
+      newHandle->data.JustLooking(!newHandle->writable);
+      newHandle->data.BeQuiet();
+      return SGDISK_OK;
+   });
+   if (retval == SGDISK_OK) {
+      newHandle->messages.swap(messages);
+      *handle = newHandle;
+   } else {
+      delete newHandle;
+   } // if/else
+   return retval;
+} // sgdisk_open()
+
+int sgdisk_load(sgdisk_handle* handle) {
+   return Run(handle, 0, [&](GPTData & data) {
+      GPTData loaded;
+
+      handle->loaded = 0;
+      loaded.JustLooking(!handle->writable);
+      loaded.BeQuiet();
+      if (!loaded.LoadPartitions(handle->device))
+         return (loaded.WhichWasUsed() == use_abort) ? SGDISK_ERR_BAD_TABLE : SGDISK_ERR_IO;
+      data = move(loaded);
+      switch (data.WhichWasUsed()) {
+         case use_gpt:
+            handle->source = SGDISK_SOURCE_GPT;
+            break;
+         case use_mbr:
+            handle->source = SGDISK_SOURCE_MBR;
+            break;
+         case use_bsd:
+            handle->source = SGDISK_SOURCE_BSD;
+            break;
+         default:
+            handle->source = SGDISK_SOURCE_NEW;
+            break;
+      } // switch
+      data.BeginTransaction(); // for sgdisk_revert()
+      handle->loaded = 1;
+      return SGDISK_OK;
+   });
+} // sgdisk_load()
+
+int sgdisk_new_table(sgdisk_handle* handle, uint32_t num_entries) {
+   return Run(handle, 0, [&](GPTData & data) {
+      if (!handle->loaded && !data.SetDisk(handle->device))
+         return SGDISK_ERR_IO;
+      if (data.GetDiskSize() == 0)
+         return SGDISK_ERR_IO;
+      data.ClearJournal();
+      data.ClearGPTData();
+      if ((num_entries > 0) && !data.SetGPTSize(num_entries)) {
+         handle->loaded = 0;
+         return SGDISK_ERR_INVALID;
+      } // if
+      data.MakeProtectiveMBR();
+      data.BeginTransaction();
+      handle->source = SGDISK_SOURCE_NEW;
+      handle->loaded = 1;
+      return SGDISK_OK;
+   });
+} // sgdisk_new_table()
+
+int sgdisk_get_info(sgdisk_handle* handle, struct sgdisk_disk_info* info) {
+   return Run(handle, 1, [&](GPTData & data) {
+      if (info == NULL)
+         return SGDISK_ERR_INVALID;
+      memset(info, 0, sizeof(*info));
+      info->sectors = data.GetDiskSize();
+      info->sector_size = data.GetBlockSize();
+      info->alignment = data.GetAlignment();
+      info->first_usable = data.GetFirstUsableLBA();
+      info->last_usable = data.GetLastUsableLBA();
+      info->num_entries = data.GetNumParts();
+      info->num_used = data.CountParts();
+      info->source = handle->source;
+      CopyString(info->disk_guid, sizeof(info->disk_guid), data.GetDiskGUID().AsString());
+      return SGDISK_OK;
+   });
+} // sgdisk_get_info()
+
+int sgdisk_get_partitions(sgdisk_handle* handle, struct sgdisk_part_info* parts,
+                          size_t max_parts, size_t* num_parts) {
+   return Run(handle, 1, [&](GPTData & data) {
+      size_t count = 0;
+      uint32_t i;
+
+      if ((num_parts == NULL) || ((parts == NULL) && (max_parts > 0)))
+         return SGDISK_ERR_INVALID;
+      for (i = 0; i < data.GetNumParts(); i++) {
+         if (data.IsUsedPartNum(i)) {
+            if (count < max_parts)
+               FillPartInfo(data, i + 1, &parts[count]);
+            count++;
+         } // if
+      } // for
+      *num_parts = count;
+      return (count > max_parts) ? SGDISK_ERR_TOO_SMALL : SGDISK_OK;
+   });
+} // sgdisk_get_partitions()
+
+int sgdisk_get_partition(sgdisk_handle* handle, uint32_t num, struct sgdisk_part_info* part) {
+   return Run(handle, 1, [&](GPTData & data) {
+      int retval = CheckPart(data, num);
+
+      if (part == NULL)
+         return SGDISK_ERR_INVALID;
+      if (retval == SGDISK_OK)
+         FillPartInfo(data, num, part);
+      return retval;
+   });
+} // sgdisk_get_partition()
+
+int sgdisk_lookup_name(sgdisk_handle* handle, const char* name, uint32_t* num) {
+   return Run(handle, 1, [&](GPTData & data) {
+      int found;
+
+      if ((name == NULL) || (num == NULL))
+         return SGDISK_ERR_INVALID;
+      found = data.FindByName((UnicodeString) name);
+      if (found < 0)
+         return SGDISK_ERR_UNUSED;
+      *num = (uint32_t) found + 1;
+      return SGDISK_OK;
+   });
+} // sgdisk_lookup_name()
+
+int sgdisk_lookup_guid(sgdisk_handle* handle, const char* guid, uint32_t* num) {
+   return Run(handle, 1, [&](GPTData & data) {
+      GUIDData theGUID;
+      int found;
+
+      if ((num == NULL) || !ParseGUID(guid, theGUID))
+         return SGDISK_ERR_INVALID;
+      found = data.FindByGUID(theGUID);
+      if (found < 0)
+         return SGDISK_ERR_UNUSED;
+      *num = (uint32_t) found + 1;
+      return SGDISK_OK;
+   });
+} // sgdisk_lookup_guid()
+
+int sgdisk_create_partition(sgdisk_handle* handle, uint32_t num, uint64_t first,
+                            uint64_t last, uint32_t* created) {
+   return Run(handle, 1, [&](GPTData & data) {
+      int freePart;
+
+      if (num == 0) {
+         freePart = data.FindFirstFreePart();
+         if (freePart < 0)
+            return SGDISK_ERR_IN_USE; // every entry is taken
+         num = (uint32_t) freePart + 1;
+      } else if (num > data.GetNumParts()) {
+         return SGDISK_ERR_RANGE;
+      } else if (!data.IsFreePartNum(num - 1)) {
+         return SGDISK_ERR_IN_USE;
+      } // if/else
+      if (!data.CreatePartition(num - 1, first, last))
+         return SGDISK_ERR_NO_SPACE;
+      if (created != NULL)
+         *created = num;
+      return SGDISK_OK;
+   });
+} // sgdisk_create_partition()
+
+int sgdisk_delete_partition(sgdisk_handle* handle, uint32_t num) {
+   return Run(handle, 1, [&](GPTData & data) {
+      int retval = CheckPart(data, num);
+
+      if ((retval == SGDISK_OK) && !data.DeletePartition(num - 1))
+         retval = SGDISK_ERR_INTERNAL;
+      return retval;
+   });
+} // sgdisk_delete_partition()
+
+int sgdisk_set_type(sgdisk_handle* handle, uint32_t num, const char* type) {
+   return Run(handle, 1, [&](GPTData & data) {
+      PartType theType;
+      int retval = CheckPart(data, num);
+
+      if (type == NULL)
+         return SGDISK_ERR_INVALID;
+      if ((strlen(type) == 4) && IsHex(type)) {
+         // A type code; don't let PartType fall back on the default type....
+         if (!theType.Valid((uint16_t) strtoul(type, NULL, 16)))
+            return SGDISK_ERR_INVALID;
+         theType = (string) type;
+      } else if (!ParseGUID(type, theType)) {
+         return SGDISK_ERR_INVALID;
+      } // if/else
+      if ((retval == SGDISK_OK) && !data.ChangePartType(num - 1, theType))
+         retval = SGDISK_ERR_INTERNAL;
+      return retval;
+   });
+} // sgdisk_set_type()
+
+int sgdisk_set_name(sgdisk_handle* handle, uint32_t num, const char* name) {
+   return Run(handle, 1, [&](GPTData & data) {
+      int retval = CheckPart(data, num);
+
+      if (name == NULL)
+         return SGDISK_ERR_INVALID;
+      if ((retval == SGDISK_OK) && !data.SetName(num - 1, (UnicodeString) name))
+         retval = SGDISK_ERR_INTERNAL;
+      return retval;
+   });
+} // sgdisk_set_name()
+
+int sgdisk_set_unique_guid(sgdisk_handle* handle, uint32_t num, const char* guid) {
+   return Run(handle, 1, [&](GPTData & data) {
+      GUIDData theGUID;
+      int retval = CheckPart(data, num);
+
+      if (guid == NULL)
+         theGUID.Randomize();
+      else if (!ParseGUID(guid, theGUID))
+         return SGDISK_ERR_INVALID;
+      if ((retval == SGDISK_OK) && !data.SetPartitionGUID(num - 1, theGUID))
+         retval = SGDISK_ERR_IN_USE; // by another partition
+      return retval;
+   });
+} // sgdisk_set_unique_guid()
+
+int sgdisk_set_attributes(sgdisk_handle* handle, uint32_t num, uint64_t attributes) {
+   return Run(handle, 1, [&](GPTData & data) {
+      int retval = CheckPart(data, num);
+
+      if ((retval == SGDISK_OK) && !data.SetAttributes(num - 1, attributes))
+         retval = SGDISK_ERR_INTERNAL;
+      return retval;
+   });
+} // sgdisk_set_attributes()
+
+int sgdisk_set_disk_guid(sgdisk_handle* handle, const char* guid) {
+   return Run(handle, 1, [&](GPTData & data) {
+      GUIDData theGUID;
+
+      if (guid == NULL)
+         theGUID.Randomize();
+      else if (!ParseGUID(guid, theGUID))
+         return SGDISK_ERR_INVALID;
+      data.SetDiskGUID(theGUID);
+      return SGDISK_OK;
+   });
+} // sgdisk_set_disk_guid()
+
+int sgdisk_commit(sgdisk_handle* handle) {
+   return Run(handle, 1, [&](GPTData & data) {
+      VerifyReport report;
+
+      if (!handle->writable)
+         return SGDISK_ERR_READ_ONLY;
+      data.Verify(report);
+      if (report.NumProblems() > 0)
+         return SGDISK_ERR_VERIFY;
+      if (!data.SaveGPTData(1))
+         return SGDISK_ERR_WRITE;
+      data.ClearJournal();
+      data.BeginTransaction();
+      return SGDISK_OK;
+   });
+} // sgdisk_commit()
+
+int sgdisk_revert(sgdisk_handle* handle) {
+   return Run(handle, 1, [&](GPTData & data) {
+      data.RollbackTransaction();
+      data.BeginTransaction();
+      return SGDISK_OK;
+   });
+} // sgdisk_revert()
+
+const char* sgdisk_get_messages(sgdisk_handle* handle) {
+   return (handle != NULL) ? handle->messages.c_str() : "";
+} // sgdisk_get_messages()
+
+void sgdisk_close(sgdisk_handle* handle) {
+   delete handle;
+} // sgdisk_close()
+
+const char* sgdisk_strerror(int error) {
+   static const char* descriptions[] = {
+      "success", "invalid argument", "out of memory", "unable to open device",
+      "unable to read device", "unusable partition data", "no partition table loaded",
+      "device opened read-only", "partition number out of range", "partition not defined",
+      "already in use", "no room for partition", "buffer too small",
+      "partition table has problems", "unable to write partition table", "internal error"};
+
+   if ((error < 0) || (error >= (int) (sizeof(descriptions) / sizeof(descriptions[0]))))
+      return "unknown error";
+   return descriptions[error];
+} // sgdisk_strerror()
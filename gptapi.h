@@ -0,0 +1,180 @@
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+/* C interface to GPT fdisk's partition-table code, for programs (such as
+ * long-running services) that link with libsgdisk rather than running
+ * sgdisk. A disk is worked on through an opaque handle:
+ *
+ *    sgdisk_open()    get a handle for a device (or disk image file)
+ *    sgdisk_load()    read its partition table (or sgdisk_new_table() to
+ *                     start a fresh, empty one)
+ *    sgdisk_get_*()   query the disk and its partitions
+ *    sgdisk_create_partition(), sgdisk_set_*(), ...
+ *                     change the partition table in memory
+ *    sgdisk_commit()  check the table and write it to the disk (or
+ *                     sgdisk_revert() to drop the changes)
+ *    sgdisk_close()   free the handle
+ *
+ * Every function returns SGDISK_OK (0) or one of the SGDISK_ERR_* codes
+ * below; results go into structures and arrays that the caller owns. The
+ * functions never end the program and never read from or write to the
+ * standard streams. Warnings and other messages that GPT fdisk would
+ * print are kept with the handle instead, for sgdisk_get_messages().
+ *
+ * Partitions are numbered from 1, as sgdisk numbers them. Sector values
+ * are in the disk's logical sectors. GUIDs are passed as strings in the
+ * usual 8-4-4-4-12 hex form (such as
+ * "0FC63DAF-8483-4772-8E79-3D69D8477DE4"); partition types may also be
+ * given as GPT fdisk type codes (such as "8300"). Names are UTF-8.
+ *
+ * Handles may be used from any thread, and different handles may be used
+ * by different threads at once, but one handle mustn't be used by two
+ * threads at once. */
+
+#ifndef __GPT_API
+#define __GPT_API
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Return values */
+#define SGDISK_OK 0
+#define SGDISK_ERR_INVALID 1     /* a bad argument (NULL pointer, malformed GUID, ...) */
+#define SGDISK_ERR_NO_MEMORY 2   /* memory ran out */
+#define SGDISK_ERR_OPEN 3        /* the device couldn't be opened */
+#define SGDISK_ERR_IO 4          /* the device couldn't be read */
+#define SGDISK_ERR_BAD_TABLE 5   /* the partition data is unusable (such as a GPT
+                                    alongside a conflicting MBR) */
+#define SGDISK_ERR_NOT_LOADED 6  /* neither sgdisk_load() nor sgdisk_new_table() has
+                                    been called */
+#define SGDISK_ERR_READ_ONLY 7   /* the handle wasn't opened for writing */
+#define SGDISK_ERR_RANGE 8       /* no such partition number */
+#define SGDISK_ERR_UNUSED 9      /* the partition isn't defined */
+#define SGDISK_ERR_IN_USE 10     /* the partition number, or unique GUID, is taken */
+#define SGDISK_ERR_NO_SPACE 11   /* the sectors asked for aren't free */
+#define SGDISK_ERR_TOO_SMALL 12  /* the caller's array is too small */
+#define SGDISK_ERR_VERIFY 13     /* the table has problems, so it wasn't written */
+#define SGDISK_ERR_WRITE 14      /* writing the table failed */
+#define SGDISK_ERR_INTERNAL 15   /* something unexpected went wrong */
+
+/* Flags for sgdisk_open() */
+#define SGDISK_OPEN_READ_ONLY 0
+#define SGDISK_OPEN_WRITE 1      /* allow sgdisk_commit() */
+
+/* Where the partition data in memory came from (sgdisk_disk_info.source) */
+#define SGDISK_SOURCE_GPT 0      /* the disk's GPT */
+#define SGDISK_SOURCE_MBR 1      /* converted from the disk's MBR partitions */
+#define SGDISK_SOURCE_BSD 2      /* converted from the disk's BSD disklabel */
+#define SGDISK_SOURCE_NEW 3      /* a new, empty table */
+
+/* Room for a GUID string and its NUL */
+#define SGDISK_GUID_SIZE 37
+
+/* Room for any partition name, as UTF-8, and its NUL */
+#define SGDISK_NAME_SIZE 109
+
+typedef struct sgdisk_handle sgdisk_handle;
+
+struct sgdisk_disk_info {
+   uint64_t sectors;          /* disk size */
+   uint32_t sector_size;      /* logical sector size, in bytes */
+   uint32_t alignment;        /* partition starts are aligned to this many sectors */
+   uint64_t first_usable;     /* first and last sectors partitions may use */
+   uint64_t last_usable;
+   uint32_t num_entries;      /* partition table entries */
+   uint32_t num_used;         /* entries holding partitions */
+   int source;                /* SGDISK_SOURCE_* */
+   char disk_guid[SGDISK_GUID_SIZE];
+};
+
+struct sgdisk_part_info {
+   uint32_t num;              /* partition number, from 1 */
+   uint64_t first_lba;
+   uint64_t last_lba;
+   uint64_t attributes;
+   char type_guid[SGDISK_GUID_SIZE];
+   char unique_guid[SGDISK_GUID_SIZE];
+   char name[SGDISK_NAME_SIZE];
+};
+
+/* Open device; flags is SGDISK_OPEN_READ_ONLY or SGDISK_OPEN_WRITE. On
+ * success, *handle is set to a new handle, to be freed by sgdisk_close(). */
+int sgdisk_open(const char* device, int flags, sgdisk_handle** handle);
+
+/* Read the disk's partition table. A disk with MBR partitions or a BSD
+ * disklabel but no GPT gets a GPT converted from them, and one with
+ * neither gets a new, empty GPT, as gdisk would; the source field of
+ * sgdisk_disk_info tells which. */
+int sgdisk_load(sgdisk_handle* handle);
+
+/* Replace whatever's in memory with a new, empty GPT with num_entries
+ * entries (0 for the usual 128) and a protective MBR. */
+int sgdisk_new_table(sgdisk_handle* handle, uint32_t num_entries);
+
+int sgdisk_get_info(sgdisk_handle* handle, struct sgdisk_disk_info* info);
+
+/* Fill in parts (room for max_parts) with the defined partitions, in
+ * partition-number order, and set *num_parts to how many there are. If
+ * there are more than max_parts, the first max_parts are filled in and
+ * SGDISK_ERR_TOO_SMALL is returned; parts may be NULL when max_parts is 0,
+ * to find out how many there are. */
+int sgdisk_get_partitions(sgdisk_handle* handle, struct sgdisk_part_info* parts,
+                          size_t max_parts, size_t* num_parts);
+
+int sgdisk_get_partition(sgdisk_handle* handle, uint32_t num, struct sgdisk_part_info* part);
+
+/* Set *num to the number of the partition with the given name (or unique
+ * GUID), or return SGDISK_ERR_UNUSED if there's none. */
+int sgdisk_lookup_name(sgdisk_handle* handle, const char* name, uint32_t* num);
+int sgdisk_lookup_guid(sgdisk_handle* handle, const char* guid, uint32_t* num);
+
+/* Create partition num (or, if num is 0, the first unused one) from first
+ * to last. A first of 0 stands for the start of the free space chosen by
+ * the placement policy, and a last of 0 for the end of the free space that
+ * holds first. The start may be moved up to meet the disk's alignment; use
+ * sgdisk_get_partition() to see where the partition ended up. If created
+ * isn't NULL, it's set to the new partition's number. The partition gets
+ * the default type and a random unique GUID. */
+int sgdisk_create_partition(sgdisk_handle* handle, uint32_t num, uint64_t first,
+                            uint64_t last, uint32_t* created);
+int sgdisk_delete_partition(sgdisk_handle* handle, uint32_t num);
+
+/* type is a GUID or a GPT fdisk type code */
+int sgdisk_set_type(sgdisk_handle* handle, uint32_t num, const char* type);
+int sgdisk_set_name(sgdisk_handle* handle, uint32_t num, const char* name);
+/* guid may be NULL, for a new random GUID */
+int sgdisk_set_unique_guid(sgdisk_handle* handle, uint32_t num, const char* guid);
+int sgdisk_set_attributes(sgdisk_handle* handle, uint32_t num, uint64_t attributes);
+/* guid may be NULL, for a new random GUID */
+int sgdisk_set_disk_guid(sgdisk_handle* handle, const char* guid);
+
+/* Check the partition table, as sgdisk -v does, and if no problems turn
+ * up, write it to the disk. */
+int sgdisk_commit(sgdisk_handle* handle);
+
+/* Undo all changes made to the partition table since it was loaded or
+ * made (or last committed). Changes made to a hybrid MBR aren't undone. */
+int sgdisk_revert(sgdisk_handle* handle);
+
+/* Return the messages (warnings and such, one per line) from the most
+ * recent call that was given this handle (the last 64 messages, if there
+ * were more), or "" if there were none. The string belongs to the handle
+ * and lasts until the next call with it. */
+const char* sgdisk_get_messages(sgdisk_handle* handle);
+
+/* Free handle; NULL is allowed. Changes that haven't been committed are
+ * lost. */
+void sgdisk_close(sgdisk_handle* handle);
+
+/* Return a short description of an SGDISK_* return value. */
+const char* sgdisk_strerror(int error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
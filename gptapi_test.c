@@ -0,0 +1,163 @@
+// gptapi_test.c
+// Test of the C API (gptapi.h), written in C to be sure that the header
+// works from C: it makes a partition table on a disk image through a
+// handle, writes it, reads it back through a second handle, and looks up
+// its partitions by name and by unique GUID. It also checks the errors
+// returned for a bad handle, an unloaded table, out-of-range and unused
+// partition numbers, a malformed GUID, and a write through a read-only
+// handle. "make apitest" builds it; run "./gptapi_test [image]". The image
+// (by default /tmp/gptapi_test.img) is created as a sparse file and deleted
+// when the program finishes. Exits with 0 if every check passes, 1 if not.
+
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "gptapi.h"
+
+#define TEST_DISK_SIZE (UINT64_C(32) * 1024 * 1024) /* bytes */
+#define TEST_PART_SIZE 2048 /* sectors in the first partition */
+#define TEST_TYPE "0FC63DAF-8483-4772-8E79-3D69D8477DE4" /* type code 8300 */
+#define TEST_GUID "5A0E0C12-3C83-4D0C-9C2B-7F0B5E3F8A61"
+
+static int failures = 0;
+
+// Check that a call returned what it should have, and report it if not.
+static void Expect(const char* what, int result, int expected) {
+   if (result != expected) {
+      fprintf(stderr, "%s returned %d (%s), not %d (%s)\n", what, result,
+              sgdisk_strerror(result), expected, sgdisk_strerror(expected));
+      failures++;
+   } // if
+} // Expect()
+
+// Create filename as a sparse file of TEST_DISK_SIZE bytes. Returns 1 on
+// success, 0 on failure.
+static int MakeImage(const char* filename) {
+   int fd, allOK;
+
+   fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if (fd < 0)
+      return 0;
+   allOK = (ftruncate(fd, TEST_DISK_SIZE) == 0);
+   close(fd);
+   return allOK;
+} // MakeImage()
+
+// Make a new table with two partitions on filename and commit it. The
+// first is TEST_PART_SIZE sectors at a given place; the second is placed
+// by the API and fills the rest of the disk.
+static void WriteTable(const char* filename) {
+   sgdisk_handle* handle;
+   struct sgdisk_part_info part;
+   uint32_t created = 0;
+
+   Expect("sgdisk_open(write)", sgdisk_open(filename, SGDISK_OPEN_WRITE, &handle), SGDISK_OK);
+   if (handle == NULL)
+      return;
+   Expect("sgdisk_get_partition(not loaded)", sgdisk_get_partition(handle, 1, &part),
+          SGDISK_ERR_NOT_LOADED);
+   Expect("sgdisk_new_table()", sgdisk_new_table(handle, 0), SGDISK_OK);
+   Expect("sgdisk_create_partition(1)",
+          sgdisk_create_partition(handle, 1, 2048, 2048 + TEST_PART_SIZE - 1, &created), SGDISK_OK);
+   Expect("number of partition 1", created, 1);
+   Expect("sgdisk_create_partition(0)", sgdisk_create_partition(handle, 0, 0, 0, &created),
+          SGDISK_OK);
+   Expect("number of partition 2", created, 2);
+   Expect("sgdisk_create_partition(in use)", sgdisk_create_partition(handle, 1, 0, 0, NULL),
+          SGDISK_ERR_IN_USE);
+   Expect("sgdisk_set_name(1)", sgdisk_set_name(handle, 1, "boot"), SGDISK_OK);
+   Expect("sgdisk_set_name(2)", sgdisk_set_name(handle, 2, "data"), SGDISK_OK);
+   Expect("sgdisk_set_type(2)", sgdisk_set_type(handle, 2, "8300"), SGDISK_OK);
+   Expect("sgdisk_set_unique_guid(2)", sgdisk_set_unique_guid(handle, 2, TEST_GUID), SGDISK_OK);
+
+   // Partition numbers out of range, and one that's in range but unused....
+   Expect("sgdisk_get_partition(0)", sgdisk_get_partition(handle, 0, &part), SGDISK_ERR_RANGE);
+   Expect("sgdisk_get_partition(129)", sgdisk_get_partition(handle, 129, &part), SGDISK_ERR_RANGE);
+   Expect("sgdisk_set_name(129)", sgdisk_set_name(handle, 129, "x"), SGDISK_ERR_RANGE);
+   Expect("sgdisk_delete_partition(129)", sgdisk_delete_partition(handle, 129), SGDISK_ERR_RANGE);
+   Expect("sgdisk_get_partition(3)", sgdisk_get_partition(handle, 3, &part), SGDISK_ERR_UNUSED);
+   Expect("sgdisk_set_unique_guid(bad GUID)", sgdisk_set_unique_guid(handle, 1, "not-a-guid"),
+          SGDISK_ERR_INVALID);
+
+   Expect("sgdisk_commit()", sgdisk_commit(handle), SGDISK_OK);
+   sgdisk_close(handle);
+} // WriteTable()
+
+// Read filename's table back through a read-only handle and check it.
+static void CheckTable(const char* filename) {
+   sgdisk_handle* handle;
+   struct sgdisk_disk_info info;
+   struct sgdisk_part_info part;
+   uint32_t num = 0;
+
+   Expect("sgdisk_open(read-only)", sgdisk_open(filename, SGDISK_OPEN_READ_ONLY, &handle),
+          SGDISK_OK);
+   if (handle == NULL)
+      return;
+   Expect("sgdisk_load()", sgdisk_load(handle), SGDISK_OK);
+   Expect("sgdisk_get_info()", sgdisk_get_info(handle, &info), SGDISK_OK);
+   Expect("table source", info.source, SGDISK_SOURCE_GPT);
+   Expect("partitions in use", info.num_used, 2);
+
+   Expect("sgdisk_get_partition(1)", sgdisk_get_partition(handle, 1, &part), SGDISK_OK);
+   Expect("size of partition 1", part.last_lba - part.first_lba + 1, TEST_PART_SIZE);
+   Expect("name of partition 1", strcmp(part.name, "boot"), 0);
+   Expect("sgdisk_get_partition(2)", sgdisk_get_partition(handle, 2, &part), SGDISK_OK);
+   Expect("end of partition 2", part.last_lba, info.last_usable);
+   Expect("type of partition 2", strcmp(part.type_guid, TEST_TYPE), 0);
+
+   Expect("sgdisk_lookup_name(data)", sgdisk_lookup_name(handle, "data", &num), SGDISK_OK);
+   Expect("number of \"data\"", num, 2);
+   Expect("sgdisk_lookup_name(boot)", sgdisk_lookup_name(handle, "boot", &num), SGDISK_OK);
+   Expect("number of \"boot\"", num, 1);
+   Expect("sgdisk_lookup_guid()", sgdisk_lookup_guid(handle, TEST_GUID, &num), SGDISK_OK);
+   Expect("number of " TEST_GUID, num, 2);
+   Expect("sgdisk_lookup_name(missing)", sgdisk_lookup_name(handle, "missing", &num),
+          SGDISK_ERR_UNUSED);
+   Expect("sgdisk_lookup_guid(bad GUID)", sgdisk_lookup_guid(handle, "not-a-guid", &num),
+          SGDISK_ERR_INVALID);
+
+   Expect("sgdisk_delete_partition(1)", sgdisk_delete_partition(handle, 1), SGDISK_OK);
+   Expect("sgdisk_commit(read-only)", sgdisk_commit(handle), SGDISK_ERR_READ_ONLY);
+   sgdisk_close(handle);
+} // CheckTable()
+
+// Calls given a NULL handle must fail cleanly.
+static void CheckBadHandle(void) {
+   struct sgdisk_disk_info info;
+   struct sgdisk_part_info part;
+   uint32_t num;
+
+   Expect("sgdisk_load(NULL)", sgdisk_load(NULL), SGDISK_ERR_INVALID);
+   Expect("sgdisk_get_info(NULL)", sgdisk_get_info(NULL, &info), SGDISK_ERR_INVALID);
+   Expect("sgdisk_get_partition(NULL)", sgdisk_get_partition(NULL, 1, &part), SGDISK_ERR_INVALID);
+   Expect("sgdisk_lookup_name(NULL)", sgdisk_lookup_name(NULL, "data", &num), SGDISK_ERR_INVALID);
+   Expect("sgdisk_commit(NULL)", sgdisk_commit(NULL), SGDISK_ERR_INVALID);
+   Expect("sgdisk_open(no device)", sgdisk_open(NULL, SGDISK_OPEN_READ_ONLY, NULL),
+          SGDISK_ERR_INVALID);
+   Expect("sgdisk_get_messages(NULL)", strcmp(sgdisk_get_messages(NULL), ""), 0);
+   sgdisk_close(NULL);
+} // CheckBadHandle()
+
+int main(int argc, char* argv[]) {
+   const char* filename = "/tmp/gptapi_test.img";
+
+   if (argc > 1)
+      filename = argv[1];
+   if (!MakeImage(filename)) {
+      fprintf(stderr, "Unable to create %s!\n", filename);
+      return 1;
+   } // if
+   CheckBadHandle();
+   WriteTable(filename);
+   CheckTable(filename);
+   unlink(filename);
+   if (failures == 0)
+      printf("All C API checks passed\n");
+   return failures > 0;
+} // main()
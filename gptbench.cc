@@ -0,0 +1,263 @@
+// gptbench.cc
+// Timing harness for bulk operations on a large (16384-entry) partition
+// table: loading it from disk (with GPTData and, as sgdisk --android-dump
+// does, with a PartitionProbe, each both from the page cache and, where
+// the cache can be dropped, cold), sorting it, copying and moving it,
+// re-verifying it after a one-partition change, listing it, and fanning it
+// out to many images (as "sgdisk -R" does to many disks). Not built by
+// default; use "make bench" and run "./gptbench [image-file]".
+// The image file (default /tmp/gptbench.img) is created as a sparse file;
+// it and the fan-out images (the same name with ".0" to ".99" appended)
+// are deleted when the program finishes.
+
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "gpt.h"
+#include "probe.h"
+
+using namespace std;
+
+#define BENCH_ENTRIES 16384
+#define BENCH_USED 4096 /* partitions actually defined in the table */
+#define BENCH_PART_SIZE 2048 /* sectors per partition */
+#define BENCH_DISK_SIZE (UINT64_C(16) * 1024 * 1024 * 1024) /* bytes */
+#define BENCH_LOOPS 50
+#define BENCH_COLD_LOOPS 10 /* loads after dropping the image from the cache */
+#define BENCH_FANOUT 100 /* fan-out images */
+
+typedef chrono::steady_clock BenchClock;
+
+// Report the average time per iteration, given the total time.
+static void Report(const char* what, double usecs, int loops) {
+   cout << what << ": " << (uint64_t) (usecs / loops) << " us per iteration ("
+        << loops << " iterations)\n";
+} // Report()
+
+// Report the average time per iteration since start.
+// Returns the microseconds since start.
+static double Elapsed(BenchClock::time_point start) {
+   return chrono::duration<double, micro>(BenchClock::now() - start).count();
+} // Elapsed()
+
+// Report the average time per iteration since start.
+static void Report(const char* what, BenchClock::time_point start, int loops) {
+   Report(what, Elapsed(start), loops);
+} // Report()
+
+// Drop filename's data from the page cache, so that the next read of it
+// goes to the disk. Returns 1 on success, 0 if that can't be done here.
+static int DropCache(const string & filename) {
+#ifdef POSIX_FADV_DONTNEED
+   int fd, retval;
+
+   fd = open(filename.c_str(), O_RDONLY);
+   if (fd < 0)
+      return 0;
+   retval = (posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0);
+   close(fd);
+   return retval;
+#else
+   return 0;
+#endif
+} // DropCache()
+
+// Read the partition tables as sgdisk_read() does, with a PartitionProbe,
+// fetching every partition. Returns the number of partitions in use.
+static uint32_t Probe(const string & filename) {
+   PartitionProbe probe;
+   GPTPart part;
+   uint32_t i, numUsed = 0;
+
+   if (probe.Open(filename) && (probe.ProbeMBR() == gpt) &&
+       (probe.ProbeGPT() == probe_gpt_main)) {
+      for (i = 0; i < probe.GetNumParts(); i++) {
+         probe.GetPartition(i, part);
+         if (part.GetFirstLBA() > 0)
+            numUsed++;
+      } // for
+   } // if
+   return numUsed;
+} // Probe()
+
+// Create a sparse disk image holding a BENCH_ENTRIES-entry GPT with
+// BENCH_USED partitions defined. Returns 1 on success, 0 on failure.
+static int MakeImage(const string & filename) {
+   GPTData gpt;
+   uint64_t start;
+   uint32_t i;
+   int fd;
+
+   fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if ((fd < 0) || (ftruncate(fd, BENCH_DISK_SIZE) != 0)) {
+      cerr << "Unable to create " << filename << "!\n";
+      return 0;
+   } // if
+   close(fd);
+   gpt.JustLooking(0);
+   if (!gpt.SetDisk(filename) || !gpt.ClearGPTData() || !gpt.SetGPTSize(BENCH_ENTRIES))
+      return 0;
+   gpt.MakeProtectiveMBR();
+   start = gpt.GetFirstUsableLBA();
+   gpt.Align(&start);
+   for (i = 0; i < BENCH_USED; i++) {
+      if (!gpt.CreatePartition(i, start, start + BENCH_PART_SIZE - 1))
+         return 0;
+      gpt.SetName(i, "bench");
+      start += BENCH_PART_SIZE;
+   } // for
+   return gpt.SaveGPTData(1);
+} // MakeImage()
+
+int main(int argc, char* argv[]) {
+   string filename = "/tmp/gptbench.img";
+   BenchClock::time_point start;
+   GPTData gpt, copy;
+   vector<GPTData> targets;
+   string targetName;
+   ostringstream listed;
+   streambuf* listing;
+   uint32_t i, j, seed = 1;
+   int loop, allOK = 1;
+   double loadTime = 0.0, probeTime = 0.0;
+
+   if (argc > 1)
+      filename = argv[1];
+   if (!MakeImage(filename)) {
+      unlink(filename.c_str());
+      return 1;
+   } // if
+
+   start = BenchClock::now();
+   for (loop = 0; loop < BENCH_LOOPS; loop++) {
+      GPTData loaded;
+
+      loaded.JustLooking();
+      loaded.BeQuiet();
+      loaded.LoadPartitions(filename);
+   } // for
+   Report("load", start, BENCH_LOOPS);
+
+   start = BenchClock::now();
+   for (loop = 0; loop < BENCH_LOOPS; loop++) {
+      if (Probe(filename) != BENCH_USED)
+         allOK = 0;
+   } // for
+   Report("probe", start, BENCH_LOOPS);
+
+   // The same again, but with the image dropped from the page cache before
+   // each load, as for the first look at a disk after it's attached....
+   if (DropCache(filename)) {
+      for (loop = 0; loop < BENCH_COLD_LOOPS; loop++) {
+         GPTData loaded;
+
+         DropCache(filename);
+         start = BenchClock::now();
+         loaded.JustLooking();
+         loaded.BeQuiet();
+         loaded.LoadPartitions(filename);
+         loadTime += Elapsed(start);
+         DropCache(filename);
+         start = BenchClock::now();
+         Probe(filename);
+         probeTime += Elapsed(start);
+      } // for
+      Report("cold load", loadTime, BENCH_COLD_LOOPS);
+      Report("cold probe", probeTime, BENCH_COLD_LOOPS);
+   } // if
+
+   gpt.JustLooking();
+   gpt.BeQuiet();
+   gpt.LoadPartitions(filename);
+   start = BenchClock::now();
+   for (loop = 0; loop < BENCH_LOOPS; loop++) {
+      copy = gpt;
+      // Shuffle the table (a cheap linear congruential generator will do)
+      // so that each sort has real work to do....
+      for (i = BENCH_ENTRIES - 1; i > 0; i--) {
+         seed = seed * 1103515245 + 12345;
+         j = (seed >> 8) % (i + 1);
+         copy.SwapPartitions(i, j);
+      } // for
+      copy.SortGPT();
+   } // for
+   Report("shuffle + sort", start, BENCH_LOOPS);
+
+   start = BenchClock::now();
+   for (loop = 0; loop < BENCH_LOOPS; loop++)
+      copy = gpt;
+   Report("copy", start, BENCH_LOOPS);
+
+   start = BenchClock::now();
+   for (loop = 0; loop < BENCH_LOOPS; loop++) {
+      GPTData moved(move(copy));
+
+      copy = move(moved);
+   } // for
+   Report("move", start, BENCH_LOOPS);
+
+   // Verify once to build the verification cache, then time re-verifying
+   // after deleting and re-creating one partition....
+   cout.setstate(ios::failbit); // Verify() reports on the table
+   start = BenchClock::now();
+   copy.Verify();
+   cout.clear();
+   Report("verify", start, 1);
+   cout.setstate(ios::failbit);
+   start = BenchClock::now();
+   for (loop = 0; loop < BENCH_LOOPS; loop++) {
+      uint64_t first = copy[loop].GetFirstLBA(), last = copy[loop].GetLastLBA();
+
+      copy.DeletePartition(loop);
+      copy.CreatePartition(loop, first, last);
+      copy.Verify();
+   } // for
+   cout.clear();
+   Report("edit + re-verify", start, BENCH_LOOPS);
+
+   // List the table, as "sgdisk -p" does, into a string rather than the
+   // terminal....
+   listing = cout.rdbuf(listed.rdbuf());
+   start = BenchClock::now();
+   for (loop = 0; loop < BENCH_LOOPS; loop++) {
+      listed.str("");
+      copy.DisplayGPTData();
+   } // for
+   cout.rdbuf(listing);
+   Report("list", start, BENCH_LOOPS);
+
+   // Fan the table out to BENCH_FANOUT images: first make all the copies
+   // (which share one partition array until one is modified), then write
+   // each one out. The images are written as backup files, since
+   // SaveGPTData() pauses for a second per disk on Linux to let the kernel
+   // catch up, which would swamp everything else....
+   targets.reserve(BENCH_FANOUT);
+   start = BenchClock::now();
+   for (i = 0; i < BENCH_FANOUT; i++)
+      targets.push_back(gpt);
+   Report("fan-out copy", start, BENCH_FANOUT);
+
+   cout.setstate(ios::failbit); // SaveGPTBackup() is chatty
+   start = BenchClock::now();
+   for (i = 0; i < BENCH_FANOUT; i++) {
+      targets[i].JustLooking(0);
+      if (!targets[i].SaveGPTBackup(filename + "." + to_string(i)))
+         allOK = 0;
+   } // for
+   cout.clear();
+   Report("fan-out write", start, BENCH_FANOUT);
+   for (i = 0; i < BENCH_FANOUT; i++)
+      unlink((filename + "." + to_string(i)).c_str());
+
+   unlink(filename.c_str());
+   return !allOK;
+} // main()
@@ -18,25 +18,37 @@
     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
+#include <stdlib.h>
 #include <string.h>
 #include <string>
 #include <iostream>
 #include <sstream>
 #include <errno.h>
+#include <unistd.h>
 #include "gptcl.h"
+#include "layout.h"
+#include "service.h"
 
-GPTDataCL::GPTDataCL(void) {
+GPTDataCL::GPTDataCL(void) : jsonDiagSink(diag_info, 1) {
    attributeOperation = backupFile = partName = hybrids = newPartInfo = NULL;
    mbrParts = twoParts = outDevice = typeCode = partGUID = diskGUID = NULL;
+   placementName = layoutFile = formatName = devicePatterns = deviceList = NULL;
+   replicaGUIDs = serveSocket = scriptName = NULL;
+   optionTable = NULL;
+   lineCon = NULL;
+   numLineOptions = failedBeforeScript = 0;
    alignment = DEFAULT_ALIGNMENT;
    deletePartNum = infoPartNum = largestPartNum = bsdPartNum = 0;
+   maxJobs = BATCH_DEFAULT_JOBS;
    tableSize = GPT_SIZE;
 } // GPTDataCL constructor
 
-GPTDataCL::GPTDataCL(string filename) {
+GPTDataCL::GPTDataCL(string filename) : jsonDiagSink(diag_info, 1) {
 } // GPTDataCL constructor with filename
 
 GPTDataCL::~GPTDataCL(void) {
+   if (&GetDiagSink() == &jsonDiagSink)
+      SetDiagSink(NULL);
 } // GPTDataCL destructor
 
 void GPTDataCL::LoadBackupFile(string backupFile, int &saveData, int &neverSaveData) {
@@ -59,11 +71,15 @@ void GPTDataCL::LoadBackupFile(string backupFile, int &saveData, int &neverSaveD
 // 3 = non-GPT disk and no -g option
 // 4 = unable to save changes
 // 8 = disk replication operation (-R) failed
+// In batch mode (--devices or --device-list), returns the highest of these
+// values for the individual devices.
 int GPTDataCL::DoOptions(int argc, char* argv[]) {
-   GPTData secondDevice;
-   int opt, numOptions = 0, saveData = 0, neverSaveData = 0;
-   int partNum = 0, newPartNum = -1, saveNonGPT = 1, retval = 0, pretend = 0;
-   uint64_t low, high, startSector, endSector, sSize, mainTableLBA;
+   DeviceBatch batch;
+   int opt, numOptions = 0, saveData = 0, neverSaveData = 0, hadError, ownStep;
+   int showFragmentation = 0, asJSON = 0, inBatch = 0, randomizeReplicas = 0;
+   int scanAll = 0, jobsGiven = 0, serve = 0;
+   int partNum = 0, newPartNum = -1, saveNonGPT = 1, retval = 0, pretend = 0, created;
+   uint64_t low, high, startSector, endSector, numSectors, sSize, mainTableLBA;
    uint64_t temp; // temporary variable; free to use in any case
    char *device;
    string cmd, typeGUID, name;
@@ -98,7 +114,8 @@ int GPTDataCL::DoOptions(int argc, char* argv[]) {
       {"print", 'p', POPT_ARG_NONE, NULL, 'p', "print partition table", ""},
       {"pretend", 'P', POPT_ARG_NONE, NULL, 'P', "make changes in memory, but don't write them", ""},
       {"transpose", 'r', POPT_ARG_STRING, &twoParts, 'r', "transpose two partitions", "partnum:partnum"},
-      {"replicate", 'R', POPT_ARG_STRING, &outDevice, 'R', "replicate partition table", "device_filename"},
+      {"replicate", 'R', POPT_ARG_STRING, &outDevice, 'R', "replicate partition table",
+          "device_filename[,device_filename...]"},
       {"sort", 's', POPT_ARG_NONE, NULL, 's', "sort partition table entries", ""},
       {"resize-table", 'S', POPT_ARG_INT, &tableSize, 'S', "resize partition table", "numparts"},
       {"typecode", 't', POPT_ARG_STRING, &typeCode, 't', "change partition type code", "partnum:{hexcode|GUID}"},
@@ -109,11 +126,30 @@ int GPTDataCL::DoOptions(int argc, char* argv[]) {
       {"version", 'V', POPT_ARG_NONE, NULL, 'V', "display version information", ""},
       {"zap", 'z', POPT_ARG_NONE, NULL, 'z', "zap (destroy) GPT (but not MBR) data structures", ""},
       {"zap-all", 'Z', POPT_ARG_NONE, NULL, 'Z', "zap (destroy) GPT and MBR data structures", ""},
+      {"placement", 0, POPT_ARG_STRING, &placementName, OPT_PLACEMENT, "choose where new partitions are placed",
+          "largest|first-fit|best-fit|last-fit"},
+      {"layout", 0, POPT_ARG_STRING, &layoutFile, OPT_LAYOUT, "make partitions match a layout file",
+          "filename"},
+      {"format", 0, POPT_ARG_STRING, &formatName, OPT_FORMAT, "output format for -p, -i, -O, -v, --scan-all, and --android-dump",
+          "text|json"},
+      {"devices", 0, POPT_ARG_STRING, &devicePatterns, OPT_DEVICES, "apply the options to many devices",
+          "pattern[,pattern...]"},
+      {"device-list", 0, POPT_ARG_STRING, &deviceList, OPT_DEVICE_LIST, "apply the options to the devices listed in a file",
+          "file"},
+      {"jobs", 0, POPT_ARG_INT, &maxJobs, OPT_JOBS, "work on up to this many devices at once", "number"},
+      {"replica-guids", 0, POPT_ARG_STRING, &replicaGUIDs, OPT_REPLICA_GUIDS, "GUIDs for -R copies",
+          "preserve|randomize"},
+      {"scan-all", 0, POPT_ARG_NONE, NULL, OPT_SCAN_ALL, "summarize the partition tables on all disks", ""},
+      {"serve", 0, POPT_ARG_STRING, &serveSocket, OPT_SERVE, "answer requests on a Unix domain socket",
+          "socket"},
+      {"script", 0, POPT_ARG_STRING, &scriptName, OPT_SCRIPT, "carry out the operations in a file, one per line",
+          "file|-"},
       POPT_AUTOHELP { NULL, 0, 0, NULL, 0, NULL, NULL }
    };
 
    // Create popt context...
    poptCon = poptGetContext(NULL, argc, (const char**) argv, theOptions, 0);
+   optionTable = theOptions;
 
    poptSetOtherOptionHelp(poptCon, " [OPTION...] <device>");
 
@@ -141,6 +177,55 @@ int GPTDataCL::DoOptions(int argc, char* argv[]) {
          case 'V':
             cout << "GPT fdisk (sgdisk) version " << GPTFDISK_VERSION << "\n\n";
             break;
+         case OPT_FORMAT:
+            // Needed before the second pass, since -v may precede --format
+            if ((string) formatName == "json") {
+               asJSON = 1;
+            } else if ((string) formatName == "text") {
+               asJSON = 0;
+            } else {
+               cerr << "Unknown output format '" << formatName << "'!\n";
+               neverSaveData = 1;
+            } // if/else
+            free(formatName);
+            break;
+         case OPT_DEVICES:
+            batch.AddDevices(devicePatterns);
+            inBatch = 1;
+            free(devicePatterns);
+            break;
+         case OPT_DEVICE_LIST:
+            if (!batch.AddDeviceList(deviceList))
+               neverSaveData = 1;
+            inBatch = 1;
+            free(deviceList);
+            break;
+         case OPT_REPLICA_GUIDS:
+            // Needed before the second pass, since -R may precede it
+            if ((string) replicaGUIDs == "randomize") {
+               randomizeReplicas = 1;
+            } else if ((string) replicaGUIDs == "preserve") {
+               randomizeReplicas = 0;
+            } else {
+               cerr << "Unknown replica GUID policy '" << replicaGUIDs << "'!\n";
+               randomizeReplicas = -1;
+               neverSaveData = 1;
+            } // if/else
+            free(replicaGUIDs);
+            break;
+         case OPT_JOBS:
+            jobsGiven = 1;
+            break;
+         case OPT_SCAN_ALL:
+            scanAll = 1;
+            break;
+         case OPT_SERVE:
+            serve = 1;
+            break;
+         case OPT_SCRIPT:
+            scriptFile = scriptName;
+            free(scriptName);
+            break;
          default:
             break;
       } // switch
@@ -151,16 +236,73 @@ int GPTDataCL::DoOptions(int argc, char* argv[]) {
    device = (char*) poptGetArg(poptCon);
    poptResetContext(poptCon);
 
+   // --scan-all looks at every disk, so it's done instead of the usual
+   // work on one device....
+   if (scanAll) {
+      poptFreeContext(poptCon);
+      return ScanAllDevices(asJSON, jobsGiven ? maxJobs : 0);
+   } // if
+
+   // So is --serve, which carries on until it's told to stop....
+   if (serve) {
+      GPTService service;
+
+      poptFreeContext(poptCon);
+      if (!service.Listen(serveSocket)) {
+         free(serveSocket);
+         return 1;
+      } // if
+      free(serveSocket);
+      return service.Run();
+   } // if
+
+   // In batch mode, a child process handles each device (including any
+   // given in the usual way) and exits when it's done; the parent reports
+   // on them all....
+   if (inBatch) {
+      if (!scriptFile.empty()) {
+         cerr << "The --script option can't be used with --devices or --device-list!\n";
+         poptFreeContext(poptCon);
+         return 1;
+      } // if
+      if (device != NULL)
+         batch.AddDevice(device);
+      if (batch.NumDevices() == 0) {
+         cerr << "No devices to work on!\n";
+         poptFreeContext(poptCon);
+         return 1;
+      } // if
+      batch.SetMaxJobs(maxJobs);
+      device = (char*) batch.Run(&retval);
+      if (device == NULL) {
+         batch.ShowReturnValues();
+         poptFreeContext(poptCon);
+         return retval;
+      } // if
+   } // if
+
+   // With --format=json, standard output holds nothing but JSON, so
+   // messages that would go there go to standard error instead....
+   if (asJSON)
+      SetDiagSink(&jsonDiagSink);
+
    if (device != NULL) {
+      if (!scriptFile.empty() && !script.Open(scriptFile))
+         neverSaveData = 1;
       JustLooking(); // reset as necessary
       BeQuiet(); // Tell called functions to be less verbose & interactive
       if (LoadPartitions((string) device)) {
          if ((WhichWasUsed() == use_mbr) || (WhichWasUsed() == use_bsd))
             saveNonGPT = 0; // flag so we don't overwrite unless directed to do so
          sSize = GetBlockSize();
-         while ((opt = poptGetNextOpt(poptCon)) > 0) {
+         while ((opt = NextOption(neverSaveData)) > 0) {
+            hadError = neverSaveData;
+            // An option from a script line is part of the line's
+            // transaction, which NextOption() opened....
+            ownStep = BeginTransaction();
             switch (opt) {
                case 'A': {
+                  cmd = GetString(attributeOperation, 1);
                   if (cmd != "list") {
                      partNum = (int) GetInt(attributeOperation, 1) - 1;
                      if (partNum < 0)
@@ -260,7 +402,10 @@ int GPTDataCL::DoOptions(int argc, char* argv[]) {
                      saveData = 1;
                   break;
                case 'i':
-                  ShowPartDetails(infoPartNum - 1);
+                  if (asJSON)
+                     ShowPartJSON(infoPartNum - 1, cout);
+                  else
+                     ShowPartDetails(infoPartNum - 1);
                   break;
                case 'j':
                    if (MoveMainTable(mainTableLBA)) {
@@ -295,16 +440,31 @@ int GPTDataCL::DoOptions(int argc, char* argv[]) {
                   newPartNum = (int) GetInt(newPartInfo, 1) - 1;
                   if (newPartNum < 0)
                      newPartNum = FindFirstFreePart();
-                  low = FindFirstInLargest();
-                  Align(&low);
-                  high = FindLastInFree(low);
-                  startSector = IeeeToInt(GetString(newPartInfo, 2), sSize, low, high, low);
-                  endSector = IeeeToInt(GetString(newPartInfo, 3), sSize, startSector, high, high);
-                  if (CreatePartition(newPartNum, startSector, endSector)) {
+                  // A default start with a default or "+size" end leaves
+                  // the placement to CreatePartition(); otherwise, the
+                  // start and end are worked out relative to the free
+                  // extent the placement policy picks....
+                  numSectors = GetSizeFromEnd(GetString(newPartInfo, 3), sSize);
+                  if (IsDefaultSpec(GetString(newPartInfo, 2)) &&
+                      (numSectors || IsDefaultSpec(GetString(newPartInfo, 3)))) {
+                     created = CreatePartition(newPartNum, numSectors);
+                     startSector = endSector = 0;
+                  } else {
+                     low = FindPlacement(numSectors);
+                     high = FindLastInFree(low);
+                     startSector = IeeeToInt(GetString(newPartInfo, 2), sSize, low, high, low);
+                     endSector = IeeeToInt(GetString(newPartInfo, 3), sSize, startSector, high, high);
+                     created = CreatePartition(newPartNum, startSector, endSector);
+                  } // if/else
+                  if (created) {
                      saveData = 1;
+                     if (showFragmentation)
+                        ShowFragmentation();
                   } else {
-                     cerr << "Could not create partition " << newPartNum + 1 << " from "
-                          << startSector << " to " << endSector << "\n";
+                     cerr << "Could not create partition " << newPartNum + 1;
+                     if (startSector != 0)
+                        cerr << " from " << startSector << " to " << endSector;
+                     cerr << "\n";
                      neverSaveData = 1;
                   } // if/else
                   free(newPartInfo);
@@ -330,10 +490,16 @@ int GPTDataCL::DoOptions(int argc, char* argv[]) {
                   saveData = 1;
                   break;
                case 'O':
-                   DisplayMBRData();
-                   break;
+                  if (asJSON)
+                     ShowMBRJSON(cout);
+                  else
+                     DisplayMBRData();
+                  break;
                case 'p':
-                  DisplayGPTData();
+                  if (asJSON)
+                     ShowJSON(cout);
+                  else
+                     DisplayGPTData();
                   break;
                case 'P':
                   pretend = 1;
@@ -349,10 +515,7 @@ int GPTDataCL::DoOptions(int argc, char* argv[]) {
                   } else saveData = 1;
                                                       break;
                case 'R':
-                  secondDevice = *this;
-                  secondDevice.SetDisk(outDevice);
-                  secondDevice.JustLooking(0);
-                  if (!secondDevice.SaveGPTData(1))
+                  if ((randomizeReplicas < 0) || !Replicate(outDevice, randomizeReplicas))
                      retval = 8;
                   break;
                case 's':
@@ -402,7 +565,8 @@ int GPTDataCL::DoOptions(int argc, char* argv[]) {
                   if (partNum < 0)
                      partNum = newPartNum;
                   if ((partNum >= 0) && (partNum < (int) GetNumParts())) {
-                     SetPartitionGUID(partNum, GetString(partGUID, 2).c_str());
+                     if (!SetPartitionGUID(partNum, GetString(partGUID, 2).c_str()))
+                        neverSaveData = 1;
                   }
                   break;
                case 'U':
@@ -411,7 +575,7 @@ int GPTDataCL::DoOptions(int argc, char* argv[]) {
                   SetDiskGUID(diskGUID);
                   break;
                case 'v':
-                  Verify();
+                  ShowVerification(asJSON);
                   break;
                case 'z':
                   if (!pretend) {
@@ -428,12 +592,77 @@ int GPTDataCL::DoOptions(int argc, char* argv[]) {
                   saveNonGPT = 1;
                   saveData = 0;
                   break;
+               case OPT_PLACEMENT:
+                  if (StringToPlacement(placementName, &placement)) {
+                     showFragmentation = 1;
+                  } else {
+                     cerr << "Unknown placement policy '" << placementName << "'!\n";
+                     neverSaveData = 1;
+                  } // if/else
+                  free(placementName);
+                  break;
+               case OPT_LAYOUT:
+                  switch (ConvergeOnLayout(layoutFile)) {
+                     case -1:
+                        neverSaveData = 1;
+                        break;
+                     case 1:
+                        JustLooking(0);
+                        saveData = 1;
+                        break;
+                     default:
+                        break;
+                  } // switch
+                  free(layoutFile);
+                  break;
+               case OPT_FORMAT:
+                  free(formatName);
+                  break;
+               case OPT_DEVICES:
+                  free(devicePatterns);
+                  break;
+               case OPT_DEVICE_LIST:
+                  free(deviceList);
+                  break;
+               case OPT_JOBS:
+                  break;
+               case OPT_REPLICA_GUIDS:
+                  free(replicaGUIDs);
+                  break;
+               case OPT_SCRIPT:
+                  free(scriptName);
+                  break;
                default:
                   cerr << "Unknown option (-" << opt << ")!\n";
                   break;
                } // switch
+            // Changes won't be saved after an error, but back out whatever
+            // a failed option did, so that later options (such as -p or -R)
+            // see the partition table as it was before it....
+            if (ownStep) {
+               if (neverSaveData && !hadError)
+                  RollbackTransaction();
+               else
+                  CommitTransaction();
+            } // if
          } // while
+         // A script's changes are saved only if every line of it worked
+         // and it ended with "commit"....
+         if (script.IsOpen()) {
+            if ((script.NumFailed() > 0) || failedBeforeScript) {
+               neverSaveData = 1;
+            } else if (script.GetEnding() == script_abort) {
+               cout << "Script aborted; not saving changes.\n";
+               saveData = 0;
+            } else if (script.GetEnding() != script_commit) {
+               cerr << "Script ended without \"commit\"; not saving changes.\n";
+               saveData = 0;
+               retval = 4;
+            } // if/else if
+         } // if
       } else { // if loaded OK
+         if (script.IsOpen())
+            cerr << "Not running the script, since the partition table couldn't be read.\n";
          poptResetContext(poptCon);
          // Do a few types of operations even if there are problems....
          while ((opt = poptGetNextOpt(poptCon)) > 0) {
@@ -452,8 +681,9 @@ int GPTDataCL::DoOptions(int argc, char* argv[]) {
                   retval = 0;
                   break;
                case 'v':
-                  cout << "Verification may miss some problems or report too many!\n";
-                  Verify();
+                  if (!asJSON)
+                     cout << "Verification may miss some problems or report too many!\n";
+                  ShowVerification(asJSON);
                   break;
                case 'z':
                   if (!pretend) {
@@ -488,6 +718,15 @@ int GPTDataCL::DoOptions(int argc, char* argv[]) {
       } // if
    } // if (device != NULL)
    poptFreeContext(poptCon);
+   if (inBatch) {
+      // A batch child; don't go back to the caller, which would carry on
+      // as if it were the parent....
+      cout.flush();
+      cerr.flush();
+      fflush(stdout);
+      fflush(stderr);
+      _exit(retval);
+   } // if
    return retval;
 } // GPTDataCL::DoOptions()
 
@@ -542,7 +781,7 @@ int GPTDataCL::BuildMBR(char* argument, int isHybrid) {
             newMBR.AddPart(mbrNum, newPart);
          } // if
          if (allOK)
-            SetProtectiveMBR(newMBR);
+            SetProtectiveMBR(move(newMBR));
       } else allOK = 0;
    } else allOK = 0;
    if (!allOK)
@@ -550,6 +789,127 @@ int GPTDataCL::BuildMBR(char* argument, int isHybrid) {
    return allOK;
 } // GPTDataCL::BuildMBR()
 
+// Make the partition table match the layout in the specified file (see
+// layout.cc), with as few changes as possible. Returns 1 if the partition
+// table was changed, 0 if it already matched the layout, or -1 if the
+// layout couldn't be read or applied.
+int GPTDataCL::ConvergeOnLayout(const string & filename) {
+   GPTLayout layout;
+
+   if (!layout.ReadSpec(filename) || !layout.MakePlan(*this))
+      return -1;
+   layout.ShowPlan(*this);
+   if (!layout.PlanChangesDisk()) {
+      cout << "The disk already matches the layout; nothing to do.\n";
+      return 0;
+   } // if
+   return layout.ApplyPlan(*this) ? 1 : -1;
+} // GPTDataCL::ConvergeOnLayout()
+
+// Report how fragmented the free space is, as left by a partition placed
+// according to a --placement policy. Fragmentation is the share of the free
+// space that lies outside the largest free extent.
+void GPTDataCL::ShowFragmentation(void) {
+   uint64_t total, largest, tenths = 0;
+   uint32_t numExtents;
+
+   total = FreeExtentSummary(&numExtents, &largest);
+   if (total > 0)
+      tenths = ((total - largest) * 1000) / total;
+   cout << "Free space left: " << total << " sectors (" << BytesToIeee(total, GetBlockSize())
+        << ") in " << numExtents << " extent" << ((numExtents == 1) ? "" : "s")
+        << "; largest is " << largest << " sectors (" << BytesToIeee(largest, GetBlockSize())
+        << "); fragmentation " << tenths / 10 << "." << tenths % 10 << "%\n";
+} // GPTDataCL::ShowFragmentation()
+
+// Verify the partition table (-v), showing the results as the traditional
+// text or (for --format=json) as JSON.
+void GPTDataCL::ShowVerification(int asJSON) {
+   VerifyReport report;
+
+   if (asJSON) {
+      Verify(report);
+      report.ShowJSON(cout);
+   } else {
+      Verify();
+   } // if/else
+} // GPTDataCL::ShowVerification()
+
+// Get the next option for DoOptions() to carry out, as poptGetNextOpt()
+// does: first from the command line and then, with --script, from each
+// line of the script in turn. Each script line runs in one transaction,
+// opened here when the line begins and closed when it ends. When an option
+// on the line fails (setting neverSaveData), the failure is charged to the
+// line, the rest of the line is skipped, and the whole line is backed out;
+// neverSaveData is then cleared, so that later lines still run and their
+// failures can be spotted, too. DoOptions() sets it again at the end if
+// any line failed. Options that only make sense on the command line are
+// refused in a script.
+int GPTDataCL::NextOption(int & neverSaveData) {
+   int opt;
+
+   // Options on the command line come first....
+   if (lineCon == NULL) {
+      opt = poptGetNextOpt(poptCon);
+      if ((opt > 0) || (opt < -1) || !script.Running())
+         return opt;
+      failedBeforeScript = neverSaveData;
+      neverSaveData = 0;
+   } else if (neverSaveData) {
+      script.Fail("");
+      neverSaveData = 0;
+   } // if/else if
+
+   // ...then those on each line of the script
+   while (1) {
+      if (lineCon == NULL) {
+         if (!script.NextLine())
+            return -1;
+         lineCon = poptGetContext(NULL, script.GetArgc(), script.GetArgv(), optionTable, 0);
+         poptResetContext(lineCon);
+         numLineOptions = 0;
+         BeginTransaction();
+      } // if
+      if (script.LineFailed())
+         opt = -1; // skip the rest of a failed line
+      else
+         opt = poptGetNextOpt(lineCon);
+      if (opt <= 0) {
+         if (!script.LineFailed()) {
+            if (opt < -1)
+               script.Fail("bad option or missing argument");
+            else if (poptGetArg(lineCon) != NULL)
+               script.Fail("unexpected argument");
+            else if (numLineOptions == 0)
+               script.Fail("no options found");
+         } // if
+         // A line is carried out whole or not at all....
+         if (script.LineFailed())
+            RollbackTransaction();
+         else
+            CommitTransaction();
+         poptFreeContext(lineCon);
+         lineCon = NULL;
+      } else if ((opt == 'L') || (opt == 'V') || (opt >= OPT_FORMAT)) {
+         // Handled in DoOptions()'s first pass, or affecting how the whole
+         // run goes, and so too late here....
+         script.Fail("this option can't be used in a script");
+         switch (opt) {
+            case OPT_FORMAT: free(formatName); break;
+            case OPT_DEVICES: free(devicePatterns); break;
+            case OPT_DEVICE_LIST: free(deviceList); break;
+            case OPT_REPLICA_GUIDS: free(replicaGUIDs); break;
+            case OPT_SERVE: free(serveSocket); break;
+            case OPT_SCRIPT: free(scriptName); break;
+            default: break;
+         } // switch
+      } else {
+         numLineOptions++;
+         return opt;
+      } // if/else if/else
+   } // while
+} // GPTDataCL::NextOption()
+
 // Returns the number of colons in argument string, ignoring the
 // first character (thus, a leading colon is ignored, as GetString()
 // does).
@@ -597,3 +957,108 @@ string GetString(string argument, int itemNum) {
 
    return retVal;
 } // GetString()
+
+// Returns the size, in sectors of sSize bytes, requested by the end-sector
+// part of a -n (--new) specification, if that's given relative to the
+// start ("+size"); or 0 if the size isn't known in advance.
+uint64_t GetSizeFromEnd(string endSpec, uint64_t sSize) {
+   uint64_t size;
+
+   while (endSpec[0] == ' ')
+      endSpec.erase(0, 1);
+   if (endSpec[0] != '+')
+      return 0;
+   size = IeeeToInt(endSpec, sSize, 1, UINT64_MAX, UINT64_MAX);
+   return (size == UINT64_MAX) ? 0 : size;
+} // GetSizeFromEnd()
+
+// Returns 1 if spec, the start- or end-sector part of a -n (--new)
+// specification, asks for the default (it's empty or 0), 0 if not.
+int IsDefaultSpec(string spec) {
+   while (spec[0] == ' ')
+      spec.erase(0, 1);
+   return spec.find_first_not_of('0') == string::npos;
+} // IsDefaultSpec()
+
+// Copy the partition table to the devices in targets (a comma-separated
+// list of devices or glob patterns, as for --devices), all at once: a
+// child process writes each copy, reads it back, and checks that it
+// matches. The copies keep this disk's GUIDs unless randomizeGUIDs is
+// non-zero, in which case each gets its own. The children share this
+// process's partition table, so when GUIDs are kept, every copy is written
+// from the same buffer. Shows each child's output and then how each copy
+// went. Returns 1 if every copy was written and checked, 0 if not.
+int GPTDataCL::Replicate(const string & targets, int randomizeGUIDs) {
+   DeviceBatch replicas;
+   GPTData copy;
+   const char* target;
+   size_t i;
+   int retval;
+
+   if (replicas.AddDevices(targets) == 0) {
+      cerr << "No devices to replicate to!\n";
+      return 0;
+   } // if
+   replicas.SetMaxJobs(maxJobs);
+   target = replicas.Run(&retval);
+   if (target != NULL) {
+      copy = *this;
+      copy.SetDisk(target);
+      copy.JustLooking(0);
+      if (randomizeGUIDs) {
+         // Every child starts with its parent's random number generator;
+         // reseed it in case GUIDData::Randomize() falls back on it....
+         GUIDData::Reseed();
+         copy.RandomizeGUIDs();
+      } // if
+      if (!copy.SaveGPTData(1))
+         retval = REPLICA_WRITE_FAILED;
+      else if (!copy.CheckWritten())
+         retval = REPLICA_CHECK_FAILED;
+      else
+         retval = 0;
+      cout.flush();
+      cerr.flush();
+      fflush(stdout);
+      fflush(stderr);
+      _exit(retval);
+   } // if
+
+   cout << "\nReplication results:\n";
+   for (i = 0; i < replicas.NumDevices(); i++) {
+      cout << "   " << replicas.GetName(i) << ": ";
+      switch (replicas.GetRetval(i)) {
+         case 0:
+            cout << "written and checked\n";
+            break;
+         case REPLICA_WRITE_FAILED:
+            cout << "write failed\n";
+            break;
+         case REPLICA_CHECK_FAILED:
+            cout << "written, but doesn't match when read back\n";
+            break;
+         default:
+            cout << "failed (" << replicas.GetRetval(i) << ")\n";
+            break;
+      } // switch
+   } // for
+   return (retval == 0);
+} // GPTDataCL::Replicate()
+
+// Summarize the partition tables on every disk on the system (--scan-all),
+// as text or (for --format=json) as JSON, probing up to maxThreads disks
+// at once (or all of them, if maxThreads is 0). Returns 0 if every disk
+// could be read, 2 if not.
+int GPTDataCL::ScanAllDevices(int asJSON, int maxThreads) {
+   DeviceScan scan;
+
+   scan.FindDevices();
+   if (maxThreads > 0)
+      scan.SetMaxThreads(maxThreads);
+   scan.Run();
+   if (asJSON)
+      scan.ShowJSON(cout);
+   else
+      scan.ShowText(cout);
+   return (scan.NumUnreadable() > 0) ? 2 : 0;
+} // GPTDataCL::ScanAllDevices()
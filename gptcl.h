@@ -23,23 +23,62 @@
 #define __GPTCL_H
 
 #include "gpt.h"
+#include "batch.h"
+#include "scan.h"
+#include "diag.h"
+#include "script.h"
 #include <popt.h>
 #include <map>
 
 using namespace std;
 
+// popt values for options that have no single-letter equivalent
+#define OPT_PLACEMENT 256
+#define OPT_LAYOUT 257
+#define OPT_FORMAT 258
+#define OPT_DEVICES 259
+#define OPT_DEVICE_LIST 260
+#define OPT_JOBS 261
+#define OPT_REPLICA_GUIDS 262
+#define OPT_SCAN_ALL 263
+#define OPT_SERVE 264
+#define OPT_SCRIPT 265
+
+// Return values of the child processes that write -R copies
+#define REPLICA_WRITE_FAILED 1
+#define REPLICA_CHECK_FAILED 2
+
 class GPTDataCL : public GPTData {
    protected:
       // Following are variables associated with popt parameters....
       char *attributeOperation, *backupFile, *partName, *hybrids;
       char *newPartInfo, *mbrParts, *twoParts, *outDevice, *typeCode;
-      char *partGUID, *diskGUID;
-      int alignment, deletePartNum, infoPartNum, largestPartNum, bsdPartNum;
+      char *partGUID, *diskGUID, *placementName, *layoutFile;
+      char *formatName, *devicePatterns, *deviceList, *replicaGUIDs, *serveSocket;
+      char *scriptName;
+      int alignment, deletePartNum, infoPartNum, largestPartNum, bsdPartNum, maxJobs;
       uint32_t tableSize;
       poptContext poptCon;
+      struct poptOption* optionTable;
+      // --script state: the script, the context for its current line (or
+      // NULL while options come from the command line) and the number of
+      // options found on it so far, and whether an option on the command
+      // line failed before the script began
+      string scriptFile;
+      CommandScript script;
+      poptContext lineCon;
+      int numLineOptions;
+      int failedBeforeScript;
+      StreamDiagSink jsonDiagSink; // keeps messages out of JSON output
       std::map<int, char> typeRaw;
 
       int BuildMBR(char* argument, int isHybrid);
+      int ConvergeOnLayout(const string & filename);
+      void ShowFragmentation(void);
+      void ShowVerification(int asJSON);
+      int Replicate(const string & targets, int randomizeGUIDs);
+      int ScanAllDevices(int asJSON, int maxThreads);
+      int NextOption(int & neverSaveData);
    public:
       GPTDataCL(void);
       GPTDataCL(string filename);
@@ -51,5 +90,7 @@ class GPTDataCL : public GPTData {
 int CountColons(char* argument);
 uint64_t GetInt(const string & argument, int itemNum);
 string GetString(string argument, int itemNum);
+uint64_t GetSizeFromEnd(string endSpec, uint64_t sSize);
+int IsDefaultSpec(string spec);
 
 #endif
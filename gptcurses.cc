@@ -222,9 +222,7 @@ void GPTDataCurses::IdentifySpaces(void) {
 Space* GPTDataCurses::ShowSpace(int spaceNum, int lineNum) {
    Space *space;
    int i = 0;
-#ifdef USE_UTF16
-   char temp[40];
-#endif
+   char temp[NAME_UTF8_SIZE];
 
    space = firstSpace;
    while ((space != NULL) && (i < spaceNum)) {
@@ -246,12 +244,8 @@ Space* GPTDataCurses::ShowSpace(int spaceNum, int lineNum) {
          move(lineNum, 24);
          printw(space->origPart->GetTypeName().c_str());
          move(lineNum, 50);
-         #ifdef USE_UTF16
-         space->origPart->GetDescription().extract(0, 39, temp, 39);
-         printw(temp);
-         #else
-         printw(space->origPart->GetDescription().c_str());
-         #endif
+         space->origPart->GetDescription(temp, sizeof(temp));
+         printw("%s", temp);
       } // if/else
    } // if
    return space;
@@ -319,9 +313,7 @@ void GPTDataCurses::DeletePartition(int partNum) {
 // Displays information on the specified partition
 void GPTDataCurses::ShowInfo(int partNum) {
    uint64_t size;
-#ifdef USE_UTF16
-   char temp[NAME_SIZE + 1];
-#endif
+   char temp[NAME_UTF8_SIZE];
 
    clear();
    move(2, (COLS - 29) / 2);
@@ -336,33 +328,28 @@ void GPTDataCurses::ShowInfo(int partNum) {
    size = partitions[partNum].GetLastLBA() - partitions[partNum].GetFirstLBA() + 1;
    printw("Partition size: %lld sectors (%s)\n", size, BytesToIeee(size, blockSize).c_str());
    printw("Attribute flags: %016x\n", partitions[partNum].GetAttributes().GetAttributes());
-   #ifdef USE_UTF16
-   partitions[partNum].GetDescription().extract(0, NAME_SIZE , temp, NAME_SIZE );
+   partitions[partNum].GetDescription(temp, sizeof(temp));
    printw("Partition name: '%s'\n", temp);
-   #else
-   printw("Partition name: '%s'\n", partitions[partNum].GetDescription().c_str());
-   #endif
    PromptToContinue();
 } // GPTDataCurses::ShowInfo()
 
 // Prompt for and change a partition's name....
 void GPTDataCurses::ChangeName(int partNum) {
-   char temp[NAME_SIZE + 1];
+   char temp[NAME_UTF8_SIZE];
 
    if (ValidPartNum(partNum)) {
       move(LINES - 4, 0);
       clrtobot();
       move(LINES - 4, 0);
-      #ifdef USE_UTF16
-      partitions[partNum].GetDescription().extract(0, NAME_SIZE , temp, NAME_SIZE );
+      partitions[partNum].GetDescription(temp, sizeof(temp));
       printw("Current partition name is '%s'\n", temp);
-      #else
-      printw("Current partition name is '%s'\n", partitions[partNum].GetDescription().c_str());
-      #endif
       printw("Enter new partition name, or <Enter> to use the current name:\n");
       echo();
-      getnstr(temp, NAME_SIZE );
-      partitions[partNum].SetName((string) temp);
+      getnstr(temp, NAME_UTF8_SIZE - 1);
+      if (temp[0] != '\0') {
+         TouchPartition(partNum);
+         partitions.Edit(partNum).SetName((string) temp);
+      } // if
       noecho();
    } // if
 } // GPTDataCurses::ChangeName()
@@ -386,7 +373,8 @@ void GPTDataCurses::ChangeType(int partNum) {
          if (temp[0] == '\0')
             tempType = partitions[partNum].GetType().GetHexType();
          tempType = temp;
-         partitions[partNum].SetType(tempType);
+         TouchPartition(partNum);
+         partitions.Edit(partNum).SetType(tempType);
       } // if
    } while ((temp[0] == 'L') || (temp[0] == 'l') || (partitions[partNum].GetType() == (GUIDData) "0x0000"));
    noecho();
@@ -682,6 +670,7 @@ void GPTDataCurses::AcceptInput() {
 int GPTDataCurses::Dispatch(char operation) {
    int exitNow = 0;
 
+   BeginTransaction(); // so that the operation can be undone
    switch (operation) {
       case 'a': case 'A':
          SetAlignment();
@@ -708,18 +697,26 @@ int GPTDataCurses::Dispatch(char operation) {
             ChangeName(currentSpace->partNum);
          break;
       case 'n': case 'N':
-         if (currentSpace->partNum < 0) {
+         if (currentSpace->partNum < 0)
             MakeNewPart();
-            IdentifySpaces();
-         } // if
          break;
       case 'q': case 'Q':
          exitNow = 1;
          break;
+      case 'r': case 'R':
+         CommitTransaction(); // (an empty one)
+         if (!Redo())
+            Report("Nothing to redo!");
+         break;
       case 't': case 'T':
          if (ValidPartNum(currentSpace->partNum))
             ChangeType(currentSpace->partNum);
          break;
+      case 'u': case 'U':
+         CommitTransaction(); // (an empty one)
+         if (!Undo())
+            Report("Nothing to undo!");
+         break;
       case 'v': case 'V':
          Verify();
          break;
@@ -729,6 +726,14 @@ int GPTDataCurses::Dispatch(char operation) {
       default:
          break;
    } // switch()
+   CommitTransaction();
+   // Any change (or undo/redo) may have replaced the partition array that
+   // the Spaces point into, so rebuild them....
+   IdentifySpaces();
+   if (currentSpaceNum >= numSpaces) {
+      currentSpaceNum = numSpaces - 1;
+      currentSpace = lastSpace;
+   } // if
    DrawMenu();
    return exitNow;
 } // GPTDataCurses::Dispatch()
@@ -45,14 +45,16 @@ static struct MenuItem menuMain[] = {
    { 'm', " naMe ", "Change the partition's name" },
    { 'n', " New  ", "Create new partition from free space" },
    { 'q', " Quit ", "Quit program without writing partition table" },
+   { 'r', " Redo ", "Redo the last undone change" },
    { 't', " Type ", "Change the filesystem type code GUID" },
+   { 'u', " Undo ", "Undo the last change" },
    { 'v', "Verify", "Verify the integrity of the disk's data structures" },
    { 'w', "Write ", "Write partition table to disk (this might destroy data)" },
    { 0, "", "" }
 };
 
-#define EMPTY_SPACE_OPTIONS "abhlnqvw"
-#define PARTITION_OPTIONS "abdhilmqtvw"
+#define EMPTY_SPACE_OPTIONS "abhlnqruvw"
+#define PARTITION_OPTIONS "abdhilmqrtuvw"
 
 // Constants for how to highlight a selected menu item
 #define USE_CURSES 1
@@ -67,7 +69,7 @@ static struct MenuItem menuMain[] = {
 struct Space {
    uint64_t firstLBA;
    uint64_t lastLBA;
-   GPTPart *origPart;
+   const GPTPart *origPart;
    int partNum;
    Space *nextSpace;
    Space *prevSpace;
@@ -17,17 +17,12 @@
 #define __STDC_CONSTANT_MACROS
 #endif
 
-#ifdef USE_UTF16
-#include <unicode/ustdio.h>
-#else
-#define UnicodeString string
-#endif
-
 #include <string.h>
 #include <stdio.h>
 #include <iostream>
 #include "gptpart.h"
 #include "attributes.h"
+#include "utf16.h"
 
 using namespace std;
 
@@ -40,18 +35,6 @@ GPTPart::GPTPart(void) {
    memset(name, 0, NAME_SIZE * sizeof(name[0]) );
 } // Default constructor
 
-GPTPart::GPTPart(const GPTPart & orig) {
-   partitionType = orig.partitionType;
-   uniqueGUID = orig.uniqueGUID;
-   firstLBA = orig.firstLBA;
-   lastLBA = orig.lastLBA;
-   attributes = orig.attributes;
-   memcpy(name, orig.name, NAME_SIZE * sizeof( name[ 0 ] ) );
-} // Copy constructor
-
-GPTPart::~GPTPart(void) {
-} // destructor
-
 // Return the gdisk-specific two-byte hex code for the partition
 uint16_t GPTPart::GetHexType(void) const {
    return partitionType.GetHexType();
@@ -59,18 +42,10 @@ uint16_t GPTPart::GetHexType(void) const {
 
 // Return a plain-text description of the partition type (e.g., "Linux/Windows
 // data" or "Linux swap").
-string GPTPart::GetTypeName(void) {
+string GPTPart::GetTypeName(void) const {
    return partitionType.TypeName();
 } // GPTPart::GetNameType()
 
-#ifdef USE_UTF16
-// Return a Unicode description of the partition type (e.g., "Linux/Windows
-// data" or "Linux swap").
-UnicodeString GPTPart::GetUTypeName(void) {
-   return partitionType.UTypeName();
-} // GPTPart::GetNameType()
-#endif
-
 // Compute and return the partition's length (or 0 if the end is incorrectly
 // set before the beginning).
 uint64_t GPTPart::GetLengthLBA(void) const {
@@ -81,77 +56,29 @@ uint64_t GPTPart::GetLengthLBA(void) const {
    return length;
 } // GPTPart::GetLengthLBA()
 
-#ifdef USE_UTF16
-// Return partition's name field, converted to a Unicode string
-UnicodeString GPTPart::GetDescription(void) {
-   return (UChar*) name;
-} // GPTPart::GetDescription()
-#else
 // Return partition's name field, converted to a C++ UTF-8 string
-string GPTPart::GetDescription(void) {
-   // convert name to utf32 then to utf8
-   string utf8 ;
-   size_t pos = 0 ;
-   while ( ( pos < NAME_SIZE ) && ( name[ pos ] != 0 ) ) {
-      uint16_t cp = name[ pos ++ ] ;
-      if ( ! IsLittleEndian() ) ReverseBytes( & cp , 2 ) ;
-      // first to utf32
-      uint32_t uni ;
-      if ( cp < 0xd800 || cp > 0xdfff ) {
-         uni = cp ;
-      } // if
-      else if ( cp < 0xdc00 ) {
-         // lead surrogate
-         uni = ( (uint32_t)( cp & 0x3ff ) ) << 10 ;
-         if ( pos >= NAME_SIZE ) {
-            // missing trail surrogate, name[] is invalid
-            break ;
-         } // if
-         cp = name[ pos ++ ] ;
-         if ( cp < 0xdc00 || cp > 0xdfff ) {
-            // invalid trail surrogate, name[] is invalid
-            break ;
-         } // if
-         // trail surrogate
-         uni |= cp & 0x3ff ;
-         uni += 0x10000 ;
-      } // if
-      else {
-         // unexpected trail surrogate, name[] is invalid
-         break ;
-      } // if
-      // then to utf8
-      if ( uni < 0x80 ) {
-         utf8 += (char) uni ;
-      } // if
-      else if ( uni < 0x800 ) {
-         utf8 += (char) ( 0xc0 | ( uni >> 6 ) ) ;
-         utf8 += (char) ( 0x80 | ( uni & 0x3f ) ) ;
-      } // if
-      else if ( uni < 0x10000 ) {
-         utf8 += (char) ( 0xe0 | ( uni >> 12 ) ) ;
-         utf8 += (char) ( 0x80 | ( ( uni >> 6 ) & 0x3f ) ) ;
-         utf8 += (char) ( 0x80 | ( uni & 0x3f ) ) ;
-      } // if
-      else {
-         utf8 += (char) ( 0xf0 | ( uni >> 18 ) ) ;
-         utf8 += (char) ( 0xe0 | ( ( uni >> 12 ) & 0x3f ) ) ;
-         utf8 += (char) ( 0x80 | ( ( uni >> 6 ) & 0x3f ) ) ;
-         utf8 += (char) ( 0x80 | ( uni & 0x3f ) ) ;
-      } // if
-   }
-   return utf8 ;
-} // GPTPart::GetDescription(), UTF-8 version
-#endif
+string GPTPart::GetDescription(void) const {
+   char utf8[NAME_UTF8_SIZE];
+
+   return string(utf8, GetDescription(utf8, sizeof(utf8)));
+} // GPTPart::GetDescription()
+
+// Copy the partition's name field, converted to UTF-8, into the
+// NUL-terminated buffer utf8, which is size bytes long. A buffer of
+// NAME_UTF8_SIZE bytes always holds the whole name. Returns the length
+// of the converted name, not counting the terminating NUL.
+size_t GPTPart::GetDescription(char* utf8, size_t size) const {
+   return UTF16ToUTF8(name, NAME_SIZE, utf8, size);
+} // GPTPart::GetDescription(char*, size_t)
 
 // Return 1 if the partition is in use
-int GPTPart::IsUsed(void) {
-   return (partitionType != GUIDData("0x00"));
+int GPTPart::IsUsed(void) const {
+   return !partitionType.IsZero();
 } // GPTPart::IsUsed()
 
 // Returns MBR_SIZED_GOOD, MBR_SIZED_IFFY, or MBR_SIZED_BAD; see comments
 // in header file for details.
-int GPTPart::IsSizedForMBR(void) {
+int GPTPart::IsSizedForMBR(void) const {
    int retval = MBR_SIZED_GOOD;
 
    if ((firstLBA > UINT32_MAX) || ((lastLBA - firstLBA) > UINT32_MAX) || (firstLBA > lastLBA))
@@ -166,126 +93,29 @@ int GPTPart::IsSizedForMBR(void) {
 // name *IF* the current name is the generic one for the current partition
 // type.
 void GPTPart::SetType(PartType t) {
-#ifdef USE_UTF16
-   if (GetDescription() == partitionType.UTypeName()) {
-#else
    if (GetDescription() == partitionType.TypeName()) {
-#endif
       SetName(t.TypeName());
    } // if
    partitionType = t;
 } // GPTPart::SetType()
 
-#ifdef USE_UTF16
-// Set the name for a partition to theName, using a C++-style string as
-// input.
+// Set the name for a partition to theName, a UTF-8 string. The GUID
+// partition definition requires UTF-16LE, so the name is converted, and
+// truncated if necessary. Conversion stops at the first invalid UTF-8
+// sequence.
 void GPTPart::SetName(const string & theName) {
-   SetName((UnicodeString) theName.c_str());
-} // GPTPart::SetName()
+   size_t len;
 
-// Set the name for a partition to theName, using a Unicode string as
-// input.
-void GPTPart::SetName(const UnicodeString & theName) {
-   if (theName.isBogus()) {
-      cerr << "Bogus UTF-16 name found in GPTPart::SetName()! Name not changed!\n";
-   } else {
-      memset(name, 0, NAME_SIZE * sizeof(name[0]) );
-      theName.extractBetween(0, NAME_SIZE, (UChar*) name);
-   } // if/else
+   len = UTF8ToUTF16(theName.data(), theName.length(), name, NAME_SIZE);
+   memset(name + len, 0, (NAME_SIZE - len) * sizeof(name[0]));
 } // GPTPart::SetName()
 
-#else
-
-// Set the name for a partition to theName. Note that theName is a
-// standard C++-style ASCII string, although the GUID partition definition
-// requires a UTF-16LE string. This function creates a simple-minded copy
-// for this.
-void GPTPart::SetName(const string & theName) {
-   // convert utf8 to utf32 then to utf16le
-   size_t len = theName.length() ;
-   size_t pos = 0 ;
-   for ( size_t i = 0 ; pos < NAME_SIZE && i < len ; ) {
-      uint32_t uni ;
-      uint8_t cp = theName[ i ++ ] ;
-      int todo ;
-      if ( cp < 0x80 ) {
-         uni = cp ;
-         todo = 0 ;
-      } // if
-      else if ( cp < 0xc0 || cp > 0xf7 ) {
-         // invalid byte, theName is broken
-         break ;
-      } // if
-      else if ( cp < 0xe0 ) {
-         uni = cp & 0x1f ;
-         todo = 1 ;
-      } // if
-      else if ( cp < 0xf0 ) {
-         uni = cp & 0x0f ;
-         todo = 2 ;
-      } // if
-      else {
-         uni = cp & 0x7 ;
-         todo = 3 ;
-      } // if
-      while ( todo > 0 ) {
-         if ( i >= len ) {
-            // missing continuation byte, theName is broken
-            goto break_converter ;
-         } // if
-         cp = theName[ i ++ ] ;
-         if ( cp > 0xbf || cp < 0x80 ) {
-            // invalid continuation byte, theName is broken
-            goto break_converter ;
-         } // if
-         uni <<= 6 ;
-         uni |= cp & 0x3f ;
-         todo -- ;
-      } // while
-      // then to utf16le
-      if ( uni < 0x10000 ) {
-         name[ pos ] = (uint16_t) uni ;
-         if ( ! IsLittleEndian() ) ReverseBytes( name + pos , 2 ) ;
-         pos ++ ;
-      } // if
-      else {
-         if ( pos > NAME_SIZE - 2 ) {
-             // not enough room for two surrogates, truncate
-             break ;
-         } // if
-         uni -= 0x10000 ;
-         name[ pos ] = (uint16_t)( uni >> 10 ) | 0xd800 ;
-         if ( ! IsLittleEndian() ) ReverseBytes( name + pos , 2 ) ;
-         pos ++ ;
-         name[ pos ] = (uint16_t)( uni & 0x3ff ) | 0xdc00 ;
-         if ( ! IsLittleEndian() ) ReverseBytes( name + pos , 2 ) ;
-         pos ++ ;
-      }
-   } // for
-   break_converter : ;
-   // finally fill with zeroes
-   while ( pos < NAME_SIZE ) {
-      name[ pos ++ ] = 0 ;
-   } // while
-} // GPTPart::SetName(), UTF-8 version
-#endif
-
 // Set the name for the partition based on the current GUID partition type
 // code's associated name
 void GPTPart::SetDefaultDescription(void) {
    SetName(partitionType.TypeName());
 } // GPTPart::SetDefaultDescription()
 
-GPTPart & GPTPart::operator=(const GPTPart & orig) {
-   partitionType = orig.partitionType;
-   uniqueGUID = orig.uniqueGUID;
-   firstLBA = orig.firstLBA;
-   lastLBA = orig.lastLBA;
-   attributes = orig.attributes;
-   memcpy(name, orig.name, NAME_SIZE * sizeof( name[ 0 ] ) );
-   return *this;
-} // assignment operator
-
 // Compare the values, and return a bool result.
 // Because this is intended for sorting and a firstLBA value of 0 denotes
 // a partition that's not in use and so that should be sorted upwards,
@@ -300,36 +130,36 @@ bool GPTPart::operator<(const GPTPart &other) const {
 
 // Display summary information; does nothing if the partition is empty.
 void GPTPart::ShowSummary(int partNum, uint32_t blockSize) {
-   string sizeInIeee;
-   UnicodeString description;
+   OutputBuffer out;
+
+   if (ShowSummary(partNum, blockSize, out)) {
+      out.Flush(cout);
+      // This has always left cout showing upper-case hex, and later output
+      // (such as ShowDetails()'s attribute flags) has come to depend on it....
+      cout.setf(ios::uppercase);
+   } // if
+} // GPTPart::ShowSummary()
+
+// As ShowSummary(int, uint32_t), but append the line to out. Returns 1 if
+// the partition is in use (and so a line was added), 0 if not.
+int GPTPart::ShowSummary(int partNum, uint32_t blockSize, OutputBuffer & out) const {
+   char size[IEEE_SIZE_LENGTH];
+   size_t sizeLen;
+   char desc[NAME_UTF8_SIZE];
    size_t i;
 
    if (firstLBA != 0) {
-      sizeInIeee = BytesToIeee(lastLBA - firstLBA + 1, blockSize);
-      cout.fill(' ');
-      cout.width(4);
-      cout << partNum + 1 << "  ";
-      cout.width(14);
-      cout << firstLBA << "  ";
-      cout.width(14);
-      cout << lastLBA  << "   ";
-      cout << sizeInIeee << "  ";
-      if (sizeInIeee.length() < 10)
-         for (i = 0; i < 10 - sizeInIeee.length(); i++)
-            cout << " ";
-      cout.fill('0');
-      cout.width(4);
-      cout.setf(ios::uppercase);
-      cout << hex << partitionType.GetHexType() << "  " << dec;
-      cout.fill(' ');
-#ifdef USE_UTF16
-      GetDescription().extractBetween(0, 23, description);
-      cout << description << "\n";
-#else
-      string desc = GetDescription() ;
+      sizeLen = BytesToIeee(lastLBA - firstLBA + 1, blockSize, size);
+      out.PutDec(partNum + 1, 4).Put("  ");
+      out.PutDec(firstLBA, 14).Put("  ");
+      out.PutDec(lastLBA, 14).Put("   ");
+      out.Put(size, sizeLen).Put("  ");
+      if (sizeLen < 10)
+         out.PutSpaces(10 - sizeLen);
+      out.PutHex(partitionType.GetHexType(), 4, '0', 1).Put("  ");
       size_t n = 0 ;
-      size_t i = 0 ;
-      size_t len = desc.length() ;
+      size_t len = GetDescription( desc , sizeof( desc ) ) ;
+      i = 0 ;
       while ( n < 22 && i < len ) {
          i ++ ;
          if ( i >= len ) {
@@ -361,17 +191,17 @@ void GPTPart::ShowSummary(int partNum, uint32_t blockSize) {
             n ++ ;
          } // while
       } // for
-      cout << GetDescription().substr( 0 , i ) ;
-      if ( i < len ) cout << "..." ;
-      cout << "\n";
-#endif
-      cout.fill(' ');
+      out.Put(desc, i);
+      if ( i < len ) out.Put("...");
+      out.Put('\n');
+      return 1;
    } // if
-} // GPTPart::ShowSummary()
+   return 0;
+} // GPTPart::ShowSummary(int, uint32_t, OutputBuffer &)
 
 // Show detailed partition information. Does nothing if the partition is
 // empty (as determined by firstLBA being 0).
-void GPTPart::ShowDetails(uint32_t blockSize) {
+void GPTPart::ShowDetails(uint32_t blockSize) const {
    uint64_t size;
 
    if (firstLBA != 0) {
@@ -397,6 +227,35 @@ void GPTPart::ShowDetails(uint32_t blockSize) {
    }  // if
 } // GPTPart::ShowDetails()
 
+// Write the partition's details, as ShowDetails() shows them, as a JSON
+// object, giving exact sizes (rather than rounded ones) and the attribute
+// flags as hex and as a list of the bits that are set. Does nothing if the
+// partition is empty.
+void GPTPart::ShowJSON(int partNum, uint32_t blockSize, JSONWriter & json, int compact) const {
+   uint64_t size = GetLengthLBA();
+   uint64_t flags = attributes.GetAttributes();
+   char desc[NAME_UTF8_SIZE];
+   uint32_t bit;
+
+   if (firstLBA != 0) {
+      json.BeginObject(compact).Put("number", (uint64_t) partNum + 1);
+      json.Put("first_lba", firstLBA).Put("last_lba", lastLBA);
+      json.Put("sectors", size).Put("bytes", size * blockSize);
+      json.Put("type_guid", partitionType.AsString());
+      json.PutHex("type_code", partitionType.GetHexType(), 4);
+      json.Put("type_name", partitionType.TypeName());
+      json.Put("unique_guid", uniqueGUID.AsString());
+      json.Key("name").PutString(desc, GetDescription(desc, sizeof(desc)));
+      json.PutHex("attributes", flags, 16);
+      json.Key("attribute_bits").BeginArray(1);
+      for (bit = 0; bit < NUM_ATR; bit++) {
+         if (flags & (UINT64_C(1) << bit))
+            json.PutDec(bit);
+      } // for
+      json.EndArray().EndObject();
+   } // if
+} // GPTPart::ShowJSON()
+
 // Blank (delete) a single partition
 void GPTPart::BlankPartition(void) {
    uniqueGUID.Zero();
@@ -408,7 +267,7 @@ void GPTPart::BlankPartition(void) {
 } // GPTPart::BlankPartition
 
 // Returns 1 if the two partitions overlap, 0 if they don't
-int GPTPart::DoTheyOverlap(const GPTPart & other) {
+int GPTPart::DoTheyOverlap(const GPTPart & other) const {
    // Don't bother checking unless these are defined (both start and end points
    // are 0 for undefined partitions, so just check the start points)
    return firstLBA && other.firstLBA &&
@@ -438,11 +297,7 @@ void GPTPart::ChangeType(void) {
    int changeName;
    PartType tempType = (GUIDData) "00000000-0000-0000-0000-000000000000";
 
-#ifdef USE_UTF16
-   changeName = (GetDescription() == GetUTypeName());
-#else
    changeName = (GetDescription() == GetTypeName());
-#endif
 
    cout << "Current type is '" << GetTypeName() << "'\n";
    do {
@@ -17,14 +17,21 @@
 
 #include <stdint.h>
 #include <string>
+#include <type_traits>
 #include <sys/types.h>
 #include "support.h"
 #include "parttypes.h"
 #include "guid.h"
 #include "attributes.h"
+#include "utf16.h"
+#include "outbuf.h"
+#include "jsonout.h"
 
 using namespace std;
 
+// Size of a buffer that can hold any partition name as UTF-8, plus a NUL
+#define NAME_UTF8_SIZE UTF8_SIZE_FOR_UTF16(NAME_SIZE)
+
 // Values returned by GPTPart::IsSizedForMBR()
 #define MBR_SIZED_GOOD 0 /* Whole partition under 2^32 sectors */
 #define MBR_SIZED_IFFY 1 /* Partition starts under 2^32 & is less than 2^32, but ends over 2^32 */
@@ -45,6 +52,10 @@ class GPTPart {
       // adjusting the data-load operation in GPTData::LoadMainTable() and
       // GPTData::LoadSecondTableAsMain() and then removing the GPTPart
       // size check in SizesOK() (in gpt.cc file).
+      // GPTPart must also remain trivially copyable (no user-defined copy
+      // constructor, assignment operator, or destructor, here or in the
+      // classes it contains), since PartitionStore loads, saves, and
+      // checksums partition tables with memcpy() and raw byte access.
       PartType partitionType;
       GUIDData uniqueGUID;
       uint64_t firstLBA;
@@ -53,23 +64,23 @@ class GPTPart {
       uint16_t name[NAME_SIZE];
    public:
       GPTPart(void);
-      GPTPart(const GPTPart &);
-      ~GPTPart(void);
 
       // Simple data retrieval:
       PartType & GetType(void) {return partitionType;}
+      const PartType & GetType(void) const {return partitionType;}
       uint16_t GetHexType(void) const;
-      string GetTypeName(void);
-      UnicodeString GetUTypeName(void);
+      string GetTypeName(void) const;
       const GUIDData GetUniqueGUID(void) const {return uniqueGUID;}
       uint64_t GetFirstLBA(void) const {return firstLBA;}
       uint64_t GetLastLBA(void) const {return lastLBA;}
       uint64_t GetLengthLBA(void) const;
-      Attributes GetAttributes(void) {return attributes;}
+      Attributes GetAttributes(void) const {return attributes;}
       void ShowAttributes(uint32_t partNum) {attributes.ShowAttributes(partNum);}
-      UnicodeString GetDescription(void);
-      int IsUsed(void);
-      int IsSizedForMBR(void);
+      string GetDescription(void) const;
+      size_t GetDescription(char* utf8, size_t size) const;
+      const uint16_t* GetRawName(void) const {return name;}
+      int IsUsed(void) const;
+      int IsSizedForMBR(void) const;
 
       // Simple data assignment:
       void SetType(PartType t);
@@ -81,22 +92,22 @@ class GPTPart {
       void SetAttributes(uint64_t a) {attributes = a;}
       void SetAttributes(void) {attributes.ChangeAttributes();}
       void SetName(const string & theName);
-#ifdef USE_UTF16
-      void SetName(const UnicodeString & theName);
-#endif
       void SetDefaultDescription(void);
 
       // Additional functions
-      GPTPart & operator=(const GPTPart & orig);
       bool operator<(const GPTPart &other) const;
       void ShowSummary(int partNum, uint32_t blockSize); // display summary information (1-line)
-      void ShowDetails(uint32_t blockSize); // display detailed information (multi-line)
+      int ShowSummary(int partNum, uint32_t blockSize, OutputBuffer & out) const;
+      void ShowDetails(uint32_t blockSize) const; // display detailed information (multi-line)
+      void ShowJSON(int partNum, uint32_t blockSize, JSONWriter & json, int compact = 1) const;
       void BlankPartition(void); // empty partition of data
-      int DoTheyOverlap(const GPTPart & other); // returns 1 if there's overlap
+      int DoTheyOverlap(const GPTPart & other) const; // returns 1 if there's overlap
       void ReversePartBytes(void); // reverse byte order of all integer fields
 
       // Functions requiring user interaction
       void ChangeType(void); // Change the type code
 }; // struct GPTPart
 
+static_assert(is_trivially_copyable<GPTPart>::value, "GPTPart must be trivially copyable");
+
 #endif
@@ -166,8 +166,8 @@ void GPTDataTextUI::ResizePartitionTable(void) {
    GetPartRange(&curLow, &curHigh);
    curHigh++; // since GetPartRange() returns numbers starting from 0...
    // There's no point in having fewer than four partitions....
-   if (curHigh < (blockSize / GPT_SIZE))
-      curHigh = blockSize / GPT_SIZE;
+   if (curHigh < (blockSize / partEntrySize))
+      curHigh = blockSize / partEntrySize;
    prompt << "Enter new size (" << curHigh << " up, default " << NUM_GPT_ENTRIES << "): ";
    newSize = GetNumber(4, 65535, 128, prompt.str());
    if (newSize < 128) {
@@ -199,7 +199,7 @@ void GPTDataTextUI::MoveMainTable(void) {
 
 // Interactively create a partition
 void GPTDataTextUI::CreatePartition(void) {
-   uint64_t firstBlock, firstInLargest, lastBlock, sector, origSector;
+   uint64_t firstBlock, defaultFirst, lastBlock, sector, origSector;
    uint32_t firstFreePart = 0;
    ostringstream prompt1, prompt2, prompt3;
    int partNum;
@@ -212,8 +212,7 @@ void GPTDataTextUI::CreatePartition(void) {
    if (((firstBlock = FindFirstAvailable()) != 0) &&
        (firstFreePart < numParts)) {
       lastBlock = FindLastAvailable();
-      firstInLargest = FindFirstInLargest();
-      Align(&firstInLargest);
+      defaultFirst = FindPlacement();
 
       // Get partition number....
       prompt1 << "Partition number (" << firstFreePart + 1 << "-" << numParts
@@ -227,9 +226,9 @@ void GPTDataTextUI::CreatePartition(void) {
 
       // Get first block for new partition...
       prompt2 << "First sector (" << firstBlock << "-" << lastBlock << ", default = "
-              << firstInLargest << ") or {+-}size{KMGTP}: ";
+              << defaultFirst << ") or {+-}size{KMGTP}: ";
       do {
-         sector = GetSectorNum(firstBlock, lastBlock, firstInLargest, blockSize, prompt2.str());
+         sector = GetSectorNum(firstBlock, lastBlock, defaultFirst, blockSize, prompt2.str());
       } while (IsFree(sector) == 0);
       origSector = sector;
       if (Align(&sector)) {
@@ -252,8 +251,9 @@ void GPTDataTextUI::CreatePartition(void) {
       lastBlock = sector;
 
       firstFreePart = GPTData::CreatePartition(partNum, firstBlock, lastBlock);
-      partitions[partNum].ChangeType();
-      partitions[partNum].SetDefaultDescription();
+      TouchPartition(partNum);
+      partitions.Edit(partNum).ChangeType();
+      partitions.Edit(partNum).SetDefaultDescription();
    } else {
       if (firstFreePart >= numParts)
          cout << "No table partition entries left\n";
@@ -284,7 +284,8 @@ void GPTDataTextUI::ChangePartType(void) {
 
    if (GetPartRange(&low, &high) > 0) {
       partNum = GetPartNum();
-      partitions[partNum].ChangeType();
+      TouchPartition(partNum);
+      partitions.Edit(partNum).ChangeType();
    } else {
       cout << "No partitions\n";
    } // if/else
@@ -314,7 +315,8 @@ void GPTDataTextUI::ChangeUniqueGuid(void) {
 // Partition attributes seem to be rarely used, but I want a way to
 // adjust them for completeness....
 void GPTDataTextUI::SetAttributes(uint32_t partNum) {
-   partitions[partNum].SetAttributes();
+   TouchPartition(partNum);
+   partitions.Edit(partNum).SetAttributes();
 } // GPTDataTextUI::SetAttributes()
 
 // Prompts the user for a partition name and sets the partition's
@@ -327,12 +329,9 @@ int GPTDataTextUI::SetName(uint32_t partNum) {
 
    if (IsUsedPartNum(partNum)) {
       cout << "Enter name: ";
-#ifdef USE_UTF16
-      theName = ReadUString();
-#else
       theName = ReadString();
-#endif
-      partitions[partNum].SetName(theName);
+      TouchPartition(partNum);
+      partitions.Edit(partNum).SetName(theName);
    } else {
       cerr << "Invalid partition number (" << partNum << ")\n";
       retval = 0;
@@ -499,7 +498,7 @@ void GPTDataTextUI::MakeHybrid(void) {
             hybridMBR.MakeBiggestPart(3, hexCode);
          } // if (GetYN() == 'Y')
       } // if unused entry
-      protectiveMBR = hybridMBR;
+      protectiveMBR = move(hybridMBR);
    } else {
       cout << "\nNo partitions converted; original protective/hybrid MBR is unmodified!\n";
    } // if/else (numConverted > 0)
@@ -564,10 +563,13 @@ void GPTDataTextUI::MainMenu(string filename) {
    int goOn = 1;
    PartType typeHelper;
    uint32_t temp1, temp2;
+   char command;
 
    do {
       cout << "\nCommand (? for help): ";
-      switch (ReadString()[0]) {
+      command = ReadString()[0];
+      BeginTransaction(); // so that the command can be undone
+      switch (command) {
          case '\0':
             goOn = cin.good();
             break;
@@ -608,6 +610,7 @@ void GPTDataTextUI::MainMenu(string filename) {
             goOn = 0;
             break;
          case 'r': case 'R':
+            CommitTransaction();
             RecoveryMenu(filename);
             goOn = 0;
             break;
@@ -618,6 +621,11 @@ void GPTDataTextUI::MainMenu(string filename) {
          case 't': case 'T':
             ChangePartType();
             break;
+         case 'u': case 'U':
+            CommitTransaction(); // (an empty one)
+            if (!Undo())
+               cout << "Nothing to undo\n";
+            break;
          case 'v': case 'V':
             Verify();
             break;
@@ -626,13 +634,20 @@ void GPTDataTextUI::MainMenu(string filename) {
                goOn = 0;
             break;
          case 'x': case 'X':
+            CommitTransaction();
             ExpertsMenu(filename);
             goOn = 0;
             break;
+         case 'y': case 'Y':
+            CommitTransaction(); // (an empty one)
+            if (!Redo())
+               cout << "Nothing to redo\n";
+            break;
          default:
             ShowCommands();
             break;
       } // switch
+      CommitTransaction();
    } while (goOn);
 } // GPTDataTextUI::MainMenu()
 
@@ -649,9 +664,11 @@ void GPTDataTextUI::ShowCommands(void) {
    cout << "r\trecovery and transformation options (experts only)\n";
    cout << "s\tsort partitions\n";
    cout << "t\tchange a partition's type code\n";
+   cout << "u\tundo the last change\n";
    cout << "v\tverify disk\n";
    cout << "w\twrite table to disk and exit\n";
    cout << "x\textra functionality (experts only)\n";
+   cout << "y\tredo the last undone change\n";
    cout << "?\tprint this menu\n";
 } // GPTDataTextUI::ShowCommands()
 
@@ -660,10 +677,13 @@ void GPTDataTextUI::ShowCommands(void) {
 void GPTDataTextUI::RecoveryMenu(string filename) {
    uint32_t numParts;
    int goOn = 1, temp1;
+   char command;
    
    do {
       cout << "\nRecovery/transformation command (? for help): ";
-      switch (ReadString()[0]) {
+      command = ReadString()[0];
+      BeginTransaction();
+      switch (command) {
          case '\0':
             goOn = cin.good();
             break;
@@ -722,6 +742,7 @@ void GPTDataTextUI::RecoveryMenu(string filename) {
             LoadGPTBackup(ReadString());
             break;
          case 'm': case 'M':
+            CommitTransaction();
             MainMenu(filename);
             goOn = 0;
             break;
@@ -746,6 +767,7 @@ void GPTDataTextUI::RecoveryMenu(string filename) {
             } // if
             break;
          case 'x': case 'X':
+            CommitTransaction();
             ExpertsMenu(filename);
             goOn = 0;
             break;
@@ -753,6 +775,7 @@ void GPTDataTextUI::RecoveryMenu(string filename) {
             ShowRecoveryCommands();
             break;
       } // switch
+      CommitTransaction();
    } while (goOn);
 } // GPTDataTextUI::RecoveryMenu()
 
@@ -786,10 +809,13 @@ void GPTDataTextUI::ExpertsMenu(string filename) {
    string guidStr, device;
    GUIDData aGUID;
    ostringstream prompt;
+   char command;
    
    do {
       cout << "\nExpert command (? for help): ";
-      switch (ReadString()[0]) {
+      command = ReadString()[0];
+      BeginTransaction();
+      switch (command) {
          case '\0':
             goOn = cin.good();
             break;
@@ -840,6 +866,7 @@ void GPTDataTextUI::ExpertsMenu(string filename) {
             SetAlignment(temp1);
             break;
          case 'm': case 'M':
+            CommitTransaction();
             MainMenu(filename);
             goOn = 0;
             break;
@@ -856,6 +883,7 @@ void GPTDataTextUI::ExpertsMenu(string filename) {
             goOn = 0;
             break;
          case 'r': case 'R':
+            CommitTransaction();
             RecoveryMenu(filename);
             goOn = 0;
             break;
@@ -891,6 +919,7 @@ void GPTDataTextUI::ExpertsMenu(string filename) {
             ShowExpertCommands();
             break;
       } // switch
+      CommitTransaction();
    } while (goOn);
 } // GPTDataTextUI::ExpertsMenu()
 
@@ -953,16 +982,4 @@ int GetMBRTypeCode(int defType) {
    return typeCode;
 } // GetMBRTypeCode
 
-#ifdef USE_UTF16
-// Note: ReadUString() is here rather than in support.cc so that the ICU
-// libraries need not be linked to fixparts.
-
-// Reads a Unicode string from stdin, returning it as an ICU-style string.
-// Note that the returned string will NOT include the carriage return
-// entered by the user. Relies on the ICU constructor from a string
-// encoded in the current codepage to work.
-UnicodeString ReadUString(void) {
-   return ReadString().c_str();
-} // ReadUString()
-#endif
    
@@ -68,6 +68,5 @@ class GPTDataTextUI : public GPTData {
 }; // class GPTDataTextUI
 
 int GetMBRTypeCode(int defType);
-UnicodeString ReadUString(void);
 
 #endif // __GPTDATATEXT_H
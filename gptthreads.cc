@@ -0,0 +1,201 @@
+// gptthreads.cc
+// Test of processing many disks at once in one process: each of several
+// threads creates partition tables (with partition types, names,
+// attributes, random GUIDs, and a hybrid MBR) on disk images of its own,
+// writes them, and reads them back with GPTData, a PartitionProbe, and the
+// C API, checking that they came through intact. It's meant to be built
+// with ThreadSanitizer ("make tsan"), which reports any data the threads
+// share without synchronization; "make threads" builds it without.
+// Run "./gptthreads [threads [image-prefix]]"; the images (by default
+// /tmp/gptthreads.img, with ".thread.image" appended) are created as
+// sparse files and deleted when the program finishes. Exits with 0 if
+// every image checks out, 1 if not.
+
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "diag.h"
+#include "gpt.h"
+#include "gptapi.h"
+#include "probe.h"
+
+using namespace std;
+
+#define THREADS_DEFAULT 8
+#define THREAD_IMAGES 3 /* images per thread */
+#define THREAD_PARTS 4 /* partitions per image */
+#define THREAD_PART_SIZE 2048 /* sectors per partition */
+#define THREAD_DISK_SIZE (UINT64_C(32) * 1024 * 1024) /* bytes */
+
+// Partition types to give the partitions, in rotation
+static const uint16_t partTypes[] = {0x8300, 0x8200, 0xef00, 0x0700};
+
+// The name for partition partNum (numbered from 0) of image imageNum made
+// by thread threadNum
+static string TestName(int threadNum, int imageNum, uint32_t partNum) {
+   return "thread " + to_string(threadNum) + " image " + to_string(imageNum) +
+          " part " + to_string(partNum + 1);
+} // TestName()
+
+// The type and attributes for partition partNum of image imageNum made by
+// thread threadNum; they vary from thread to thread and image to image.
+static uint16_t TestType(int threadNum, int imageNum, uint32_t partNum) {
+   return partTypes[(threadNum + imageNum + partNum) % 4];
+} // TestType()
+
+static uint64_t TestAttributes(int threadNum, int imageNum, uint32_t partNum) {
+   return UINT64_C(1) << ((threadNum + imageNum + partNum) % 3);
+} // TestAttributes()
+
+// Create a sparse disk image holding a GPT with THREAD_PARTS partitions
+// and a hybrid MBR that covers the first of them. Returns 1 on success,
+// 0 on failure.
+static int MakeImage(const string & filename, int threadNum, int imageNum) {
+   GPTData gpt;
+   BasicMBRData hybridMBR;
+   MBRPart mbrPart;
+   PartType type;
+   uint64_t start;
+   uint32_t i;
+   int fd;
+
+   fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if ((fd < 0) || (ftruncate(fd, THREAD_DISK_SIZE) != 0)) {
+      cerr << "Unable to create " << filename << "!\n";
+      return 0;
+   } // if
+   close(fd);
+   gpt.JustLooking(0);
+   gpt.BeQuiet();
+   if (!gpt.SetDisk(filename) || !gpt.ClearGPTData())
+      return 0;
+   gpt.MakeProtectiveMBR();
+   start = gpt.GetFirstUsableLBA();
+   gpt.Align(&start);
+   for (i = 0; i < THREAD_PARTS; i++) {
+      type = TestType(threadNum, imageNum, i);
+      if (!gpt.CreatePartition(i, start, start + THREAD_PART_SIZE - 1) ||
+          !gpt.ChangePartType(i, type) ||
+          !gpt.SetName(i, TestName(threadNum, imageNum, i)) ||
+          !gpt.SetAttributes(i, TestAttributes(threadNum, imageNum, i)))
+         return 0;
+      start += THREAD_PART_SIZE;
+   } // for
+   gpt.RandomizeGUIDs();
+
+   // A hybrid MBR, as "sgdisk -h 1" makes, so that the MBR partitions'
+   // CHS values are worked out from this disk's geometry....
+   hybridMBR.SetDisk(gpt.GetDisk());
+   mbrPart.SetInclusion(PRIMARY);
+   mbrPart.SetType(0x83);
+   mbrPart.SetLocation(gpt[0].GetFirstLBA(), gpt[0].GetLengthLBA());
+   hybridMBR.AddPart(1, mbrPart);
+   mbrPart.SetType(0xEE);
+   mbrPart.SetLocation(1, hybridMBR.FindLastInFree(1));
+   hybridMBR.AddPart(0, mbrPart);
+   gpt.SetProtectiveMBR(move(hybridMBR));
+   return gpt.SaveGPTData(1);
+} // MakeImage()
+
+// Read filename back, with GPTData, with a PartitionProbe, and through the
+// C API, and check that it holds what MakeImage() put there. Returns 1 if
+// it does, 0 if not.
+static int CheckImage(const string & filename, int threadNum, int imageNum) {
+   GPTData gpt;
+   GPTPart part;
+   VerifyReport report;
+   PartitionProbe probe;
+   sgdisk_handle* handle;
+   struct sgdisk_part_info info;
+   uint32_t i;
+   int allOK = 1;
+
+   gpt.JustLooking();
+   gpt.BeQuiet();
+   if (!gpt.LoadPartitions(filename) || (gpt.Verify(report) != 0) ||
+       (gpt.CountParts() != THREAD_PARTS))
+      return 0;
+   for (i = 0; i < THREAD_PARTS; i++) {
+      part = gpt[i];
+      if ((part.GetHexType() != TestType(threadNum, imageNum, i)) ||
+          (part.GetDescription() != TestName(threadNum, imageNum, i)) ||
+          (part.GetAttributes().GetAttributes() != TestAttributes(threadNum, imageNum, i)) ||
+          (part.GetTypeName() == "Unknown") || part.GetUniqueGUID().IsZero())
+         allOK = 0;
+   } // for
+
+   if (!probe.Open(filename) || (probe.ProbeMBR() != hybrid) ||
+       (probe.GetMBRParts().size() != 2) || (probe.ProbeGPT() != probe_gpt_main) ||
+       (probe.CountUsed() != THREAD_PARTS))
+      allOK = 0;
+
+   if (sgdisk_open(filename.c_str(), SGDISK_OPEN_READ_ONLY, &handle) != SGDISK_OK)
+      return 0;
+   if (sgdisk_load(handle) != SGDISK_OK)
+      allOK = 0;
+   for (i = 0; allOK && (i < THREAD_PARTS); i++) {
+      if ((sgdisk_get_partition(handle, i + 1, &info) != SGDISK_OK) ||
+          (TestName(threadNum, imageNum, i) != info.name) ||
+          (gpt[i].GetUniqueGUID().AsString() != info.unique_guid))
+         allOK = 0;
+   } // for
+   sgdisk_close(handle);
+   return allOK;
+} // CheckImage()
+
+// Make and check THREAD_IMAGES images, named for threadNum, and delete
+// them again. Sets *failures to the number that didn't check out.
+static void Worker(const string & prefix, int threadNum, int* failures) {
+   NullDiagSink quiet;
+   string filename;
+   int imageNum;
+
+   SetDiagSink(&quiet);
+   *failures = 0;
+   for (imageNum = 0; imageNum < THREAD_IMAGES; imageNum++) {
+      filename = prefix + "." + to_string(threadNum) + "." + to_string(imageNum);
+      if (!MakeImage(filename, threadNum, imageNum) || !CheckImage(filename, threadNum, imageNum))
+         (*failures)++;
+      unlink(filename.c_str());
+   } // for
+   SetDiagSink(NULL);
+} // Worker()
+
+int main(int argc, char* argv[]) {
+   string prefix = "/tmp/gptthreads.img";
+   vector<thread> threads;
+   vector<int> failures;
+   int numThreads = THREADS_DEFAULT, i, totalFailures = 0;
+
+   if (argc > 1)
+      numThreads = atoi(argv[1]);
+   if (argc > 2)
+      prefix = argv[2];
+   if (numThreads < 1) {
+      cerr << "Usage: " << argv[0] << " [threads [image-prefix]]\n";
+      return 1;
+   } // if
+
+   failures.resize(numThreads);
+   for (i = 0; i < numThreads; i++)
+      threads.push_back(thread(Worker, prefix, i, &failures[i]));
+   for (i = 0; i < numThreads; i++) {
+      threads[i].join();
+      if (failures[i] > 0)
+         cerr << "Thread " << i << ": " << failures[i] << " of " << THREAD_IMAGES
+              << " images failed\n";
+      totalFailures += failures[i];
+   } // for
+   cout << numThreads * THREAD_IMAGES - totalFailures << " of " << numThreads * THREAD_IMAGES
+        << " images made and checked in " << numThreads << " threads\n";
+   return totalFailures > 0;
+} // main()
@@ -0,0 +1,126 @@
+// gptzones.cc
+// Test of partition placement on zoned devices. Disk image files have no
+// zones, so this makes an image look like a zoned disk with
+// GPTData::SetZoneSize() and checks that Align() puts partitions on zone
+// boundaries, that FindLastInFree() stops at the end of a zone, that
+// CreatePartition() (given sectors, or left to place the partition itself)
+// makes partitions that begin and end on zone boundaries, and that Verify()
+// accepts them but flags a partition that ends in the middle of a zone.
+// "make zones" builds it; run "./gptzones [image]". The image (by default
+// /tmp/gptzones.img) is created as a sparse file and deleted when the
+// program finishes. Exits with 0 if every check passes, 1 if not.
+
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include "gpt.h"
+#include "verifyreport.h"
+
+using namespace std;
+
+#define ZONES_DISK_SIZE (UINT64_C(64) * 1024 * 1024) /* bytes */
+#define ZONES_ZONE_SIZE (UINT64_C(4) * 1024 * 1024) /* bytes */
+
+static int failures = 0;
+
+// Report a failed check.
+static void Check(const string & what, int ok) {
+   if (!ok) {
+      cerr << "Failed: " << what << "\n";
+      failures++;
+   } // if
+} // Check()
+
+// Check that partition partNum of gpt begins and ends on zone boundaries.
+static void CheckOnZones(GPTData & gpt, uint32_t partNum) {
+   uint64_t zoneSectors = gpt.ZoneSectors();
+   string name = "partition " + to_string(partNum + 1);
+
+   Check(name + " is defined", gpt.IsUsedPartNum(partNum));
+   Check(name + " begins on a zone boundary", gpt[partNum].GetFirstLBA() % zoneSectors == 0);
+   Check(name + " ends on a zone boundary", (gpt[partNum].GetLastLBA() + 1) % zoneSectors == 0);
+} // CheckOnZones()
+
+int main(int argc, char* argv[]) {
+   string filename = "/tmp/gptzones.img";
+   GPTData gpt;
+   VerifyReport report;
+   uint64_t zoneSectors, sector, last;
+   int fd;
+
+   if (argc > 1)
+      filename = argv[1];
+   fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if ((fd < 0) || (ftruncate(fd, ZONES_DISK_SIZE) != 0)) {
+      cerr << "Unable to create " << filename << "!\n";
+      return 1;
+   } // if
+   close(fd);
+   gpt.JustLooking(0);
+   gpt.BeQuiet();
+   if (!gpt.SetDisk(filename) || !gpt.ClearGPTData()) {
+      cerr << "Unable to use " << filename << "!\n";
+      unlink(filename.c_str());
+      return 1;
+   } // if
+   gpt.MakeProtectiveMBR();
+   Check("an image file isn't zoned", gpt.ZoneSectors() == 0);
+
+   gpt.SetZoneSize(ZONES_ZONE_SIZE);
+   zoneSectors = gpt.ZoneSectors();
+   Check("zone size in sectors", zoneSectors == ZONES_ZONE_SIZE / gpt.GetBlockSize());
+   Check("number of zones", gpt.GetTopology().numZones == ZONES_DISK_SIZE / ZONES_ZONE_SIZE);
+
+   // Align() moves a start into the first whole zone....
+   sector = gpt.GetFirstUsableLBA();
+   gpt.Align(&sector);
+   Check("Align() moves a start to a zone boundary", sector == zoneSectors);
+
+   // FindLastInFree() stops short of the partial zone that holds the
+   // backup partition table....
+   last = gpt.FindLastInFree(sector);
+   Check("FindLastInFree() stops at a zone end", (last + 1) % zoneSectors == 0);
+   Check("FindLastInFree() stops at the last whole zone",
+         gpt.GetLastUsableLBA() - last < zoneSectors);
+
+   // A partition smaller than a zone grows to a whole zone; one that
+   // starts and ends mid-zone is moved and trimmed to zone boundaries; one
+   // left to CreatePartition() to place fills whole zones, too....
+   Check("create a partition smaller than a zone",
+         gpt.CreatePartition(0, sector, sector + zoneSectors / 2) == 1);
+   CheckOnZones(gpt, 0);
+   Check("partition 1 fills one zone", gpt[0].GetLengthLBA() == zoneSectors);
+   Check("create a partition between zone boundaries",
+         gpt.CreatePartition(1, 3 * zoneSectors + 100, 5 * zoneSectors + 100) == 1);
+   CheckOnZones(gpt, 1);
+   Check("create a placed partition of two zones",
+         gpt.CreatePartition(2, 2 * zoneSectors) == 1);
+   CheckOnZones(gpt, 2);
+   Check("create a placed partition filling free space", gpt.CreatePartition(3, 0, 0) == 1);
+   CheckOnZones(gpt, 3);
+   Check("Verify() accepts zone-aligned partitions", gpt.Verify(report) == 0);
+
+   // A partition made as though the disk weren't zoned ends mid-zone, so
+   // Verify() should object to it once the disk is zoned again....
+   Check("delete partition 4", gpt.DeletePartition(3) == 1);
+   gpt.SetZoneSize(0);
+   Check("SetZoneSize(0) clears the number of zones", gpt.GetTopology().numZones == 0);
+   sector = gpt.FindPlacement();
+   Check("create a partition on an unzoned disk",
+         gpt.CreatePartition(3, sector, sector + zoneSectors / 2) == 1);
+   gpt.SetZoneSize(ZONES_ZONE_SIZE);
+   report.Clear();
+   gpt.Verify(report);
+   Check("Verify() flags a partition that ends mid-zone",
+         report.CountCode(verify_off_zone) == 1);
+
+   unlink(filename.c_str());
+   if (failures == 0)
+      cout << "All zoned-disk checks passed\n";
+   return failures > 0;
+} // main()
@@ -19,27 +19,24 @@
 #include <stdio.h>
 #include <time.h>
 #include <string.h>
+#include <random>
 #include <string>
 #include <iostream>
+#include "diag.h"
 #include "guid.h"
 #include "support.h"
 
 using namespace std;
 
-bool GUIDData::firstInstance = 1;
+// The random numbers for GUIDs that Randomize() has to make up itself. Each
+// thread has its own generator, seeded on first use, so that GUIDs may be
+// made in several threads at once.
+static thread_local mt19937 fallbackRandom(random_device{}() ^ (unsigned int) time(0));
 
 GUIDData::GUIDData(void) {
-   if (firstInstance) {
-      srand((unsigned int) time(0));
-      firstInstance = 0;
-   } // if
    Zero();
 } // constructor
 
-GUIDData::GUIDData(const GUIDData & orig) {
-   memcpy(uuidData, orig.uuidData, sizeof(uuidData));
-} // copy constructor
-
 GUIDData::GUIDData(const string & orig) {
    operator=(orig);
 } // copy (from string) constructor
@@ -48,14 +45,6 @@ GUIDData::GUIDData(const char * orig) {
    operator=(orig);
 } // copy (from char*) constructor
 
-GUIDData::~GUIDData(void) {
-} // destructor
-
-GUIDData & GUIDData::operator=(const GUIDData & orig) {
-   memcpy(uuidData, orig.uuidData, sizeof(uuidData));
-   return *this;
-} // GUIDData::operator=(const GUIDData & orig)
-
 // Assign the GUID from a string input value. A GUID is normally formatted
 // with four dashes as element separators, for a total length of 36
 // characters. If the input string is this long or longer, this function
@@ -159,13 +148,20 @@ void GUIDData::Randomize(void) {
 #endif
 
    if (!uuidGenerated) {
-      cerr << "Warning! Unable to generate a proper UUID! Creating an improper one as a last\n"
-           << "resort! Windows 7 may crash if you save this partition table!\a\n";
+      DIAG(diag_bad_uuid,
+           "Warning! Unable to generate a proper UUID! Creating an improper one as a last\n"
+           << "resort! Windows 7 may crash if you save this partition table!\a\n");
       for (i = 0; i < 16; i++)
-         uuidData[i] = (unsigned char) (256.0 * (rand() / (RAND_MAX + 1.0)));
+         uuidData[i] = (unsigned char) (fallbackRandom() >> 24);
    } // if
 } // GUIDData::Randomize
 
+// Seed the calling thread's generator for Randomize() afresh, as a child
+// process should, since it starts with a copy of its parent's.
+void GUIDData::Reseed(void) {
+   fallbackRandom.seed(random_device{}() ^ (unsigned int) time(0));
+} // GUIDData::Reseed()
+
 // Equality operator; returns 1 if the GUIDs are equal, 0 if they're unequal
 int GUIDData::operator==(const GUIDData & orig) const {
    return !memcmp(uuidData, orig.uuidData, sizeof(uuidData));
@@ -176,6 +172,14 @@ int GUIDData::operator!=(const GUIDData & orig) const {
    return !operator==(orig);
 } // GUIDData::operator!=
 
+// Returns 1 if the GUID is all zeroes (as for an unused partition's type
+// code), 0 otherwise
+int GUIDData::IsZero(void) const {
+   static const my_uuid_t zero = {0};
+
+   return !memcmp(uuidData, zero, sizeof(uuidData));
+} // GUIDData::IsZero()
+
 // Return the GUID as a string, suitable for display to the user.
 string GUIDData::AsString(void) const {
    char theString[40];
@@ -33,33 +33,33 @@ typedef uuid_t my_uuid_t;
 using namespace std;
 
 // Note: This class's data size is critical. If data elements must be added,
-// it will be necessary to modify various GPT classes to compensate.
+// it will be necessary to modify various GPT classes to compensate. The
+// class must also remain trivially copyable (no user-defined copy
+// constructor, assignment operator, or destructor), since GPTPart is.
 class GUIDData {
-   private:
-      static bool firstInstance;
    protected:
       my_uuid_t uuidData;
       string DeleteSpaces(string s);
    public:
       GUIDData(void);
-      GUIDData(const GUIDData & orig);
       GUIDData(const string & orig);
       GUIDData(const char * orig);
-      ~GUIDData(void);
 
       // Data assignment operators....
-      GUIDData & operator=(const GUIDData & orig);
       GUIDData & operator=(const string & orig);
       GUIDData & operator=(const char * orig);
       void Zero(void);
       void Randomize(void);
+      static void Reseed(void);
 
       // Data tests....
       int operator==(const GUIDData & orig) const;
       int operator!=(const GUIDData & orig) const;
+      int IsZero(void) const;
 
       // Data retrieval....
       string AsString(void) const;
+      const unsigned char* GetBytes(void) const {return uuidData;}
 }; // class GUIDData
 
 ostream & operator<<(ostream & os, const GUIDData & data);
@@ -0,0 +1,120 @@
+// jsonout.cc
+// Class to write JSON (for sgdisk's --format=json) a piece at a time,
+// without building a document in memory first.
+
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+#include <stdint.h>
+#include <string.h>
+#include "jsonout.h"
+
+using namespace std;
+
+// Get ready for a value (or a key): add the comma and line break or space
+// that separate it from the one before, unless it follows its key.
+void JSONWriter::StartValue(void) {
+   if (afterKey) {
+      afterKey = 0;
+   } else if (!levels.empty()) {
+      Level & level = levels.back();
+
+      if (level.compact) {
+         if (level.count > 0)
+            out.Put(", ");
+      } else {
+         out.Put((level.count > 0) ? ",\n" : "\n").PutSpaces(levels.size() * 2);
+      } // if/else
+      level.count++;
+   } // if/else if
+} // JSONWriter::StartValue()
+
+// Start an object or array. Anything inside a compact one is compact, too.
+JSONWriter & JSONWriter::Begin(char bracket, int compact) {
+   Level level;
+
+   StartValue();
+   out.Put(bracket);
+   level.compact = compact || (!levels.empty() && levels.back().compact);
+   level.count = 0;
+   levels.push_back(level);
+   return *this;
+} // JSONWriter::Begin()
+
+// Finish the innermost object or array; a line break follows the outermost.
+JSONWriter & JSONWriter::End(char bracket) {
+   if (!levels.empty()) {
+      if (!levels.back().compact && (levels.back().count > 0))
+         out.Put('\n').PutSpaces((levels.size() - 1) * 2);
+      levels.pop_back();
+   } // if
+   out.Put(bracket);
+   if (levels.empty())
+      out.Put('\n');
+   return *this;
+} // JSONWriter::End()
+
+JSONWriter & JSONWriter::Key(const char* name) {
+   StartValue();
+   PutQuoted(name, strlen(name));
+   out.Put(": ");
+   afterKey = 1;
+   return *this;
+} // JSONWriter::Key()
+
+// Add len bytes of text in quotes, escaping quotes, backslashes, and
+// control characters. Other bytes (such as UTF-8 sequences) go out as
+// they are.
+void JSONWriter::PutQuoted(const char* text, size_t len) {
+   size_t i, start;
+   unsigned char c;
+
+   out.Put('"');
+   for (i = start = 0; i < len; i++) {
+      c = (unsigned char) text[i];
+      if ((c >= 0x20) && (c != '"') && (c != '\\'))
+         continue;
+      out.Put(text + start, i - start);
+      start = i + 1;
+      switch (c) {
+         case '"': out.Put("\\\""); break;
+         case '\\': out.Put("\\\\"); break;
+         case '\n': out.Put("\\n"); break;
+         case '\r': out.Put("\\r"); break;
+         case '\t': out.Put("\\t"); break;
+         default: out.Put("\\u00").PutHex(c, 2); break;
+      } // switch
+   } // for
+   out.Put(text + start, len - start).Put('"');
+} // JSONWriter::PutQuoted()
+
+JSONWriter & JSONWriter::PutString(const char* text, size_t len) {
+   StartValue();
+   PutQuoted(text, len);
+   return *this;
+} // JSONWriter::PutString(const char*, size_t)
+
+JSONWriter & JSONWriter::PutString(const char* text) {
+   return PutString(text, strlen(text));
+} // JSONWriter::PutString(const char*)
+
+// Write value as a string of width (or more) upper-case hex digits, for
+// values (such as attribute flags) that are read as hex, or that a JSON
+// reader might round if given as a number.
+JSONWriter & JSONWriter::PutHex(uint64_t value, int width) {
+   StartValue();
+   out.Put('"').PutHex(value, width, '0', 1).Put('"');
+   return *this;
+} // JSONWriter::PutHex()
+
+JSONWriter & JSONWriter::PutDec(uint64_t value) {
+   StartValue();
+   out.PutDec(value);
+   return *this;
+} // JSONWriter::PutDec()
+
+JSONWriter & JSONWriter::PutBool(int value) {
+   StartValue();
+   out.Put(value ? "true" : "false");
+   return *this;
+} // JSONWriter::PutBool()
@@ -0,0 +1,71 @@
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+// Streaming JSON output for sgdisk's --format=json. A JSONWriter writes
+// objects, arrays, keys, and values into an OutputBuffer as they're given,
+// keeping track of nothing but how deeply they're nested (there's no
+// document tree), and adds the commas, quotes, escapes, and indentation.
+// Members of an ordinary object or array go on lines of their own; those
+// of a compact one (and of everything inside it) go on one line, separated
+// by ", ", as for one partition in a list of them:
+//
+//    {
+//      "partitions": [
+//        {"number": 1, "first_lba": 2048}
+//      ]
+//    }
+
+#include <stdint.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "outbuf.h"
+
+#ifndef __JSON_WRITER
+#define __JSON_WRITER
+
+using namespace std;
+
+class JSONWriter {
+protected:
+   struct Level {
+      int compact;
+      uint64_t count; // members written so far
+   }; // struct Level
+   OutputBuffer out;
+   vector<Level> levels;
+   int afterKey; // a key's been written, so its value follows directly
+
+   void StartValue(void);
+   void PutQuoted(const char* text, size_t len);
+   JSONWriter & Begin(char bracket, int compact);
+   JSONWriter & End(char bracket);
+public:
+   JSONWriter(void) {afterKey = 0;}
+
+   JSONWriter & BeginObject(int compact = 0) {return Begin('{', compact);}
+   JSONWriter & EndObject(void) {return End('}');}
+   JSONWriter & BeginArray(int compact = 0) {return Begin('[', compact);}
+   JSONWriter & EndArray(void) {return End(']');}
+   JSONWriter & Key(const char* name);
+
+   JSONWriter & PutString(const char* text, size_t len);
+   JSONWriter & PutString(const string & text) {return PutString(text.data(), text.size());}
+   JSONWriter & PutString(const char* text);
+   JSONWriter & PutHex(uint64_t value, int width);
+   JSONWriter & PutDec(uint64_t value);
+   JSONWriter & PutBool(int value);
+
+   // Shorthand for Key() followed by a value
+   JSONWriter & Put(const char* name, const string & text) {return Key(name).PutString(text);}
+   JSONWriter & Put(const char* name, const char* text) {return Key(name).PutString(text);}
+   JSONWriter & Put(const char* name, uint64_t value) {return Key(name).PutDec(value);}
+   JSONWriter & PutBool(const char* name, int value) {return Key(name).PutBool(value);}
+   JSONWriter & PutHex(const char* name, uint64_t value, int width) {
+      return Key(name).PutHex(value, width);
+   }
+
+   void Flush(ostream & os) {out.Flush(os);}
+}; // class JSONWriter
+
+#endif
@@ -0,0 +1,402 @@
+// layout.cc
+// Class to converge a disk's partition table on a declarative layout. A
+// layout file holds one line per partition:
+//
+//    partnum:size:type[:name[:attributes[:alignment]]]
+//
+// where size is a number of sectors, a size with a K, M, G, T, P, or E
+// suffix, a percentage of the disk's usable area (such as "25%"), or "*"
+// for whatever free space is left over; type is an sgdisk hex code or a
+// GUID; attributes is a hex value; and alignment is in sectors. Empty
+// fields mean "don't care." Text from a "#" to the end of a line is a
+// comment. Partitions that aren't in the layout are deleted.
+
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include "layout.h"
+#include "support.h"
+
+using namespace std;
+
+// Read a layout from the named file, or from standard input if filename
+// is "-". Returns 1 on success, 0 if the file couldn't be read or holds
+// an invalid line.
+int GPTLayout::ReadSpec(const string & filename) {
+   ifstream inFile;
+
+   if (filename == "-")
+      return ReadSpec(cin, "standard input");
+   inFile.open(filename.c_str());
+   if (!inFile.is_open()) {
+      cerr << "Unable to open layout file " << filename << "!\n";
+      return 0;
+   } // if
+   return ReadSpec(inFile, filename);
+} // GPTLayout::ReadSpec(const string &)
+
+// Read a layout from an input stream; source names the stream in error
+// messages. Returns 1 on success, 0 if a line is invalid.
+int GPTLayout::ReadSpec(istream & in, const string & source) {
+   string line;
+   int lineNum = 0, allOK = 1;
+
+   while (getline(in, line)) {
+      lineNum++;
+      if (!ParseLine(line, source, lineNum))
+         allOK = 0;
+   } // while
+   return allOK;
+} // GPTLayout::ReadSpec(istream &, const string &)
+
+// Parse one line of a layout file and add the result to the layout.
+// Returns 1 if the line is valid (or blank), 0 if not.
+int GPTLayout::ParseLine(const string & line, const string & source, int lineNum) {
+   LayoutEntry entry;
+   vector<string> fields;
+   string text = line, field;
+   size_t pos;
+   char *end;
+   int valid = 1;
+   uint64_t number, unitSize = 1;
+
+   pos = text.find('#');
+   if (pos != string::npos)
+      text.erase(pos);
+   istringstream inString(text);
+   while (getline(inString, field, ':')) {
+      pos = field.find_first_not_of(" \t\r");
+      field.erase(0, (pos == string::npos) ? field.length() : pos);
+      pos = field.find_last_not_of(" \t\r");
+      field.erase((pos == string::npos) ? 0 : pos + 1);
+      fields.push_back(field);
+   } // while
+   if ((fields.size() == 0) || ((fields.size() == 1) && (fields[0] == "")))
+      return 1;
+   fields.resize(6);
+
+   entry.hasType = entry.hasName = entry.hasAttributes = 0;
+   entry.attributes = 0;
+   entry.alignment = 0;
+
+   // Partition number....
+   number = strtoull(fields[0].c_str(), &end, 10);
+   if (!isdigit(fields[0][0]) || (*end != '\0') || (number < 1) || (number > UINT32_MAX))
+      valid = 0;
+   entry.partNum = (uint32_t) (number - 1);
+
+   // Size....
+   if (fields[1] == "*") {
+      entry.sizeType = layout_rest;
+      entry.size = 0;
+   } else {
+      number = strtoull(fields[1].c_str(), &end, 10);
+      if (!isdigit(fields[1][0]) || (number == 0)) {
+         valid = 0;
+      } else if (string(end) == "%") {
+         entry.sizeType = layout_percent;
+         if (number > 100)
+            valid = 0;
+      } else if (*end == '\0') {
+         entry.sizeType = layout_sectors;
+      } else {
+         pos = string("KMGTPE").find((char) toupper(*end));
+         if ((end[1] != '\0') || (pos == string::npos)) {
+            valid = 0;
+         } else {
+            entry.sizeType = layout_bytes;
+            unitSize = UINT64_C(1) << (10 * (pos + 1));
+            if (number > UINT64_MAX / unitSize)
+               valid = 0;
+            number *= unitSize;
+         } // if/else
+      } // if/else
+      entry.size = number;
+   } // if/else
+
+   // Type code....
+   if (fields[2] != "") {
+      entry.type = (GUIDData) "00000000-0000-0000-0000-000000000000";
+      entry.type = fields[2];
+      if (entry.type == (GUIDData) "00000000-0000-0000-0000-000000000000")
+         valid = 0;
+      entry.hasType = 1;
+   } // if
+
+   // Name....
+   if (fields[3] != "") {
+      entry.name = fields[3];
+      entry.hasName = 1;
+   } // if
+
+   // Attributes....
+   if (fields[4] != "") {
+      entry.attributes = strtoull(fields[4].c_str(), &end, 16);
+      if (!isxdigit(fields[4][0]) || (*end != '\0'))
+         valid = 0;
+      entry.hasAttributes = 1;
+   } // if
+
+   // Alignment....
+   if (fields[5] != "") {
+      number = strtoull(fields[5].c_str(), &end, 10);
+      if (!isdigit(fields[5][0]) || (*end != '\0') || (number < 1) || (number > UINT32_MAX))
+         valid = 0;
+      entry.alignment = (uint32_t) number;
+   } // if
+
+   if (!valid) {
+      cerr << source << ", line " << lineNum << ": invalid layout entry '" << line << "'\n";
+      return 0;
+   } // if
+   return AddEntry(entry);
+} // GPTLayout::ParseLine()
+
+// Add an entry to the layout. Returns 1 on success, 0 if the entry names
+// a partition that's already in the layout or is a second entry that takes
+// the rest of the free space.
+int GPTLayout::AddEntry(const LayoutEntry & entry) {
+   for (const LayoutEntry & other : entries) {
+      if (other.partNum == entry.partNum) {
+         cerr << "Partition " << entry.partNum + 1 << " appears more than once in the layout!\n";
+         return 0;
+      } // if
+      if ((other.sizeType == layout_rest) && (entry.sizeType == layout_rest)) {
+         cerr << "Only one partition in a layout may take the rest of the free space!\n";
+         return 0;
+      } // if
+   } // for
+   entries.push_back(entry);
+   plan.clear();
+   return 1;
+} // GPTLayout::AddEntry()
+
+// Returns the size, in sectors, that an entry asks for on disk, or 0 if
+// it takes whatever space is left. Percentages are of the disk's usable
+// area, rounded down to a multiple of the alignment.
+uint64_t GPTLayout::TargetSize(GPTData & disk, const LayoutEntry & entry) {
+   uint64_t usable, size = 0, align, blockSize = disk.GetBlockSize();
+
+   align = entry.alignment ? entry.alignment : disk.GetAlignment();
+   switch (entry.sizeType) {
+      case layout_sectors:
+         size = entry.size;
+         break;
+      case layout_bytes:
+         size = (entry.size + blockSize - 1) / blockSize;
+         break;
+      case layout_percent:
+         usable = disk.GetLastUsableLBA() - disk.GetFirstUsableLBA() + 1;
+         size = (usable / 100) * entry.size + ((usable % 100) * entry.size) / 100;
+         if (size >= align)
+            size -= size % align;
+         if (size == 0)
+            size = 1;
+         break;
+      case layout_rest:
+         break;
+   } // switch
+   return size;
+} // GPTLayout::TargetSize()
+
+// Add a step to the plan
+void GPTLayout::AddStep(LayoutAction action, uint32_t partNum, uint32_t entry, uint64_t numSectors) {
+   LayoutStep step;
+
+   step.action = action;
+   step.partNum = partNum;
+   step.entry = entry;
+   step.numSectors = numSectors;
+   plan.push_back(step);
+} // GPTLayout::AddStep()
+
+// Work out the changes needed to make disk match the layout. An existing
+// partition is kept if it's the size the layout asks for (any size will do
+// for a partition that takes the rest of the free space) and, if the layout
+// gives it an alignment, starts on that alignment; its type, name, and
+// attributes are then changed as necessary. Other partitions are deleted
+// and, if they're in the layout, re-created. Deletions come first, so that
+// their space is available to new partitions, and the partition (if any)
+// that takes the rest of the free space is created last. Returns 1 if a
+// plan could be made, 0 if the layout doesn't fit the partition table.
+int GPTLayout::MakePlan(GPTData & disk) {
+   vector<int> wanted(disk.GetNumParts(), -1);
+   vector<char> deleted(disk.GetNumParts(), 0);
+   vector<uint32_t> toCreate;
+   GPTPart part;
+   uint64_t size;
+   uint32_t i, pn, numParts = disk.GetNumParts();
+   int restEntry = -1;
+
+   plan.clear();
+   for (i = 0; i < entries.size(); i++) {
+      if (entries[i].partNum >= numParts) {
+         cerr << "Partition " << entries[i].partNum + 1 << " is beyond the end of the "
+              << numParts << "-entry partition table!\n";
+         return 0;
+      } // if
+      wanted[entries[i].partNum] = (int) i;
+   } // for
+
+   // Delete partitions that aren't wanted or don't fit the layout....
+   for (pn = 0; pn < numParts; pn++) {
+      if (!disk.IsUsedPartNum(pn))
+         continue;
+      if (wanted[pn] >= 0) {
+         const LayoutEntry & entry = entries[wanted[pn]];
+         part = disk[pn];
+         size = TargetSize(disk, entry);
+         if (((size == 0) || (part.GetLengthLBA() == size)) &&
+             ((entry.alignment == 0) || ((part.GetFirstLBA() % entry.alignment) == 0)))
+            continue;
+      } // if
+      AddStep(layout_delete, pn, 0);
+      deleted[pn] = 1;
+   } // for
+
+   // Keep the rest, fixing up their types, names, and attributes....
+   for (i = 0; i < entries.size(); i++) {
+      pn = entries[i].partNum;
+      if (!disk.IsUsedPartNum(pn) || deleted[pn]) {
+         toCreate.push_back(i);
+         continue;
+      } // if
+      part = disk[pn];
+      AddStep(layout_keep, pn, i);
+      if (entries[i].hasType && !(part.GetType() == entries[i].type))
+         AddStep(layout_retype, pn, i);
+      if (entries[i].hasName && (part.GetDescription() != entries[i].name))
+         AddStep(layout_rename, pn, i);
+      if (entries[i].hasAttributes && (part.GetAttributes().GetAttributes() != entries[i].attributes))
+         AddStep(layout_attributes, pn, i);
+   } // for
+
+   // Create the missing partitions, saving any that takes the rest for last....
+   for (i = 0; i < toCreate.size(); i++) {
+      if (entries[toCreate[i]].sizeType == layout_rest)
+         restEntry = (int) toCreate[i];
+      else
+         AddStep(layout_create, entries[toCreate[i]].partNum, toCreate[i],
+                 TargetSize(disk, entries[toCreate[i]]));
+   } // for
+   if (restEntry >= 0)
+      AddStep(layout_create, entries[restEntry].partNum, restEntry, 0);
+   return 1;
+} // GPTLayout::MakePlan()
+
+// Returns 1 if carrying out the plan would change the disk, 0 if the disk
+// already matches the layout.
+int GPTLayout::PlanChangesDisk(void) {
+   for (const LayoutStep & step : plan) {
+      if (step.action != layout_keep)
+         return 1;
+   } // for
+   return 0;
+} // GPTLayout::PlanChangesDisk()
+
+// Set a partition's attributes to those in a layout entry. Returns 1 on
+// success, 0 on failure.
+static int SetAttributes(GPTData & disk, uint32_t partNum, const LayoutEntry & entry) {
+   ostringstream hexAttributes;
+
+   hexAttributes << hex << entry.attributes;
+   return (disk.ManageAttributes(partNum, "=", hexAttributes.str()) == 1);
+} // SetAttributes()
+
+// Create a partition as a layout entry describes it, placing it according
+// to disk's placement policy (see GPTData::CreatePartition()). numSectors
+// is 0 to fill the free block it lands in. Returns 1 on success, 0 on
+// failure.
+static int CreateFromEntry(GPTData & disk, const LayoutEntry & entry, uint64_t numSectors) {
+   uint32_t diskAlignment = disk.GetAlignment();
+   int retval = 1;
+
+   if (entry.alignment && (entry.alignment != diskAlignment))
+      disk.SetAlignment(entry.alignment);
+   if (!disk.CreatePartition(entry.partNum, numSectors)) {
+      cerr << "Not enough free space for partition " << entry.partNum + 1 << "!\n";
+      retval = 0;
+   } // if
+   if (disk.GetAlignment() != diskAlignment)
+      disk.SetAlignment(diskAlignment);
+   if (retval && entry.hasType)
+      retval = disk.ChangePartType(entry.partNum, entry.type);
+   if (retval && entry.hasName)
+      retval = disk.SetName(entry.partNum, entry.name);
+   if (retval && entry.hasAttributes && entry.attributes)
+      retval = SetAttributes(disk, entry.partNum, entry);
+   return retval;
+} // CreateFromEntry()
+
+// Carry out the plan made by MakePlan() on disk, in memory. Returns 1 on
+// success, 0 if a step failed (in which case the steps before it have been
+// carried out).
+int GPTLayout::ApplyPlan(GPTData & disk) {
+   int retval = 1;
+
+   for (const LayoutStep & step : plan) {
+      switch (step.action) {
+         case layout_keep:
+            break;
+         case layout_delete:
+            retval = disk.DeletePartition(step.partNum);
+            break;
+         case layout_create:
+            retval = CreateFromEntry(disk, entries[step.entry], step.numSectors);
+            break;
+         case layout_retype:
+            retval = disk.ChangePartType(step.partNum, entries[step.entry].type);
+            break;
+         case layout_rename:
+            retval = disk.SetName(step.partNum, entries[step.entry].name);
+            break;
+         case layout_attributes:
+            retval = SetAttributes(disk, step.partNum, entries[step.entry]);
+            break;
+      } // switch
+      if (!retval) {
+         cerr << "Could not make partition " << step.partNum + 1 << " match the layout!\n";
+         break;
+      } // if
+   } // for
+   return retval;
+} // GPTLayout::ApplyPlan()
+
+// Display the plan
+void GPTLayout::ShowPlan(GPTData & disk) {
+   for (const LayoutStep & step : plan) {
+      switch (step.action) {
+         case layout_keep:
+            cout << "Keep partition " << step.partNum + 1 << "\n";
+            break;
+         case layout_delete:
+            cout << "Delete partition " << step.partNum + 1 << "\n";
+            break;
+         case layout_create:
+            cout << "Create partition " << step.partNum + 1 << " (";
+            if (step.numSectors > 0)
+               cout << BytesToIeee(step.numSectors, disk.GetBlockSize()) << ")\n";
+            else
+               cout << "rest of free space)\n";
+            break;
+         case layout_retype:
+            cout << "Change partition " << step.partNum + 1 << "'s type to "
+                 << entries[step.entry].type.TypeName() << "\n";
+            break;
+         case layout_rename:
+            cout << "Rename partition " << step.partNum + 1 << " to '" << entries[step.entry].name << "'\n";
+            break;
+         case layout_attributes:
+            cout << "Set partition " << step.partNum + 1 << "'s attributes to "
+                 << hex << entries[step.entry].attributes << dec << "\n";
+            break;
+      } // switch
+   } // for
+} // GPTLayout::ShowPlan()
@@ -0,0 +1,78 @@
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+// Declarative partition layouts. A GPTLayout holds a description of the
+// partitions a disk should have; MakePlan() compares it with a GPTData
+// object and works out the fewest changes (keep, delete, create, retype,
+// rename, set attributes) needed to make the two match, and ApplyPlan()
+// makes those changes in memory, so that the caller can save them with a
+// single SaveGPTData() call -- or skip saving if nothing changed.
+
+#include <stdint.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "gpt.h"
+#include "parttypes.h"
+
+#ifndef __GPT_LAYOUT
+#define __GPT_LAYOUT
+
+using namespace std;
+
+// How a layout entry's size is given
+enum LayoutSizeType {layout_sectors, layout_bytes, layout_percent, layout_rest};
+
+// What a plan step does to a partition
+enum LayoutAction {layout_keep, layout_delete, layout_create, layout_retype,
+                   layout_rename, layout_attributes};
+
+// One partition in a layout. Fields whose "has" flag is 0 are left alone
+// on existing partitions and take their defaults on new ones.
+struct LayoutEntry {
+   uint32_t partNum; // 0-based
+   LayoutSizeType sizeType;
+   uint64_t size; // sectors, bytes, or percent of the usable area; unused for layout_rest
+   int hasType;
+   PartType type;
+   int hasName;
+   string name;
+   int hasAttributes;
+   uint64_t attributes;
+   uint32_t alignment; // 0 to use the disk's alignment
+}; // struct LayoutEntry
+
+// One step of a plan; entry indexes the layout's entries (unused for deletes)
+struct LayoutStep {
+   LayoutAction action;
+   uint32_t partNum;
+   uint32_t entry;
+   uint64_t numSectors; // new partitions' sizes; 0 for the rest of the free space
+}; // struct LayoutStep
+
+class GPTLayout {
+protected:
+   vector<LayoutEntry> entries;
+   vector<LayoutStep> plan;
+   int ParseLine(const string & line, const string & source, int lineNum);
+   uint64_t TargetSize(GPTData & disk, const LayoutEntry & entry);
+   void AddStep(LayoutAction action, uint32_t partNum, uint32_t entry, uint64_t numSectors = 0);
+public:
+   GPTLayout(void) {}
+
+   // Build the layout....
+   int ReadSpec(const string & filename);
+   int ReadSpec(istream & in, const string & source);
+   int AddEntry(const LayoutEntry & entry);
+   void Clear(void) {entries.clear(); plan.clear();}
+
+   // Compare with, and change, a disk....
+   int MakePlan(GPTData & disk);
+   int ApplyPlan(GPTData & disk);
+   int PlanChangesDisk(void);
+   void ShowPlan(GPTData & disk);
+   const vector<LayoutStep> & GetPlan(void) const {return plan;}
+   const vector<LayoutEntry> & GetEntries(void) const {return entries;}
+}; // class GPTLayout
+
+#endif
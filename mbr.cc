@@ -30,15 +30,18 @@ using namespace std;
  *                                      *
  ****************************************/
 
-MBRData::~MBRData(void) {
-} // MBRData destructor
-
 // Assignment operator -- copy entire set of MBR data.
 MBRData & MBRData::operator=(const BasicMBRData & orig) {
    BasicMBRData::operator=(orig);
    return *this;
 } // MBRData::operator=()
 
+// Move assignment -- move entire set of MBR data.
+MBRData & MBRData::operator=(BasicMBRData && orig) {
+   BasicMBRData::operator=(move(orig));
+   return *this;
+} // MBRData::operator=(BasicMBRData &&)
+
 /*****************************************************
  *                                                   *
  * Functions to create, delete, or change partitions *
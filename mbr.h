@@ -27,8 +27,10 @@ protected:
 public:
    MBRData(void) {}
    MBRData(string deviceFilename) : BasicMBRData(deviceFilename) {}
+   // No destructor is declared, so that the compiler supplies the move
+   // constructor and move assignment operator.
    MBRData & operator=(const BasicMBRData & orig);
-   ~MBRData(void);
+   MBRData & operator=(BasicMBRData && orig);
 
    // Functions to create, delete, or change partitions
    // Pass EmptyMBR 1 to clear the boot loader code, 0 to leave it intact
@@ -25,17 +25,12 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <iostream>
+#include "diag.h"
 #include "support.h"
 #include "mbrpart.h"
 
 using namespace std;
 
-uint32_t MBRPart::numHeads = MAX_HEADS;
-uint32_t MBRPart::numSecspTrack = MAX_SECSPERTRACK;
-uint64_t MBRPart::diskSize = 0;
-uint32_t MBRPart::blockSize = 512;
-int MBRPart::numInstances = 0;
-
 MBRPart::MBRPart() {
    int i;
 
@@ -50,24 +45,20 @@ MBRPart::MBRPart() {
    includeAs = NONE;
    canBePrimary = 0;
    canBeLogical = 0;
-   if (numInstances == 0) {
-      numHeads = MAX_HEADS;
-      numSecspTrack = MAX_SECSPERTRACK;
-      diskSize = 0;
-      blockSize = 512;
-   } // if
-   numInstances++;
+   numHeads = MAX_HEADS;
+   numSecspTrack = MAX_SECSPERTRACK;
+   diskSize = 0;
+   blockSize = 512;
 }
 
 MBRPart::MBRPart(const MBRPart& orig) {
-   numInstances++;
    operator=(orig);
 }
 
 MBRPart::~MBRPart() {
-   numInstances--;
 }
 
+// Copy the partition, along with the geometry it was set up for.
 MBRPart& MBRPart::operator=(const MBRPart& orig) {
    int i;
 
@@ -82,6 +73,10 @@ MBRPart& MBRPart::operator=(const MBRPart& orig) {
    includeAs = orig.includeAs;
    canBePrimary = orig.canBePrimary;
    canBeLogical = orig.canBeLogical;
+   numHeads = orig.numHeads;
+   numSecspTrack = orig.numSecspTrack;
+   diskSize = orig.diskSize;
+   blockSize = orig.blockSize;
    return *this;
 } // MBRPart::operator=(const MBRPart& orig)
 
@@ -123,6 +118,10 @@ bool MBRPart::operator<(const MBRPart &other) const {
  *                                                *
  **************************************************/
 
+// Set the geometry of the disk the partition is on, which its CHS values
+// are computed from. Each partition has its own copy, so that partitions
+// on different disks can be worked on at once; BasicMBRData keeps those
+// of its partitions in step with its own.
 void MBRPart::SetGeometry(uint32_t heads, uint32_t sectors, uint64_t ds, uint32_t bs) {
    numHeads = heads;
    numSecspTrack = sectors;
@@ -160,14 +159,14 @@ int MBRPart::SetType(uint8_t typeCode, int isExtended) {
 
 void MBRPart::SetStartLBA(uint64_t start) {
    if (start > UINT32_MAX)
-      cerr << "Partition start out of range! Continuing, but problems now likely!\n";
+      DIAG(diag_mbr_out_of_range, "Partition start out of range! Continuing, but problems now likely!\n");
    firstLBA = (uint32_t) start;
    RecomputeCHS();
 } // MBRPart::SetStartLBA()
 
 void MBRPart::SetLengthLBA(uint64_t length) {
    if (length > UINT32_MAX)
-      cerr << "Partition length out of range! Continuing, but problems now likely!\n";
+      DIAG(diag_mbr_out_of_range, "Partition length out of range! Continuing, but problems now likely!\n");
    lengthLBA = (uint32_t) length;
    RecomputeCHS();
 } // MBRPart::SetLengthLBA()
@@ -179,8 +178,8 @@ void MBRPart::SetLocation(uint64_t start, uint64_t length) {
    int validCHS;
 
    if ((start > UINT32_MAX) || (length > UINT32_MAX)) {
-      cerr << "Partition values out of range in MBRPart::SetLocation()!\n"
-           << "Continuing, but strange problems are now likely!\n";
+      DIAG(diag_mbr_out_of_range, "Partition values out of range in MBRPart::SetLocation()!\n"
+           << "Continuing, but strange problems are now likely!\n");
    } // if
    firstLBA = (uint32_t) start;
    lengthLBA = (uint32_t) length;
@@ -64,11 +64,11 @@ protected:
    int includeAs; // PRIMARY, LOGICAL, or NONE
    int canBeLogical;
    int canBePrimary;
-   static uint32_t numHeads;
-   static uint32_t numSecspTrack;
-   static uint64_t diskSize;
-   static uint32_t blockSize;
-   static int numInstances;
+   // The disk's geometry, for CHS values; see SetGeometry()
+   uint32_t numHeads;
+   uint32_t numSecspTrack;
+   uint64_t diskSize;
+   uint32_t blockSize;
 
 public:
     MBRPart();
@@ -0,0 +1,63 @@
+// outbuf.cc
+// Class to build up listings (such as the partition table display) in
+// memory, with fixed-width number formatting, and write them out in one go.
+
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+#include <stdint.h>
+#include <charconv>
+#include <iostream>
+#include "outbuf.h"
+#include "support.h"
+
+using namespace std;
+
+// Append len bytes of text, preceded by enough copies of fill to make
+// width bytes in all. As with ostream::width(), longer text isn't
+// truncated.
+OutputBuffer & OutputBuffer::PutPadded(const char* text, size_t len, int width, char fill) {
+   if ((width > 0) && (len < (size_t) width))
+      buf.append(width - len, fill);
+   buf.append(text, len);
+   return *this;
+} // OutputBuffer::PutPadded()
+
+// Append value in decimal, padded on the left to width characters.
+OutputBuffer & OutputBuffer::PutDec(uint64_t value, int width, char fill) {
+   char digits[20];
+   to_chars_result result;
+
+   result = to_chars(digits, digits + sizeof(digits), value);
+   return PutPadded(digits, result.ptr - digits, width, fill);
+} // OutputBuffer::PutDec()
+
+// Append value in hexadecimal (with no "0x"), padded on the left to width
+// characters, using upper-case digits if upper is non-zero.
+OutputBuffer & OutputBuffer::PutHex(uint64_t value, int width, char fill, int upper) {
+   char digits[16];
+   to_chars_result result;
+   char *c;
+
+   result = to_chars(digits, digits + sizeof(digits), value, 16);
+   if (upper) {
+      for (c = digits; c < result.ptr; c++) {
+         if (*c >= 'a')
+            *c -= 'a' - 'A';
+      } // for
+   } // if
+   return PutPadded(digits, result.ptr - digits, width, fill);
+} // OutputBuffer::PutHex()
+
+// Append size sectors of sectorSize bytes as BytesToIeee() shows them.
+OutputBuffer & OutputBuffer::PutIeee(uint64_t size, uint32_t sectorSize) {
+   char text[IEEE_SIZE_LENGTH];
+
+   return Put(text, BytesToIeee(size, sectorSize, text));
+} // OutputBuffer::PutIeee()
+
+// Write everything collected so far to os, and empty the buffer.
+void OutputBuffer::Flush(ostream & os) {
+   os.write(buf.data(), buf.size());
+   buf.clear();
+} // OutputBuffer::Flush()
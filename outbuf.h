@@ -0,0 +1,41 @@
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+// Buffered output for partition-table listings. An OutputBuffer collects
+// text, decimal and hex numbers padded to fixed widths, and IEEE-style sizes
+// (as BytesToIeee() gives them) in a single growable string, formatting
+// numbers with to_chars() rather than iostream manipulators, and writes it
+// all to a stream at once with Flush().
+
+#include <stdint.h>
+#include <iostream>
+#include <string>
+
+#ifndef __OUTPUT_BUFFER
+#define __OUTPUT_BUFFER
+
+using namespace std;
+
+class OutputBuffer {
+protected:
+   string buf;
+
+   OutputBuffer & PutPadded(const char* text, size_t len, int width, char fill);
+public:
+   OutputBuffer(void) {}
+
+   OutputBuffer & Put(char c) {buf.push_back(c); return *this;}
+   OutputBuffer & Put(const char* text, size_t len) {buf.append(text, len); return *this;}
+   OutputBuffer & Put(const char* text) {buf.append(text); return *this;}
+   OutputBuffer & Put(const string & text) {buf.append(text); return *this;}
+   OutputBuffer & PutSpaces(size_t count) {buf.append(count, ' '); return *this;}
+   OutputBuffer & PutDec(uint64_t value, int width = 0, char fill = ' ');
+   OutputBuffer & PutHex(uint64_t value, int width = 0, char fill = '0', int upper = 0);
+   OutputBuffer & PutIeee(uint64_t size, uint32_t sectorSize);
+
+   const string & GetText(void) const {return buf;}
+   void Clear(void) {buf.clear();}
+   void Flush(ostream & os);
+}; // class OutputBuffer
+
+#endif
@@ -0,0 +1,314 @@
+// partstore.cc
+// Class to hold a partition table's entries in memory in proportion to the
+// number of partitions, rather than the number of entries the table can
+// hold, which may be far bigger.
+
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include "crc32.h"
+#include "partstore.h"
+
+using namespace std;
+
+// Bytes of zeros fed to the CRC at a time for runs of blank entries
+#define ZERO_RUN_CHUNK 4096
+
+// The entry that unstored entries read as
+static const GPTPart & BlankEntry(void) {
+   static const GPTPart blank;
+
+   return blank;
+} // BlankEntry()
+
+// Returns 1 if the length bytes at data are all 0, 0 if not. (If the first
+// is 0 and each of the rest matches the one before it, all are 0.)
+static int AllZero(const uint8_t* data, size_t length) {
+   return (length == 0) || ((data[0] == 0) && (memcmp(data, data + 1, length - 1) == 0));
+} // AllZero()
+
+// Extend crc to cover length bytes of zeros.
+static uint32_t ZeroRunCRC(uint32_t crc, uint64_t length) {
+   static const unsigned char zeros[ZERO_RUN_CHUNK] = {0};
+   unsigned int chunk;
+
+   while (length > 0) {
+      chunk = (unsigned int) min(length, (uint64_t) ZERO_RUN_CHUNK);
+      crc = chksum_crc32_continue(crc, (unsigned char*) zeros, chunk);
+      length -= chunk;
+   } // while
+   return crc;
+} // ZeroRunCRC()
+
+PartitionStore::PartitionStore(void) {
+   contents = make_shared<Contents>();
+   numSlots = 0;
+   tailSize = 0;
+} // PartitionStore constructor
+
+// Store entry pn, as a blank entry, if it isn't stored already. Returns its
+// place in the array of stored entries.
+uint32_t PartitionStore::Store(uint32_t pn) {
+   Contents & c = Own();
+   map<uint32_t, uint32_t>::const_iterator it = c.places.find(pn);
+   uint32_t place;
+
+   if (it != c.places.end())
+      return it->second;
+   place = c.parts.size();
+   c.places[pn] = place;
+   c.parts.push_back(GPTPart());
+   c.nums.push_back(pn);
+   c.tails.resize(c.tails.size() + tailSize, 0);
+   return place;
+} // PartitionStore::Store()
+
+// Returns 1 if the stored entry at place i is blank (all its bytes are 0),
+// 0 if not.
+int PartitionStore::IsBlank(uint32_t i) const {
+   return AllZero((const uint8_t*) &contents->parts[i], GPT_SIZE) &&
+          AllZero(TailAt(i), tailSize);
+} // PartitionStore::IsBlank()
+
+// Returns the stored entries for modification, first making a private copy
+// of them if they're shared with other stores.
+PartitionStore::Contents & PartitionStore::Own(void) {
+   if (contents.use_count() > 1)
+      contents = make_shared<Contents>(*contents);
+   return *contents;
+} // PartitionStore::Own()
+
+// Change the number of entries in the table. Entries past the new end are
+// discarded.
+void PartitionStore::Resize(uint32_t newNumSlots) {
+   while (!contents->places.empty() && (contents->places.rbegin()->first >= newNumSlots))
+      Erase(contents->places.rbegin()->first);
+   numSlots = newNumSlots;
+} // PartitionStore::Resize()
+
+// Change the number of bytes of vendor data per entry. Any that were held
+// are discarded, leaving the entries' tails all 0.
+void PartitionStore::SetTailSize(uint32_t newTailSize) {
+   if (newTailSize != tailSize) {
+      Own().tails.assign(NumStored() * newTailSize, 0);
+      tailSize = newTailSize;
+   } // if
+} // PartitionStore::SetTailSize()
+
+// Blank every entry.
+void PartitionStore::Clear(void) {
+   contents = make_shared<Contents>();
+} // PartitionStore::Clear()
+
+// Returns entry pn, which must be less than GetNumSlots(), not for
+// modification. The reference is good until the store is next changed.
+const GPTPart & PartitionStore::operator[](uint32_t pn) const {
+   map<uint32_t, uint32_t>::const_iterator it = contents->places.find(pn);
+
+   if (it == contents->places.end())
+      return BlankEntry();
+   return contents->parts[it->second];
+} // PartitionStore::operator[]()
+
+// Returns entry pn for modification. The reference is good until the store
+// is next changed by anything but changes made through the reference.
+GPTPart & PartitionStore::Edit(uint32_t pn) {
+   uint32_t i = Store(pn);
+
+   return contents->parts[i];
+} // PartitionStore::Edit()
+
+// Returns a copy of the vendor data of entry pn.
+string PartitionStore::GetTail(uint32_t pn) const {
+   map<uint32_t, uint32_t>::const_iterator it = contents->places.find(pn);
+
+   if (it == contents->places.end())
+      return string(tailSize, '\0');
+   return string((const char*) TailAt(it->second), tailSize);
+} // PartitionStore::GetTail()
+
+// Make entry pn hold part, followed by tail (truncated or padded with 0s to
+// GetTailSize() bytes). If that makes it blank, it's no longer stored.
+void PartitionStore::SetEntry(uint32_t pn, const GPTPart & part, const string & tail) {
+   uint32_t i = Store(pn);
+   size_t tailLen = min((size_t) tailSize, tail.size());
+   uint8_t* entryTail = TailAt(i);
+
+   contents->parts[i] = part;
+   if (tailSize > 0) {
+      memcpy(entryTail, tail.data(), tailLen);
+      memset(entryTail + tailLen, 0, tailSize - tailLen);
+   } // if
+   if (IsBlank(i))
+      Erase(pn);
+} // PartitionStore::SetEntry()
+
+// Blank entry pn. The last stored entry is moved into its place, so that
+// the array stays compact.
+void PartitionStore::Erase(uint32_t pn) {
+   map<uint32_t, uint32_t>::iterator it;
+   uint32_t place, last;
+
+   if (contents->places.count(pn) == 0)
+      return;
+   Contents & c = Own();
+   it = c.places.find(pn);
+   place = it->second;
+   last = c.parts.size() - 1;
+   c.places.erase(it);
+   if (place != last) {
+      c.parts[place] = c.parts[last];
+      c.nums[place] = c.nums[last];
+      memcpy(TailAt(place), TailAt(last), tailSize);
+      c.places[c.nums[place]] = place;
+   } // if
+   c.parts.pop_back();
+   c.nums.pop_back();
+   c.tails.resize((uint64_t) last * tailSize);
+} // PartitionStore::Erase()
+
+// Exchange the contents of entries pn1 and pn2. Only the map from entry
+// numbers to places changes.
+void PartitionStore::Swap(uint32_t pn1, uint32_t pn2) {
+   map<uint32_t, uint32_t>::iterator it1, it2;
+   uint32_t place;
+
+   if ((pn1 == pn2) || ((contents->places.count(pn1) == 0) && (contents->places.count(pn2) == 0)))
+      return;
+   Contents & c = Own();
+   it1 = c.places.find(pn1);
+   it2 = c.places.find(pn2);
+   if ((it1 != c.places.end()) && (it2 != c.places.end())) {
+      swap(it1->second, it2->second);
+      c.nums[it1->second] = pn1;
+      c.nums[it2->second] = pn2;
+   } else {
+      if (it1 == c.places.end()) { // only pn2 is stored; move it to pn1
+         swap(pn1, pn2);
+         it1 = it2;
+      } // if
+      place = it1->second;
+      c.places.erase(it1);
+      c.places[pn2] = place;
+      c.nums[place] = pn2;
+   } // if/else
+} // PartitionStore::Swap()
+
+// Move the stored entries to new numbers: the ith stored entry, in order of
+// entry number, becomes entry newNums[i]. newNums must have NumStored()
+// distinct values, each less than GetNumSlots(); entries not given a new
+// number are left blank. The entries themselves stay where they are.
+void PartitionStore::Renumber(const vector<uint32_t> & newNums) {
+   vector<pair<uint32_t, uint32_t> > renumbered;
+   map<uint32_t, uint32_t>::const_iterator it;
+   size_t i = 0;
+
+   Contents & c = Own();
+   renumbered.reserve(c.parts.size());
+   for (it = c.places.begin(); it != c.places.end(); it++) {
+      renumbered.push_back(make_pair(newNums[i], it->second));
+      c.nums[it->second] = newNums[i];
+      i++;
+   } // for
+   // Sorted, the new map can be built from the end, which costs constant
+   // time per entry rather than a search....
+   sort(renumbered.begin(), renumbered.end());
+   c.places.clear();
+   for (i = 0; i < renumbered.size(); i++)
+      c.places.insert(c.places.end(), renumbered[i]);
+} // PartitionStore::Renumber()
+
+// Replace the entries with those of table, an on-disk image of
+// GetNumSlots() entries of GPT_SIZE + GetTailSize() bytes each. Only the
+// entries that aren't blank are stored.
+void PartitionStore::Unpack(const uint8_t* table) {
+   shared_ptr<Contents> loaded = make_shared<Contents>();
+   uint64_t entrySize = GPT_SIZE + tailSize;
+   const uint8_t* entry;
+   vector<uint32_t> nums;
+   uint32_t pn, i;
+
+   // Find the non-blank entries first, so that the arrays can be allocated
+   // once....
+   for (pn = 0; pn < numSlots; pn++) {
+      if (!AllZero(table + pn * entrySize, entrySize))
+         nums.push_back(pn);
+   } // for
+   loaded->parts.resize(nums.size());
+   loaded->tails.resize(nums.size() * tailSize);
+   for (i = 0; i < nums.size(); i++) {
+      entry = table + nums[i] * entrySize;
+      memcpy(&loaded->parts[i], entry, GPT_SIZE);
+      loaded->places.insert(loaded->places.end(), make_pair(nums[i], i));
+   } // for
+   loaded->nums.swap(nums);
+   contents = loaded;
+   for (i = 0; (tailSize > 0) && (i < NumStored()); i++)
+      memcpy(TailAt(i), table + contents->nums[i] * entrySize + GPT_SIZE, tailSize);
+} // PartitionStore::Unpack()
+
+// Write the on-disk image of count entries, starting with entry first, to
+// table, which must hold count * (GPT_SIZE + GetTailSize()) bytes. The
+// table can thus be written out a piece at a time.
+void PartitionStore::Pack(uint8_t* table, uint32_t first, uint32_t count) const {
+   uint64_t entrySize = GPT_SIZE + tailSize;
+   StoredIterator it;
+   uint8_t* entry;
+
+   memset(table, 0, count * entrySize);
+   for (it = contents->places.lower_bound(first);
+        (it != EndStored()) && (it->first - first < count); it++) {
+      entry = table + (it->first - first) * entrySize;
+      memcpy(entry, &contents->parts[it->second], GPT_SIZE);
+      if (tailSize > 0)
+         memcpy(entry + GPT_SIZE, TailAt(it->second), tailSize);
+   } // for
+} // PartitionStore::Pack()
+
+// Returns the CRC of the on-disk image of the table, as Pack() would write
+// it, computed without building the image.
+uint32_t PartitionStore::ComputeCRC(void) const {
+   uint64_t entrySize = GPT_SIZE + tailSize;
+   uint32_t crc = 0, next = 0;
+   StoredIterator it;
+
+   for (it = BeginStored(); it != EndStored(); it++) {
+      crc = ZeroRunCRC(crc, (it->first - next) * entrySize);
+      crc = chksum_crc32_continue(crc, (unsigned char*) &contents->parts[it->second], GPT_SIZE);
+      if (tailSize > 0)
+         crc = chksum_crc32_continue(crc, TailAt(it->second), tailSize);
+      next = it->first + 1;
+   } // for
+   return ZeroRunCRC(crc, (numSlots - next) * entrySize);
+} // PartitionStore::ComputeCRC()
+
+// Reverse the byte order of the integer fields of every entry. (Blank
+// entries read the same either way.)
+void PartitionStore::ReverseBytes(void) {
+   for (GPTPart & part : Own().parts)
+      part.ReversePartBytes();
+} // PartitionStore::ReverseBytes()
+
+// Returns 1 if this store and other hold the same table, entry for entry
+// and byte for byte, 0 if not.
+int PartitionStore::SameAs(const PartitionStore & other) const {
+   StoredIterator it;
+
+   if ((numSlots != other.numSlots) || (tailSize != other.tailSize))
+      return 0;
+   // Every entry stored in one must match the same entry in the other,
+   // whether stored or blank....
+   for (it = BeginStored(); it != EndStored(); it++) {
+      if ((memcmp(&contents->parts[it->second], &other[it->first], GPT_SIZE) != 0) ||
+          (GetTail(it->first) != other.GetTail(it->first)))
+         return 0;
+   } // for
+   for (it = other.BeginStored(); it != other.EndStored(); it++) {
+      if ((contents->places.count(it->first) == 0) && !other.IsBlank(it->second))
+         return 0;
+   } // for
+   return 1;
+} // PartitionStore::SameAs()
@@ -0,0 +1,81 @@
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+// Compact storage for a GPT's partition entries. A PartitionStore stands for
+// a table of GetNumSlots() entries, each GPT_SIZE bytes plus GetTailSize()
+// bytes of vendor data, but holds only the entries that have something in
+// them, in a compact array (in no particular order) along with a map from
+// entry numbers to places in the array; the rest read as blank entries.
+// Memory use thus follows the number of partitions rather than the size of
+// the table. The on-disk (dense) form of the table is built only by Pack(),
+// a piece at a time for writing it out, and ComputeCRC() checksums it
+// without building it.
+// Copies share the stored entries until one of them is changed, so copying a
+// store (as for the undo journal) is cheap.
+
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "gptpart.h"
+
+#ifndef __GPT_PARTITION_STORE
+#define __GPT_PARTITION_STORE
+
+using namespace std;
+
+class PartitionStore {
+protected:
+   struct Contents {
+      map<uint32_t, uint32_t> places; // entry number -> place in parts
+      vector<GPTPart> parts; // the stored entries
+      vector<uint32_t> nums; // nums[i] is the number of entry parts[i]
+      vector<uint8_t> tails; // and its tail is at tails[i * tailSize]
+   }; // struct Contents
+   shared_ptr<Contents> contents;
+   uint32_t numSlots;
+   uint32_t tailSize;
+
+   uint8_t* TailAt(uint32_t i) const {return contents->tails.data() + (uint64_t) i * tailSize;}
+   uint32_t Store(uint32_t pn);
+   int IsBlank(uint32_t i) const;
+   Contents & Own(void);
+public:
+   // Walks the stored entries in ascending order of entry number; it->first
+   // is the entry number, and Stored(it) the entry.
+   typedef map<uint32_t, uint32_t>::const_iterator StoredIterator;
+
+   PartitionStore(void);
+
+   uint32_t GetNumSlots(void) const {return numSlots;}
+   uint32_t GetTailSize(void) const {return tailSize;}
+   void Resize(uint32_t newNumSlots);
+   void SetTailSize(uint32_t newTailSize);
+   void Clear(void);
+
+   // Entries by number. Edit() stores the entry, if it isn't stored
+   // already, so it can be changed.
+   const GPTPart & operator[](uint32_t pn) const;
+   GPTPart & Edit(uint32_t pn);
+   string GetTail(uint32_t pn) const;
+   void SetEntry(uint32_t pn, const GPTPart & part, const string & tail);
+   void Erase(uint32_t pn);
+   void Swap(uint32_t pn1, uint32_t pn2);
+   void Renumber(const vector<uint32_t> & newNums);
+
+   // The stored entries
+   size_t NumStored(void) const {return contents->parts.size();}
+   StoredIterator BeginStored(void) const {return contents->places.begin();}
+   StoredIterator EndStored(void) const {return contents->places.end();}
+   const GPTPart & Stored(StoredIterator it) const {return contents->parts[it->second];}
+
+   // Conversion to and from the on-disk form
+   void Unpack(const uint8_t* table);
+   void Pack(uint8_t* table, uint32_t first, uint32_t count) const;
+   uint32_t ComputeCRC(void) const;
+   void ReverseBytes(void);
+   int SameAs(const PartitionStore & other) const;
+}; // class PartitionStore
+
+#endif
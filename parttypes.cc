@@ -14,11 +14,14 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "diag.h"
 #include "parttypes.h"
+#include "outbuf.h"
 
 using namespace std;
 
-int PartType::numInstances = 0;
 AType* PartType::allTypes = NULL;
 AType* PartType::lastType = NULL;
 
@@ -26,54 +29,36 @@ AType* PartType::lastType = NULL;
 #define NUM_COLUMNS 2
 #define DESC_LENGTH (SCREEN_WIDTH - (6 * NUM_COLUMNS)) / NUM_COLUMNS
 
-// Constructor. Its main task is to initialize the data list, but only
-// if this is the first instance, since it's a static linked list.
-// Partition type codes are MBR type codes multiplied by 0x0100, with
-// additional related codes taking on following numbers. For instance,
-// the FreeBSD disklabel code in MBR is 0xa5; here, it's 0xa500, with
-// additional FreeBSD codes being 0xa501, 0xa502, and so on. This gives
-// related codes similar numbers and (given appropriate entry positions
-// in the linked list) keeps them together in the listings generated
-// by typing "L" at the main gdisk menu.
 PartType::PartType(void) : GUIDData() {
-   numInstances++;
-   if (numInstances == 1) {
-      AddAllTypes();
-   } // if
 } // default constructor
 
-PartType::PartType(const PartType & orig) : GUIDData(orig) {
-   numInstances++;
-   if (numInstances == 1) { // should never happen; just being paranoid
-      AddAllTypes();
-   } // if
-} // PartType copy constructor
-
 PartType::PartType(const GUIDData & orig) : GUIDData(orig) {
-   numInstances++;
-   if (numInstances == 1) {
-      AddAllTypes();
-   } // if
 } // PartType copy constructor
 
-PartType::~PartType(void) {
-   AType* tempType;
+// Return the start of the type list, building it first if need be. The
+// list is built only once, on first use, and never changes afterwards, so
+// it may be read from any number of threads; C++ guarantees that a
+// function-local static is initialized exactly once, even if several
+// threads get here at once.
+const AType* PartType::TypeList(void) {
+   static const int typesReady = AddAllTypes();
 
-   numInstances--;
-   if (numInstances == 0) {
-      while (allTypes != NULL) {
-         tempType = allTypes;
-         allTypes = allTypes->next;
-         delete tempType;
-      } // while
-   } // if
-} // destructor
+   (void) typesReady;
+   return allTypes;
+} // PartType::TypeList()
 
 // Add all partition type codes to the internal linked-list structure.
-// Used by constructors.
+// Used by TypeList(). Returns 1.
+// Partition type codes are MBR type codes multiplied by 0x0100, with
+// additional related codes taking on following numbers. For instance,
+// the FreeBSD disklabel code in MBR is 0xa5; here, it's 0xa500, with
+// additional FreeBSD codes being 0xa501, 0xa502, and so on. This gives
+// related codes similar numbers and (given appropriate entry positions
+// in the linked list) keeps them together in the listings generated
+// by typing "L" at the main gdisk menu.
 // See http://www.win.tue.nl/~aeb/partitions/partition_types-1.html
 // for a list of MBR partition type codes.
-void PartType::AddAllTypes(void) {
+int PartType::AddAllTypes(void) {
    // Start with the "unused entry," which should normally appear only
    // on empty partition table entries....
    AddType(0x0000, "00000000-0000-0000-0000-000000000000", "Unused entry", 0);
@@ -358,6 +343,7 @@ void PartType::AddAllTypes(void) {
 
    // Note: DO NOT use the 0xffff code; that's reserved to indicate an
    // unknown GUID type code.
+   return 1;
 } // PartType::AddAllTypes()
 
 // Add a single type to the linked list of types. Returns 1 if operation
@@ -381,8 +367,8 @@ int PartType::AddType(uint16_t mbrType, const char * guidData, const char * name
       } // if/else
       lastType = tempType;
    } else {
-      cerr << "Unable to allocate memory in PartType::AddType()! Partition type list will\n";
-      cerr << "be incomplete!\n";
+      DIAG(diag_no_memory, "Unable to allocate memory in PartType::AddType()! Partition type list will\n"
+           << "be incomplete!\n");
       allOK = 0;
    } // if/else
    return allOK;
@@ -413,9 +399,11 @@ PartType & PartType::operator=(const char * orig) {
 
 // Assign a GUID based on my custom 2-byte (16-bit) MBR hex ID variant
 PartType & PartType::operator=(uint16_t ID) {
-   AType* theItem = allTypes;
+   const AType* theItem;
    int found = 0;
 
+   theItem = TypeList();
+
    // Now search the type list for a match to the ID....
    while ((theItem != NULL) && (!found)) {
       if (theItem->MBRType == ID)  {
@@ -428,46 +416,23 @@ PartType & PartType::operator=(uint16_t ID) {
    if (!found) {
       // Assign a default value....
       operator=(DEFAULT_GPT_TYPE);
-      cout.setf(ios::uppercase);
-      cout.fill('0');
-      cout << "Exact type match not found for type code ";
-      cout.width(4);
-      cout << hex << ID << "; assigning type code for\n'" << TypeName() << "'\n" << dec;
-      cout.fill(' ');
+      DIAG(diag_unknown_type, "Exact type match not found for type code " << uppercase << hex
+           << setfill('0') << setw(4) << ID << "; assigning type code for\n'" << TypeName() << "'\n");
    } // if (!found)
    return *this;
 } // PartType::operator=(uint16_t ID)
 
 // Return the English description of the partition type (e.g., "Linux filesystem")
 string PartType::TypeName(void) const {
-   AType* theItem = allTypes;
+   const AType* theItem;
    int found = 0;
    string typeName;
 
-   while ((theItem != NULL) && (!found)) {
-      if (theItem->GUIDType == *this) { // found it!
-         typeName = theItem->name;
-         found = 1;
-      } else {
-         theItem = theItem->next;
-      } // if/else
-   } // while
-   if (!found) {
-      typeName = "Unknown";
-   } // if (!found)
-   return typeName;
-} // PartType::TypeName()
-
-#ifdef USE_UTF16
-// Return the Unicode description of the partition type (e.g., "Linux filesystem")
-UnicodeString PartType::UTypeName(void) const {
-   AType* theItem = allTypes;
-   int found = 0;
-   UnicodeString typeName;
+   theItem = TypeList();
 
    while ((theItem != NULL) && (!found)) {
       if (theItem->GUIDType == *this) { // found it!
-         typeName = theItem->name.c_str();
+         typeName = theItem->name;
          found = 1;
       } else {
          theItem = theItem->next;
@@ -478,7 +443,6 @@ UnicodeString PartType::UTypeName(void) const {
    } // if (!found)
    return typeName;
 } // PartType::TypeName()
-#endif
 
 // Return the custom GPT fdisk 2-byte (16-bit) hex code for this GUID partition type
 // Note that this function ignores entries for which the display variable
@@ -486,10 +450,12 @@ UnicodeString PartType::UTypeName(void) const {
 // there are multiple possibilities, but opens the algorithm up to the
 // potential for problems should the data in the list be bad.
 uint16_t PartType::GetHexType() const {
-   AType* theItem = allTypes;
+   const AType* theItem;
    int found = 0;
    uint16_t theID = 0xFFFF;
 
+   theItem = TypeList();
+
    while ((theItem != NULL) && (!found)) {
       if ((theItem->GUIDType == *this) && (theItem->display == 1)) { // found it!
          theID = theItem->MBRType;
@@ -515,10 +481,12 @@ uint16_t PartType::GetHexType() const {
 // (namely, sgdisk).
 void PartType::ShowAllTypes(int maxLines) const {
    int colCount = 1, lineCount = 1;
-   size_t i;
-   AType* thisType = allTypes;
+   const AType* thisType;
    string line, matchString = "";
-   size_t found;
+   size_t found, nameLen;
+   OutputBuffer out;
+
+   thisType = TypeList();
 
    cout.unsetf(ios::uppercase);
    if (maxLines > 0) {
@@ -528,36 +496,36 @@ void PartType::ShowAllTypes(int maxLines) const {
    while (thisType != NULL) {
       found = thisType->name.find(matchString);
       if ((thisType->display == 1) && (found != string::npos)) { // show it
-         cout.fill('0');
-         cout.width(4);
-         cout << hex << thisType->MBRType << " ";
-         cout << thisType->name.substr(0, DESC_LENGTH);
-         for (i = 0; i < (DESC_LENGTH - (thisType->name.substr(0, DESC_LENGTH).length())); i++)
-            cout << " ";
+         nameLen = min(thisType->name.length(), (size_t) DESC_LENGTH);
+         out.PutHex(thisType->MBRType, 4).Put(' ');
+         out.Put(thisType->name.data(), nameLen).PutSpaces(DESC_LENGTH - nameLen);
          if ((colCount % NUM_COLUMNS) == 0) {
             if (thisType->next) {
-               cout << "\n";
+               out.Put('\n');
                if ((maxLines > 0) && (lineCount++ % maxLines) == 0) {
-                  cout << "Press the <Enter> key to see more codes: ";
+                  out.Put("Press the <Enter> key to see more codes: ");
+                  out.Flush(cout);
                   getline(cin, line);
                } // if reached screen line limit
             } // if there's another entry following this one
          } else {
-            cout << "  ";
+            out.Put("  ");
          }
          colCount++;
       } // if
       thisType = thisType->next;
    } // while
-   cout.fill(' ');
-   cout << "\n" << dec;
+   out.Put('\n');
+   out.Flush(cout);
 } // PartType::ShowAllTypes(int maxLines)
 
 // Returns 1 if code is a valid extended MBR code, 0 if it's not
 int PartType::Valid(uint16_t code) const {
-   AType* thisType = allTypes;
+   const AType* thisType;
    int found = 0;
 
+   thisType = TypeList();
+
    while ((thisType != NULL) && (!found)) {
       if (thisType->MBRType == code) {
          found = 1;
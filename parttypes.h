@@ -3,11 +3,9 @@
 
 #include <stdint.h>
 #include <stdlib.h>
-#ifdef USE_UTF16
-#include <unicode/ustream.h>
-#else
+// Partition names are UTF-8 strings, converted to and from UTF-16 by the
+// routines in utf16.cc; the old ICU-based build is no longer needed.
 #define UnicodeString string
-#endif
 #include <string>
 #include "support.h"
 #include "guid.h"
@@ -29,20 +27,20 @@ struct AType {
    AType* next;
 }; // struct AType
 
+// Note: Like GUIDData, PartType must remain trivially copyable, since it's
+// part of GPTPart. The type list is therefore built on first use (by
+// TypeList()) rather than by a reference-counting constructor, and is
+// read-only once it's built.
 class PartType : public GUIDData {
 protected:
-   static int numInstances;
    static AType* allTypes; // Linked list holding all the data
    static AType* lastType; // Pointer to last entry in the list
-   void AddAllTypes(void);
+   static int AddAllTypes(void);
+   static int AddType(uint16_t mbrType, const char * guidData, const char * name, int toDisplay = 1);
+   static const AType* TypeList(void);
 public:
    PartType(void);
-   PartType(const PartType & orig);
    PartType(const GUIDData & orig);
-   ~PartType(void);
-
-   // Set up type information
-   int AddType(uint16_t mbrType, const char * guidData, const char * name, int toDisplay = 1);
 
    // New assignment operators....
    PartType & operator=(const string & orig);
@@ -56,7 +54,6 @@ public:
 
    // Retrieve transformed GUID data based on type code matches
    string TypeName(void) const;
-   UnicodeString UTypeName(void) const;
    uint16_t GetHexType() const;
 
    // Information relating to all type data
@@ -0,0 +1,305 @@
+// probe.cc
+// Class to take a quick, read-only look at the MBR and GPT data on a disk,
+// without the overhead (or the chatter) of loading it into a GPTData object.
+
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "probe.h"
+#include "crc32.h"
+#include "gpt.h"
+#include "support.h"
+
+using namespace std;
+
+// Return the numBytes-byte little-endian value at data, as GPT and MBR data
+// structures store them, whatever the CPU's byte order.
+static uint64_t GetLE(const unsigned char* data, int numBytes) {
+   uint64_t value = 0;
+
+   while (numBytes-- > 0)
+      value = (value << 8) | data[numBytes];
+   return value;
+} // GetLE()
+
+// Extended partition types, whose partitions hold EBRs rather than data
+static int IsExtended(uint8_t type) {
+   return (type == 0x05) || (type == 0x0f) || (type == 0x85);
+} // IsExtended()
+
+PartitionProbe::PartitionProbe(void) {
+   fd = -1;
+   error = 0;
+   blockSize = SECTOR_SIZE;
+   diskSize = 0;
+   memset(diskGUID, 0, sizeof(diskGUID));
+   numParts = entrySize = 0;
+} // PartitionProbe constructor
+
+PartitionProbe::~PartitionProbe(void) {
+   Close();
+} // PartitionProbe destructor
+
+// Open device, read-only, and find its sector size (unless sectorSize is
+// non-0, in which case it's used as-is) and its size. Returns 1 on success,
+// 0 on failure (in which case GetError() tells why).
+int PartitionProbe::Open(const string & device, uint32_t sectorSize) {
+   struct stat st;
+   uint64_t bytes = 0;
+   int ssize = 0;
+
+   Close();
+   error = 0;
+   fd = open(device.c_str(), O_RDONLY);
+   if (fd < 0) {
+      error = errno;
+      return 0;
+   } // if
+   blockSize = sectorSize;
+   if (blockSize == 0) {
+#ifdef __linux__
+      if (ioctl(fd, BLKSSZGET, &ssize) == 0)
+         blockSize = (uint32_t) ssize;
+#endif
+#if defined (__FreeBSD__) || defined (__FreeBSD_kernel__)
+      if (ioctl(fd, DIOCGSECTORSIZE, &ssize) == 0)
+         blockSize = (uint32_t) ssize;
+#endif
+#ifdef __APPLE__
+      if (ioctl(fd, DKIOCGETBLOCKSIZE, &ssize) == 0)
+         blockSize = (uint32_t) ssize;
+#endif
+      if (blockSize < SECTOR_SIZE) // also for disk image files
+         blockSize = SECTOR_SIZE;
+   } // if
+#ifdef __linux__
+   if (ioctl(fd, BLKGETSIZE64, &bytes) != 0)
+      bytes = 0;
+#endif
+#if defined (__FreeBSD__) || defined (__FreeBSD_kernel__)
+   if (ioctl(fd, DIOCGMEDIASIZE, &bytes) != 0)
+      bytes = 0;
+#endif
+#ifdef __APPLE__
+   if (ioctl(fd, DKIOCGETBLOCKCOUNT, &bytes) == 0)
+      bytes *= blockSize;
+   else
+      bytes = 0;
+#endif
+   if ((bytes == 0) && (fstat(fd, &st) == 0))
+      bytes = (uint64_t) st.st_size;
+   diskSize = bytes / blockSize;
+   return 1;
+} // PartitionProbe::Open()
+
+void PartitionProbe::Close(void) {
+   if (fd >= 0)
+      close(fd);
+   fd = -1;
+} // PartitionProbe::Close()
+
+// Read count sectors, starting at sector, into buffer. Returns 1 on
+// success; on failure, sets error and returns 0.
+int PartitionProbe::ReadSectors(uint64_t sector, size_t count, unsigned char* buffer) {
+   size_t wanted = count * blockSize, done = 0;
+   off_t offset = (off_t) (sector * blockSize);
+   ssize_t numRead;
+
+   while (done < wanted) {
+      numRead = pread(fd, buffer + done, wanted - done, offset + (off_t) done);
+      if (numRead < 0) {
+         if (errno == EINTR)
+            continue;
+         error = errno;
+         return 0;
+      } // if
+      if (numRead == 0) {
+         error = EIO; // ran off the end of the disk
+         return 0;
+      } // if
+      done += (size_t) numRead;
+   } // while
+   return 1;
+} // PartitionProbe::ReadSectors()
+
+// Follow the chain of EBRs in the extended partition starting at
+// extendedStart, adding the logical partitions to mbrParts, numbered from
+// partNum + 1. Follows BasicMBRData::ReadLogicalParts(), so that partitions
+// are numbered the same way; returns the index of the last logical
+// partition, for numbering those in any further extended partitions.
+uint32_t PartitionProbe::ReadLogicals(uint64_t extendedStart, uint32_t partNum) {
+   vector<unsigned char> ebr(blockSize);
+   uint64_t ebrLocations[MAX_MBR_PARTS], offset = extendedStart;
+   ProbeMBRPart part;
+   uint32_t i;
+
+   memset(ebrLocations, 0, sizeof(ebrLocations));
+   while (partNum < MAX_MBR_PARTS) {
+      for (i = 0; i < MAX_MBR_PARTS; i++) {
+         if (ebrLocations[i] == offset) { // an EBR loop
+            return (partNum > 0) ? partNum - 1 : 0;
+         } // if
+      } // for
+      ebrLocations[partNum] = offset;
+      if (!ReadSectors(offset, 1, ebr.data()) || (GetLE(&ebr[510], 2) != MBR_SIGNATURE)) {
+         error = 0; // the main MBR was fine, so the disk is readable
+         return partNum;
+      } // if
+      // An EBR may point straight to another EBR....
+      if (IsExtended(ebr[446 + 4])) {
+         offset = extendedStart + GetLE(&ebr[446 + 8], 4);
+         continue;
+      } // if
+      part.num = partNum + 1;
+      part.type = ebr[446 + 4];
+      part.firstLBA = GetLE(&ebr[446 + 8], 4) + offset;
+      part.lengthLBA = GetLE(&ebr[446 + 12], 4);
+      if (part.lengthLBA > 0)
+         mbrParts.push_back(part);
+      if ((GetLE(&ebr[446 + 16 + 8], 4) == 0) || (partNum >= MAX_MBR_PARTS - 1))
+         break;
+      offset = extendedStart + GetLE(&ebr[446 + 16 + 8], 4);
+      partNum++;
+   } // while
+   return partNum;
+} // PartitionProbe::ReadLogicals()
+
+// Read the MBR and any EBRs and classify the disk as BasicMBRData would:
+// invalid (no MBR signature, or the MBR couldn't be read), gpt (a
+// protective MBR), hybrid, or mbr. The partitions (not counting extended
+// partitions or empty entries) are left for GetMBRParts().
+MBRValidity PartitionProbe::ProbeMBR(void) {
+   vector<unsigned char> sector(blockSize);
+   ProbeMBRPart part;
+   uint32_t logicalNum = 3;
+   int i, haveEE = 0, numTypes = 0;
+
+   mbrParts.clear();
+   if (!ReadSectors(0, 1, sector.data()) || (GetLE(&sector[510], 2) != MBR_SIGNATURE))
+      return invalid;
+   for (i = 0; i < 4; i++) {
+      part.num = i + 1;
+      part.type = sector[446 + i * 16 + 4];
+      part.firstLBA = GetLE(&sector[446 + i * 16 + 8], 4);
+      part.lengthLBA = GetLE(&sector[446 + i * 16 + 12], 4);
+      if (IsExtended(part.type)) {
+         logicalNum = ReadLogicals(part.firstLBA, logicalNum + 1);
+      } else {
+         if (part.type == 0xEE)
+            haveEE = 1;
+         else if (part.type != 0x00)
+            numTypes++;
+         if (part.lengthLBA > 0)
+            mbrParts.push_back(part);
+      } // if/else
+   } // for
+   // Logicals may have been found before the later primaries....
+   sort(mbrParts.begin(), mbrParts.end(),
+        [](const ProbeMBRPart & a, const ProbeMBRPart & b) {return a.num < b.num;});
+   if (haveEE)
+      return (numTypes > 0) ? hybrid : gpt;
+   return mbr;
+} // PartitionProbe::ProbeMBR()
+
+// Check the GPT header at sector and the partition table it describes. If
+// the header has a GPT signature and backupLBA isn't NULL, sets *backupLBA
+// to the header's idea of where the backup header is. Returns 1 if the
+// header and table are intact (and keeps the table and disk GUID), 0 if
+// there's a GPT signature but something is wrong, or -1 if there's no GPT
+// signature (or the disk couldn't be read, in which case error is set).
+int PartitionProbe::LoadGPT(uint64_t sector, uint64_t *backupLBA) {
+   vector<unsigned char> header(blockSize), newTable;
+   uint32_t headerSize, crc, newNumParts, newEntrySize;
+   uint64_t tableLBA, tableSize, tableSectors;
+
+   if (!ReadSectors(sector, 1, header.data()) || (GetLE(header.data(), 8) != GPT_SIGNATURE))
+      return -1;
+   if (backupLBA != NULL)
+      *backupLBA = GetLE(&header[32], 8);
+   headerSize = (uint32_t) GetLE(&header[12], 4);
+   crc = (uint32_t) GetLE(&header[16], 4);
+   memset(&header[16], 0, 4);
+   newNumParts = (uint32_t) GetLE(&header[80], 4);
+   newEntrySize = (uint32_t) GetLE(&header[84], 4);
+   tableLBA = GetLE(&header[72], 8);
+   tableSize = (uint64_t) newNumParts * newEntrySize;
+   tableSectors = (tableSize + blockSize - 1) / blockSize;
+   if ((headerSize < HEADER_SIZE) || (headerSize > blockSize) ||
+       (chksum_crc32(header.data(), headerSize) != crc) || (GetLE(&header[24], 8) != sector) ||
+       (newEntrySize < GPT_SIZE) || ((newEntrySize % GPT_SIZE) != 0) ||
+       (tableSize > MAX_GPT_TABLE_SIZE) || (tableLBA >= diskSize) ||
+       (tableSectors > diskSize - tableLBA))
+      return 0;
+   newTable.resize(tableSectors * blockSize);
+   if (!ReadSectors(tableLBA, tableSectors, newTable.data()) ||
+       (chksum_crc32(newTable.data(), (unsigned int) tableSize) != (uint32_t) GetLE(&header[88], 4)))
+      return 0;
+   table.swap(newTable);
+   numParts = newNumParts;
+   entrySize = newEntrySize;
+   memcpy(diskGUID, &header[56], sizeof(diskGUID));
+   return 1;
+} // PartitionProbe::LoadGPT()
+
+// Look for a GPT: the main header and table first, and the backup header
+// and table only if the main ones are missing or damaged. Once this returns
+// probe_gpt_main or probe_gpt_backup, the partitions may be fetched.
+ProbeGPTState PartitionProbe::ProbeGPT(void) {
+   uint64_t backupLBA = 0;
+   int mainGPT, backupGPT, mainError;
+
+   numParts = entrySize = 0;
+   table.clear();
+   mainGPT = LoadGPT(1, &backupLBA);
+   if (mainGPT == 1)
+      return probe_gpt_main;
+   mainError = error;
+   if ((backupLBA <= 1) || (backupLBA >= diskSize))
+      backupLBA = diskSize - 1;
+   backupGPT = LoadGPT(backupLBA, NULL);
+   // The backup's location may be bogus, so an error reading it is ignored
+   // (but not an error reading the main header)....
+   error = mainError;
+   if (backupGPT == 1) {
+      error = 0;
+      return probe_gpt_backup;
+   } // if
+   if ((mainGPT == 0) || (backupGPT == 0))
+      return probe_gpt_damaged;
+   return probe_gpt_none;
+} // PartitionProbe::ProbeGPT()
+
+void PartitionProbe::GetDiskGUID(GUIDData & guid) const {
+   memcpy((void*) &guid, diskGUID, sizeof(diskGUID));
+} // PartitionProbe::GetDiskGUID()
+
+// Returns the number of partition table entries in use (that is, with a
+// type GUID that isn't all 0s).
+uint32_t PartitionProbe::CountUsed(void) const {
+   uint32_t i, numUsed = 0;
+
+   for (i = 0; i < numParts; i++) {
+      if ((GetLE(&table[i * entrySize], 8) != 0) || (GetLE(&table[i * entrySize + 8], 8) != 0))
+         numUsed++;
+   } // for
+   return numUsed;
+} // PartitionProbe::CountUsed()
+
+// Copy entry partNum (numbered from 0) of the partition table into part.
+// Returns 1 on success, 0 if there's no such entry.
+int PartitionProbe::GetPartition(uint32_t partNum, GPTPart & part) const {
+   if (partNum >= numParts)
+      return 0;
+   memcpy((void*) &part, &table[(size_t) partNum * entrySize], GPT_SIZE);
+   if (IsLittleEndian() == 0)
+      part.ReversePartBytes();
+   return 1;
+} // PartitionProbe::GetPartition()
@@ -0,0 +1,74 @@
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+// Quick, read-only look at a disk's partition tables, for callers that only
+// want to know what's there (sgdisk --android-dump, sgdisk_read(), and
+// sgdisk --scan-all). Unlike GPTData::LoadPartitions(), a PartitionProbe
+// never opens the disk for writing, never writes to standard output or
+// standard error, and reads no more than it must: the MBR (and any EBRs),
+// then the main GPT header and partition table, each once, and the backup
+// header and table only if the main ones fail their CRC checks.
+//
+// A PartitionProbe reads the disk directly, with pread(), and keeps all its
+// state in the object, so separate probes may run in separate threads.
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "basicmbr.h"
+#include "gptpart.h"
+#include "guid.h"
+
+#ifndef __PARTITION_PROBE
+#define __PARTITION_PROBE
+
+using namespace std;
+
+// One MBR partition, primary or logical, numbered as BasicMBRData numbers
+// them (1-4 for primaries, 5 and up for logicals, in EBR-chain order)
+struct ProbeMBRPart {
+   uint32_t num;
+   uint8_t type;
+   uint64_t firstLBA;
+   uint64_t lengthLBA;
+}; // struct ProbeMBRPart
+
+// Which GPT, if any, was found
+enum ProbeGPTState {probe_gpt_none, probe_gpt_main, probe_gpt_backup, probe_gpt_damaged};
+
+class PartitionProbe {
+protected:
+   int fd;
+   int error; // errno value from the first failed open or read; otherwise 0
+   uint32_t blockSize;
+   uint64_t diskSize; // in blockSize-byte sectors
+   vector<ProbeMBRPart> mbrParts;
+   unsigned char diskGUID[16];
+   uint32_t numParts;
+   uint32_t entrySize;
+   vector<unsigned char> table; // the partition table, as read from disk
+
+   int ReadSectors(uint64_t sector, size_t count, unsigned char* buffer);
+   uint32_t ReadLogicals(uint64_t extendedStart, uint32_t partNum);
+   int LoadGPT(uint64_t sector, uint64_t *backupLBA);
+public:
+   PartitionProbe(void);
+   ~PartitionProbe(void);
+
+   int Open(const string & device, uint32_t sectorSize = 0);
+   void Close(void);
+   int GetError(void) const {return error;}
+   uint32_t GetBlockSize(void) const {return blockSize;}
+   uint64_t DiskSize(void) const {return diskSize;}
+
+   MBRValidity ProbeMBR(void);
+   const vector<ProbeMBRPart> & GetMBRParts(void) const {return mbrParts;}
+
+   ProbeGPTState ProbeGPT(void);
+   void GetDiskGUID(GUIDData & guid) const;
+   uint32_t GetNumParts(void) const {return numParts;}
+   uint32_t CountUsed(void) const;
+   int GetPartition(uint32_t partNum, GPTPart & part) const;
+}; // class PartitionProbe
+
+#endif
@@ -0,0 +1,206 @@
+// scan.cc
+// Class to survey the partition tables on every disk on a system, probing
+// the disks in parallel threads.
+
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+#include <stdint.h>
+#include <string.h>
+#include <dirent.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include "scan.h"
+#include "jsonout.h"
+#include "outbuf.h"
+#include "probe.h"
+#include "support.h"
+
+using namespace std;
+
+static const char* mbrNames[] = {"none", "protective", "hybrid", "mbr"};
+static const char* gptNames[] = {"none", "valid", "backup", "damaged"};
+
+DeviceScan::DeviceScan(const string & sysDirectory, const string & devDirectory) {
+   sysDir = sysDirectory;
+   devDir = devDirectory;
+   maxThreads = 0; // one per device
+} // DeviceScan constructor
+
+// Build the list of disks from the entries in sysDir, leaving out loop and
+// RAM disks and devices with a size of 0 (such as empty card readers).
+// Returns the number of disks found.
+int DeviceScan::FindDevices(void) {
+   DIR* dir;
+   struct dirent* entry;
+   ScanDevice device;
+   ifstream sizeFile;
+   uint64_t size;
+   size_t slash;
+
+   devices.clear();
+   dir = opendir(sysDir.c_str());
+   if (dir == NULL)
+      return 0;
+   while ((entry = readdir(dir)) != NULL) {
+      device.name = entry->d_name;
+      if ((device.name[0] == '.') || (device.name.compare(0, 4, "loop") == 0) ||
+          (device.name.compare(0, 3, "ram") == 0))
+         continue;
+      size = 0;
+      sizeFile.open((sysDir + "/" + device.name + "/size").c_str());
+      sizeFile >> size; // always in 512-byte units
+      sizeFile.close();
+      sizeFile.clear();
+      if (size == 0)
+         continue;
+      device.sectorSize = 0;
+      sizeFile.open((sysDir + "/" + device.name + "/queue/logical_block_size").c_str());
+      sizeFile >> device.sectorSize;
+      sizeFile.close();
+      sizeFile.clear();
+      if (device.sectorSize < 512)
+         device.sectorSize = 512;
+      device.sectors = size * 512 / device.sectorSize;
+      // Names such as cciss!c0d0 stand for /dev/cciss/c0d0....
+      device.path = devDir + "/" + device.name;
+      while ((slash = device.path.find('!')) != string::npos)
+         device.path[slash] = '/';
+      device.error = 0;
+      device.mbr = scan_mbr_none;
+      device.gpt = scan_gpt_none;
+      device.numParts = device.numUsed = 0;
+      devices.push_back(device);
+   } // while
+   closedir(dir);
+   sort(devices.begin(), devices.end(),
+        [](const ScanDevice & a, const ScanDevice & b) {return a.name < b.name;});
+   return (int) devices.size();
+} // DeviceScan::FindDevices()
+
+// Set the most disks to probe at once; by default, all of them are.
+void DeviceScan::SetMaxThreads(int threads) {
+   maxThreads = (threads > 0) ? threads : 1;
+} // DeviceScan::SetMaxThreads()
+
+// Find out what partition tables device holds. Called from the worker
+// threads, so it mustn't touch anything but device.
+void DeviceScan::Probe(ScanDevice & device) {
+   PartitionProbe probe;
+   MBRValidity mbrState;
+   ProbeGPTState gptState;
+
+   if (!probe.Open(device.path, device.sectorSize)) {
+      device.error = probe.GetError();
+      return;
+   } // if
+   mbrState = probe.ProbeMBR();
+   if (mbrState == gpt)
+      device.mbr = scan_mbr_protective;
+   else if (mbrState == hybrid)
+      device.mbr = scan_mbr_hybrid;
+   else if ((mbrState == mbr) && !probe.GetMBRParts().empty())
+      device.mbr = scan_mbr_mbr;
+   device.error = probe.GetError();
+   if (device.error != 0)
+      return;
+
+   gptState = probe.ProbeGPT();
+   device.error = probe.GetError();
+   if ((gptState == probe_gpt_main) || (gptState == probe_gpt_backup)) {
+      device.gpt = (gptState == probe_gpt_main) ? scan_gpt_valid : scan_gpt_backup;
+      probe.GetDiskGUID(device.diskGUID);
+      device.numParts = probe.GetNumParts();
+      device.numUsed = probe.CountUsed();
+   } else if ((gptState == probe_gpt_damaged) || (device.mbr == scan_mbr_protective) ||
+              (device.mbr == scan_mbr_hybrid)) {
+      device.gpt = scan_gpt_damaged;
+   } // if/else if
+} // DeviceScan::Probe()
+
+// Probe every disk in the list, up to maxThreads at once; each thread takes
+// the next unprobed disk as soon as it's done with one, so the whole scan
+// takes about as long as the slowest disk (or slowest few, with fewer
+// threads than disks).
+void DeviceScan::Run(void) {
+   vector<thread> threads;
+   atomic<size_t> next(0);
+   size_t numThreads = devices.size(), i;
+
+   if ((maxThreads > 0) && (numThreads > (size_t) maxThreads))
+      numThreads = maxThreads;
+   for (i = 0; i < numThreads; i++) {
+      threads.push_back(thread([this, &next]() {
+         size_t num;
+
+         while ((num = next++) < devices.size())
+            Probe(devices[num]);
+      }));
+   } // for
+   for (thread & worker : threads)
+      worker.join();
+} // DeviceScan::Run()
+
+// Returns the number of disks that couldn't be read.
+int DeviceScan::NumUnreadable(void) const {
+   int count = 0;
+
+   for (const ScanDevice & device : devices)
+      if (device.error != 0)
+         count++;
+   return count;
+} // DeviceScan::NumUnreadable()
+
+// Show the results, one line per disk.
+void DeviceScan::ShowText(ostream & os) const {
+   OutputBuffer out;
+   static const char* mbrText[] = {"no MBR", "protective MBR", "hybrid MBR", "MBR"};
+   static const char* gptText[] = {"no GPT", "GPT OK", "main GPT damaged, backup OK",
+                                   "GPT damaged"};
+
+   for (const ScanDevice & device : devices) {
+      out.Put(device.path).Put(": ").PutIeee(device.sectors, device.sectorSize).Put(", ");
+      out.PutDec(device.sectorSize).Put("-byte sectors; ");
+      if (device.error != 0) {
+         out.Put("unreadable (").Put(strerror(device.error)).Put(")\n");
+         continue;
+      } // if
+      out.Put(mbrText[device.mbr]).Put("; ").Put(gptText[device.gpt]);
+      if ((device.gpt == scan_gpt_valid) || (device.gpt == scan_gpt_backup)) {
+         out.Put(", ").PutDec(device.numUsed).Put(" of ").PutDec(device.numParts);
+         out.Put(" entries used; disk GUID ").Put(device.diskGUID.AsString());
+      } // if
+      out.Put('\n');
+   } // for
+   out.PutDec(devices.size()).Put((devices.size() == 1) ? " disk" : " disks").Put(" scanned");
+   if (NumUnreadable() > 0)
+      out.Put(", ").PutDec(NumUnreadable()).Put(" unreadable");
+   out.Put(".\n");
+   out.Flush(os);
+} // DeviceScan::ShowText()
+
+// Show the results as a JSON object holding an array of disks.
+void DeviceScan::ShowJSON(ostream & os) const {
+   JSONWriter json;
+
+   json.BeginObject().Key("devices").BeginArray();
+   for (const ScanDevice & device : devices) {
+      json.BeginObject(1).Put("device", device.path);
+      json.Put("sectors", device.sectors).Put("sector_size", device.sectorSize);
+      if (device.error != 0) {
+         json.Put("error", device.error).EndObject();
+         continue;
+      } // if
+      json.Put("mbr", mbrNames[device.mbr]).Put("gpt", gptNames[device.gpt]);
+      if ((device.gpt == scan_gpt_valid) || (device.gpt == scan_gpt_backup)) {
+         json.Put("entries", device.numParts).Put("used", device.numUsed);
+         json.Put("disk_guid", device.diskGUID.AsString());
+      } // if
+      json.EndObject();
+   } // for
+   json.EndArray().EndObject();
+   json.Flush(os);
+} // DeviceScan::ShowJSON()
@@ -0,0 +1,66 @@
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+// Quick survey of every disk on a system (sgdisk --scan-all). A DeviceScan
+// lists the disks in /sys/block, ignoring loop and RAM disks and devices
+// with no media, and probes them all at once, reading just the sectors
+// needed to tell what partition tables each one holds: the MBR, the main
+// GPT header and partition table, and (only if those are damaged) the
+// backup header and table.
+//
+// The probes are PartitionProbes, which read the disks directly rather than
+// through GPTData and DiskIO and write nothing to cout or cerr; the results
+// are shown only once every probe is done. Unlike batch mode, whose
+// GPTDataCL writes straight to cout and cerr as it works, they can thus
+// run as threads in one process.
+
+#include <stdint.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "guid.h"
+
+#ifndef __GPT_SCAN
+#define __GPT_SCAN
+
+using namespace std;
+
+// What's on a disk, as far as the MBR and GPT go
+enum ScanMBR {scan_mbr_none, scan_mbr_protective, scan_mbr_hybrid, scan_mbr_mbr};
+enum ScanGPT {scan_gpt_none, scan_gpt_valid, scan_gpt_backup, scan_gpt_damaged};
+
+// One disk and what was found on it
+struct ScanDevice {
+   string name; // as in /sys/block (such as "sda")
+   string path; // as in /dev (such as "/dev/sda")
+   uint64_t sectors; // size, in logical sectors
+   uint32_t sectorSize;
+   int error; // errno value if the disk couldn't be read; otherwise 0
+   ScanMBR mbr;
+   ScanGPT gpt;
+   GUIDData diskGUID; // The rest are set only if the GPT is usable
+   uint32_t numParts;
+   uint32_t numUsed;
+}; // struct ScanDevice
+
+class DeviceScan {
+protected:
+   string sysDir;
+   string devDir;
+   vector<ScanDevice> devices;
+   int maxThreads;
+
+   void Probe(ScanDevice & device);
+public:
+   DeviceScan(const string & sysDirectory = "/sys/block", const string & devDirectory = "/dev");
+
+   int FindDevices(void);
+   void SetMaxThreads(int threads);
+   void Run(void);
+   const vector<ScanDevice> & GetDevices(void) const {return devices;}
+   int NumUnreadable(void) const;
+   void ShowText(ostream & os) const;
+   void ShowJSON(ostream & os) const;
+}; // class DeviceScan
+
+#endif
@@ -0,0 +1,91 @@
+// script.cc
+// Class to read sgdisk options from a file or standard input, one
+// operation per line, for sgdisk's --script option.
+
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+#include <stdint.h>
+#include <fstream>
+#include <iostream>
+#include "script.h"
+#include "support.h"
+
+using namespace std;
+
+CommandScript::CommandScript(void) {
+   in = NULL;
+   lineNum = 0;
+   ending = script_running;
+   numFailed = 0;
+   lastFailed = 0;
+} // CommandScript constructor
+
+// Get ready to read the script in filename, or standard input if filename
+// is "-". Returns 1 on success, 0 if the file couldn't be opened.
+int CommandScript::Open(const string & filename) {
+   if (filename == "-") {
+      in = &cin;
+   } else {
+      inFile.open(filename.c_str());
+      if (!inFile.is_open()) {
+         cerr << "Unable to open script " << filename << "!\n";
+         return 0;
+      } // if
+      in = &inFile;
+   } // if/else
+   return 1;
+} // CommandScript::Open()
+
+// Read up to the next line that holds an operation, and split it into
+// words for GetArgc() and GetArgv(). Returns 1 if there's such a line, 0
+// if the script has ended (with "commit", "abort", or the end of the file).
+int CommandScript::NextLine(void) {
+   size_t pos;
+
+   while (Running()) {
+      if (!getline(*in, line)) {
+         ending = script_eof;
+         break;
+      } // if
+      lineNum++;
+      pos = line.find_first_not_of(" \t\r");
+      line.erase(0, (pos == string::npos) ? line.length() : pos);
+      pos = line.find_last_not_of(" \t\r");
+      line.erase((pos == string::npos) ? 0 : pos + 1);
+      if (line.empty() || (line[0] == '#'))
+         continue;
+      words = SplitWords(line);
+      if (words.size() == 1) {
+         if (words[0] == "commit") {
+            ending = script_commit;
+            break;
+         } else if (words[0] == "abort") {
+            ending = script_abort;
+            break;
+         } // if/else if
+      } // if
+      argv.clear();
+      argv.push_back("sgdisk");
+      for (const string & word : words)
+         argv.push_back(word.c_str());
+      argv.push_back(NULL);
+      return 1;
+   } // while
+   argv.clear();
+   return 0;
+} // CommandScript::NextLine()
+
+// Report that the current line failed, for reason (which may be empty if
+// the operation has already said what went wrong). Each line is reported
+// and counted once, however many of its operations fail.
+void CommandScript::Fail(const string & reason) {
+   if (lastFailed != lineNum) {
+      cerr << "Script line " << lineNum << " (" << line << ") failed";
+      if (!reason.empty())
+         cerr << ": " << reason;
+      cerr << "\n";
+      lastFailed = lineNum;
+      numFailed++;
+   } // if
+} // CommandScript::Fail()
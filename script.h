@@ -0,0 +1,56 @@
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+// Command scripts for sgdisk (--script). A CommandScript reads sgdisk
+// options from a file (or standard input), one operation per line, and
+// hands each line over as an argument vector, so that GPTDataCL can parse
+// it with popt and carry it out just as it would the same options on the
+// command line, all against one loaded partition table. Words are split as
+// for --serve requests (see SplitWords()). Blank lines and lines that begin
+// with '#' are skipped. A line holding just "commit" or "abort" ends the
+// script, saying whether its changes should be saved; so does the end of
+// the file (which saves nothing), so that a script that's cut short does no
+// harm.
+
+#include <stdint.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef __GPT_SCRIPT
+#define __GPT_SCRIPT
+
+using namespace std;
+
+// How the script ended, if it has
+enum ScriptEnd {script_running, script_commit, script_abort, script_eof};
+
+class CommandScript {
+protected:
+   ifstream inFile;
+   istream* in; // NULL until Open() succeeds
+   string line; // the line being carried out
+   uint64_t lineNum;
+   vector<string> words;
+   vector<const char*> argv; // "sgdisk", then words, then NULL
+   ScriptEnd ending;
+   uint64_t numFailed;
+   uint64_t lastFailed; // the line most recently reported as failed
+public:
+   CommandScript(void);
+
+   int Open(const string & filename);
+   int IsOpen(void) const {return in != NULL;}
+   int Running(void) const {return (in != NULL) && (ending == script_running);}
+   int NextLine(void);
+   int GetArgc(void) const {return (int) argv.size() - 1;}
+   const char** GetArgv(void) {return argv.data();}
+   uint64_t GetLineNum(void) const {return lineNum;}
+   void Fail(const string & reason);
+   int LineFailed(void) const {return (lineNum > 0) && (lastFailed == lineNum);}
+   uint64_t NumFailed(void) const {return numFailed;}
+   ScriptEnd GetEnding(void) const {return ending;}
+}; // class CommandScript
+
+#endif
@@ -0,0 +1,523 @@
+// service.cc
+// Class to answer requests about partition tables over a Unix domain
+// socket, keeping the tables loaded between requests.
+
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <linux/netlink.h>
+#endif
+#include <iostream>
+#include <sstream>
+#include "service.h"
+#include "gptcl.h"
+#include "outbuf.h"
+
+using namespace std;
+
+// Set by SIGTERM and SIGINT to shut the service down
+static volatile sig_atomic_t stopService = 0;
+
+static void StopService(int) {
+   stopService = 1;
+} // StopService()
+
+GPTService::GPTService(void) {
+   listenFD = ueventFD = -1;
+} // GPTService constructor
+
+GPTService::~GPTService(void) {
+   for (auto & client : clients)
+      close(client.first);
+   if (ueventFD >= 0)
+      close(ueventFD);
+   if (listenFD >= 0) {
+      close(listenFD);
+      unlink(socketPath.c_str());
+   } // if
+} // GPTService destructor
+
+// Returns the name under which device's snapshot is kept: the device's
+// real path, so that (say) /dev/disk/by-id names share /dev/sda's snapshot.
+string GPTService::DeviceKey(const string & device) {
+   char realName[PATH_MAX];
+
+   if (realpath(device.c_str(), realName) != NULL)
+      return realName;
+   return device;
+} // GPTService::DeviceKey()
+
+// Read the first SERVICE_CHECK_SIZE bytes of device (or all of it, if it's
+// smaller) into check. Returns 1 on success, 0 on failure.
+int GPTService::ReadCheck(const string & device, string & check) {
+   char buffer[SERVICE_CHECK_SIZE];
+   ssize_t numRead;
+   int fd;
+
+   fd = open(device.c_str(), O_RDONLY);
+   if (fd < 0)
+      return 0;
+   numRead = pread(fd, buffer, sizeof(buffer), 0);
+   close(fd);
+   if (numRead <= 0)
+      return 0;
+   check.assign(buffer, numRead);
+   return 1;
+} // GPTService::ReadCheck()
+
+// Returns the snapshot of device (as given by DeviceKey()), loading it if
+// there isn't one or if the disk has changed since it was loaded. Returns
+// NULL, with the reason in text, if the disk can't be read.
+ServiceSnapshot* GPTService::GetSnapshot(const string & device, string & text) {
+   map<string, ServiceSnapshot>::iterator it;
+   ostringstream output;
+   streambuf *oldOut, *oldErr;
+   string check;
+   int loaded;
+
+   // Read the check bytes before loading, so that a change made while the
+   // table is being loaded shows up next time....
+   if (!ReadCheck(device, check)) {
+      snapshots.erase(device);
+      text = "Unable to read " + device + "!\n";
+      return NULL;
+   } // if
+   it = snapshots.find(device);
+   if ((it != snapshots.end()) && !it->second.stale && (it->second.check == check))
+      return &it->second;
+
+   snapshots.erase(device);
+   ServiceSnapshot & snapshot = snapshots[device];
+   snapshot.check = check;
+   snapshot.stale = 0;
+   snapshot.kernelName = device.substr(device.find_last_of('/') + 1);
+   snapshot.data.JustLooking();
+   snapshot.data.BeQuiet();
+   oldOut = cout.rdbuf(output.rdbuf());
+   oldErr = cerr.rdbuf(output.rdbuf());
+   loaded = snapshot.data.LoadPartitions(device);
+   cout.rdbuf(oldOut);
+   cerr.rdbuf(oldErr);
+   if (!loaded) {
+      snapshots.erase(device);
+      text = output.str();
+      return NULL;
+   } // if
+   return &snapshot;
+} // GPTService::GetSnapshot()
+
+// Answer a query (print, info, list, verify, or verify-json) from
+// snapshot, putting the reply in text. Replies are kept with the snapshot,
+// for the next time the same query comes along. Returns the return value
+// for the reply.
+int GPTService::Query(ServiceSnapshot & snapshot, const vector<string> & words, string & text) {
+   ostringstream output;
+   streambuf *oldOut, *oldErr;
+   ios_base::fmtflags oldFlags;
+   OutputBuffer out;
+   GPTPart part;
+   VerifyReport report;
+   string key = words[0];
+   size_t i;
+   uint32_t partNum, slot;
+   int retval = 0;
+
+   for (i = 2; i < words.size(); i++)
+      key += " " + words[i];
+   if (snapshot.replies.count(key) > 0) {
+      text = snapshot.replies[key];
+      return 0;
+   } // if
+
+   GPTData & data = snapshot.data;
+   oldFlags = cout.flags();
+   oldOut = cout.rdbuf(output.rdbuf());
+   oldErr = cerr.rdbuf(output.rdbuf());
+   if (words[0] == "print") {
+      data.DisplayGPTData();
+   } else if ((words[0] == "info") && (words.size() == 3)) {
+      partNum = (uint32_t) strtoul(words[2].c_str(), NULL, 10);
+      data.ShowPartDetails(partNum - 1);
+   } else if (words[0] == "list") {
+      for (slot = 0; slot < data.GetNumParts(); slot++) {
+         if (!data.IsUsedPartNum(slot))
+            continue;
+         part = data[slot];
+         out.PutDec(slot + 1).Put('\t').PutDec(part.GetFirstLBA()).Put('\t');
+         out.PutDec(part.GetLastLBA()).Put('\t').Put(part.GetType().AsString()).Put('\t');
+         out.Put(part.GetUniqueGUID().AsString()).Put('\t');
+         out.PutHex(part.GetAttributes().GetAttributes(), 16).Put('\t');
+         out.Put(part.GetDescription()).Put('\n');
+      } // for
+      out.Flush(cout);
+   } else if (words[0] == "verify") {
+      data.Verify();
+   } else if (words[0] == "verify-json") {
+      data.Verify(report);
+      report.ShowJSON(cout);
+   } else {
+      cerr << "Invalid request!\n";
+      retval = 1;
+   } // if/else
+   cout.rdbuf(oldOut);
+   cerr.rdbuf(oldErr);
+   cout.flags(oldFlags);
+   text = output.str();
+   if (retval == 0)
+      snapshot.replies[key] = text;
+   return retval;
+} // GPTService::Query()
+
+// Start a child process to carry out the sgdisk options in words (after
+// the request and device) on device, on behalf of client clientFD. Returns
+// 1 if the child started, or 0 (with the reason in text) if not.
+int GPTService::StartEdit(int clientFD, const string & device, const vector<string> & words,
+                          string & text) {
+   ServiceEdit edit;
+   vector<char*> argv;
+   size_t i;
+   int nullFD, retval;
+
+   for (i = 2; i < words.size(); i++) {
+      if (words[i].compare(0, 7, "--serve") == 0) {
+         text = "The --serve option can't be used in an edit!\n";
+         return 0;
+      } // if
+   } // for
+   edit.output = tmpfile();
+   if (edit.output == NULL) {
+      text = "Unable to create a temporary file!\n";
+      return 0;
+   } // if
+   cout.flush();
+   cerr.flush();
+   fflush(stdout);
+   fflush(stderr);
+   edit.pid = fork();
+   if (edit.pid < 0) {
+      fclose(edit.output);
+      text = "Unable to start the edit!\n";
+      return 0;
+   } // if
+   if (edit.pid == 0) {
+      // In the child; none of the service's connections are its business....
+      GPTDataCL cl;
+
+      close(listenFD);
+      if (ueventFD >= 0)
+         close(ueventFD);
+      for (auto & client : clients)
+         close(client.first);
+      nullFD = open("/dev/null", O_RDONLY);
+      if (nullFD >= 0) {
+         dup2(nullFD, STDIN_FILENO);
+         close(nullFD);
+      } // if
+      dup2(fileno(edit.output), STDOUT_FILENO);
+      dup2(fileno(edit.output), STDERR_FILENO);
+      argv.push_back((char*) "sgdisk");
+      for (i = 2; i < words.size(); i++)
+         argv.push_back((char*) words[i].c_str());
+      argv.push_back((char*) device.c_str());
+      argv.push_back(NULL);
+      retval = cl.DoOptions((int) argv.size() - 1, argv.data());
+      cout.flush();
+      cerr.flush();
+      fflush(stdout);
+      fflush(stderr);
+      _exit(retval);
+   } // if
+   edit.clientFD = clientFD;
+   edit.device = device;
+   edits.push_back(edit);
+   editing.insert(device);
+   snapshots.erase(device);
+   return 1;
+} // GPTService::StartEdit()
+
+// Reply to the clients whose edits have finished, and let requests for
+// those devices go ahead.
+void GPTService::FinishEdits(void) {
+   map<int, ServiceClient>::iterator client;
+   char buffer[4096];
+   string text;
+   size_t i = 0, numRead;
+   int status, retval;
+
+   while (i < edits.size()) {
+      if (waitpid(edits[i].pid, &status, WNOHANG) != edits[i].pid) {
+         i++;
+         continue;
+      } // if
+      retval = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+      text.clear();
+      rewind(edits[i].output);
+      while ((numRead = fread(buffer, 1, sizeof(buffer), edits[i].output)) > 0)
+         text.append(buffer, numRead);
+      fclose(edits[i].output);
+      client = clients.find(edits[i].clientFD);
+      if (client != clients.end()) {
+         Reply(client->second, retval, text);
+         client->second.waiting = 0;
+      } // if
+      editing.erase(edits[i].device);
+      snapshots.erase(edits[i].device);
+      edits.erase(edits.begin() + i);
+   } // while
+} // GPTService::FinishEdits()
+
+// Add a reply (return value, byte count, and text) to client's output.
+void GPTService::Reply(ServiceClient & client, int retval, const string & text) {
+   client.output += to_string(retval) + " " + to_string(text.length()) + "\n" + text;
+} // GPTService::Reply()
+
+// Deal with one request (already split into words) from client clientFD.
+void GPTService::HandleRequest(int clientFD, ServiceClient & client, const vector<string> & words) {
+   ServiceSnapshot* snapshot;
+   string device, text;
+   int retval;
+
+   if (words.size() < 2) {
+      Reply(client, 1, "Invalid request!\n");
+      return;
+   } // if
+   device = DeviceKey(words[1]);
+   if ((words[0] == "print") || (words[0] == "info") || (words[0] == "list") ||
+       (words[0] == "verify") || (words[0] == "verify-json")) {
+      snapshot = GetSnapshot(device, text);
+      if (snapshot == NULL) {
+         Reply(client, 2, text);
+      } else {
+         retval = Query(*snapshot, words, text);
+         Reply(client, retval, text);
+      } // if/else
+   } else if (words[0] == "edit") {
+      if (StartEdit(clientFD, device, words, text))
+         client.waiting = 1;
+      else
+         Reply(client, 1, text);
+   } else if (words[0] == "forget") {
+      snapshots.erase(device);
+      Reply(client, 0, "");
+   } else {
+      Reply(client, 1, "Unknown request '" + words[0] + "'!\n");
+   } // if/else
+} // GPTService::HandleRequest()
+
+// Answer every client's complete requests, in order, stopping at any that
+// must wait for an edit to finish.
+void GPTService::ProcessRequests(void) {
+   vector<string> words;
+   string line;
+   size_t end;
+
+   for (auto & entry : clients) {
+      ServiceClient & client = entry.second;
+
+      while (!client.waiting && ((end = client.input.find('\n')) != string::npos)) {
+         line = client.input.substr(0, end);
+         if (!line.empty() && (line.back() == '\r'))
+            line.pop_back();
+         words = SplitWords(line);
+         if ((words.size() >= 2) && (editing.count(DeviceKey(words[1])) > 0))
+            break;
+         client.input.erase(0, end + 1);
+         if (!words.empty())
+            HandleRequest(entry.first, client, words);
+      } // while
+   } // for
+} // GPTService::ProcessRequests()
+
+// Mark the snapshots of devices named in kernel uevents as stale.
+void GPTService::HandleUevents(void) {
+#ifdef __linux__
+   char buffer[8192];
+   ssize_t numRead;
+   size_t pos;
+   string field, devName;
+   int isBlock;
+
+   while ((numRead = recv(ueventFD, buffer, sizeof(buffer) - 1, MSG_DONTWAIT)) > 0) {
+      buffer[numRead] = '\0';
+      isBlock = 0;
+      devName.clear();
+      for (pos = 0; pos < (size_t) numRead; pos += field.length() + 1) {
+         field = &buffer[pos];
+         if (field == "SUBSYSTEM=block")
+            isBlock = 1;
+         else if (field.compare(0, 8, "DEVNAME=") == 0)
+            devName = field.substr(field.find_last_of("=/") + 1);
+      } // for
+      if (isBlock && !devName.empty()) {
+         for (auto & snapshot : snapshots)
+            if (snapshot.second.kernelName == devName)
+               snapshot.second.stale = 1;
+      } // if
+   } // while
+#endif
+} // GPTService::HandleUevents()
+
+// Accept a new connection.
+void GPTService::AcceptClient(void) {
+   ServiceClient client;
+   int fd;
+
+   fd = accept(listenFD, NULL, NULL);
+   if (fd < 0)
+      return;
+   fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+   client.waiting = client.closed = 0;
+   clients[fd] = client;
+} // GPTService::AcceptClient()
+
+// Close a connection. Any edit it started carries on.
+void GPTService::CloseClient(int fd) {
+   if (clients.erase(fd) > 0)
+      close(fd);
+} // GPTService::CloseClient()
+
+// Create the socket at path, which only the current user may use, and
+// (where possible) subscribe to kernel uevents. Returns 1 on success, 0
+// on failure.
+int GPTService::Listen(const string & path) {
+   struct sockaddr_un address;
+   struct stat info;
+   mode_t oldMask;
+   int allOK;
+
+   if (path.length() >= sizeof(address.sun_path)) {
+      cerr << "Socket name " << path << " is too long!\n";
+      return 0;
+   } // if
+   // Clear away a socket left by an earlier run, but nothing else....
+   if ((stat(path.c_str(), &info) == 0) && S_ISSOCK(info.st_mode))
+      unlink(path.c_str());
+   memset(&address, 0, sizeof(address));
+   address.sun_family = AF_UNIX;
+   strcpy(address.sun_path, path.c_str());
+   listenFD = socket(AF_UNIX, SOCK_STREAM, 0);
+   oldMask = umask(0077);
+   allOK = (listenFD >= 0) && (bind(listenFD, (struct sockaddr*) &address, sizeof(address)) == 0) &&
+           (listen(listenFD, 64) == 0);
+   umask(oldMask);
+   if (!allOK) {
+      cerr << "Unable to listen on " << path << "! Error is " << errno << "\n";
+      if (listenFD >= 0)
+         close(listenFD);
+      listenFD = -1;
+      return 0;
+   } // if
+   socketPath = path;
+   fcntl(listenFD, F_SETFL, fcntl(listenFD, F_GETFL) | O_NONBLOCK);
+
+#ifdef __linux__
+   struct sockaddr_nl netlink;
+
+   memset(&netlink, 0, sizeof(netlink));
+   netlink.nl_family = AF_NETLINK;
+   netlink.nl_groups = 1; // kernel uevents
+   ueventFD = socket(AF_NETLINK, SOCK_DGRAM, NETLINK_KOBJECT_UEVENT);
+   if ((ueventFD >= 0) && (bind(ueventFD, (struct sockaddr*) &netlink, sizeof(netlink)) != 0)) {
+      // Not fatal; the header checks still catch changes....
+      close(ueventFD);
+      ueventFD = -1;
+   } // if
+#endif
+   return 1;
+} // GPTService::Listen()
+
+// Serve requests until SIGTERM or SIGINT arrives. Returns 0.
+int GPTService::Run(void) {
+   vector<struct pollfd> fds;
+   struct pollfd entry;
+   vector<int> toClose;
+   char buffer[65536];
+   ssize_t numDone;
+   size_t i;
+
+   signal(SIGPIPE, SIG_IGN);
+   signal(SIGTERM, StopService);
+   signal(SIGINT, StopService);
+   while (!stopService) {
+      fds.clear();
+      entry.fd = listenFD;
+      entry.events = POLLIN;
+      fds.push_back(entry);
+      if (ueventFD >= 0) {
+         entry.fd = ueventFD;
+         fds.push_back(entry);
+      } // if
+      for (auto & client : clients) {
+         entry.fd = client.first;
+         entry.events = (client.second.closed ? 0 : POLLIN) |
+                        (client.second.output.empty() ? 0 : POLLOUT);
+         fds.push_back(entry);
+      } // for
+      // No signal says when an edit is done, so check now and then....
+      if (poll(fds.data(), fds.size(), edits.empty() ? -1 : 20) < 0) {
+         if (errno == EINTR)
+            continue;
+         cerr << "Error " << errno << " waiting for requests!\n";
+         break;
+      } // if
+
+      for (i = 0; i < fds.size(); i++) {
+         if (fds[i].revents == 0)
+            continue;
+         if (fds[i].fd == listenFD) {
+            AcceptClient();
+         } else if (fds[i].fd == ueventFD) {
+            HandleUevents();
+         } else {
+            ServiceClient & client = clients[fds[i].fd];
+            if (fds[i].revents & POLLIN) {
+               numDone = read(fds[i].fd, buffer, sizeof(buffer));
+               if (numDone > 0)
+                  client.input.append(buffer, numDone);
+               else if ((numDone == 0) || (errno != EAGAIN))
+                  client.closed = 1;
+               if (client.input.length() > SERVICE_MAX_REQUEST + 1) {
+                  client.input.clear();
+                  client.closed = 1;
+               } // if
+            } else if (fds[i].revents & (POLLHUP | POLLERR)) {
+               client.closed = 1;
+            } // if/else
+            if ((fds[i].revents & POLLOUT) && !client.output.empty()) {
+               numDone = write(fds[i].fd, client.output.data(), client.output.length());
+               if (numDone > 0)
+                  client.output.erase(0, numDone);
+               else if (errno != EAGAIN)
+                  toClose.push_back(fds[i].fd);
+            } // if
+         } // if/else
+      } // for
+
+      FinishEdits();
+      ProcessRequests();
+      for (auto & client : clients) {
+         if (client.second.closed && client.second.output.empty() && !client.second.waiting &&
+             (client.second.input.find('\n') == string::npos))
+            toClose.push_back(client.first);
+      } // for
+      for (int fd : toClose)
+         CloseClient(fd);
+      toClose.clear();
+   } // while
+   return 0;
+} // GPTService::Run()
@@ -0,0 +1,108 @@
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+// Partition-table service (sgdisk --serve). A GPTService listens on a Unix
+// domain socket and answers requests about any number of devices, keeping
+// each device's partition table loaded (a "snapshot") between requests, so
+// that a query doesn't cost a process start and a full read of the disk.
+// Before a snapshot is used, the first few sectors of the disk (the MBR and
+// main GPT header) are read again and compared with what they held when it
+// was loaded; on Linux, kernel uevents for the device also mark it stale.
+// Replies to queries are kept with the snapshot, so a repeated query costs
+// one small read.
+//
+// Requests are single lines, with words separated by spaces (words may be
+// quoted with "..." and characters escaped with \):
+//
+//    print DEVICE          as sgdisk -p
+//    info DEVICE PARTNUM   as sgdisk -i PARTNUM
+//    list DEVICE           one tab-separated line per partition: number,
+//                          first and last sectors, type GUID, unique GUID,
+//                          attributes (in hex), and name
+//    verify DEVICE         as sgdisk -v
+//    verify-json DEVICE    as sgdisk --format=json -v
+//    edit DEVICE OPTION... as sgdisk OPTION... DEVICE
+//    forget DEVICE         drop the snapshot
+//
+// Each reply is a line holding a return value (as sgdisk's) and a byte
+// count, followed by that many bytes of output. A client's requests are
+// answered in order. Edits run in child processes (sgdisk's options may
+// prompt, exit, or fork), one device at a time: other requests for a device
+// wait until its edit is done, while requests for other devices go on.
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "gpt.h"
+
+#ifndef __GPT_SERVICE
+#define __GPT_SERVICE
+
+using namespace std;
+
+// Bytes at the start of a disk that are compared to see if a snapshot is
+// still good: enough for the MBR and main GPT header with any sector size
+#define SERVICE_CHECK_SIZE 8192
+
+// Longest request line accepted
+#define SERVICE_MAX_REQUEST 65536
+
+// One device's partition table, as of the last time it was read
+struct ServiceSnapshot {
+   GPTData data;
+   string check; // first SERVICE_CHECK_SIZE bytes of the disk when loaded
+   string kernelName; // such as "sda", to match uevents
+   int stale;
+   map<string, string> replies; // replies to queries, by request
+}; // struct ServiceSnapshot
+
+// One connection and its unanswered requests and unsent replies
+struct ServiceClient {
+   string input;
+   string output;
+   int waiting; // for an edit to finish
+   int closed; // no more requests will come
+}; // struct ServiceClient
+
+// An edit being made by a child process
+struct ServiceEdit {
+   pid_t pid;
+   int clientFD;
+   string device;
+   FILE* output;
+}; // struct ServiceEdit
+
+class GPTService {
+protected:
+   string socketPath;
+   int listenFD;
+   int ueventFD;
+   map<string, ServiceSnapshot> snapshots;
+   map<int, ServiceClient> clients;
+   vector<ServiceEdit> edits;
+   set<string> editing; // devices with edits under way
+
+   static string DeviceKey(const string & device);
+   static int ReadCheck(const string & device, string & check);
+   ServiceSnapshot* GetSnapshot(const string & device, string & text);
+   int Query(ServiceSnapshot & snapshot, const vector<string> & words, string & text);
+   int StartEdit(int clientFD, const string & device, const vector<string> & words, string & text);
+   void FinishEdits(void);
+   void HandleRequest(int clientFD, ServiceClient & client, const vector<string> & words);
+   void ProcessRequests(void);
+   void HandleUevents(void);
+   void AcceptClient(void);
+   void CloseClient(int fd);
+   void Reply(ServiceClient & client, int retval, const string & text);
+public:
+   GPTService(void);
+   ~GPTService(void);
+
+   int Listen(const string & path);
+   int Run(void);
+}; // class GPTService
+
+#endif
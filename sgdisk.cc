@@ -20,57 +20,56 @@
 #include <unistd.h>
 
 #include "sgdisk.h"
+#include "gptapi.h"
+#include "diag.h"
 #include "gptcl.h"
+#include "jsonout.h"
+#include "probe.h"
 
 using namespace std;
 
 #define MAX_OPTIONS 50
 
+/*
+ * Read the partition tables on device. This uses a PartitionProbe rather
+ * than BasicMBRData and GPTData, so it never opens the device for writing,
+ * prints nothing, and reads only the MBR (and any EBRs), the main GPT
+ * header and partition table, and the backup ones only if those are
+ * damaged.
+ */
 int sgdisk_read(const char* device, sgdisk_partition_table& ptbl,
                 vector<sgdisk_partition>& partitions) {
-    BasicMBRData mbrData;
-    GPTData gptData;
+    PartitionProbe probe;
     GPTPart partData;
-    int numParts = 0;
-
-    /* Silence noisy underlying library */
-    int stdout_fd = dup(STDOUT_FILENO);
-    int stderr_fd = dup(STDERR_FILENO);
-    int silence = open("/dev/null", 0);
-    dup2(silence, STDOUT_FILENO);
-    dup2(silence, STDERR_FILENO);
-
-    if (!mbrData.ReadMBRData((string) device)) {
-        cerr << "Failed to read MBR" << endl;
-        return 8;
-    }
+    GUIDData diskGUID;
+    ProbeGPTState gptState;
 
-    switch (mbrData.GetValidity()) {
+    if (!probe.Open(device))
+        return 8; /* Failed to read MBR */
+
+    switch (probe.ProbeMBR()) {
     case mbr:
         ptbl.type = MBR;
         ptbl.guid.clear();
-        for (size_t i = 0; i < MAX_MBR_PARTS; i++) {
-            if (mbrData.GetLength(i) > 0) {
-                char typebuf[2+8+1];
-                sprintf(typebuf, "%x", (unsigned int)mbrData.GetType(i));
-                sgdisk_partition part;
-                part.num = i + 1;
-                part.type = typebuf;
-                partitions.push_back(part);
-            }
+        for (const ProbeMBRPart& mbrPart : probe.GetMBRParts()) {
+            char typebuf[2+8+1];
+            sprintf(typebuf, "%x", (unsigned int)mbrPart.type);
+            sgdisk_partition part;
+            part.num = mbrPart.num;
+            part.type = typebuf;
+            partitions.push_back(part);
         }
         break;
     case gpt:
-        gptData.JustLooking();
-        if (!gptData.LoadPartitions((string) device)) {
-            cerr << "Failed to read GPT" << endl;
-            return 9;
-        }
+        gptState = probe.ProbeGPT();
+        if ((gptState != probe_gpt_main) && (gptState != probe_gpt_backup))
+            return 9; /* Failed to read GPT */
 
         ptbl.type = GPT;
-        ptbl.guid = gptData.GetDiskGUID().AsString();
-        for (size_t i = 0; i < gptData.GetNumParts(); i++) {
-            partData = gptData[i];
+        probe.GetDiskGUID(diskGUID);
+        ptbl.guid = diskGUID.AsString();
+        for (uint32_t i = 0; i < probe.GetNumParts(); i++) {
+            probe.GetPartition(i, partData);
             if (partData.GetFirstLBA() > 0) {
                 sgdisk_partition part;
                 part.num = i + 1;
@@ -81,20 +80,106 @@ int sgdisk_read(const char* device, sgdisk_partition_table& ptbl,
             }
         }
         break;
+    case hybrid:
+        return 10; /* Unknown partition table */
     default:
-        cerr << "Unknown partition table" << endl;
-        return 10;
+        return 8; /* Failed to read MBR */
     }
 
-    fflush(stdout);
-    fflush(stderr);
-    dup2(stdout_fd, STDOUT_FILENO);
-    dup2(stderr_fd, STDERR_FILENO);
-    close(silence);
+    return 0;
+}
+
+/*
+ * Look up one partition in the table loaded on handle, either by name or by
+ * unique GUID (PARTUUID), using the handle's lookup index; it's built on the
+ * first lookup and kept for later ones. Returns 0 and fills in part if it's
+ * found.
+ */
+static int sgdisk_find(sgdisk_handle* handle, const char* key, bool byGuid,
+                       sgdisk_partition& part) {
+    sgdisk_part_info info;
+    uint32_t num;
+    int rc;
 
+    if (byGuid)
+        rc = sgdisk_lookup_guid(handle, key, &num);
+    else
+        rc = sgdisk_lookup_name(handle, key, &num);
+    if (rc == SGDISK_ERR_NOT_LOADED)
+        return 9; /* Failed to read GPT */
+    if ((rc != SGDISK_OK) || (sgdisk_get_partition(handle, num, &info) != SGDISK_OK))
+        return 11; /* No such partition */
+    part.num = info.num;
+    part.type = info.type_guid;
+    part.guid = info.unique_guid;
+    part.name = info.name;
     return 0;
 }
 
+/*
+ * Load the GPT on device and look up one partition in it. This reads the
+ * whole table for just one lookup; callers that make several should load
+ * the table once with sgdisk_open() and sgdisk_load() and pass the handle.
+ */
+static int sgdisk_find(const char* device, const char* key, bool byGuid,
+                       sgdisk_partition& part) {
+    sgdisk_handle* handle;
+    int rc = 9;
+
+    if (sgdisk_open(device, SGDISK_OPEN_READ_ONLY, &handle) != SGDISK_OK)
+        return rc;
+    if (sgdisk_load(handle) == SGDISK_OK)
+        rc = sgdisk_find(handle, key, byGuid, part);
+    sgdisk_close(handle);
+
+    return rc;
+}
+
+int sgdisk_find_by_name(sgdisk_handle* handle, const char* name,
+                        sgdisk_partition& part) {
+    return sgdisk_find(handle, name, false, part);
+}
+
+int sgdisk_find_by_guid(sgdisk_handle* handle, const char* guid,
+                        sgdisk_partition& part) {
+    return sgdisk_find(handle, guid, true, part);
+}
+
+int sgdisk_find_by_name(const char* device, const char* name,
+                        sgdisk_partition& part) {
+    return sgdisk_find(device, name, false, part);
+}
+
+int sgdisk_find_by_guid(const char* device, const char* guid,
+                        sgdisk_partition& part) {
+    return sgdisk_find(device, guid, true, part);
+}
+
+/*
+ * Load the GPT on device and verify it, without printing anything: the
+ * library's messages go to a NullDiagSink, which affects only the calling
+ * thread, and the problems found are returned in problems.
+ */
+int sgdisk_verify(const char* device, vector<VerifyProblem>& problems) {
+    GPTData gptData;
+    VerifyReport report;
+    NullDiagSink quiet;
+    DiagSink* oldSink = SetDiagSink(&quiet);
+    int rc = 0;
+
+    gptData.JustLooking();
+    gptData.BeQuiet();
+    if (!gptData.LoadPartitions((string) device)) {
+        rc = 9;
+    } else {
+        gptData.Verify(report);
+        problems = report.GetProblems();
+    }
+    SetDiagSink(oldSink);
+
+    return rc;
+}
+
 /*
  * Dump partition details in a machine readable format:
  *
@@ -130,13 +215,94 @@ static int android_dump(const char* device) {
     return rc;
 }
 
+/*
+ * Dump partition details as JSON, for --android-dump --format=json. This
+ * reads the disk as sgdisk_read() does, but also gives each partition's
+ * location and size, and a GPT partition's attributes:
+ *
+ * {"table": "gpt", "sectors": ..., "sector_size": ..., "disk_guid": ...,
+ *  "partitions": [objects, as for sgdisk --format=json -p]}
+ * {"table": "mbr", "sectors": ..., "sector_size": ...,
+ *  "partitions": [{"number": ..., "type": ..., "first_lba": ...,
+ *                  "last_lba": ..., "sectors": ..., "bytes": ...}]}
+ */
+static int android_dump_json(const char* device) {
+    PartitionProbe probe;
+    GPTPart partData;
+    GUIDData diskGUID;
+    ProbeGPTState gptState;
+    JSONWriter json;
+
+    if (!probe.Open(device))
+        return 8; /* Failed to read MBR */
+
+    json.BeginObject();
+    switch (probe.ProbeMBR()) {
+    case mbr:
+        json.Put("table", "mbr").Put("sectors", probe.DiskSize());
+        json.Put("sector_size", probe.GetBlockSize());
+        json.Key("partitions").BeginArray();
+        for (const ProbeMBRPart& mbrPart : probe.GetMBRParts()) {
+            uint64_t bytes = mbrPart.lengthLBA * probe.GetBlockSize();
+            json.BeginObject(1).Put("number", mbrPart.num);
+            json.PutHex("type", mbrPart.type, 2);
+            json.Put("first_lba", mbrPart.firstLBA);
+            json.Put("last_lba", mbrPart.firstLBA + mbrPart.lengthLBA - 1);
+            json.Put("sectors", mbrPart.lengthLBA).Put("bytes", bytes);
+            json.EndObject();
+        }
+        break;
+    case gpt:
+        gptState = probe.ProbeGPT();
+        if ((gptState != probe_gpt_main) && (gptState != probe_gpt_backup))
+            return 9; /* Failed to read GPT */
+
+        probe.GetDiskGUID(diskGUID);
+        json.Put("table", "gpt").Put("sectors", probe.DiskSize());
+        json.Put("sector_size", probe.GetBlockSize());
+        json.Put("disk_guid", diskGUID.AsString());
+        json.Key("partitions").BeginArray();
+        for (uint32_t i = 0; i < probe.GetNumParts(); i++) {
+            probe.GetPartition(i, partData);
+            partData.ShowJSON(i, probe.GetBlockSize(), json);
+        }
+        break;
+    case hybrid:
+        return 10; /* Unknown partition table */
+    default:
+        return 8; /* Failed to read MBR */
+    }
+    json.EndArray().EndObject();
+    json.Flush(cout);
+
+    return 0;
+}
+
 extern "C" int main(int argc, char *argv[]) {
-    for (int i = 0; i < argc; i++) {
+    bool androidDump = false, json = false;
+    const char* device = NULL;
+
+    // --android-dump and --format may come before or after the device, so
+    // the device is the first argument that's neither an option nor the
+    // value of --format.
+    for (int i = 1; i < argc; i++) {
         if (!strcmp("--android-dump", argv[i])) {
-            return android_dump(argv[i + 1]);
+            androidDump = true;
+        } else if (!strcmp("--format=json", argv[i])) {
+            json = true;
+        } else if (!strcmp("--format", argv[i]) && (i + 1 < argc)) {
+            json = !strcmp("json", argv[++i]);
+        } else if ((argv[i][0] != '-') && (device == NULL)) {
+            device = argv[i];
         }
     }
+    if (androidDump) {
+        if (device == NULL)
+            return 8; /* Failed to read MBR */
+        return json ? android_dump_json(device) : android_dump(device);
+    }
 
+    cout.setf(ios::uppercase); /* hex values are shown in upper case */
     GPTDataCL theGPT;
     return theGPT.DoOptions(argc, argv);
 }
@@ -19,6 +19,8 @@
 
 #include <string>
 #include <vector>
+#include "gptapi.h"
+#include "verifyreport.h"
 
 enum ptbl_type {
     MBR,
@@ -37,7 +39,32 @@ struct sgdisk_partition {
     std::string name;
 };
 
+/* Read a disk's MBR or GPT, without opening it for writing or printing
+ * anything; returns 0 and fills in ptbl and partitions on success. */
 int sgdisk_read(const char* device, sgdisk_partition_table& ptbl,
                 std::vector<sgdisk_partition>& partitions);
 
+/* Look up a GPT partition by name, or by unique GUID (PARTUUID) as in
+ * /dev/disk/by-partuuid, in a table loaded with sgdisk_load() (see
+ * gptapi.h); returns 0 and fills in part on success. The handle keeps its
+ * lookup index, so after the first lookup each takes constant time and
+ * no disk I/O. */
+int sgdisk_find_by_name(sgdisk_handle* handle, const char* name,
+                        sgdisk_partition& part);
+int sgdisk_find_by_guid(sgdisk_handle* handle, const char* guid,
+                        sgdisk_partition& part);
+
+/* Conveniences for a single lookup: open device, load its GPT, look up
+ * the partition as above, and close the device again. Each call reads the
+ * whole table, so use a handle for more than one lookup. */
+int sgdisk_find_by_name(const char* device, const char* name,
+                        sgdisk_partition& part);
+int sgdisk_find_by_guid(const char* device, const char* guid,
+                        sgdisk_partition& part);
+
+/* Check a GPT disk's partition table, as sgdisk -v does; returns 0 and
+ * fills in problems (which may be left empty) once the table has been
+ * checked. */
+int sgdisk_verify(const char* device, std::vector<VerifyProblem>& problems);
+
 #endif
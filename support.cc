@@ -17,10 +17,13 @@
 #include <fcntl.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <charconv>
 #include <string>
 #include <iostream>
+#include <new>
 #include <inttypes.h>
 #include <sstream>
+#include "diag.h"
 #include "support.h"
 
 #include <sys/types.h>
@@ -161,7 +164,7 @@ uint64_t IeeeToInt(string inValue, uint64_t sSize, uint64_t low, uint64_t high,
 
    if (sSize == 0) {
       sSize = SECTOR_SIZE;
-      cerr << "Bug: Sector size invalid in IeeeToInt()!\n";
+      DIAG(diag_internal, "Bug: Sector size invalid in IeeeToInt()!\n");
    } // if
 
    // Remove leading spaces, if present
@@ -245,34 +248,49 @@ uint64_t IeeeToInt(string inValue, uint64_t sSize, uint64_t low, uint64_t high,
 // theValue.precision() because this isn't possible using the available
 // EFI library.
 string BytesToIeee(uint64_t size, uint32_t sectorSize) {
+   char text[IEEE_SIZE_LENGTH];
+
+   return string(text, BytesToIeee(size, sectorSize, text));
+} // BytesToIeee()
+
+// As BytesToIeee(uint64_t, uint32_t), but put the result in text, which must
+// be at least IEEE_SIZE_LENGTH bytes long, and return its length. (The text
+// isn't NUL-terminated.)
+size_t BytesToIeee(uint64_t size, uint32_t sectorSize, char* text) {
    uint64_t sizeInIeee;
    uint64_t previousIeee;
    float decimalIeee;
    uint64_t index = 0;
-   string units, prefixes = " KMGTPEZ";
-   ostringstream theValue;
+   const char prefixes[] = " KMGTPEZ";
+   char* end;
 
    sizeInIeee = previousIeee = size * (uint64_t) sectorSize;
-   while ((sizeInIeee > 1024) && (index < (prefixes.length() - 1))) {
+   while ((sizeInIeee > 1024) && (index < (sizeof(prefixes) - 2))) {
       index++;
       previousIeee = sizeInIeee;
       sizeInIeee /= 1024;
    } // while
    if (prefixes[index] == ' ') {
-      theValue << sizeInIeee << " bytes";
+      end = to_chars(text, text + IEEE_SIZE_LENGTH, sizeInIeee).ptr;
+      memcpy(end, " bytes", 6);
+      end += 6;
    } else {
-      units = "  iB";
-      units[1] = prefixes[index];
       decimalIeee = ((float) previousIeee -
                      ((float) sizeInIeee * 1024.0) + 51.2) / 102.4;
       if (decimalIeee >= 10.0) {
          decimalIeee = 0.0;
          sizeInIeee++;
       }
-      theValue << sizeInIeee << "." << (uint32_t) decimalIeee << units;
+      end = to_chars(text, text + IEEE_SIZE_LENGTH, sizeInIeee).ptr;
+      *end++ = '.';
+      end = to_chars(end, text + IEEE_SIZE_LENGTH, (uint32_t) decimalIeee).ptr;
+      *end++ = ' ';
+      *end++ = prefixes[index];
+      *end++ = 'i';
+      *end++ = 'B';
    } // if/else
-   return theValue.str();
-} // BytesToIeee()
+   return end - text;
+} // BytesToIeee(uint64_t, uint32_t, char*)
 
 // Converts two consecutive characters in the input string into a
 // number, interpreting the string as a hexadecimal number, starting
@@ -341,11 +359,61 @@ void ReverseBytes(void* theValue, int numBytes) {
          ((char*) theValue)[i] = tempValue[numBytes - i - 1];
       delete[] tempValue;
    } else {
-      cerr << "Could not allocate memory in ReverseBytes()! Terminating\n";
-      exit(1);
+      DIAG(diag_no_memory, "Could not allocate memory in ReverseBytes()! Terminating\n");
+      throw bad_alloc();
    } // if/else
 } // ReverseBytes()
 
+// Returns the least common multiple of a and b, or UINT64_MAX if that's too
+// big to represent. A 0 value counts as "no constraint," so the result is
+// then the other value.
+uint64_t LeastCommonMultiple(uint64_t a, uint64_t b) {
+   uint64_t x = a, y = b, temp;
+
+   if ((a == 0) || (b == 0))
+      return a + b;
+   while (y != 0) {
+      temp = x % y;
+      x = y;
+      y = temp;
+   } // while
+   a /= x; // x is now the greatest common divisor
+   if (a > UINT64_MAX / b)
+      return UINT64_MAX;
+   return a * b;
+} // LeastCommonMultiple()
+
+// Split a line (such as a --serve request or a --script line) into words,
+// at spaces and tabs, except within double quotes; a backslash makes the
+// next character an ordinary one.
+vector<string> SplitWords(const string & line) {
+   vector<string> words;
+   string word;
+   size_t i;
+   int inWord = 0, quoted = 0;
+
+   for (i = 0; i < line.length(); i++) {
+      if ((line[i] == '\\') && (i + 1 < line.length())) {
+         word += line[++i];
+         inWord = 1;
+      } else if (line[i] == '"') {
+         quoted = !quoted;
+         inWord = 1;
+      } else if (!quoted && ((line[i] == ' ') || (line[i] == '\t'))) {
+         if (inWord)
+            words.push_back(word);
+         word.clear();
+         inWord = 0;
+      } else {
+         word += line[i];
+         inWord = 1;
+      } // if/else
+   } // for
+   if (inWord)
+      words.push_back(word);
+   return words;
+} // SplitWords()
+
 // On Windows, display a warning and ask whether to continue. If the user elects
 // not to continue, exit immediately.
 void WinWarning(void) {
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string>
+#include <vector>
 
 #ifndef __GPTSUPPORT
 #define __GPTSUPPORT
@@ -49,6 +50,9 @@
 #define DEFAULT_GPT_TYPE 0x8300
 #endif
 
+// Room for the longest BytesToIeee() result
+#define IEEE_SIZE_LENGTH 32
+
 // Set this as a default
 #define SECTOR_SIZE UINT32_C(512)
 
@@ -77,10 +81,13 @@ char GetYN(void);
 uint64_t GetSectorNum(uint64_t low, uint64_t high, uint64_t def, uint64_t sSize, const std::string& prompt);
 uint64_t IeeeToInt(string IeeeValue, uint64_t sSize, uint64_t low, uint64_t high, uint64_t def = 0);
 string BytesToIeee(uint64_t size, uint32_t sectorSize);
+size_t BytesToIeee(uint64_t size, uint32_t sectorSize, char* text);
 unsigned char StrToHex(const string & input, unsigned int position);
 int IsHex(string input); // Returns 1 if input can be hexadecimal number....
 int IsLittleEndian(void); // Returns 1 if CPU is little-endian, 0 if it's big-endian
 void ReverseBytes(void* theValue, int numBytes); // Reverses byte-order of theValue
+uint64_t LeastCommonMultiple(uint64_t a, uint64_t b);
+vector<string> SplitWords(const string & line);
 void WinWarning(void);
 
 #endif
@@ -0,0 +1,179 @@
+// utf16.cc
+// UTF-16 <-> UTF-8 conversion for partition names. Partition names are
+// almost always plain ASCII, so both directions handle runs of ASCII
+// characters a vector at a time (SSE2 or NEON, when available) and drop
+// to a scalar, validating converter for everything else.
+
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "utf16.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UTF16_SSE2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define UTF16_NEON
+#endif
+
+using namespace std;
+
+// Convert up to srcLen UTF-16 code units from src to UTF-8 in dest, which
+// holds destSize bytes. Conversion stops at a NUL code unit, at an unpaired
+// surrogate, or when the next character won't fit. dest is always
+// NUL-terminated (if destSize > 0). Returns the number of bytes stored,
+// not counting the terminating NUL.
+size_t UTF16ToUTF8(const uint16_t* src, size_t srcLen, char* dest, size_t destSize) {
+   size_t in = 0, out = 0;
+   uint32_t uni;
+   uint16_t cp;
+
+   if (destSize == 0)
+      return 0;
+   destSize--; // reserve space for the NUL
+   while (in < srcLen) {
+#if defined(UTF16_SSE2)
+      // Eight code units, all in the range 0x0001-0x007f....
+      while ((srcLen - in >= 8) && (destSize - out >= 8)) {
+         __m128i v = _mm_loadu_si128((const __m128i*) (src + in));
+         __m128i high = _mm_and_si128(v, _mm_set1_epi16((short) 0xff80));
+         if ((_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) != 0xffff) ||
+             (_mm_movemask_epi8(_mm_cmpeq_epi16(v, _mm_setzero_si128())) != 0))
+            break;
+         _mm_storel_epi64((__m128i*) (dest + out), _mm_packus_epi16(v, v));
+         in += 8;
+         out += 8;
+      } // while
+#elif defined(UTF16_NEON)
+      while ((srcLen - in >= 8) && (destSize - out >= 8)) {
+         uint16x8_t v = vld1q_u16(src + in);
+         if ((vmaxvq_u16(v) >= 0x80) || (vminvq_u16(v) == 0))
+            break;
+         vst1_u8((uint8_t*) (dest + out), vmovn_u16(v));
+         in += 8;
+         out += 8;
+      } // while
+#endif
+      if (in >= srcLen)
+         break;
+      cp = src[in];
+      if (cp == 0)
+         break;
+      if ((cp < 0xd800) || (cp > 0xdfff)) {
+         uni = cp;
+         in++;
+      } else if ((cp < 0xdc00) && (in + 1 < srcLen) &&
+                 (src[in + 1] >= 0xdc00) && (src[in + 1] <= 0xdfff)) {
+         uni = ((((uint32_t) cp & 0x3ff) << 10) | (src[in + 1] & 0x3ff)) + 0x10000;
+         in += 2;
+      } else {
+         break; // unpaired surrogate; the name is invalid from here on
+      } // if/else
+      if (uni < 0x80) {
+         if (destSize - out < 1)
+            break;
+         dest[out++] = (char) uni;
+      } else if (uni < 0x800) {
+         if (destSize - out < 2)
+            break;
+         dest[out++] = (char) (0xc0 | (uni >> 6));
+         dest[out++] = (char) (0x80 | (uni & 0x3f));
+      } else if (uni < 0x10000) {
+         if (destSize - out < 3)
+            break;
+         dest[out++] = (char) (0xe0 | (uni >> 12));
+         dest[out++] = (char) (0x80 | ((uni >> 6) & 0x3f));
+         dest[out++] = (char) (0x80 | (uni & 0x3f));
+      } else {
+         if (destSize - out < 4)
+            break;
+         dest[out++] = (char) (0xf0 | (uni >> 18));
+         dest[out++] = (char) (0x80 | ((uni >> 12) & 0x3f));
+         dest[out++] = (char) (0x80 | ((uni >> 6) & 0x3f));
+         dest[out++] = (char) (0x80 | (uni & 0x3f));
+      } // if/else
+   } // while
+   dest[out] = '\0';
+   return out;
+} // UTF16ToUTF8()
+
+// Convert up to srcLen bytes of UTF-8 from src to UTF-16 in dest, which
+// holds destLen code units. Conversion stops at an invalid, overlong, or
+// truncated sequence, at an encoded surrogate or a value above U+10FFFF,
+// or when the next character won't fit (a surrogate pair is never split).
+// dest is NOT NUL-terminated. Returns the number of code units stored.
+size_t UTF8ToUTF16(const char* src, size_t srcLen, uint16_t* dest, size_t destLen) {
+   const unsigned char* s = (const unsigned char*) src;
+   size_t in = 0, out = 0;
+   uint32_t uni, minUni;
+   int todo;
+
+   while (in < srcLen) {
+#if defined(UTF16_SSE2)
+      // Sixteen bytes, all ASCII....
+      while ((srcLen - in >= 16) && (destLen - out >= 16)) {
+         __m128i v = _mm_loadu_si128((const __m128i*) (s + in));
+         if (_mm_movemask_epi8(v) != 0)
+            break;
+         _mm_storeu_si128((__m128i*) (dest + out), _mm_unpacklo_epi8(v, _mm_setzero_si128()));
+         _mm_storeu_si128((__m128i*) (dest + out + 8), _mm_unpackhi_epi8(v, _mm_setzero_si128()));
+         in += 16;
+         out += 16;
+      } // while
+#elif defined(UTF16_NEON)
+      while ((srcLen - in >= 16) && (destLen - out >= 16)) {
+         uint8x16_t v = vld1q_u8(s + in);
+         if (vmaxvq_u8(v) >= 0x80)
+            break;
+         vst1q_u16(dest + out, vmovl_u8(vget_low_u8(v)));
+         vst1q_u16(dest + out + 8, vmovl_u8(vget_high_u8(v)));
+         in += 16;
+         out += 16;
+      } // while
+#endif
+      if ((in >= srcLen) || (out >= destLen))
+         break;
+      uni = s[in++];
+      if (uni < 0x80) {
+         dest[out++] = (uint16_t) uni;
+         continue;
+      } else if ((uni & 0xe0) == 0xc0) {
+         uni &= 0x1f;
+         todo = 1;
+         minUni = 0x80;
+      } else if ((uni & 0xf0) == 0xe0) {
+         uni &= 0x0f;
+         todo = 2;
+         minUni = 0x800;
+      } else if ((uni & 0xf8) == 0xf0) {
+         uni &= 0x07;
+         todo = 3;
+         minUni = 0x10000;
+      } else {
+         break; // stray continuation byte or invalid lead byte
+      } // if/else
+      if (srcLen - in < (size_t) todo)
+         break; // truncated sequence
+      while (todo > 0) {
+         if ((s[in] & 0xc0) != 0x80)
+            return out;
+         uni = (uni << 6) | (s[in++] & 0x3f);
+         todo--;
+      } // while
+      if ((uni < minUni) || (uni > 0x10ffff) || ((uni >= 0xd800) && (uni <= 0xdfff)))
+         break;
+      if (uni < 0x10000) {
+         dest[out++] = (uint16_t) uni;
+      } else {
+         if (destLen - out < 2)
+            break; // not enough room for two surrogates, truncate
+         uni -= 0x10000;
+         dest[out++] = (uint16_t) (0xd800 | (uni >> 10));
+         dest[out++] = (uint16_t) (0xdc00 | (uni & 0x3ff));
+      } // if/else
+   } // while
+   return out;
+} // UTF8ToUTF16()
@@ -0,0 +1,24 @@
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+// Conversion between the UTF-16 used for GPT partition names and the UTF-8
+// used for everything else. Code units are in host byte order; on-disk
+// (little-endian) ordering is handled by GPTPart::ReversePartBytes().
+// Neither function allocates memory; both write into caller-supplied
+// buffers and stop at the first malformed sequence.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef __GPT_UTF16
+#define __GPT_UTF16
+
+// Size of a UTF-8 buffer big enough to hold the conversion of n UTF-16 code
+// units plus a terminating NUL. (A surrogate pair takes two units and four
+// bytes, so three bytes per unit is the worst case.)
+#define UTF8_SIZE_FOR_UTF16(n) ((n) * 3 + 1)
+
+size_t UTF16ToUTF8(const uint16_t* src, size_t srcLen, char* dest, size_t destSize);
+size_t UTF8ToUTF16(const char* src, size_t srcLen, uint16_t* dest, size_t destLen);
+
+#endif
@@ -0,0 +1,334 @@
+// verifycache.cc
+// Class to keep the results of the partition-table checks current as
+// individual entries change, so that re-verifying a big table after a
+// small edit doesn't mean checking every entry (and every pair of entries)
+// again.
+
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+#include <stdint.h>
+#include <algorithm>
+#include "verifycache.h"
+
+using namespace std;
+
+// As GPTPart::DoTheyOverlap(), for two (first, last) extents.
+static int ExtentsOverlap(uint64_t first1, uint64_t last1, uint64_t first2, uint64_t last2) {
+   return (first1 != 0) && (first2 != 0) && ((first1 <= last2) != (last1 < first2));
+} // ExtentsOverlap()
+
+// Remove one copy of value from a multiset, if it's there.
+template <class T> static void EraseOne(multiset<T> & values, const T & value) {
+   typename multiset<T>::iterator it = values.find(value);
+
+   if (it != values.end())
+      values.erase(it);
+} // EraseOne()
+
+VerifyCache::VerifyCache(void) {
+   valid = 0;
+   freeTotal = 0;
+   params = VerifyParams();
+} // VerifyCache constructor
+
+// Forget everything; the next Update() checks every entry.
+void VerifyCache::Invalidate(void) {
+   valid = 0;
+   dirty.clear();
+} // VerifyCache::Invalidate()
+
+// Note that entry pn has changed (or is about to) and must be re-checked.
+void VerifyCache::MarkDirty(uint32_t pn) {
+   if (valid) {
+      if (pn < params.numParts)
+         dirty.insert(pn);
+      else
+         Invalidate();
+   } // if
+} // VerifyCache::MarkDirty()
+
+// Bring the results up to date with parts, a table of newParams.numParts
+// entries. Starting over means checking only parts' stored (non-blank)
+// entries, since blank ones are unused. Returns the number of entries
+// checked.
+uint32_t VerifyCache::Update(const PartitionStore & parts, const VerifyParams & newParams) {
+   PartitionStore::StoredIterator it;
+   uint32_t numChecked = 0;
+
+   if (!valid || (newParams.diskSize != params.diskSize) ||
+       (newParams.firstUsable != params.firstUsable) ||
+       (newParams.lastUsable != params.lastUsable) ||
+       (newParams.alignment != params.alignment) ||
+       (newParams.zoneSectors != params.zoneSectors) ||
+       (newParams.numParts != params.numParts)) {
+      Reset(newParams);
+      for (it = parts.BeginStored(); it != parts.EndStored(); it++)
+         Insert(it->first, parts.Stored(it));
+      numChecked = parts.NumStored();
+   } else {
+      // Take out all the old entries before putting in any new ones, so
+      // that each new one is compared with the others' current state....
+      for (const uint32_t i : dirty)
+         Remove(i);
+      for (const uint32_t i : dirty)
+         Insert(i, parts[i]);
+      numChecked = dirty.size();
+   } // if/else
+   dirty.clear();
+   return numChecked;
+} // VerifyCache::Update()
+
+// Empty the cache and set it up for a table of newParams.numParts unused
+// entries.
+void VerifyCache::Reset(const VerifyParams & newParams) {
+   params = newParams;
+   slots.clear();
+   cleanByStart.clear();
+   irregular.clear();
+   overlaps.clear();
+   flagged.clear();
+   guidSlots.clear();
+   dupSlots.clear();
+   firsts.clear();
+   lasts.clear();
+   extents.clear();
+   segments.clear();
+   freeTotal = 0;
+   CountGap(NULL, NULL, 1);
+   dirty.clear();
+   valid = 1;
+} // VerifyCache::Reset()
+
+// Take entry pn, as last seen, out of the results.
+void VerifyCache::Remove(uint32_t pn) {
+   map<uint32_t, SlotState>::iterator found = slots.find(pn);
+   map<string, set<uint32_t> >::iterator group;
+
+   if (found == slots.end())
+      return;
+   SlotState & slot = found->second;
+   EraseOne(firsts, slot.first);
+   EraseOne(lasts, slot.last);
+   EraseOne(extents, make_pair(slot.first, slot.last));
+   flagged.erase(pn);
+
+   group = guidSlots.find(slot.guid);
+   if (group != guidSlots.end()) {
+      group->second.erase(pn);
+      dupSlots.erase(pn);
+      if (group->second.size() == 1)
+         dupSlots.erase(*group->second.begin());
+      else if (group->second.empty())
+         guidSlots.erase(group);
+   } // if
+
+   // Unlink the partners; any that now overlap nothing (and are sane)
+   // become clean again....
+   for (const uint32_t other : slot.partners) {
+      SlotState & partner = slots[other];
+
+      overlaps.erase(make_pair(max(pn, other), min(pn, other)));
+      partner.partners.erase(pn);
+      if (partner.partners.empty() && (partner.first <= partner.last)) {
+         irregular.erase(other);
+         AddClean(other);
+      } // if
+   } // for
+   if (slot.clean)
+      RemoveClean(pn);
+   else
+      irregular.erase(pn);
+   slots.erase(found);
+} // VerifyCache::Remove()
+
+// Check entry pn, now holding part, and add it to the results. The entry
+// must not be in the results already.
+void VerifyCache::Insert(uint32_t pn, const GPTPart & part) {
+   set<pair<uint64_t, uint32_t> >::iterator it;
+   vector<uint32_t> found;
+   uint64_t low, high;
+   uint32_t flags = 0;
+
+   if (!part.IsUsed())
+      return;
+   SlotState & slot = slots[pn];
+   slot.clean = 0;
+   slot.first = part.GetFirstLBA();
+   slot.last = part.GetLastLBA();
+   slot.guid = string((const char*) part.GetUniqueGUID().GetBytes(), sizeof(my_uuid_t));
+   firsts.insert(slot.first);
+   lasts.insert(slot.last);
+   extents.insert(make_pair(slot.first, slot.last));
+
+   if (slot.first > slot.last)
+      flags |= VERIFY_BACKWARDS;
+   if (slot.last >= params.diskSize)
+      flags |= VERIFY_TOO_BIG;
+   if ((params.alignment != 0) && ((slot.first % params.alignment) != 0))
+      flags |= VERIFY_MISALIGNED;
+   if ((params.zoneSectors != 0) && (((slot.first % params.zoneSectors) != 0) ||
+                                     (((slot.last + 1) % params.zoneSectors) != 0)))
+      flags |= VERIFY_OFF_ZONE;
+   if (flags != 0)
+      flagged[pn] = flags;
+
+   set<uint32_t> & sameGUID = guidSlots[slot.guid];
+   sameGUID.insert(pn);
+   if (sameGUID.size() == 2)
+      dupSlots.insert(sameGUID.begin(), sameGUID.end());
+   else if (sameGUID.size() > 2)
+      dupSlots.insert(pn);
+
+   if (slot.first == 0)
+      return;
+
+   // Anything this entry overlaps is a clean entry that begins at or
+   // before the lower of its first and last LBAs (only the nearest one can
+   // qualify), a clean entry that begins between the two, or an irregular
+   // entry....
+   low = min(slot.first, slot.last);
+   high = max(slot.first, slot.last);
+   it = cleanByStart.upper_bound(make_pair(low, UINT32_MAX));
+   if (it != cleanByStart.begin()) {
+      it--;
+      if (ExtentsOverlap(slot.first, slot.last, slots[it->second].first, slots[it->second].last))
+         found.push_back(it->second);
+      it++;
+   } // if
+   for (; (it != cleanByStart.end()) && (it->first <= high); it++) {
+      if (ExtentsOverlap(slot.first, slot.last, slots[it->second].first, slots[it->second].last))
+         found.push_back(it->second);
+   } // for
+   for (const uint32_t other : irregular) {
+      if (ExtentsOverlap(slot.first, slot.last, slots[other].first, slots[other].last))
+         found.push_back(other);
+   } // for
+
+   for (const uint32_t other : found) {
+      slot.partners.insert(other);
+      slots[other].partners.insert(pn);
+      overlaps.insert(make_pair(max(pn, other), min(pn, other)));
+      if (slots[other].clean) {
+         RemoveClean(other);
+         irregular.insert(other);
+      } // if
+   } // for
+   if ((slot.first > slot.last) || !slot.partners.empty())
+      irregular.insert(pn);
+   else
+      AddClean(pn);
+} // VerifyCache::Insert()
+
+// Put entry pn into cleanByStart, splitting the free space around it.
+void VerifyCache::AddClean(uint32_t pn) {
+   set<pair<uint64_t, uint32_t> >::iterator it, prev, next;
+   const SlotState* before = NULL;
+   const SlotState* after = NULL;
+
+   it = cleanByStart.insert(make_pair(slots[pn].first, pn)).first;
+   next = it;
+   if (++next != cleanByStart.end())
+      after = &slots[next->second];
+   if (it != cleanByStart.begin()) {
+      prev = it;
+      before = &slots[(--prev)->second];
+   } // if
+   CountGap(before, after, -1);
+   CountGap(before, &slots[pn], 1);
+   CountGap(&slots[pn], after, 1);
+   slots[pn].clean = 1;
+} // VerifyCache::AddClean()
+
+// Take entry pn out of cleanByStart, merging the free space around it.
+void VerifyCache::RemoveClean(uint32_t pn) {
+   set<pair<uint64_t, uint32_t> >::iterator it, prev, next;
+   const SlotState* before = NULL;
+   const SlotState* after = NULL;
+
+   it = cleanByStart.find(make_pair(slots[pn].first, pn));
+   if (it == cleanByStart.end())
+      return;
+   next = it;
+   if (++next != cleanByStart.end())
+      after = &slots[next->second];
+   if (it != cleanByStart.begin()) {
+      prev = it;
+      before = &slots[(--prev)->second];
+   } // if
+   CountGap(before, &slots[pn], -1);
+   CountGap(&slots[pn], after, -1);
+   CountGap(before, after, 1);
+   cleanByStart.erase(it);
+   slots[pn].clean = 0;
+} // VerifyCache::RemoveClean()
+
+// Add (sign > 0) or remove (sign < 0) the free segments in the usable
+// area between prev and next, two neighboring clean entries. A NULL prev
+// or next stands for the start or end of the usable area.
+void VerifyCache::CountGap(const SlotState* prev, const SlotState* next, int sign) {
+   uint64_t first, last, zoneEnd;
+
+   if (prev == NULL)
+      first = params.firstUsable;
+   else if (prev->last == UINT64_MAX)
+      return;
+   else
+      first = max(prev->last + 1, params.firstUsable);
+   if (next == NULL)
+      last = params.lastUsable;
+   else
+      last = min(next->first - 1, params.lastUsable);
+   if ((first > last) || (last == UINT64_MAX))
+      return;
+   // On zoned devices, FindFreeBlocks() splits a free run at its last zone
+   // boundary....
+   if (params.zoneSectors > 0) {
+      zoneEnd = ((last + 1) / params.zoneSectors) * params.zoneSectors;
+      if ((zoneEnd > first) && (zoneEnd <= last)) {
+         CountSegment(first, zoneEnd - 1, sign);
+         first = zoneEnd;
+      } // if
+   } // if
+   CountSegment(first, last, sign);
+} // VerifyCache::CountGap()
+
+// Add or remove one free segment.
+void VerifyCache::CountSegment(uint64_t first, uint64_t last, int sign) {
+   if (sign > 0) {
+      segments.insert(last - first + 1);
+      freeTotal += last - first + 1;
+   } else {
+      EraseOne(segments, last - first + 1);
+      freeTotal -= last - first + 1;
+   } // if/else
+} // VerifyCache::CountSegment()
+
+// Returns the lowest-numbered entry with the same unique GUID as entry pn
+// (which may be pn itself).
+uint32_t VerifyCache::FirstWithGUID(uint32_t pn) const {
+   map<uint32_t, SlotState>::const_iterator slot = slots.find(pn);
+   map<string, set<uint32_t> >::const_iterator group;
+
+   if (slot == slots.end())
+      return pn;
+   group = guidSlots.find(slot->second.guid);
+   if ((group == guidSlots.end()) || group->second.empty())
+      return pn;
+   return *group->second.begin();
+} // VerifyCache::FirstWithGUID()
+
+// Returns 1 if a used entry runs from first to last, 0 if not.
+int VerifyCache::HasExtent(uint64_t first, uint64_t last) const {
+   return extents.count(make_pair(first, last)) > 0;
+} // VerifyCache::HasExtent()
+
+// Returns the total free space in the usable area, and the number and
+// largest size of the free segments, as GPTData::FindFreeBlocks() does.
+// Meaningful only if no partitions overlap, are insane, or lie outside
+// the usable area.
+uint64_t VerifyCache::FreeSummary(uint32_t *numSegments, uint64_t *largestSegment) const {
+   *numSegments = segments.size();
+   *largestSegment = segments.empty() ? 0 : *segments.rbegin();
+   return freeTotal;
+} // VerifyCache::FreeSummary()
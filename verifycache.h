@@ -0,0 +1,101 @@
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+// Incremental partition-table verification. A VerifyCache holds the results
+// of the per-entry checks behind GPTData::Verify() (overlaps, duplicate
+// unique GUIDs, insane, misaligned, and off-zone partitions, the used range,
+// and the free space) along with the indexes needed to keep them current.
+// The owner calls MarkDirty() for each entry it changes and Invalidate()
+// when it changes many or replaces the table; Update() then re-checks only
+// the dirty entries, each in O(log n) time (plus the number of partitions
+// the entry overlaps).
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "partstore.h"
+
+#ifndef __GPT_VERIFY_CACHE
+#define __GPT_VERIFY_CACHE
+
+using namespace std;
+
+// Per-entry problems, as bits in the values of VerifyCache::Flagged()
+#define VERIFY_BACKWARDS 1 /* ends before it begins */
+#define VERIFY_TOO_BIG 2 /* ends past the end of the disk */
+#define VERIFY_MISALIGNED 4 /* doesn't begin on an alignment boundary */
+#define VERIFY_OFF_ZONE 8 /* doesn't begin and end on zone boundaries */
+
+// The disk parameters that the checks depend on. A change to any of them
+// makes Update() start over.
+struct VerifyParams {
+   uint64_t diskSize; // in sectors
+   uint64_t firstUsable;
+   uint64_t lastUsable;
+   uint32_t alignment; // 0 to skip the alignment check
+   uint64_t zoneSectors; // 0 for unzoned devices
+   uint32_t numParts;
+}; // struct VerifyParams
+
+class VerifyCache {
+protected:
+   // What the last Update() saw of each used entry (unused ones aren't
+   // kept, so this grows with the number of partitions, not the table size)
+   struct SlotState {
+      int clean; // in cleanByStart
+      uint64_t first;
+      uint64_t last;
+      string guid; // raw 16-byte unique GUID
+      set<uint32_t> partners; // entries this one overlaps
+   }; // struct SlotState
+   map<uint32_t, SlotState> slots;
+   VerifyParams params;
+   int valid;
+   set<uint32_t> dirty;
+   // Used, sane entries that overlap nothing, by (first LBA, entry); these
+   // never overlap each other, so a predecessor lookup and a range scan
+   // find everything a new extent overlaps. Insane and overlapping entries
+   // are in irregular instead, which is normally empty. Used entries that
+   // begin at LBA 0 are in neither, since they never overlap anything.
+   set<pair<uint64_t, uint32_t> > cleanByStart;
+   set<uint32_t> irregular;
+   set<pair<uint32_t, uint32_t> > overlaps; // (higher entry, lower entry)
+   map<uint32_t, uint32_t> flagged; // entry -> VERIFY_* bits
+   map<string, set<uint32_t> > guidSlots;
+   set<uint32_t> dupSlots; // entries whose unique GUID isn't unique
+   multiset<uint64_t> firsts;
+   multiset<uint64_t> lasts;
+   multiset<pair<uint64_t, uint64_t> > extents;
+   // Sizes of the free segments between clean entries, as
+   // GPTData::FindFreeBlocks() would report them when there are no problems
+   multiset<uint64_t> segments;
+   uint64_t freeTotal;
+
+   void Reset(const VerifyParams & newParams);
+   void Remove(uint32_t pn);
+   void Insert(uint32_t pn, const GPTPart & part);
+   void AddClean(uint32_t pn);
+   void RemoveClean(uint32_t pn);
+   void CountGap(const SlotState* prev, const SlotState* next, int sign);
+   void CountSegment(uint64_t first, uint64_t last, int sign);
+public:
+   VerifyCache(void);
+
+   void Invalidate(void);
+   void MarkDirty(uint32_t pn);
+   uint32_t Update(const PartitionStore & parts, const VerifyParams & newParams);
+
+   // Results of the last Update()....
+   const set<pair<uint32_t, uint32_t> > & Overlaps(void) const {return overlaps;}
+   const map<uint32_t, uint32_t> & Flagged(void) const {return flagged;}
+   const set<uint32_t> & DuplicateGUIDs(void) const {return dupSlots;}
+   uint32_t FirstWithGUID(uint32_t pn) const;
+   uint64_t FirstUsed(void) const {return firsts.empty() ? UINT64_MAX : *firsts.begin();}
+   uint64_t LastUsed(void) const {return lasts.empty() ? 0 : *lasts.rbegin();}
+   int HasExtent(uint64_t first, uint64_t last) const;
+   uint64_t FreeSummary(uint32_t *numSegments, uint64_t *largestSegment) const;
+}; // class VerifyCache
+
+#endif
@@ -0,0 +1,381 @@
+// verifyreport.cc
+// Class to hold the results of verifying a disk's partition data, and to
+// show them as text (the traditional gdisk/sgdisk verification report) or
+// as JSON.
+
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+#include <stdint.h>
+#include <iostream>
+#include "verifyreport.h"
+#include "jsonout.h"
+#include "support.h"
+
+using namespace std;
+
+// Indexed by VerifyCode
+static const VerifyCodeInfo codeInfo[] = {
+   {"main_header_crc", verify_problem, NULL, 0, {NULL}, {NULL}},
+   {"main_table_crc", verify_problem, NULL, 0, {NULL}, {NULL}},
+   {"backup_header_crc", verify_problem, NULL, 0, {NULL}, {NULL}},
+   {"backup_table_crc", verify_problem, NULL, 0, {NULL}, {NULL}},
+   {"main_self_pointer", verify_problem, NULL, 0, {NULL}, {NULL}},
+   {"backup_self_pointer", verify_problem, NULL, 0, {NULL}, {NULL}},
+   {"main_current_lba", verify_problem, NULL, 0, {"main_current_lba", "backup_alternate_lba"}, {NULL}},
+   {"main_backup_lba", verify_problem, NULL, 0, {"main_backup_lba", "backup_current_lba"}, {NULL}},
+   {"first_usable_mismatch", verify_problem, NULL, 0, {"main_first_usable", "backup_first_usable"}, {NULL}},
+   {"last_usable_mismatch", verify_problem, NULL, 0, {"main_last_usable", "backup_last_usable"}, {NULL}},
+   {"disk_guid_mismatch", verify_problem, NULL, 0, {NULL}, {"main_disk_guid", "backup_disk_guid"}},
+   {"num_parts_mismatch", verify_problem, NULL, 0, {"main_num_parts", "backup_num_parts"}, {NULL}},
+   {"entry_size_mismatch", verify_problem, NULL, 0, {"main_entry_size", "backup_entry_size"}, {NULL}},
+   {"disk_too_small", verify_problem, NULL, 0, {"disk_sectors", "needed_sectors"}, {NULL}},
+   {"main_table_past_first_usable", verify_problem, NULL, 0, {NULL}, {NULL}},
+   {"main_table_too_early", verify_problem, NULL, 0, {NULL}, {NULL}},
+   {"backup_table_overlaps_header", verify_problem, NULL, 0, {NULL}, {NULL}},
+   {"main_table_gap", verify_warning, NULL, 0, {"main_table_lba"}, {NULL}},
+   {"first_usable_gap", verify_warning, NULL, 0, {"main_table_last_lba", "first_usable"}, {NULL}},
+   {"table_too_small", verify_warning, NULL, 0, {"table_bytes"}, {NULL}},
+   {"last_usable_too_big", verify_problem, NULL, 0, {"last_usable", "backup_lba", "disk_sectors"}, {NULL}},
+   {"overlap", verify_problem, "partitions", 2,
+    {"first_lba_1", "last_lba_1", "first_lba_2", "last_lba_2"}, {NULL}},
+   {"duplicate_guid", verify_problem, "partitions", 2, {NULL}, {"guid"}},
+   {"backwards", verify_problem, "partitions", 1, {NULL}, {NULL}},
+   {"too_big", verify_problem, "partitions", 1, {NULL}, {NULL}},
+   {"hybrid_mismatch", verify_problem, "mbr_partitions", 1, {"mbr_type"}, {NULL}},
+   {"mbr_overlap", verify_problem, "mbr_partitions", 2, {NULL}, {NULL}},
+   {"mbr_multiple_ee", verify_note, NULL, 0, {NULL}, {NULL}},
+   {"mbr_ee_not_on_1", verify_warning, NULL, 0, {NULL}, {NULL}},
+   {"ee_active", verify_warning, NULL, 0, {NULL}, {NULL}},
+   {"main_table_overlaps_partition", verify_problem, NULL, 0, {"overlap_sectors", "first_used_lba"}, {NULL}},
+   {"backup_table_overlaps_partition", verify_problem, NULL, 0,
+    {"overlap_sectors", "last_used_lba", "disk_sectors"}, {NULL}},
+   {"mbr_too_big", verify_problem, NULL, 0, {NULL}, {NULL}},
+   {"misaligned", verify_note, "partitions", 1, {"alignment"}, {NULL}},
+   {"topology_hint", verify_note, NULL, 0,
+    {"minimum_io_bytes", "optimal_io_bytes", "erase_bytes", "alignment"}, {NULL}},
+   {"alignment_advice", verify_note, NULL, 0, {NULL}, {NULL}},
+   {"off_zone", verify_note, "partitions", 1, {"zone_sectors"}, {NULL}},
+   {"align_offset", verify_note, NULL, 0, {"offset_bytes"}, {NULL}},
+   {"free_space", verify_note, NULL, 0,
+    {"free_sectors", "segments", "largest_segment", "sector_size"}, {NULL}}
+};
+
+static const char* severityNames[] = {"note", "warning", "problem"};
+
+// Record a result and return it, so that the caller can fill in its GUIDs.
+VerifyProblem & VerifyReport::Add(VerifyCode code, uint32_t part1, uint32_t part2,
+                                  uint64_t value1, uint64_t value2, uint64_t value3,
+                                  uint64_t value4) {
+   VerifyProblem problem;
+
+   problem.code = code;
+   problem.severity = Describe(code).severity;
+   problem.partNums[0] = part1;
+   problem.partNums[1] = part2;
+   problem.values[0] = value1;
+   problem.values[1] = value2;
+   problem.values[2] = value3;
+   problem.values[3] = value4;
+   problems.push_back(problem);
+   return problems.back();
+} // VerifyReport::Add()
+
+// Add another report's results to the end of this one.
+void VerifyReport::Append(const VerifyReport & other) {
+   problems.insert(problems.end(), other.problems.begin(), other.problems.end());
+} // VerifyReport::Append()
+
+// Returns the number of results that are real problems (as opposed to
+// warnings and notes).
+int VerifyReport::NumProblems(void) const {
+   int num = 0;
+
+   for (const VerifyProblem & problem : problems)
+      if (problem.severity == verify_problem)
+         num++;
+   return num;
+} // VerifyReport::NumProblems()
+
+// Returns the number of results with the given code.
+int VerifyReport::CountCode(VerifyCode code) const {
+   int num = 0;
+
+   for (const VerifyProblem & problem : problems)
+      if (problem.code == code)
+         num++;
+   return num;
+} // VerifyReport::CountCode()
+
+// Returns the name, severity, and field names for a code.
+const VerifyCodeInfo & VerifyReport::Describe(VerifyCode code) {
+   return codeInfo[code];
+} // VerifyReport::Describe()
+
+// Show the results as the traditional verification report.
+void VerifyReport::ShowText(ostream & os) const {
+   uint32_t p1, p2;
+   const uint64_t* v;
+
+   for (const VerifyProblem & problem : problems) {
+      p1 = problem.partNums[0] + 1;
+      p2 = problem.partNums[1] + 1;
+      v = problem.values;
+      switch (problem.code) {
+         case verify_main_header_crc:
+            os << "\nProblem: The CRC for the main GPT header is invalid. The main GPT header may\n"
+               << "be corrupt. Consider loading the backup GPT header to rebuild the main GPT\n"
+               << "header ('b' on the recovery & transformation menu). This report may be a false\n"
+               << "alarm if you've already corrected other problems.\n";
+            break;
+         case verify_main_table_crc:
+            os << "\nProblem: The CRC for the main partition table is invalid. This table may be\n"
+               << "corrupt. Consider loading the backup partition table ('c' on the recovery &\n"
+               << "transformation menu). This report may be a false alarm if you've already\n"
+               << "corrected other problems.\n";
+            break;
+         case verify_backup_header_crc:
+            os << "\nProblem: The CRC for the backup GPT header is invalid. The backup GPT header\n"
+               << "may be corrupt. Consider using the main GPT header to rebuild the backup GPT\n"
+               << "header ('d' on the recovery & transformation menu). This report may be a false\n"
+               << "alarm if you've already corrected other problems.\n";
+            break;
+         case verify_backup_table_crc:
+            os << "\nCaution: The CRC for the backup partition table is invalid. This table may\n"
+               << "be corrupt. This program will automatically create a new backup partition\n"
+               << "table when you save your partitions.\n";
+            break;
+         case verify_main_self_pointer:
+            os << "\nProblem: The main header's self-pointer doesn't point to itself. This problem\n"
+               << "is being automatically corrected, but it may be a symptom of more serious\n"
+               << "problems. Think carefully before saving changes with 'w' or using this disk.\n";
+            break;
+         case verify_backup_self_pointer:
+            os << "\nProblem: The secondary header's self-pointer indicates that it doesn't reside\n"
+               << "at the end of the disk. If you've added a disk to a RAID array, use the 'e'\n"
+               << "option on the experts' menu to adjust the secondary header's and partition\n"
+               << "table's locations.\n";
+            break;
+         case verify_main_current_lba:
+            os << "\nProblem: main GPT header's current LBA pointer (" << v[0]
+               << ") doesn't\nmatch the backup GPT header's alternate LBA pointer("
+               << v[1] << ").\n";
+            break;
+         case verify_main_backup_lba:
+            os << "\nProblem: main GPT header's backup LBA pointer (" << v[0]
+               << ") doesn't\nmatch the backup GPT header's current LBA pointer ("
+               << v[1] << ").\n"
+               << "The 'e' option on the experts' menu may fix this problem.\n";
+            break;
+         case verify_first_usable_mismatch:
+            os << "\nProblem: main GPT header's first usable LBA pointer (" << v[0]
+               << ") doesn't\nmatch the backup GPT header's first usable LBA pointer ("
+               << v[1] << ")\n";
+            break;
+         case verify_last_usable_mismatch:
+            os << "\nProblem: main GPT header's last usable LBA pointer (" << v[0]
+               << ") doesn't\nmatch the backup GPT header's last usable LBA pointer ("
+               << v[1] << ")\n"
+               << "The 'e' option on the experts' menu can probably fix this problem.\n";
+            break;
+         case verify_disk_guid_mismatch:
+            os << "\nProblem: main header's disk GUID (" << problem.guids[0]
+               << ") doesn't\nmatch the backup GPT header's disk GUID ("
+               << problem.guids[1] << ")\n"
+               << "You should use the 'b' or 'd' option on the recovery & transformation menu to\n"
+               << "select one or the other header.\n";
+            break;
+         case verify_num_parts_mismatch:
+            os << "\nProblem: main GPT header's number of partitions (" << v[0]
+               << ") doesn't\nmatch the backup GPT header's number of partitions ("
+               << v[1] << ")\n"
+               << "Resizing the partition table ('s' on the experts' menu) may help.\n";
+            break;
+         case verify_entry_size_mismatch:
+            os << "\nProblem: main GPT header's size of partition entries ("
+               << v[0] << ") doesn't\n"
+               << "match the backup GPT header's size of partition entries ("
+               << v[1] << ")\n"
+               << "You should use the 'b' or 'd' option on the recovery & transformation menu to\n"
+               << "select one or the other header.\n";
+            break;
+         case verify_disk_too_small:
+            os << "\nProblem: Disk is too small to hold all the data!\n"
+               << "(Disk size is " << v[0] << " sectors, needs to be "
+               << v[1] << " sectors.)\n"
+               << "The 'e' option on the experts' menu may fix this problem.\n";
+            break;
+         case verify_main_table_past_first_usable:
+            os << "\nProblem: Main partition table extends past the first usable LBA.\n"
+               << "Using 'j' on the experts' menu may enable fixing this problem.\n";
+            break;
+         case verify_main_table_too_early:
+            os << "\nProblem: Main partition table appears impossibly early on the disk.\n"
+               << "Using 'j' on the experts' menu may enable fixing this problem.\n";
+            break;
+         case verify_backup_table_overlaps_header:
+            os << "\nProblem: The backup partition table overlaps the backup header.\n"
+               << "Using 'e' on the experts' menu may fix this problem.\n";
+            break;
+         case verify_main_table_gap:
+            os << "\nWarning: There is a gap between the main metadata (sector 1) and the main\n"
+               << "partition table (sector " << v[0]
+               << "). This is helpful in some exotic configurations,\n"
+               << "but is generally ill-advised. Using 'j' on the experts' menu can adjust this\n"
+               << "gap.\n";
+            break;
+         case verify_first_usable_gap:
+            os << "\nWarning: There is a gap between the main partition table (ending sector "
+               << v[0] << ")\n"
+               << "and the first usable sector (" << v[1] << "). This is helpful in some exotic configurations,\n"
+               << "but is unusual. The util-linux fdisk program often creates disks like this.\n"
+               << "Using 'j' on the experts' menu can adjust this gap.\n";
+            break;
+         case verify_table_too_small:
+            os << "\nWarning: The size of the partition table (" << v[0]
+               << " bytes) is less than the minimum\n"
+               << "required by the GPT specification. Most OSes and tools seem to work fine on\n"
+               << "such disks, but this is a violation of the GPT specification and so may cause\n"
+               << "problems.\n";
+            break;
+         case verify_last_usable_too_big:
+            os << "\nProblem: GPT claims the disk is larger than it is! (Claimed last usable\n"
+               << "sector is " << v[0] << ", but backup header is at\n"
+               << v[1] << " and disk size is " << v[2] << " sectors.\n"
+               << "The 'e' option on the experts' menu will probably fix this problem\n";
+            break;
+         case verify_overlap:
+            os << "\nProblem: partitions " << p1 << " and " << p2 << " overlap:\n";
+            os << "  Partition " << p1 << ": " << v[0] << " to " << v[1] << "\n";
+            os << "  Partition " << p2 << ": " << v[2] << " to " << v[3] << "\n";
+            break;
+         case verify_duplicate_guid:
+            os << "\nProblem: partitions " << p1 << " and " << p2
+               << " have the same unique GUID\n(" << problem.guids[0]
+               << "). Use 'f' on the experts' menu (or sgdisk's\n"
+               << "-G option) to assign new GUIDs.\n";
+            break;
+         case verify_backwards:
+            os << "\nProblem: partition " << p1 << " ends before it begins.\n";
+            break;
+         case verify_too_big:
+            os << "\nProblem: partition " << p1 << " is too big for the disk.\n";
+            break;
+         case verify_hybrid_mismatch:
+            os << "\nWarning! Mismatched GPT and MBR partition! MBR partition "
+               << p1 << ", of type 0x";
+            os.fill('0');
+            os.setf(ios::uppercase);
+            os.width(2);
+            os << hex << (int) v[0] << ",\n"
+               << "has no corresponding GPT partition! You may continue, but this condition\n"
+               << "might cause data loss in the future!\a\n" << dec;
+            os.fill(' ');
+            break;
+         case verify_mbr_overlap:
+            os << "\nProblem: MBR partitions " << p1 << " and " << p2
+               << " overlap!\n";
+            break;
+         case verify_mbr_multiple_ee:
+            os << "\nCaution: More than one 0xEE MBR partition found. This can cause problems\n"
+               << "in some OSes.\n";
+            break;
+         case verify_mbr_ee_not_on_1:
+            os << "\nWarning: 0xEE partition doesn't start on sector 1. This can cause "
+               << "problems\nin some OSes.\n";
+            break;
+         case verify_ee_active:
+            os << "\nWarning: The 0xEE protective partition in the MBR is marked as active. This is\n"
+               << "technically a violation of the GPT specification, and can cause some EFIs to\n"
+               << "ignore the disk, but it is required to boot from a GPT disk on some BIOS-based\n"
+               << "computers. You can clear this flag by creating a fresh protective MBR using\n"
+               << "the 'n' option on the experts' menu.\n";
+            break;
+         case verify_main_table_overlaps_partition:
+            os << "Warning! Main partition table overlaps the first partition by "
+               << v[0] << " blocks!\n";
+            if (v[1] > 2) {
+               os << "Try reducing the partition table size by " << v[0] * 4
+                  << " entries.\n(Use the 's' item on the experts' menu.)\n";
+            } else {
+               os << "You will need to delete this partition or resize it in another utility.\n";
+            } // if/else
+            break;
+         case verify_backup_table_overlaps_partition:
+            os << "\nWarning! Secondary partition table overlaps the last partition by\n"
+               << v[0] << " blocks!\n";
+            if (v[1] > (v[2] - 2)) {
+               os << "You will need to delete this partition or resize it in another utility.\n";
+            } else {
+               os << "Try reducing the partition table size by " << v[0] * 4
+                  << " entries.\n(Use the 's' item on the experts' menu.)\n";
+            } // if/else
+            break;
+         case verify_mbr_too_big:
+            os << "\nPartition(s) in the protective MBR are too big for the disk! Creating a\n"
+               << "fresh protective or hybrid MBR is recommended.\n";
+            break;
+         case verify_misaligned:
+            os << "\nCaution: Partition " << p1 << " doesn't begin on a "
+               << v[0] << "-sector boundary. This may\nresult "
+               << "in degraded performance on some modern (2009 and later) hard disks.\n";
+            break;
+         case verify_topology_hint:
+            os << "\nThe kernel reports a minimum I/O size of " << v[0]
+               << " bytes, an optimal I/O size of\n" << v[1] << " bytes, and an erase size of "
+               << v[2] << " bytes for this device, so partitions\nshould "
+               << "begin on multiples of " << v[3] << " sectors.\n";
+            break;
+         case verify_alignment_advice:
+            os << "\nConsult http://www.ibm.com/developerworks/linux/library/l-4kb-sector-disks/\n"
+               << "for information on disk alignment.\n";
+            break;
+         case verify_off_zone:
+            os << "\nCaution: Partition " << p1 << " doesn't begin and end on "
+               << v[0] << "-sector zone\nboundaries. Zoned filesystems may "
+               << "refuse to use it.\n";
+            break;
+         case verify_align_offset:
+            os << "\nCaution: This device's natural alignment is offset by " << v[0]
+               << " bytes from its\nstart. Partitions aligned by GPT fdisk don't allow for this offset.\n";
+            break;
+         case verify_free_space:
+            os << "\nNo problems found. " << v[0] << " free sectors ("
+               << BytesToIeee(v[0], (uint32_t) v[3]) << ") available in "
+               << v[1] << "\nsegments, the largest of which is "
+               << v[2] << " (" << BytesToIeee(v[2], (uint32_t) v[3])
+               << ") in size.\n";
+            break;
+      } // switch
+   } // for
+} // VerifyReport::ShowText()
+
+// Show the results as a JSON object: the number of problems and an array
+// of results, one per line, each with its code, severity, 1-based
+// partition numbers, and named values.
+void VerifyReport::ShowJSON(ostream & os) const {
+   JSONWriter json;
+   int j;
+
+   json.BeginObject().Put("problems", NumProblems());
+   json.Key("results").BeginArray();
+   for (const VerifyProblem & problem : problems) {
+      const VerifyCodeInfo & info = Describe(problem.code);
+
+      json.BeginObject(1).Put("code", info.name);
+      json.Put("severity", severityNames[problem.severity]);
+      if (info.numParts > 0) {
+         json.Key(info.partsName).BeginArray();
+         for (j = 0; j < info.numParts; j++)
+            json.PutDec(problem.partNums[j] + 1);
+         json.EndArray();
+      } // if
+      for (j = 0; (j < 4) && (info.valueNames[j] != NULL); j++)
+         json.Put(info.valueNames[j], problem.values[j]);
+      for (j = 0; (j < 2) && (info.guidNames[j] != NULL); j++)
+         json.Put(info.guidNames[j], problem.guids[j]);
+      json.EndObject();
+   } // for
+   json.EndArray().EndObject();
+   json.Flush(os);
+} // VerifyReport::ShowJSON()
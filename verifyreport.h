@@ -0,0 +1,82 @@
+/* This program is copyright (c) 2020 by Roderick W. Smith. It is distributed
+  under the terms of the GNU GPL version 2, as detailed in the COPYING file. */
+
+// Structured verification results. GPTData::Verify(VerifyReport &) and the
+// checks it calls record each problem they find as a VerifyProblem (a code,
+// a severity, and the partition numbers, LBAs, and other values involved)
+// rather than writing prose to cout. A VerifyReport can then be shown as
+// the traditional text or as JSON, or examined directly by library users.
+
+#include <stdint.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef __GPT_VERIFY_REPORT
+#define __GPT_VERIFY_REPORT
+
+using namespace std;
+
+// What a check found. Keep in step with the table in verifyreport.cc.
+enum VerifyCode {
+   verify_main_header_crc, verify_main_table_crc, verify_backup_header_crc,
+   verify_backup_table_crc, verify_main_self_pointer, verify_backup_self_pointer,
+   verify_main_current_lba, verify_main_backup_lba, verify_first_usable_mismatch,
+   verify_last_usable_mismatch, verify_disk_guid_mismatch, verify_num_parts_mismatch,
+   verify_entry_size_mismatch, verify_disk_too_small, verify_main_table_past_first_usable,
+   verify_main_table_too_early, verify_backup_table_overlaps_header, verify_main_table_gap,
+   verify_first_usable_gap, verify_table_too_small, verify_last_usable_too_big,
+   verify_overlap, verify_duplicate_guid, verify_backwards, verify_too_big,
+   verify_hybrid_mismatch, verify_mbr_overlap, verify_mbr_multiple_ee,
+   verify_mbr_ee_not_on_1, verify_ee_active, verify_main_table_overlaps_partition,
+   verify_backup_table_overlaps_partition, verify_mbr_too_big, verify_misaligned,
+   verify_topology_hint, verify_alignment_advice, verify_off_zone, verify_align_offset,
+   verify_free_space
+}; // enum VerifyCode
+
+// Only verify_problem results count as problems in Verify()'s return value
+enum VerifySeverity {verify_note, verify_warning, verify_problem};
+
+#define VERIFY_NO_PART UINT32_MAX
+
+// One result. Which of the partition numbers (0-based), values, and GUIDs
+// are meaningful depends on the code; see VerifyReport::Describe().
+struct VerifyProblem {
+   VerifyCode code;
+   VerifySeverity severity;
+   uint32_t partNums[2];
+   uint64_t values[4];
+   string guids[2];
+}; // struct VerifyProblem
+
+// What the fields of a VerifyProblem with a given code mean
+struct VerifyCodeInfo {
+   const char* name;
+   VerifySeverity severity;
+   const char* partsName; // "partitions", "mbr_partitions", or NULL for none
+   int numParts;
+   const char* valueNames[4]; // NULL for unused values
+   const char* guidNames[2];
+}; // struct VerifyCodeInfo
+
+class VerifyReport {
+protected:
+   vector<VerifyProblem> problems;
+public:
+   VerifyReport(void) {}
+
+   VerifyProblem & Add(VerifyCode code, uint32_t part1 = VERIFY_NO_PART,
+                       uint32_t part2 = VERIFY_NO_PART, uint64_t value1 = 0,
+                       uint64_t value2 = 0, uint64_t value3 = 0, uint64_t value4 = 0);
+   void Append(const VerifyReport & other);
+   void Clear(void) {problems.clear();}
+   const vector<VerifyProblem> & GetProblems(void) const {return problems;}
+   int NumProblems(void) const;
+   int CountCode(VerifyCode code) const;
+
+   static const VerifyCodeInfo & Describe(VerifyCode code);
+   void ShowText(ostream & os) const;
+   void ShowJSON(ostream & os) const;
+}; // class VerifyReport
+
+#endif